@@ -6,12 +6,18 @@
 #include "color_plate_scanner.hpp"
 
 namespace Invader {
+    enum BitmapSpritePackingAlgorithm {
+        BITMAP_SPRITE_PACKING_ALGORITHM_LEGACY,
+        BITMAP_SPRITE_PACKING_ALGORITHM_MAXRECTS
+    };
+    
     struct BitmapProcessorSpriteParameters {
         BitmapSpriteUsage sprite_usage;
         std::uint32_t sprite_budget;
         std::uint32_t sprite_budget_count;
         std::uint32_t sprite_spacing;
         bool force_square_sprite_sheets;
+        BitmapSpritePackingAlgorithm sprite_packing_algorithm = BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_LEGACY;
     };
     
     class BitmapProcessor {
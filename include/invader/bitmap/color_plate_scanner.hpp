@@ -85,7 +85,81 @@ namespace Invader {
             bool reg_point_hack
         );
 
+        /**
+         * Begin scanning a color plate whose rows will be passed in with add_rows()
+         * @param  width              width of color plate
+         * @param  height             height of color plate
+         * @param  type               type of bitmap
+         * @param  usage              usage value for bitmap
+         * @param  reg_point_hack     ignore sequence dividers when calculating registration point
+         */
+        ColorPlateScanner(std::uint32_t width, std::uint32_t height, BitmapType type, BitmapUsage usage, bool reg_point_hack);
+
+        /**
+         * Add the next rows of the color plate, top to bottom. Sequences are scanned as soon as they end, and their rows are then discarded.
+         * @param pixels    pointer to the first pixel of the first row
+         * @param row_count number of rows
+         */
+        void add_rows(const Pixel *pixels, std::uint32_t row_count);
+
+        /**
+         * Finish scanning the color plate once all rows were added
+         * @return scanned color plate data
+         */
+        GeneratedBitmapData finish();
+
     private:
+        enum ColorPlateKey {
+            /** Row 0 hasn't been read yet */
+            COLOR_PLATE_KEY_UNKNOWN,
+
+            /** No color plate key; the whole image is kept */
+            COLOR_PLATE_KEY_NONE,
+
+            /** Too small to hold a key (less than 4x2), so there are no sequences or bitmaps */
+            COLOR_PLATE_KEY_TOO_SMALL,
+
+            /** Sequences are separated by sequence divider rows */
+            COLOR_PLATE_KEY_SEQUENCE_DIVIDER,
+
+            /** Sequences are separated by rows of transparency */
+            COLOR_PLATE_KEY_TRANSPARENCY_DIVIDER
+        };
+
+        /** Color plate dimensions */
+        std::uint32_t width;
+        std::uint32_t height;
+
+        /** Ignore sequence dividers when calculating registration point */
+        bool reg_point_hack;
+
+        /** Kind of color plate key found on row 0 */
+        ColorPlateKey key = COLOR_PLATE_KEY_UNKNOWN;
+
+        /** Number of rows added so far */
+        std::uint32_t rows_read = 0;
+
+        /** Start of the sequence currently being read, if any */
+        std::optional<std::uint32_t> sequence_start;
+
+        /** Rows of the sequence currently being read (or the whole image if there is no key) */
+        std::vector<Pixel> pending_rows;
+
+        /** Number of 64-bit words in a row's pixel mask */
+        std::size_t mask_words_per_row;
+
+        /** Per-row bitmasks of the pending rows' pixels that aren't transparency or sequence dividers */
+        std::vector<std::uint64_t> pending_visible_masks;
+
+        /** Per-row bitmasks of the pending rows' pixels that aren't spacing, either (i.e. actual bitmap data) */
+        std::vector<std::uint64_t> pending_content_masks;
+
+        /** Scratch transparency, sequence divider, and spacing masks for the row being added */
+        std::vector<std::uint64_t> row_masks;
+
+        /** Output */
+        GeneratedBitmapData generated_bitmap;
+
         /** Is power of two required */
         bool power_of_two = true;
 
@@ -120,20 +194,29 @@ namespace Invader {
         bool is_spacing_color(const Pixel &color) const;
 
         /**
-         * Check if the color is ignored
-         * @param  color color to check
-         * @return       true if ignored
+         * Read the color plate key from the first row
+         * @param row first row
          */
-        bool is_ignored(const Pixel &color) const;
+        void read_color_plate_key(const Pixel *row);
 
         /**
-         * Read the color plate data bitmap data
-         * @param generated_bitmap bitmap data to write to (output)
-         * @param pixels           pixel input
-         * @param width            width of input
-         * @param reg_point_hack   ignore sequence edges
+         * Handle the next row of the color plate
+         * @param row row to handle
+         */
+        void add_row(const Pixel *row);
+
+        /**
+         * Scan the pending rows as a sequence ending at the given row and discard them
+         * @param y_end row after the last row of the sequence
          */
-        void read_color_plate(GeneratedBitmapData &generated_bitmap, const Pixel *pixels, std::uint32_t width, bool reg_point_hack) const;
+        void end_sequence(std::uint32_t y_end);
+
+        /**
+         * Read the bitmaps in a sequence
+         * @param sequence         sequence to read (y_start and y_end must be set)
+         * @param pixels           pixel input, starting at the sequence's first row
+         */
+        void read_sequence(GeneratedBitmapDataSequence &sequence, const Pixel *pixels);
 
         /**
          * Read an unrolled cubemap
@@ -152,8 +235,6 @@ namespace Invader {
          * @param height           height of input
          */
         void read_single_bitmap(GeneratedBitmapData &generated_bitmap, const Pixel *pixels, std::uint32_t width, std::uint32_t height) const;
-
-        ColorPlateScanner() = default;
     };
 }
 #endif
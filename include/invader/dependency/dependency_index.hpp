@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__DEPENDENCY__DEPENDENCY_INDEX_HPP
+#define INVADER__DEPENDENCY__DEPENDENCY_INDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../file/file.hpp"
+
+namespace Invader {
+    /**
+     * Index of the references of every tag in a set of tags directories, and of what references each tag.
+     *
+     * The index can be saved to a file and brought up to date later, in which case only tags that were added or changed (by modification time
+     * or size) since it was saved are read again. Index files are only meant to be read on the machine that wrote them.
+     */
+    class DependencyIndex {
+    public:
+        struct IndexedTag {
+            /** Path (with Halo path separators) and class of the tag */
+            File::TagFilePath tag;
+
+            /** Path to the tag file */
+            std::filesystem::path file_path;
+
+            /** Modification time of the tag file when it was read */
+            std::int64_t modified = 0;
+
+            /** Size of the tag file when it was read */
+            std::uint64_t size = 0;
+
+            /** The tag could not be read, so it has no references */
+            bool invalid = false;
+
+            /** References in the tag, in the order they're stored, without duplicates */
+            std::vector<File::TagFilePath> dependencies;
+        };
+
+        struct UpdateResult {
+            /** Number of tags that were read */
+            std::size_t read = 0;
+
+            /** Number of tags that were unchanged since the index was saved */
+            std::size_t unchanged = 0;
+
+            /** Number of tags that were removed since the index was saved */
+            std::size_t removed = 0;
+        };
+
+        /**
+         * Load an index. If the file doesn't exist (or isn't a valid index), the index is empty and needs to be updated.
+         * @param path path to the index file
+         * @return     index
+         */
+        static DependencyIndex load(const std::filesystem::path &path);
+
+        /**
+         * Save the index
+         * @param path path to the index file
+         * @return     true on success; false on failure
+         */
+        bool save(const std::filesystem::path &path) const;
+
+        /**
+         * Bring the index up to date with the tags directories, reading tags that were added or changed on multiple threads
+         * @param tags_directories tags directories, ordered by precedence
+         * @return                 what was done
+         */
+        UpdateResult update(const std::vector<std::filesystem::path> &tags_directories);
+
+        /**
+         * Get a tag in the index
+         * @param tag path (with Halo path separators) and class of the tag
+         * @return    tag, or nullptr if the tag doesn't exist
+         */
+        const IndexedTag *get_tag(const File::TagFilePath &tag) const;
+
+        /**
+         * Get all tags that reference a tag
+         * @param tag path (with Halo path separators) and class of the tag
+         * @return    tags that reference the tag
+         */
+        std::vector<const IndexedTag *> get_dependents(const File::TagFilePath &tag) const;
+
+        /**
+         * Get all tags referenced by a tag, and all tags referenced by those, and so on, in the order they are found
+         * @param tag path (with Halo path separators) and class of the tag
+         * @return    referenced tags (including tags that don't exist)
+         */
+        std::vector<File::TagFilePath> get_dependencies_recursive(const File::TagFilePath &tag) const;
+
+        /**
+         * Get all tags that reference a tag, and all tags that reference those, and so on, in the order they are found
+         * @param tag path (with Halo path separators) and class of the tag
+         * @return    tags that reference the tag
+         */
+        std::vector<const IndexedTag *> get_dependents_recursive(const File::TagFilePath &tag) const;
+
+    private:
+        std::vector<IndexedTag> tags;
+
+        /** Index of each tag in tags, by path and extension */
+        std::unordered_map<std::string, std::size_t> tag_indices;
+
+        /** Indices of the tags referencing each tag, by path and extension */
+        std::unordered_map<std::string, std::vector<std::size_t>> dependents;
+
+        /** Rebuild tag_indices and dependents after tags is changed */
+        void build_lookups();
+    };
+}
+
+#endif
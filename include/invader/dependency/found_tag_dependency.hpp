@@ -10,6 +10,8 @@
 #include "../hek/fourcc.hpp"
 
 namespace Invader {
+    class DependencyIndex;
+
     struct FoundTagDependency {
         std::string path;
         Invader::TagFourCC fourcc;
@@ -18,6 +20,18 @@ namespace Invader {
 
         static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success);
 
+        /**
+         * Find dependencies using an index rather than reading tags
+         * @param tag_path_to_find path of the tag (with Halo path separators)
+         * @param tag_int_to_find  class of the tag
+         * @param index            up-to-date index of the tags directories
+         * @param reverse          find tags that depend on the tag, instead
+         * @param recursive        find dependencies of dependencies (or dependents of dependents), too
+         * @param success          set to false if the tag or a dependency could not be read
+         * @return                 tags found
+         */
+        static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, const DependencyIndex &index, bool reverse, bool recursive, bool &success);
+
         FoundTagDependency(std::string path, Invader::TagFourCC fourcc, bool broken, std::optional<std::filesystem::path> file_path) : path(path), fourcc(fourcc), broken(broken), file_path(file_path) {}
     };
 }
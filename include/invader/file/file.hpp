@@ -134,6 +134,12 @@ namespace Invader::File {
      */
     std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates = true, std::pair<std::mutex, std::size_t> *status = nullptr, std::size_t *errors = nullptr);
 
+    /**
+     * Remove tags that are overridden by a tag with the same path in a tags directory with a higher priority, keeping the order of the rest
+     * @param tags tags to filter
+     */
+    void remove_duplicate_tags(std::vector<TagFile> &tags);
+
     /**
      * Convert the tag path to a path using the system's preferred separators
      * @param  tag_path tag path input
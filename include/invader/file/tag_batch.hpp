@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__TAG_BATCH_HPP
+#define INVADER__FILE__TAG_BATCH_HPP
+
+#include <cstddef>
+#include <cstdarg>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Invader::File {
+    /**
+     * Runs a function on many tags on multiple threads.
+     *
+     * Worker threads take the next tag by incrementing an atomic counter, so they never wait on each other. Messages for a tag are buffered
+     * and printed by the calling thread in the order the tags were given once each tag is done, so output from different tags is never mixed.
+     */
+    class TagBatch {
+    public:
+        /** Result of processing a tag */
+        enum Result {
+            /** The tag could not be processed */
+            RESULT_FAILED,
+
+            /** The tag was processed, but nothing had to be changed */
+            RESULT_UNCHANGED,
+
+            /** The tag was processed and changed */
+            RESULT_CHANGED
+        };
+
+        /** Messages for one tag, held until the tag is done */
+        class Output {
+        public:
+            /**
+             * Add a message, printed like oprintf (with a newline), oprintf_success, oprintf_success_warn, eprintf_warn, or eprintf_error,
+             * respectively
+             */
+            void message(const char *format, ...) __attribute__((format(printf, 2, 3)));
+            void success(const char *format, ...) __attribute__((format(printf, 2, 3)));
+            void success_warn(const char *format, ...) __attribute__((format(printf, 2, 3)));
+            void warning(const char *format, ...) __attribute__((format(printf, 2, 3)));
+            void error(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+            /**
+             * Print every message in the order they were added, and then remove them
+             */
+            void print();
+
+            /**
+             * Get whether there are no messages to print
+             * @return true if there are no messages
+             */
+            bool empty() const noexcept {
+                return this->messages.empty();
+            }
+
+        private:
+            enum Level {
+                LEVEL_MESSAGE,
+                LEVEL_SUCCESS,
+                LEVEL_SUCCESS_WARN,
+                LEVEL_WARNING,
+                LEVEL_ERROR
+            };
+
+            void add(Level level, const char *format, std::va_list args);
+            std::vector<std::pair<Level, std::string>> messages;
+        };
+
+        struct Summary {
+            /** Number of tags that could not be processed */
+            std::size_t failed = 0;
+
+            /** Number of tags that did not need to be changed */
+            std::size_t unchanged = 0;
+
+            /** Number of tags that were changed */
+            std::size_t changed = 0;
+        };
+
+        /**
+         * Function to run on each tag
+         * @param index  index of the tag
+         * @param output output for any messages about the tag
+         * @return       result
+         */
+        using Function = std::function<Result (std::size_t index, Output &output)>;
+
+        /**
+         * Run a function on each tag, printing the messages for each tag as it finishes. Exceptions thrown by the function are printed as errors,
+         * and the tag is counted as failed.
+         * @param tag_count    number of tags
+         * @param function     function to run on each tag
+         * @param thread_count maximum number of threads to use
+         * @return             number of tags with each result
+         */
+        static Summary run(std::size_t tag_count, const Function &function, std::size_t thread_count);
+
+        /** Result of saving a tag */
+        enum SaveResult {
+            /** The file could not be written */
+            SAVE_RESULT_FAILED,
+
+            /** The file already had the same data, so it was not written */
+            SAVE_RESULT_UNCHANGED,
+
+            /** The file was written */
+            SAVE_RESULT_SAVED
+        };
+
+        /**
+         * Save tag data to a file, skipping the write if the file already has exactly the same data
+         * @param path     path to the file
+         * @param data     data to save
+         * @param original current contents of the file, if already read (otherwise, the file is read if it exists and is the same size)
+         * @return         result
+         */
+        static SaveResult save_if_changed(const std::filesystem::path &path, const std::vector<std::byte> &data, const std::vector<std::byte> *original = nullptr);
+    };
+}
+
+#endif
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__TAG_INDEX_HPP
+#define INVADER__FILE__TAG_INDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "file.hpp"
+
+namespace Invader::File {
+    /**
+     * Listing of the tags in a set of tags directories that can be kept up to date without listing everything again.
+     *
+     * The listing can be saved to a cache file and loaded later, in which case only directories that were modified since are listed again. While
+     * watching (inotify on Linux), only directories that had files added, removed, or renamed are listed again; otherwise, the modification time
+     * of every directory is checked instead.
+     */
+    class TagIndex {
+    public:
+        /**
+         * Make an empty index. Call load() to list the tags.
+         * @param tags_directories tags directories, ordered by precedence
+         */
+        TagIndex(const std::vector<std::filesystem::path> &tags_directories);
+        ~TagIndex();
+
+        TagIndex(const TagIndex &) = delete;
+        TagIndex &operator=(const TagIndex &) = delete;
+
+        /**
+         * Load the listing from a cache file, bringing it up to date, or list the tags directories if there is no usable cache file
+         * @param cache_path path to the cache file, if any
+         * @param status     optional pointer to a size_t to store the current number of tags listed (for status messages)
+         * @return           number of directories that could not be listed
+         */
+        std::size_t load(const std::optional<std::filesystem::path> &cache_path = std::nullopt, std::pair<std::mutex, std::size_t> *status = nullptr);
+
+        /**
+         * Save the listing to a cache file
+         * @param cache_path path to the cache file
+         * @return           true on success; false on failure
+         */
+        bool save(const std::filesystem::path &cache_path) const;
+
+        /**
+         * Start watching the tags directories for changes after they were loaded. If this isn't supported or fails, update() checks modification
+         * times, instead.
+         * @return true if the tags directories are being watched
+         */
+        bool watch();
+
+        /**
+         * Get a file descriptor that becomes readable when there are changes to pass to update()
+         * @return file descriptor, or -1 if not watching
+         */
+        int get_watch_descriptor() const noexcept {
+            return this->watch_descriptor;
+        }
+
+        /**
+         * Bring the listing up to date, listing directories that changed again
+         * @return true if any tags or directories were added or removed
+         */
+        bool update();
+
+        /**
+         * Get all tags, including tags overridden by tags in tags directories with a higher priority
+         * @return all tags
+         */
+        const std::vector<TagFile> &get_all_tags() const noexcept {
+            return this->all_tags;
+        }
+
+        /**
+         * Get all tags, filtering tags overridden by tags in tags directories with a higher priority like load_virtual_tag_folder()
+         * @return tags
+         */
+        std::vector<TagFile> get_tags() const;
+
+    private:
+        struct Directory {
+            /** Tags directory this directory is in */
+            std::size_t priority = 0;
+
+            /** Depth of this directory (1 for the tags directory itself) */
+            std::uint32_t depth = 1;
+
+            /** Virtual path of this directory, ending with a separator unless it's a tags directory */
+            std::string tag_path;
+
+            /** Modification time of the directory when it was listed */
+            std::int64_t modified = 0;
+
+            /** Names of subdirectories */
+            std::vector<std::string> subdirectories;
+
+            /** Tags directly in this directory */
+            std::vector<TagFile> tags;
+
+            /** Watch for this directory, if any */
+            int watch = -1;
+        };
+
+        std::vector<std::filesystem::path> tags_directories;
+
+        /** Every directory listed, by path */
+        std::map<std::string, Directory> directories;
+
+        std::vector<TagFile> all_tags;
+
+        int watch_descriptor = -1;
+        std::unordered_map<int, std::string> watches;
+
+        /** Directories that changed since they were last listed */
+        std::set<std::string> changed_directories;
+
+        /** Every directory has to be checked (for example, if watch events were lost) */
+        bool check_all_directories = false;
+
+        /** Status passed to load(), if any */
+        std::pair<std::mutex, std::size_t> *status = nullptr;
+
+        /** Number of directories that could not be listed since errors were last reset */
+        std::size_t errors = 0;
+
+        /** Watch (if watch_descriptor isn't -1) and list a directory, throwing if it can't be listed */
+        static void read_directory(const std::string &path, Directory &directory, int watch_descriptor);
+
+        /** List directories and all of their subdirectories (priority, depth, and tag_path need to be set for each) */
+        void add_directories(std::vector<std::pair<std::string, Directory>> directories_to_add);
+
+        /** Remove a directory and all of its subdirectories */
+        void remove_directory(const std::string &path);
+
+        /** List a directory again, returning true if anything changed */
+        bool relist_directory(const std::string &path);
+
+        /** List every directory with a different modification time again, returning true if anything changed */
+        bool check_directories();
+
+        /** Read the cache file, returning false if it can't be used */
+        bool load_cache(const std::filesystem::path &cache_path);
+
+        /** Stop watching everything, falling back to checking modification times */
+        void stop_watching();
+
+        /** Rebuild all_tags */
+        void gather_tags();
+    };
+}
+
+#endif
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__HEK__BULK_SWAP_HPP
+#define INVADER__HEK__BULK_SWAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <numeric>
+#include <vector>
+
+namespace Invader::HEK {
+    /**
+     * Converts arrays of a struct from one endianness to another all at once by shuffling bytes, rather than reading each field individually.
+     *
+     * The shuffle is worked out from the struct's own endian conversion operator, so it handles whatever fields the struct has. Bytes that the
+     * conversion doesn't copy (such as padding) are zeroed, and if the conversion does anything other than move bytes around (such as checking
+     * that strings are terminated), it's used as-is instead. SSSE3 or NEON shuffles are used when available.
+     */
+    class BulkSwap {
+    public:
+        /** Maximum number of structs a caller should convert at once to keep the converted copy in cache */
+        static constexpr std::size_t BLOCK_SIZE = 64;
+
+        /**
+         * Get the shuffle for converting From to To
+         * @return shuffle
+         */
+        template<typename From, typename To> static const BulkSwap &for_struct() {
+            static const BulkSwap swap = from_conversion<From, To>();
+            return swap;
+        }
+
+        /**
+         * Convert an array of structs
+         * @param input  structs to convert
+         * @param output where to write the converted structs (must not overlap input)
+         * @param count  number of structs
+         */
+        void swap(const std::byte *input, std::byte *output, std::size_t count) const;
+
+        /**
+         * Get whether structs are converted by shuffling bytes, rather than by converting each struct (see for_struct())
+         * @return true if shuffling
+         */
+        bool is_shuffle() const noexcept {
+            return this->convert_each == nullptr;
+        }
+
+        /**
+         * Make a shuffle
+         * @param source      for each byte of the output struct, the byte of the input struct to copy, or -1 to zero it
+         * @param struct_size size of the struct in bytes
+         */
+        BulkSwap(const std::int32_t *source, std::size_t struct_size);
+
+    private:
+        std::size_t struct_size;
+        std::vector<std::int32_t> source;
+
+        /** Shuffle masks for each 16-byte block, repeating every lcm(struct_size, 16) bytes of the array; empty if they can't be used */
+        std::vector<std::uint8_t> masks;
+
+        /** Conversion to fall back to if the struct's conversion turned out not to be a shuffle */
+        void (*convert_each)(const std::byte *input, std::byte *output, std::size_t count) = nullptr;
+
+        /** Copy bytes in the range [begin, end) of the array one at a time */
+        void swap_bytes(const std::byte *input, std::byte *output, std::size_t begin, std::size_t end) const;
+
+        BulkSwap(std::size_t struct_size, void (*convert_each)(const std::byte *input, std::byte *output, std::size_t count)) : struct_size(struct_size), convert_each(convert_each) {}
+
+        template<typename From, typename To> static void convert_structs(const std::byte *input, std::byte *output, std::size_t count) {
+            for(std::size_t i = 0; i < count; i++) {
+                const auto &from = *reinterpret_cast<const From *>(input + i * sizeof(From));
+                *reinterpret_cast<To *>(output + i * sizeof(To)) = from;
+            }
+        }
+
+        template<typename From, typename To> static BulkSwap from_conversion() {
+            static_assert(sizeof(From) == sizeof(To), "structs must be the same size");
+            static_assert(sizeof(From) <= 0x1000, "struct is too big");
+            constexpr std::size_t size = sizeof(From);
+
+            try {
+                // Convert structs filled with each byte's index (six bits of it at a time, so floats never become NaN) and see where each byte ends up
+                std::byte input[size], low[size], high[size], mapped[size];
+                auto convert = [&input](std::uint8_t (*byte_for_index)(std::size_t), std::byte *output) {
+                    for(std::size_t i = 0; i < size; i++) {
+                        input[i] = static_cast<std::byte>(byte_for_index(i));
+                    }
+                    convert_structs<From, To>(input, output, 1);
+                };
+                convert([](std::size_t i) { return static_cast<std::uint8_t>(i & 0x3F); }, low);
+                convert([](std::size_t i) { return static_cast<std::uint8_t>(i >> 6); }, high);
+                convert([](std::size_t) { return static_cast<std::uint8_t>(1); }, mapped);
+
+                std::int32_t source[size];
+                for(std::size_t i = 0; i < size; i++) {
+                    source[i] = mapped[i] == std::byte { 1 } ? static_cast<std::int32_t>(std::to_integer<int>(low[i]) | (std::to_integer<int>(high[i]) << 6)) : -1;
+                }
+                BulkSwap swap(source, size);
+
+                // Make sure the shuffle does the same thing as the conversion. Convert enough structs that shuffling covers two whole periods of the
+                // masks, so blocks that straddle structs and the masks wrapping around are checked, too.
+                constexpr std::size_t period = std::lcm(size, static_cast<std::size_t>(16));
+                constexpr std::size_t check_count = (2 * period + 32 + size - 1) / size;
+                std::vector<std::byte> check_input(check_count * size), expected(check_count * size), shuffled(check_count * size);
+                std::uint32_t seed = 0x2545F491;
+                for(std::size_t pass = 0; pass < 4; pass++) {
+                    for(auto &b : check_input) {
+                        seed = seed * 1664525 + 1013904223;
+                        b = static_cast<std::byte>((seed >> 24) & 0x3F);
+                    }
+                    convert_structs<From, To>(check_input.data(), expected.data(), check_count);
+                    swap.swap(check_input.data(), shuffled.data(), check_count);
+                    if(expected != shuffled) {
+                        return BulkSwap(size, convert_structs<From, To>);
+                    }
+                }
+
+                return swap;
+            }
+            // The conversion rejected our made-up data, so it isn't just moving bytes around
+            catch(std::exception &) {
+                return BulkSwap(size, convert_structs<From, To>);
+            }
+        }
+    };
+}
+
+#endif
@@ -105,6 +105,14 @@ namespace Invader {
         std::string string() const;
         static JMS from_string(const char *string, const char **end = nullptr);
         
+        /**
+         * Parse a JMS file in place
+         * @param string pointer to the JMS file's text (does not need to be null-terminated)
+         * @param length length of the text in bytes
+         * @return       parsed JMS
+         */
+        static JMS from_string(const char *string, std::size_t length);
+        
         /**
          * Optimize, removing duplicate vertices
          */
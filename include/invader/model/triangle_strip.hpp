@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__MODEL__TRIANGLE_STRIP_HPP
+#define INVADER__MODEL__TRIANGLE_STRIP_HPP
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "../hek/data_type.hpp"
+
+namespace Invader::TriangleStrip {
+    /** Vertex indices of a triangle */
+    using Triangle = std::array<HEK::Index, 3>;
+
+    /** Number of entries assumed to be in the post-transform vertex cache */
+    static constexpr std::size_t VERTEX_CACHE_SIZE = 32;
+
+    /**
+     * Make a single triangle strip out of the triangles, joining separate strips with degenerate triangles.
+     *
+     * Triangle N in the strip is (N, N+1, N+2) if N is even or (N, N+2, N+1) if N is odd. Triangles are walked through shared edges, and when a
+     * strip can't be continued, a new one is started at the next remaining triangle in the order given, so triangles should be ordered for the
+     * vertex cache (see optimize_vertex_cache()) beforehand. Degenerate input triangles are dropped.
+     *
+     * @param  triangles triangles to strip
+     * @return           strip indices
+     */
+    std::vector<HEK::Index> make_triangle_strip(const std::vector<Triangle> &triangles);
+
+    /**
+     * Reorder triangles to make better use of the post-transform vertex cache (Forsyth's linear-speed vertex cache optimization), then
+     * renumber the vertices in the order they're first used.
+     * @param  triangles    triangles to reorder (input and output)
+     * @param  vertex_count number of vertices
+     * @return              for each new vertex index, the old vertex index
+     */
+    std::vector<std::size_t> optimize_vertex_cache(std::vector<Triangle> &triangles, std::size_t vertex_count);
+
+    /**
+     * Calculate the average cache miss ratio (vertex cache misses per non-degenerate triangle) of a triangle strip with a FIFO vertex cache
+     * @param  strip      strip indices
+     * @param  cache_size size of the vertex cache
+     * @return            average cache miss ratio, or 0 if there are no triangles
+     */
+    double calculate_acmr(const std::vector<HEK::Index> &strip, std::size_t cache_size = VERTEX_CACHE_SIZE);
+}
+
+#endif
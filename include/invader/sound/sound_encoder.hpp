@@ -8,7 +8,17 @@
 #include <cstdint>
 #include <optional>
 
+namespace Invader {
+    class ThreadPool;
+}
+
 namespace Invader::SoundEncoder {
+    /** Default lookahead depth used when searching for the best ADPCM nibbles */
+    static constexpr std::size_t DEFAULT_XBOX_ADPCM_LOOKAHEAD = 3;
+
+    /** Maximum lookahead depth; each extra level multiplies the search time */
+    static constexpr std::size_t MAX_XBOX_ADPCM_LOOKAHEAD = 8;
+
     /**
      * Encode the PCM data to Ogg Vorbis with a variable bitrate. This is lossy.
      * @param pcm             PCM data
@@ -57,9 +67,11 @@ namespace Invader::SoundEncoder {
      * @param pcm             PCM data
      * @param bits_per_sample bits per sample of the PCM data
      * @param channel_count   number of channels
+     * @param lookahead       lookahead depth (0 to MAX_XBOX_ADPCM_LOOKAHEAD); higher is slower but more accurate
+     * @param thread_pool     if set, ranges of blocks are encoded in parallel on this, each starting from its own predictor estimate
      * @return                Xbox ADPCM data
      */
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count);
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, std::size_t lookahead = DEFAULT_XBOX_ADPCM_LOOKAHEAD, ThreadPool *thread_pool = nullptr);
     
     /**
      * Calculate the PCM block size to use for encoding to ADPCM. Basically the number of samples must be a multiple of this.
@@ -68,6 +80,13 @@ namespace Invader::SoundEncoder {
      */
     std::size_t calculate_adpcm_pcm_block_size(std::size_t channel_count) noexcept;
 
+    /**
+     * Calculate the size of an encoded Xbox ADPCM block in bytes.
+     * @param channel_count channel count
+     * @return              ADPCM block size
+     */
+    std::size_t calculate_adpcm_block_size(std::size_t channel_count) noexcept;
+
     /**
      * Encode the PCM data to 16-bit big endian PCM. This is lossless unless the input data is greater than 16 bits.
      * @param pcm             PCM data
@@ -8,6 +8,7 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <functional>
 
 namespace Invader::SoundReader {
     struct Sound {
@@ -39,6 +40,27 @@ namespace Invader::SoundReader {
         void *internal;
     };
 
+    /**
+     * Function that receives PCM data as it's decoded. The sound's sample rate, channel count, and bits per sample are set before the first call.
+     */
+    using PCMCallback = std::function<void (const Sound &sound, const std::byte *pcm, std::size_t size)>;
+
+    /**
+     * Decode a WAV file a piece at a time rather than all at once
+     * @param  path     path to the file
+     * @param  callback function to pass decoded PCM to; if empty, only the format is read
+     * @return          sound (without PCM data)
+     */
+    Sound stream_wav_file(const std::filesystem::path &path, const PCMCallback &callback);
+
+    /**
+     * Decode a FLAC file a piece at a time rather than all at once
+     * @param  path     path to the file
+     * @param  callback function to pass decoded PCM to; if empty, only the format is read
+     * @return          sound (without PCM data)
+     */
+    Sound stream_flac_file(const std::filesystem::path &path, const PCMCallback &callback);
+
     /**
      * Get the sound from a WAV file
      * @param  path path to the file
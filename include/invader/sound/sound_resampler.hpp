@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__SOUND__RESAMPLER_HPP
+#define INVADER__SOUND__RESAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Invader {
+    /**
+     * Resampler quality, from slowest (and best) to fastest
+     */
+    enum SoundResamplerQuality {
+        /** Best quality sinc interpolation */
+        SOUND_RESAMPLER_QUALITY_BEST,
+
+        /** Medium quality sinc interpolation */
+        SOUND_RESAMPLER_QUALITY_MEDIUM,
+
+        /** Fastest sinc interpolation */
+        SOUND_RESAMPLER_QUALITY_FASTEST,
+
+        /** Linear interpolation */
+        SOUND_RESAMPLER_QUALITY_LINEAR
+    };
+
+    /**
+     * Resample integer PCM a piece at a time, keeping the resampler's state between pieces so the result is the same as resampling it all at
+     * once without needing the whole stream (or a float copy of it) in memory.
+     */
+    class SoundResampler {
+    public:
+        /**
+         * Start resampling a stream
+         * @param channel_count   number of channels
+         * @param bits_per_sample bits per sample of both the input and output PCM
+         * @param ratio           output sample rate divided by input sample rate
+         * @param quality         quality of the resampler
+         */
+        SoundResampler(std::size_t channel_count, std::size_t bits_per_sample, double ratio, SoundResamplerQuality quality = SOUND_RESAMPLER_QUALITY_BEST);
+
+        /**
+         * Resample the next piece of the stream, appending what's ready to output
+         * @param pcm    PCM data (must be whole frames)
+         * @param size   size of the PCM data in bytes
+         * @param output PCM data to append to (output)
+         */
+        void process(const std::byte *pcm, std::size_t size, std::vector<std::byte> &output);
+
+        /**
+         * Flush the rest of the stream, appending it to output
+         * @param output PCM data to append to (output)
+         */
+        void finish(std::vector<std::byte> &output);
+
+        ~SoundResampler();
+
+        SoundResampler(const SoundResampler &) = delete;
+        SoundResampler &operator=(const SoundResampler &) = delete;
+
+    private:
+        /** libsamplerate state (kept opaque so this header doesn't need samplerate.h) */
+        void *state;
+
+        /** Number of channels */
+        std::size_t channel_count;
+
+        /** Bits per sample */
+        std::size_t bits_per_sample;
+
+        /** Resampling ratio */
+        double ratio;
+
+        /** Float input for the piece being resampled */
+        std::vector<float> input;
+
+        /** Float output buffer */
+        std::vector<float> output_buffer;
+
+        /**
+         * Run the resampler over the current input
+         * @param end_of_input true if this is the end of the stream
+         * @param output       PCM data to append to (output)
+         */
+        void run(bool end_of_input, std::vector<std::byte> &output);
+    };
+}
+
+#endif
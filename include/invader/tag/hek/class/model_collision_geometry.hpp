@@ -3,9 +3,14 @@
 #ifndef INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY_HPP
 #define INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY_HPP
 
+#include <vector>
 #include "../../../hek/data_type.hpp"
 #include "../definition.hpp"
 
+namespace Invader {
+    class ThreadPool;
+}
+
 namespace Invader::HEK {
     /**
      * Struct for containing all information required to find intersections among other things
@@ -59,5 +64,101 @@ namespace Invader::HEK {
          */
         bool check_if_point_inside_bsp(const Point3D<LittleEndian> &point, std::uint32_t *leaf_index = nullptr) const;
     };
+
+    /**
+     * Runs many queries against one BSP. The BSP3D nodes (with their planes), BSP2D nodes, and BSP2D references are copied once into flat
+     * native arrays, and batches are split across a thread pool. Results are the same as the respective BSPData functions.
+     */
+    class BSPQuery {
+    public:
+        /**
+         * Result of a query
+         */
+        struct Result {
+            /** True if an intersection was found or the point is inside of the BSP */
+            bool found = false;
+
+            /** Point where the intersection was found */
+            Point3D<LittleEndian> intersection_point = {};
+
+            /** Surface index where the intersection was found */
+            std::uint32_t surface_index = 0;
+
+            /** Leaf index where the intersection was found or the point is located */
+            std::uint32_t leaf_index = 0;
+        };
+
+        /**
+         * Line segment to check
+         */
+        struct Segment {
+            Point3D<LittleEndian> point_a;
+            Point3D<LittleEndian> point_b;
+        };
+
+        /**
+         * Build the flat layout of the BSP
+         * @param bsp BSP to query; its arrays must outlive this object
+         */
+        BSPQuery(const BSPData &bsp);
+
+        /**
+         * Determine if line segments intersect with the BSP (see BSPData::check_for_intersection).
+         * @param segments    segments to check
+         * @param thread_pool if non-null, split the segments across this thread pool
+         * @return            result for each segment
+         */
+        std::vector<Result> check_for_intersections(const std::vector<Segment> &segments, ThreadPool *thread_pool = nullptr) const;
+
+        /**
+         * Determine if points intersect vertically with the BSP (see BSPData::check_for_intersection).
+         * @param points      points to check
+         * @param range       range up-and-down to check
+         * @param thread_pool if non-null, split the points across this thread pool
+         * @return            result for each point
+         */
+        std::vector<Result> check_for_intersections(const std::vector<Point3D<LittleEndian>> &points, float range, ThreadPool *thread_pool = nullptr) const;
+
+        /**
+         * Determine if points lay inside of the BSP (see BSPData::check_if_point_inside_bsp). Only found and leaf_index are set.
+         * @param points      points to check
+         * @param thread_pool if non-null, split the points across this thread pool
+         * @return            result for each point
+         */
+        std::vector<Result> check_if_points_inside_bsp(const std::vector<Point3D<LittleEndian>> &points, ThreadPool *thread_pool = nullptr) const;
+
+    private:
+        struct Node3D {
+            float i, j, k, w;
+            std::uint32_t plane;
+            std::uint32_t back_child;
+            std::uint32_t front_child;
+        };
+
+        struct Node2D {
+            float i, j, w;
+            std::uint32_t left_child;
+            std::uint32_t right_child;
+        };
+
+        struct Reference2D {
+            std::uint32_t plane;
+            std::uint32_t node;
+            std::uint8_t x_axis;
+            std::uint8_t y_axis;
+        };
+
+        BSPData bsp;
+        std::vector<Node3D> nodes_3d;
+        std::vector<Node2D> nodes_2d;
+        std::vector<Reference2D> references_2d;
+
+        std::uint32_t leaf_for_point(const Point3D<LittleEndian> &point) const;
+        bool in_front_of_node(const Node3D &node, const Point3D<LittleEndian> &point) const;
+        bool surface_for_point(std::uint32_t node_index, const Point2D<LittleEndian> &point, std::uint32_t &surface_index) const;
+        bool intersect_segment(const Segment &original, const Point3D<LittleEndian> &point_a, const Point3D<LittleEndian> &point_b, std::uint32_t node_index, Result &result) const;
+        Result intersect_segment(const Segment &segment) const;
+        Result intersect_vertically(const Point3D<LittleEndian> &point, float range) const;
+    };
 }
 #endif
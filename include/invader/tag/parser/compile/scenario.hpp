@@ -21,6 +21,14 @@ namespace Invader::Parser {
      * @return          true if there were too many nodes and it was fixable, false if not
      */
     bool fix_excessive_script_nodes(Scenario &scenario, bool fix);
+
+    /**
+     * Get the tags referenced by the scripts of a scenario, as a map build would compile them
+     * @param  scenario scenario to check (as read from a tag file)
+     * @return          paths and classes of the referenced tags in node order, with object definitions given the object class
+     * @throws          InvalidTagDataException if a node has an invalid string offset
+     */
+    std::vector<File::TagFilePath> get_script_tag_references(const Scenario &scenario);
 }
 
 #endif
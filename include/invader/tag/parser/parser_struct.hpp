@@ -9,6 +9,7 @@
 #include <optional>
 #include <variant>
 #include <memory>
+#include <memory_resource>
 #include "../hek/definition.hpp"
 
 namespace Invader {
@@ -252,16 +253,16 @@ namespace Invader::Parser {
          * Get the data
          * @return data
          */
-        std::vector<std::byte> &get_data() noexcept {
-            return *reinterpret_cast<std::vector<std::byte> *>(this->address);
+        std::pmr::vector<std::byte> &get_data() noexcept {
+            return *reinterpret_cast<std::pmr::vector<std::byte> *>(this->address);
         }
         
         /**
          * Get the data
          * @return data
          */
-        const std::vector<std::byte> &get_data() const noexcept {
-            return *reinterpret_cast<const std::vector<std::byte> *>(this->address);
+        const std::pmr::vector<std::byte> &get_data() const noexcept {
+            return *reinterpret_cast<const std::pmr::vector<std::byte> *>(this->address);
         }
 
         /**
@@ -465,7 +466,7 @@ namespace Invader::Parser {
          * @return data size
          */
         std::size_t get_data_size() const noexcept {
-            return reinterpret_cast<const std::vector<std::byte> *>(this->address)->size();
+            return reinterpret_cast<const std::pmr::vector<std::byte> *>(this->address)->size();
         }
 
         /**
@@ -806,11 +807,11 @@ namespace Invader::Parser {
          * @param read_only   value is read only
          */
         ParserStructValue(
-            const char *            name,
-            const char *            member_name,
-            const char *            comment,
-            std::vector<std::byte> *offset,
-            bool                    read_only
+            const char *                 name,
+            const char *                 member_name,
+            const char *                 comment,
+            std::pmr::vector<std::byte> *offset,
+            bool                         read_only
         );
 
         /**
@@ -950,9 +951,10 @@ namespace Invader::Parser {
          * @param  data        Tag file data to read from
          * @param  data_size   Size of the tag file
          * @param  postprocess Do post-processing on data, such as default values
+         * @param  resource    Memory resource to allocate blocks and data from (such as a TagArena), which must outlive the parsed tag
          * @return             parsed tag data
          */
-        static std::unique_ptr<ParserStruct> parse_hek_tag_file(const std::byte *data, std::size_t data_size, bool postprocess = false);
+        static std::unique_ptr<ParserStruct> parse_hek_tag_file(const std::byte *data, std::size_t data_size, bool postprocess = false, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
         /**
          * Generate a tag base struct
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__TAG__PARSER__TAG_ARENA_HPP
+#define INVADER__TAG__PARSER__TAG_ARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace Invader::Parser {
+    /**
+     * Memory for parsing tags one after another with ParserStruct::parse_hek_tag_file(). Everything in a tag is allocated from one buffer, which
+     * is freed all at once and reused for the next tag, rather than allocating and freeing each block and data separately.
+     *
+     * A tag parsed with an arena must be destroyed before the arena is used for the next tag. Arenas can't be shared between threads.
+     */
+    class TagArena {
+    public:
+        /**
+         * Free everything from the last tag and get a memory resource for parsing the next one
+         * @param  tag_size size of the tag file, used to guess how much memory the parsed tag will need
+         * @return          memory resource to parse the tag with
+         */
+        std::pmr::memory_resource *next_tag(std::size_t tag_size) {
+            this->resource.reset();
+
+            // Parsed tags take up more memory than tag files; anything that doesn't fit is allocated normally
+            std::size_t size_wanted = tag_size * 2;
+            if(this->buffer.size() < size_wanted) {
+                this->buffer = std::vector<std::byte>(size_wanted);
+            }
+
+            return &this->resource.emplace(this->buffer.data(), this->buffer.size());
+        }
+
+    private:
+        std::vector<std::byte> buffer;
+        std::optional<std::pmr::monotonic_buffer_resource> resource;
+    };
+}
+
+#endif
@@ -0,0 +1,405 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__TAG__PARSER__VIEW_STRUCT_HPP
+#define INVADER__TAG__PARSER__VIEW_STRUCT_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "../hek/definition.hpp"
+#include "../hek/header.hpp"
+#include "../../printf.hpp"
+#include "../../error.hpp"
+#include "../../file/file.hpp"
+
+namespace Invader::Parser::View {
+    /**
+     * Tag reference in a HEK tag file
+     */
+    class TagDependencyView {
+    public:
+        /**
+         * Get the tag class of the reference (if the reference is null and has no class, this is the field's default class, like when parsing)
+         * @return tag class
+         */
+        HEK::TagFourCC get_tag_fourcc() const noexcept {
+            return this->tag_fourcc;
+        }
+
+        /**
+         * Get the path of the reference as stored in the tag file (slashes are not cleaned up)
+         * @return null-terminated path, or an empty string if the reference is null
+         */
+        const char *get_path() const noexcept {
+            return this->path;
+        }
+
+        /**
+         * Get whether the reference has a path
+         * @return true if the reference is null
+         */
+        bool is_null() const noexcept {
+            return *this->path == 0;
+        }
+
+        TagDependencyView(HEK::TagFourCC tag_fourcc, const char *path) noexcept : tag_fourcc(tag_fourcc), path(path) {}
+
+    private:
+        HEK::TagFourCC tag_fourcc;
+        const char *path;
+    };
+
+    /**
+     * Data in a HEK tag file
+     */
+    class TagDataView {
+    public:
+        /**
+         * Get the data
+         * @return pointer to the data
+         */
+        const std::byte *get_data() const noexcept {
+            return this->data;
+        }
+
+        /**
+         * Get the size of the data
+         * @return size in bytes
+         */
+        std::size_t get_size() const noexcept {
+            return this->size;
+        }
+
+        TagDataView(const std::byte *data, std::size_t size) noexcept : data(data), size(size) {}
+
+    private:
+        const std::byte *data;
+        std::size_t size;
+    };
+
+    template<typename T> class TagReflexiveView;
+
+    /**
+     * Walks over the references, blocks, and data that follow a block in a HEK tag file, checking that each one is in bounds
+     */
+    class ViewCursor {
+    public:
+        /**
+         * Read a reference and move past its path
+         * @param dependency     reference in the block
+         * @param name           name of the field, for errors
+         * @param default_fourcc class to use if the reference is null and has no class
+         * @return               view of the reference
+         * @throws               Invader::OutOfBoundsException or Invader::InvalidTagDataException if the path is invalid
+         */
+        TagDependencyView read_dependency(const HEK::TagDependency<HEK::BigEndian> &dependency, const char *name, HEK::TagFourCC default_fourcc = HEK::TagFourCC::TAG_FOURCC_NULL) {
+            std::size_t path_size = dependency.path_size.read();
+            HEK::TagFourCC tag_fourcc = dependency.tag_fourcc.read();
+            if(path_size == 0) {
+                return TagDependencyView(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL ? default_fourcc : tag_fourcc, "");
+            }
+            if(path_size + 1 > this->get_remaining()) {
+                eprintf_error("Failed to read dependency %s: %zu bytes needed > %zu bytes available", name, path_size + 1, this->get_remaining());
+                throw OutOfBoundsException();
+            }
+            const auto *path = reinterpret_cast<const char *>(this->position);
+            for(std::size_t i = 0; i < path_size; i++) {
+                if(path[i] == 0) {
+                    eprintf_error("Failed to read dependency %s: size is smaller than expected (%zu expected > %zu actual)", name, path_size, i);
+                    throw InvalidTagDataException();
+                }
+            }
+            if(path[path_size] != 0) {
+                eprintf_error("Failed to read dependency %s: missing null terminator", name);
+                throw InvalidTagDataException();
+            }
+            this->position += path_size + 1;
+            return TagDependencyView(tag_fourcc, path);
+        }
+
+        /**
+         * Get a block without moving past it
+         * @param count number of elements in the block
+         * @param name  name of the field, for errors
+         * @return      view of the block
+         * @throws      Invader::OutOfBoundsException if the elements don't fit
+         */
+        template<typename T> TagReflexiveView<T> get_reflexive(std::size_t count, const char *name) const {
+            std::size_t total_size = sizeof(typename T::struct_big) * count;
+            if(total_size > this->get_remaining()) {
+                eprintf_error("Failed to read reflexive %s: %zu bytes needed > %zu bytes available", name, total_size, this->get_remaining());
+                throw OutOfBoundsException();
+            }
+            return TagReflexiveView<T>(this->position, count, this->data_end);
+        }
+
+        /**
+         * Read a block and move past it, including everything that follows each of its elements
+         * @param count number of elements in the block
+         * @param name  name of the field, for errors
+         * @return      view of the block
+         * @throws      Invader::OutOfBoundsException or Invader::InvalidTagDataException if anything in the block is invalid
+         */
+        template<typename T> TagReflexiveView<T> read_reflexive(std::size_t count, const char *name) {
+            auto reflexive = this->get_reflexive<T>(count, name);
+            this->position += reflexive.get_total_size();
+            return reflexive;
+        }
+
+        /**
+         * Read a block and move past it, calling a function for each reference in it that is read when parsing
+         * @param count    number of elements in the block
+         * @param name     name of the field, for errors
+         * @param callback function to call with each non-null reference
+         * @throws         Invader::OutOfBoundsException or Invader::InvalidTagDataException if anything in the block is invalid
+         */
+        template<typename T, typename Callback> void read_reflexive_dependencies(std::size_t count, const char *name, Callback &callback) {
+            this->position += this->get_reflexive<T>(count, name).for_each_dependency(callback);
+        }
+
+        /**
+         * Read data and move past it
+         * @param data data in the block
+         * @param name name of the field, for errors
+         * @return     view of the data
+         * @throws     Invader::OutOfBoundsException if the data doesn't fit
+         */
+        TagDataView read_data(const HEK::TagDataOffset<HEK::BigEndian> &data, const char *name) {
+            std::size_t size = data.size.read();
+            if(size > this->get_remaining()) {
+                eprintf_error("Failed to read tag data block %s: %zu bytes needed > %zu bytes available", name, size, this->get_remaining());
+                throw OutOfBoundsException();
+            }
+            TagDataView view(this->position, size);
+            this->position += size;
+            return view;
+        }
+
+        /**
+         * Get the current position
+         * @return position
+         */
+        const std::byte *get_position() const noexcept {
+            return this->position;
+        }
+
+        ViewCursor(const std::byte *position, const std::byte *data_end) noexcept : position(position), data_end(data_end) {}
+
+    private:
+        const std::byte *position;
+        const std::byte *data_end;
+
+        std::size_t get_remaining() const noexcept {
+            return static_cast<std::size_t>(this->data_end - this->position);
+        }
+    };
+
+    /**
+     * Base of the generated views, which read a block of a HEK tag file in place without parsing or copying it.
+     *
+     * Fields that are stored in the block itself are read through operator->() (converting from big endian as they are read). References,
+     * blocks, and data are stored after the block, so these are found by accessors named after the field which walk over everything before
+     * them. Everything is checked to be in bounds as it's accessed, so views may throw when accessed rather than when made.
+     *
+     * Views point into the tag file data, so the data must outlive them.
+     */
+    template<typename View, typename StructBig> class ViewStruct {
+    public:
+        using struct_big = StructBig;
+
+        /**
+         * View the HEK tag file. Unlike parsing, this does not check for data left over at the end of the tag.
+         * @param data      tag file data to read from
+         * @param data_size size of the tag file
+         * @return          view of the tag
+         * @throws          Invader::OutOfBoundsException or Invader::InvalidTagDataException if the header or base block is invalid
+         */
+        static View from_hek_tag_file(const std::byte *data, std::size_t data_size) {
+            HEK::TagFileHeader::validate_header(reinterpret_cast<const HEK::TagFileHeader *>(data), data_size);
+            if(data_size < sizeof(HEK::TagFileHeader) + sizeof(struct_big)) {
+                eprintf_error("invalid tag file; base block is out of bounds");
+                throw OutOfBoundsException();
+            }
+            const auto *base = data + sizeof(HEK::TagFileHeader);
+            return View(base, base + sizeof(struct_big), data + data_size);
+        }
+
+        const struct_big &operator*() const noexcept {
+            return *this->struct_data;
+        }
+
+        const struct_big *operator->() const noexcept {
+            return this->struct_data;
+        }
+
+        /**
+         * Make a view of a block
+         * @param struct_data   block to view
+         * @param trailing_data data following the block
+         * @param data_end      end of the tag data
+         */
+        ViewStruct(const std::byte *struct_data, const std::byte *trailing_data, const std::byte *data_end) noexcept :
+            struct_data(reinterpret_cast<const struct_big *>(struct_data)), trailing_data(trailing_data), data_end(data_end) {}
+
+    protected:
+        const struct_big *struct_data;
+        const std::byte *trailing_data;
+        const std::byte *data_end;
+
+        ViewCursor get_cursor() const noexcept {
+            return ViewCursor(this->trailing_data, this->data_end);
+        }
+    };
+
+    /**
+     * Block in a HEK tag file. The elements are stored next to each other, followed by what follows each element in order, so finding an
+     * element means walking over everything before it unless nothing follows each element.
+     */
+    template<typename T> class TagReflexiveView {
+    public:
+        using struct_big = typename T::struct_big;
+
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = T;
+
+            T operator*() const noexcept {
+                return T(reinterpret_cast<const std::byte *>(this->element), this->trailing_data, this->data_end);
+            }
+
+            iterator &operator++() {
+                if constexpr(T::HAS_TRAILING_DATA) {
+                    this->trailing_data += (**this).get_trailing_size();
+                }
+                this->element++;
+                return *this;
+            }
+
+            iterator operator++(int) {
+                auto copy = *this;
+                ++*this;
+                return copy;
+            }
+
+            bool operator==(const iterator &other) const noexcept {
+                return this->element == other.element;
+            }
+
+            bool operator!=(const iterator &other) const noexcept {
+                return this->element != other.element;
+            }
+
+            iterator() noexcept = default;
+            iterator(const struct_big *element, const std::byte *trailing_data, const std::byte *data_end) noexcept : element(element), trailing_data(trailing_data), data_end(data_end) {}
+
+        private:
+            const struct_big *element = nullptr;
+            const std::byte *trailing_data = nullptr;
+            const std::byte *data_end = nullptr;
+        };
+
+        /**
+         * Get the number of elements
+         * @return number of elements
+         */
+        std::size_t size() const noexcept {
+            return this->count;
+        }
+
+        /**
+         * Get whether there are no elements
+         * @return true if empty
+         */
+        bool empty() const noexcept {
+            return this->count == 0;
+        }
+
+        iterator begin() const noexcept {
+            return iterator(this->array, reinterpret_cast<const std::byte *>(this->array + this->count), this->data_end);
+        }
+
+        iterator end() const noexcept {
+            return iterator(this->array + this->count, nullptr, this->data_end);
+        }
+
+        /**
+         * Get an element. This walks over each element before it unless nothing follows each element.
+         * @param index index of the element
+         * @return      view of the element
+         * @throws      std::out_of_range if the index is out of bounds
+         */
+        T at(std::size_t index) const {
+            if(index >= this->count) {
+                throw std::out_of_range("reflexive index out of bounds");
+            }
+            if constexpr(T::HAS_TRAILING_DATA) {
+                return *std::next(this->begin(), static_cast<std::ptrdiff_t>(index));
+            }
+            else {
+                return T(reinterpret_cast<const std::byte *>(this->array + index), reinterpret_cast<const std::byte *>(this->array + this->count), this->data_end);
+            }
+        }
+
+        /**
+         * Get the size of the elements and everything that follows them
+         * @return size in bytes
+         */
+        std::size_t get_total_size() const {
+            const auto *trailing_data = reinterpret_cast<const std::byte *>(this->array + this->count);
+            if constexpr(T::HAS_TRAILING_DATA) {
+                for(std::size_t i = 0; i < this->count; i++) {
+                    trailing_data += T(reinterpret_cast<const std::byte *>(this->array + i), trailing_data, this->data_end).get_trailing_size();
+                }
+            }
+            return static_cast<std::size_t>(trailing_data - reinterpret_cast<const std::byte *>(this->array));
+        }
+
+        /**
+         * Call a function for each reference in the elements that is read when parsing, in the order they're stored
+         * @param callback function to call with each non-null reference
+         * @return         size of the elements and everything that follows them
+         */
+        template<typename Callback> std::size_t for_each_dependency(Callback &callback) const {
+            const auto *trailing_data = reinterpret_cast<const std::byte *>(this->array + this->count);
+            if constexpr(T::HAS_TRAILING_DATA) {
+                for(std::size_t i = 0; i < this->count; i++) {
+                    trailing_data += T(reinterpret_cast<const std::byte *>(this->array + i), trailing_data, this->data_end).for_each_dependency(callback);
+                }
+            }
+            return static_cast<std::size_t>(trailing_data - reinterpret_cast<const std::byte *>(this->array));
+        }
+
+        TagReflexiveView(const std::byte *array, std::size_t count, const std::byte *data_end) noexcept : array(reinterpret_cast<const struct_big *>(array)), count(count), data_end(data_end) {}
+
+    private:
+        const struct_big *array;
+        std::size_t count;
+        const std::byte *data_end;
+    };
+
+    /**
+     * Get every non-null reference in a HEK tag file that is read when parsing it, without parsing it. Paths have duplicate slashes removed,
+     * like when parsing.
+     * @param data      tag file data to read from
+     * @param data_size size of the tag file
+     * @return          references in the order they're stored (this may contain duplicates)
+     * @throws          Invader::OutOfBoundsException or Invader::InvalidTagDataException if the tag is invalid
+     */
+    std::vector<File::TagFilePath> get_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size);
+
+    /**
+     * Get whether tags of a class can have any references that are read when parsing, so tags of classes that can't don't need to be read to
+     * find their references
+     * @param tag_fourcc tag class
+     * @return           true if tags of the class can have references (or if the class is unknown)
+     */
+    bool hek_tag_class_has_dependencies(TagFourCC tag_fourcc) noexcept;
+}
+
+#endif
@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__THREAD_POOL_HPP
+#define INVADER__THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Invader {
+    /**
+     * Header only work-stealing thread pool with a fixed number of worker threads.
+     *
+     * Each worker has its own queue. Tasks submitted from a worker go onto that worker's queue and are taken from the back (so nested work runs
+     * while it's still hot), while idle workers steal from the front of other queues. Results and exceptions are returned through futures.
+     */
+    class ThreadPool {
+    public:
+        /**
+         * Get the default number of threads to use (the CPU thread count, or 1 if it can't be determined)
+         * @return default thread count
+         */
+        static std::size_t default_thread_count() noexcept {
+            auto count = std::thread::hardware_concurrency();
+            return count < 1 ? 1 : count;
+        }
+
+        /**
+         * Start the thread pool
+         * @param thread_count number of worker threads to start (at least 1 is always started)
+         */
+        ThreadPool(std::size_t thread_count = default_thread_count()) {
+            if(thread_count < 1) {
+                thread_count = 1;
+            }
+
+            this->queues.reserve(thread_count);
+            for(std::size_t i = 0; i < thread_count; i++) {
+                this->queues.emplace_back(std::make_unique<Queue>());
+            }
+
+            this->threads.reserve(thread_count);
+            for(std::size_t i = 0; i < thread_count; i++) {
+                this->threads.emplace_back(&ThreadPool::worker_loop, this, i);
+            }
+        }
+
+        /**
+         * Finish all queued tasks and stop the worker threads
+         */
+        ~ThreadPool() {
+            {
+                std::scoped_lock<std::mutex> lock(this->sleep_mutex);
+                this->stopping = true;
+            }
+            this->sleep_condition.notify_all();
+            for(auto &t : this->threads) {
+                t.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * Get the number of worker threads
+         * @return number of worker threads
+         */
+        std::size_t get_thread_count() const noexcept {
+            return this->threads.size();
+        }
+
+        /**
+         * Queue a task. Any exception it throws is rethrown when getting its result.
+         * @param  function function to run
+         * @return          future for the result of the function
+         */
+        template<typename Function>
+        std::future<std::invoke_result_t<std::decay_t<Function>>> submit(Function &&function) {
+            using Result = std::invoke_result_t<std::decay_t<Function>>;
+
+            // std::function needs to be copyable, so hold the packaged task in a shared pointer
+            auto task = std::make_shared<std::packaged_task<Result ()>>(std::forward<Function>(function));
+            auto future = task->get_future();
+
+            // Prefer our own queue if we're a worker of this pool; otherwise spread tasks across the queues
+            std::size_t queue_index;
+            auto &worker = current_worker();
+            if(worker.first == this) {
+                queue_index = worker.second;
+            }
+            else {
+                queue_index = this->next_queue++ % this->queues.size();
+            }
+
+            // Count it first so the count never drops below the number of queued tasks. Taking the sleep mutex here makes sure a worker can't
+            // miss the wakeup between checking for tasks and going to sleep.
+            {
+                std::scoped_lock<std::mutex> lock(this->sleep_mutex);
+                this->queued_task_count++;
+            }
+
+            auto &queue = *this->queues[queue_index];
+            {
+                std::scoped_lock<std::mutex> lock(queue.mutex);
+                queue.tasks.emplace_back([task]() { (*task)(); });
+            }
+            this->sleep_condition.notify_one();
+
+            return future;
+        }
+
+        /**
+         * Wait for a task to finish and get its result, rethrowing any exception it threw. Queued tasks are run on the calling thread while
+         * waiting, so this can also be called from a worker thread without deadlocking the pool.
+         * @param  future future returned by submit()
+         * @return        result of the task
+         */
+        template<typename T>
+        T wait(std::future<T> &future) {
+            while(future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                // Nothing left to help with, so whatever we're waiting on is already running
+                if(!this->run_pending_task()) {
+                    future.wait();
+                    break;
+                }
+            }
+            return future.get();
+        }
+
+        /**
+         * Wait for all of the given tasks to finish and get their results in order. If any task threw an exception, every task is still waited
+         * on before the first exception (in order) is rethrown.
+         * @param  futures futures returned by submit()
+         * @return         results of the tasks
+         */
+        template<typename T>
+        std::vector<T> wait_all(std::vector<std::future<T>> &futures) {
+            std::vector<T> results;
+            results.reserve(futures.size());
+            std::exception_ptr first_exception;
+
+            for(auto &f : futures) {
+                try {
+                    results.emplace_back(this->wait(f));
+                }
+                catch(...) {
+                    if(!first_exception) {
+                        first_exception = std::current_exception();
+                    }
+                }
+            }
+
+            if(first_exception) {
+                std::rethrow_exception(first_exception);
+            }
+
+            return results;
+        }
+
+        /**
+         * Wait for all of the given tasks to finish. If any task threw an exception, every task is still waited on before the first exception
+         * (in order) is rethrown.
+         * @param futures futures returned by submit()
+         */
+        void wait_all(std::vector<std::future<void>> &futures) {
+            std::exception_ptr first_exception;
+
+            for(auto &f : futures) {
+                try {
+                    this->wait(f);
+                }
+                catch(...) {
+                    if(!first_exception) {
+                        first_exception = std::current_exception();
+                    }
+                }
+            }
+
+            if(first_exception) {
+                std::rethrow_exception(first_exception);
+            }
+        }
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void ()>> tasks;
+        };
+
+        /** Task queues (one per worker) */
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        /** Worker threads */
+        std::vector<std::thread> threads;
+
+        /** Used for sleeping when there's nothing to do */
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_condition;
+
+        /** Number of tasks submitted but not yet started (guarded by sleep_mutex when incremented) */
+        std::atomic<std::size_t> queued_task_count = 0;
+
+        /** Queue to put the next task from a non-worker thread into */
+        std::atomic<std::size_t> next_queue = 0;
+
+        /** Set when the pool is being destroyed (guarded by sleep_mutex) */
+        bool stopping = false;
+
+        /**
+         * Get the pool and queue index of the calling thread, if it's a worker thread
+         * @return pool and queue index, or null and 0 if not a worker thread
+         */
+        static std::pair<const ThreadPool *, std::size_t> &current_worker() noexcept {
+            static thread_local std::pair<const ThreadPool *, std::size_t> worker = { nullptr, 0 };
+            return worker;
+        }
+
+        /**
+         * Take a task, preferring the back of our own queue and otherwise stealing from the front of the others
+         * @param  task task to write to (output)
+         * @return      true if a task was taken
+         */
+        bool take_task(std::function<void ()> &task) {
+            std::size_t queue_count = this->queues.size();
+            auto &worker = current_worker();
+            std::size_t start;
+
+            if(worker.first == this) {
+                start = worker.second;
+                auto &own = *this->queues[start];
+                std::scoped_lock<std::mutex> lock(own.mutex);
+                if(!own.tasks.empty()) {
+                    task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    this->queued_task_count--;
+                    return true;
+                }
+            }
+            else {
+                start = this->next_queue % queue_count;
+            }
+
+            for(std::size_t i = 0; i < queue_count; i++) {
+                auto &victim = *this->queues[(start + i) % queue_count];
+                std::scoped_lock<std::mutex> lock(victim.mutex);
+                if(!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    this->queued_task_count--;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * Run a queued task on the calling thread, if there is one
+         * @return true if a task was run
+         */
+        bool run_pending_task() {
+            std::function<void ()> task;
+            if(!this->take_task(task)) {
+                return false;
+            }
+            task();
+            return true;
+        }
+
+        /**
+         * Worker thread loop
+         * @param index queue index of the worker
+         */
+        void worker_loop(std::size_t index) {
+            current_worker() = { this, index };
+
+            while(true) {
+                if(this->run_pending_task()) {
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(this->sleep_mutex);
+                this->sleep_condition.wait(lock, [this]() { return this->stopping || this->queued_task_count > 0; });
+                if(this->stopping && this->queued_task_count == 0) {
+                    break;
+                }
+            }
+
+            current_worker() = { nullptr, 0 };
+        }
+    };
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <unordered_set>
 #include <archive.h>
 #include <archive_entry.h>
 #include <invader/version.hpp>
@@ -12,9 +13,192 @@
 #include <invader/dependency/found_tag_dependency.hpp>
 #include <invader/command_line_option.hpp>
 #include <invader/file/file.hpp>
+#include <invader/tag/parser/view.hpp>
+#include <invader/tag/parser/compile/scenario.hpp>
+#include <invader/thread_pool.hpp>
 
 #include "../build/build.hpp"
 
+// Tag found when following the references of a scenario
+struct ReferencedTag {
+    /** Path and class of the tag (object references are resolved to the class of the tag that exists) */
+    Invader::File::TagFilePath tag;
+
+    /** Path to the tag file */
+    std::filesystem::path file_path;
+
+    /** References in the tag (and, for scenarios, its scripts) */
+    std::vector<Invader::File::TagFilePath> dependencies;
+
+    /** Type of scenario, if the tag is a scenario */
+    std::optional<Invader::HEK::ScenarioType> scenario_type;
+
+    /** The scenario uses the demo UI */
+    bool demo_ui = false;
+};
+
+// Find a tag file the way a map build would, trying each object class for object references
+static std::optional<std::filesystem::path> find_tag_file(Invader::File::TagFilePath &tag, const std::vector<std::filesystem::path> &tags_directories) {
+    using namespace Invader::HEK;
+
+    auto find_tag = [&tag, &tags_directories](TagFourCC fourcc) {
+        return Invader::File::tag_path_to_file_path(Invader::File::halo_path_to_preferred_path(tag.path + "." + tag_fourcc_to_extension(fourcc)), tags_directories);
+    };
+
+    if(tag.fourcc != TagFourCC::TAG_FOURCC_OBJECT) {
+        return find_tag(tag.fourcc);
+    }
+
+    static constexpr TagFourCC OBJECT_CLASSES[] = {
+        TagFourCC::TAG_FOURCC_BIPED,
+        TagFourCC::TAG_FOURCC_VEHICLE,
+        TagFourCC::TAG_FOURCC_WEAPON,
+        TagFourCC::TAG_FOURCC_EQUIPMENT,
+        TagFourCC::TAG_FOURCC_GARBAGE,
+        TagFourCC::TAG_FOURCC_SCENERY,
+        TagFourCC::TAG_FOURCC_PLACEHOLDER,
+        TagFourCC::TAG_FOURCC_SOUND_SCENERY,
+        TagFourCC::TAG_FOURCC_DEVICE_CONTROL,
+        TagFourCC::TAG_FOURCC_DEVICE_MACHINE,
+        TagFourCC::TAG_FOURCC_DEVICE_LIGHT_FIXTURE
+    };
+    for(auto fourcc : OBJECT_CLASSES) {
+        if(auto file_path = find_tag(fourcc); file_path.has_value()) {
+            tag.fourcc = fourcc;
+            return file_path;
+        }
+    }
+    return std::nullopt;
+}
+
+// Find and read a tag, throwing if it can't be found or read
+static ReferencedTag read_referenced_tag(const Invader::File::TagFilePath &tag, const std::vector<std::filesystem::path> &tags_directories) {
+    using namespace Invader;
+
+    ReferencedTag referenced_tag;
+    referenced_tag.tag = tag;
+    auto file_path = find_tag_file(referenced_tag.tag, tags_directories);
+    if(!file_path.has_value()) {
+        eprintf_error("Failed to find %s.%s. Archive could not be made.", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc));
+        throw InvalidTagPathException();
+    }
+    referenced_tag.file_path = std::move(*file_path);
+
+    // Tags that can't reference anything don't need to be opened. Meter bitmaps aren't compiled into maps, either.
+    auto fourcc = referenced_tag.tag.fourcc;
+    if(!Parser::View::hek_tag_class_has_dependencies(fourcc) || fourcc == HEK::TagFourCC::TAG_FOURCC_METER) {
+        return referenced_tag;
+    }
+
+    auto tag_data = File::open_file(referenced_tag.file_path);
+    if(!tag_data.has_value()) {
+        eprintf_error("Failed to open %s. Archive could not be made.", referenced_tag.file_path.string().c_str());
+        throw FailedToOpenFileException();
+    }
+
+    try {
+        referenced_tag.dependencies = Parser::View::get_hek_tag_file_dependencies(tag_data->data(), tag_data->size());
+
+        // Scripts reference tags by name, and the scenario type decides which tags the engine requires
+        if(fourcc == HEK::TagFourCC::TAG_FOURCC_SCENARIO) {
+            auto scenario = Parser::Scenario::parse_hek_tag_file(tag_data->data(), tag_data->size());
+            auto script_references = Parser::get_script_tag_references(scenario);
+            referenced_tag.dependencies.insert(referenced_tag.dependencies.end(), script_references.begin(), script_references.end());
+            referenced_tag.scenario_type = scenario.type;
+            referenced_tag.demo_ui = scenario.flags & HEK::ScenarioFlagsFlag::SCENARIO_FLAGS_FLAG_USE_DEMO_UI;
+        }
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to read %s: %s. Archive could not be made.", referenced_tag.file_path.string().c_str(), e.what());
+        throw;
+    }
+
+    return referenced_tag;
+}
+
+// Find every tag a map built from a scenario would have by following references on multiple threads rather than building the map
+static std::vector<ReferencedTag> find_scenario_tags(const std::string &scenario, Invader::HEK::GameEngine engine, const std::vector<std::filesystem::path> &tags_directories, std::size_t thread_count) {
+    using namespace Invader;
+
+    std::vector<ReferencedTag> found_tags;
+    std::unordered_set<std::string> queued;
+    std::unordered_set<std::string> found;
+    std::vector<File::TagFilePath> pending;
+
+    auto queue_tag = [&queued, &pending](const File::TagFilePath &tag) {
+        if(queued.insert(tag.join()).second) {
+            pending.emplace_back(tag);
+        }
+    };
+    queue_tag(File::TagFilePath(File::preferred_path_to_halo_path(scenario), HEK::TagFourCC::TAG_FOURCC_SCENARIO));
+
+    // Read each level of references at once
+    ThreadPool thread_pool(thread_count);
+    while(!pending.empty()) {
+        std::vector<std::future<ReferencedTag>> futures;
+        futures.reserve(pending.size());
+        for(auto &tag : pending) {
+            futures.emplace_back(thread_pool.submit([tag, &tags_directories]() {
+                return read_referenced_tag(tag, tags_directories);
+            }));
+        }
+        pending.clear();
+
+        for(auto &referenced_tag : thread_pool.wait_all(futures)) {
+            // Object references may resolve to a tag that was already found
+            if(!found.insert(referenced_tag.tag.join()).second) {
+                continue;
+            }
+
+            for(auto &dependency : referenced_tag.dependencies) {
+                queue_tag(dependency);
+            }
+
+            // The first scenario decides which tags the engine requires, along with the globals tag
+            if(found_tags.empty()) {
+                auto &required_tags = HEK::GameEngineInfo::get_game_engine_info(engine).required_tags;
+                auto queue_all = [&queue_tag](const HEK::GameEngineInfo::RequiredTags::TagPairPtrArray &tags) {
+                    for(std::size_t t = 0; t < tags.count; t++) {
+                        queue_tag(File::TagFilePath(tags.ptr[t].path, tags.ptr[t].fourcc));
+                    }
+                };
+
+                const HEK::GameEngineInfo::RequiredTags::TagPairPtrArray *type_tags, *ui_tags;
+                switch(referenced_tag.scenario_type.value_or(HEK::ScenarioType::SCENARIO_TYPE_ENUM_COUNT)) {
+                    case HEK::ScenarioType::SCENARIO_TYPE_SINGLEPLAYER:
+                        type_tags = &required_tags.singleplayer;
+                        ui_tags = referenced_tag.demo_ui ? &required_tags.singleplayer_demo : &required_tags.singleplayer_full;
+                        break;
+                    case HEK::ScenarioType::SCENARIO_TYPE_MULTIPLAYER:
+                        type_tags = &required_tags.multiplayer;
+                        ui_tags = referenced_tag.demo_ui ? &required_tags.multiplayer_demo : &required_tags.multiplayer_full;
+                        break;
+                    case HEK::ScenarioType::SCENARIO_TYPE_USER_INTERFACE:
+                        type_tags = &required_tags.user_interface;
+                        ui_tags = referenced_tag.demo_ui ? &required_tags.user_interface_demo : &required_tags.user_interface_full;
+                        break;
+                    default:
+                        eprintf_error("%s has an invalid scenario type. Archive could not be made.", referenced_tag.file_path.string().c_str());
+                        throw InvalidTagDataException();
+                }
+                if(referenced_tag.demo_ui && ui_tags->count == 0) {
+                    eprintf_error("No demo UI exists for the target engine for this type of scenario. Archive could not be made.");
+                    throw InvalidTagDataException();
+                }
+
+                queue_all(required_tags.all);
+                queue_all(*type_tags);
+                queue_all(*ui_tags);
+                queue_tag(File::TagFilePath("globals\\globals", HEK::TagFourCC::TAG_FOURCC_GLOBALS));
+            }
+
+            found_tags.emplace_back(std::move(referenced_tag));
+        }
+    }
+
+    return found_tags;
+}
+
 int main(int argc, const char **argv) {
     using namespace Invader;
     
@@ -28,10 +212,12 @@ int main(int argc, const char **argv) {
         bool copy = false;
         bool verbose = false;
         bool overwrite = false;
+        bool dependencies_only = false;
+        std::size_t threads = ThreadPool::default_thread_count();
         std::optional<HEK::GameEngine> engine;
     } archive_options;
 
-    static constexpr char DESCRIPTION[] = "Generate .tar.xz archives of the tags required to build a cache file.";
+    static constexpr char DESCRIPTION[] = "Generate .tar.xz or .tar.zst archives of the tags required to build a cache file.";
     static constexpr char USAGE[] = "[options] <scenario | -s tag.class>";
     
     std::string game_engine_arguments = std::string("Specify the game engine. This option is required. Valid engines are: ") + Build::get_comma_separated_game_engine_shorthands();
@@ -43,11 +229,13 @@ int main(int argc, const char **argv) {
     options.emplace_back("exclude-matched", 'E', 1, "Exclude copying any tags that are also located in the specified directory and are functionally the same. Use multiple times to exclude multiple directories.", "<dir>");
     options.emplace_back("overwrite", 'O', 0, "Overwrite tags if they already exist if using --copy");
     options.emplace_back("exclude", 'e', 1, "Exclude copying any tags that share a path with a tag in specified directory. Use multiple times to exclude multiple directories.", "<dir>");
-    options.emplace_back("output", 'o', 1, "Output to a specific file. Extension must be .tar.xz unless using --copy which then it's a directory.", "<file>");
+    options.emplace_back("output", 'o', 1, "Output to a specific file. Extension must be .tar.xz or .tar.zst unless using --copy which then it's a directory.", "<file>");
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the tag.");
     options.emplace_back("copy", 'C', 0, "Copy instead of making an archive.");
     options.emplace_back("verbose", 'v', 0, "Print whether or not tags are omitted,  Do verbose comparisons.");
     options.emplace_back("game-engine", 'g', 1, game_engine_arguments.c_str(), "<id>");
+    options.emplace_back("dependencies-only", 'D', 0, "Find the tags for a cache file by following references instead of building it. This is much faster, but the tags are not checked for errors.");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for finding tags with --dependencies-only and for compressing. Default: CPU thread count", "<#>");
 
     auto remaining_arguments = CommandLineOption::parse_arguments<ArchiveOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, archive_options, [](char opt, const auto &arguments, auto &archive_options) {
         switch(opt) {
@@ -92,6 +280,22 @@ int main(int argc, const char **argv) {
             case 'C':
                 archive_options.copy = true;
                 break;
+            case 'D':
+                archive_options.dependencies_only = true;
+                break;
+            case 'j':
+                try {
+                    auto threads = std::stoi(arguments[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    archive_options.threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s\n", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
         }
     });
 
@@ -141,25 +345,28 @@ int main(int argc, const char **argv) {
 
     // If no output filename was given, make one
     static const char extension[] = ".tar.xz";
+    static const char zstd_extension[] = ".tar.zst";
+    bool zstd = false;
     if(archive_options.output.size() == 0) {
         // Set output
         archive_options.output = File::base_name(base_tag.data()) + ((archive_options.copy) ? "" : extension);
     }
     else {
-        bool fail = true;
-        if(archive_options.output.size() > sizeof(extension)) {
-            fail = std::strcmp(archive_options.output.c_str() + archive_options.output.size() - sizeof(extension) + 1, extension) != 0;
-        }
+        auto has_extension = [&archive_options](const char *extension, std::size_t extension_size) {
+            return archive_options.output.size() > extension_size && std::strcmp(archive_options.output.c_str() + archive_options.output.size() - extension_size, extension) == 0;
+        };
+        bool xz = has_extension(extension, sizeof(extension) - 1);
+        zstd = has_extension(zstd_extension, sizeof(zstd_extension) - 1);
 
         if(!archive_options.copy) {
-            if(fail) {
-                eprintf_error("Invalid output file path %s. This should end with %s.\n", archive_options.output.c_str(), extension);
+            if(!xz && !zstd) {
+                eprintf_error("Invalid output file path %s. This should end with %s or %s.\n", archive_options.output.c_str(), extension, zstd_extension);
                 return EXIT_FAILURE;
             }
         }
         else {
-            if(!fail) {
-                eprintf_warn("Output directory path %s ends with %s.\nThis is technically valid, but you probably didn't want to do this.", archive_options.output.c_str(), extension);
+            if(xz || zstd) {
+                eprintf_warn("Output directory path %s ends with %s.\nThis is technically valid, but you probably didn't want to do this.", archive_options.output.c_str(), xz ? extension : zstd_extension);
             }
         }
     }
@@ -168,7 +375,22 @@ int main(int argc, const char **argv) {
     File::halo_path_to_preferred_path_chars(base_tag.data());
     File::remove_duplicate_slashes_chars(base_tag.data());
 
-    if(!archive_options.single_tag) {
+    if(!archive_options.single_tag && archive_options.dependencies_only) {
+        // Follow references rather than building the map
+        std::vector<ReferencedTag> tags;
+        try {
+            tags = find_scenario_tags(base_tag, *archive_options.engine, archive_options.tags, archive_options.threads);
+        }
+        catch(std::exception &) {
+            return EXIT_FAILURE;
+        }
+
+        archive_list.reserve(tags.size());
+        for(auto &tag : tags) {
+            archive_list.emplace_back(std::move(tag.file_path), File::halo_path_to_preferred_path(tag.tag.path + "." + tag_fourcc_to_extension(tag.tag.fourcc)));
+        }
+    }
+    else if(!archive_options.single_tag) {
         // Build the map
         std::vector<std::byte> map;
 
@@ -334,7 +556,32 @@ int main(int argc, const char **argv) {
     if(!archive_options.copy) {
         // Begin making the archive
         auto *archive = archive_write_new();
-        archive_write_add_filter_xz(archive);
+
+        // Older versions of libarchive (before 3.6.0 for zstd) don't have a threads option, in which case it compresses on one thread
+        auto set_threads = [&archive, &archive_options](const char *filter) {
+            if(archive_options.threads <= 1) {
+                return;
+            }
+            auto threads = std::to_string(archive_options.threads);
+            if(archive_write_set_filter_option(archive, filter, "threads", threads.c_str()) != ARCHIVE_OK) {
+                const char *error = archive_error_string(archive);
+                eprintf_warn("Warning: Failed to compress with %s on %s threads (%s); one thread will be used instead", filter, threads.c_str(), error == nullptr ? "not supported" : error);
+            }
+        };
+
+        if(zstd) {
+            #if ARCHIVE_VERSION_NUMBER >= 3003003
+            archive_write_add_filter_zstd(archive);
+            set_threads("zstd");
+            #else
+            eprintf_error("This build of libarchive does not support zstd. Use %s instead.", extension);
+            return EXIT_FAILURE;
+            #endif
+        }
+        else {
+            archive_write_add_filter_xz(archive);
+            set_threads("xz");
+        }
         archive_write_set_format_pax_restricted(archive);
         archive_write_open_filename(archive, archive_options.output.c_str());
 
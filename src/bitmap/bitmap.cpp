@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <zlib.h>
+#include <algorithm>
 #include <filesystem>
 #include <optional>
 
@@ -76,6 +77,7 @@ struct BitmapOptions {
     std::optional<std::uint32_t> sprite_budget_count;
     std::optional<std::uint16_t> sprite_spacing;
     bool force_square_sprite_sheets = false;
+    BitmapSpritePackingAlgorithm sprite_packing_algorithm = BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_LEGACY;
 
     // Dithering?
     std::optional<bool> dither_alpha, dither_color, dithering;
@@ -204,100 +206,180 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
 
     #undef DEFAULT_VALUE
 
+    // Set up sprite parameters
+    std::optional<BitmapProcessorSpriteParameters> sprite_parameters;
+    if(bitmap_options.bitmap_type.value() == BitmapType::BITMAP_TYPE_SPRITES) {
+        sprite_parameters.emplace();
+        auto &p = sprite_parameters.value();
+        p.sprite_budget = bitmap_options.sprite_budget.value();
+        p.sprite_budget_count = bitmap_options.sprite_budget_count.value();
+        p.sprite_usage = bitmap_options.sprite_usage.value();
+        p.sprite_spacing = bitmap_options.sprite_spacing.value();
+        p.force_square_sprite_sheets = bitmap_options.force_square_sprite_sheets;
+        p.sprite_packing_algorithm = bitmap_options.sprite_packing_algorithm;
+    }
+
     // Have these variables handy
     std::uint32_t image_width = 0, image_height = 0;
     std::size_t image_size = 0;
-    std::vector<Pixel> image_pixels;
-
-    // If we're regenerating, our color plate data is in the tag
-    if(bitmap_options.regenerate) {
-        // Check to see if we have data
-        auto size = bitmap_tag_data.compressed_color_plate_data.size();
-        image_width = bitmap_tag_data.color_plate_width;
-        image_height = bitmap_tag_data.color_plate_height;
-        if(size < sizeof(std::uint32_t) || image_width == 0 || image_height == 0) {
-            eprintf_error("Cannot regenerate a bitmap that doesn't have color plate data.");
-            return EXIT_FAILURE;
+    
+    // Rows are scanned (and compressed) as they're decoded, so the whole color plate never has to be in memory at once
+    std::optional<ColorPlateScanner> scanner;
+    
+    // Compressed color plate data is deflated a chunk at a time straight into the tag
+    static constexpr std::size_t DEFLATE_CHUNK_SIZE = 1024 * 1024;
+    std::vector<std::byte> deflate_chunk;
+    z_stream deflate_stream = {};
+    auto deflate_color_plate = [&deflate_stream, &deflate_chunk, &bitmap_tag_data](const Pixel *pixels, std::size_t size, int flush) {
+        deflate_stream.avail_in = size;
+        deflate_stream.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(pixels));
+        do {
+            deflate_stream.avail_out = deflate_chunk.size();
+            deflate_stream.next_out = reinterpret_cast<Bytef *>(deflate_chunk.data());
+            deflate(&deflate_stream, flush);
+            auto &compressed_data = bitmap_tag_data.compressed_color_plate_data;
+            compressed_data.insert(compressed_data.end(), deflate_chunk.data(), deflate_chunk.data() + (deflate_chunk.size() - deflate_stream.avail_out));
         }
-        
-        // Get the size of the data we're going to decompress
-        auto *data = bitmap_tag_data.compressed_color_plate_data.data();
-        image_size = reinterpret_cast<HEK::BigEndian<std::uint32_t> *>(data)->read();
-        if((image_size % sizeof(Pixel)) != 0) {
-            eprintf_error("Cannot regenerate due the compressed color plate data size being wrong");
-            return EXIT_FAILURE;
+        while(deflate_stream.avail_out == 0);
+    };
+    
+    auto add_rows = [&scanner, &image_width, &image_height, &image_size, &bitmap_options, &bitmap_tag_data, &deflate_stream, &deflate_chunk, &deflate_color_plate](const Pixel *rows, std::uint32_t row_count) {
+        // Begin once we know the dimensions
+        if(!scanner.has_value()) {
+            scanner.emplace(image_width, image_height, bitmap_options.bitmap_type.value(), bitmap_options.usage.value(), *bitmap_options.filthy_sprite_bug_fix);
+            
+            // Compress the original input blob unless we got it from the tag in the first place
+            if(!bitmap_options.regenerate) {
+                BigEndian<std::uint32_t> decompressed_size;
+                decompressed_size = static_cast<std::uint32_t>(image_size);
+                bitmap_tag_data.color_plate_width = image_width;
+                bitmap_tag_data.color_plate_height = image_height;
+                
+                // Set compressed size
+                bitmap_tag_data.compressed_color_plate_data.clear();
+                bitmap_tag_data.compressed_color_plate_data.resize(sizeof(decompressed_size));
+                *reinterpret_cast<BigEndian<std::uint32_t> *>(bitmap_tag_data.compressed_color_plate_data.data()) = decompressed_size;
+                
+                deflate_chunk.resize(DEFLATE_CHUNK_SIZE);
+                deflate_stream.zalloc = Z_NULL;
+                deflate_stream.zfree = Z_NULL;
+                deflate_stream.opaque = Z_NULL;
+                deflateInit(&deflate_stream, Z_BEST_COMPRESSION);
+            }
         }
-        image_pixels = std::vector<Pixel>(image_size / sizeof(Pixel));
         
-        data += sizeof(std::uint32_t);
-        size -= sizeof(std::uint32_t);
+        scanner->add_rows(rows, row_count);
         
-        z_stream inflate_stream;
-        inflate_stream.zalloc = Z_NULL;
-        inflate_stream.zfree = Z_NULL;
-        inflate_stream.opaque = Z_NULL;
-        inflate_stream.avail_out = image_size;
-        inflate_stream.next_out = reinterpret_cast<Bytef *>(image_pixels.data());
-        inflate_stream.avail_in = size;
-        inflate_stream.next_in = reinterpret_cast<Bytef *>(data);
-
-        // Do it
-        inflateInit(&inflate_stream);
-        inflate(&inflate_stream, Z_FINISH);
-        inflateEnd(&inflate_stream);
-    }
+        if(!bitmap_options.regenerate) {
+            deflate_color_plate(rows, static_cast<std::size_t>(row_count) * image_width * sizeof(*rows), Z_NO_FLUSH);
+        }
+    };
     
-    // Otherwise, find the file
-    else {
-        // Try to figure out the extension
-        auto bitmap_data_path = (data_path / bitmap_tag).string();
-        for(auto i = found_format; i < SUPPORTED_FORMATS_INT_COUNT; i = static_cast<SupportedFormatsInt>(i + 1)) {
-            std::string image_path = bitmap_data_path + SUPPORTED_FORMATS[i];
-            if(std::filesystem::exists(image_path)) {
-                switch(i) {
-                    case SUPPORTED_FORMATS_TIF:
-                    case SUPPORTED_FORMATS_TIFF:
-                        image_pixels = load_tiff(image_path.c_str(), image_width, image_height, image_size);
-                        break;
-                    case SUPPORTED_FORMATS_PNG:
-                    case SUPPORTED_FORMATS_TGA:
-                    case SUPPORTED_FORMATS_BMP:
-                        image_pixels = load_image(image_path.c_str(), image_width, image_height, image_size);
-                        break;
-                    default:
-                        std::terminate();
-                        break;
-                }
-                break;
+    // Do it!
+    try {
+        // If we're regenerating, our color plate data is in the tag
+        if(bitmap_options.regenerate) {
+            // Check to see if we have data
+            auto size = bitmap_tag_data.compressed_color_plate_data.size();
+            image_width = bitmap_tag_data.color_plate_width;
+            image_height = bitmap_tag_data.color_plate_height;
+            if(size < sizeof(std::uint32_t) || image_width == 0 || image_height == 0) {
+                eprintf_error("Cannot regenerate a bitmap that doesn't have color plate data.");
+                return EXIT_FAILURE;
+            }
+            
+            // Get the size of the data we're going to decompress
+            auto *data = bitmap_tag_data.compressed_color_plate_data.data();
+            image_size = reinterpret_cast<HEK::BigEndian<std::uint32_t> *>(data)->read();
+            if((image_size % sizeof(Pixel)) != 0 || image_size != static_cast<std::size_t>(image_width) * image_height * sizeof(Pixel)) {
+                eprintf_error("Cannot regenerate due the compressed color plate data size being wrong");
+                return EXIT_FAILURE;
             }
+            
+            data += sizeof(std::uint32_t);
+            size -= sizeof(std::uint32_t);
+            
+            z_stream inflate_stream;
+            inflate_stream.zalloc = Z_NULL;
+            inflate_stream.zfree = Z_NULL;
+            inflate_stream.opaque = Z_NULL;
+            inflate_stream.avail_in = size;
+            inflate_stream.next_in = reinterpret_cast<Bytef *>(data);
+            inflateInit(&inflate_stream);
+            
+            // Inflate a chunk of rows at a time
+            static constexpr std::uint32_t ROWS_PER_CHUNK = 64;
+            std::vector<Pixel> rows(static_cast<std::size_t>(image_width) * ROWS_PER_CHUNK);
+            for(std::uint32_t row = 0; row < image_height; row += ROWS_PER_CHUNK) {
+                auto row_count = std::min(ROWS_PER_CHUNK, image_height - row);
+                auto chunk_size = static_cast<std::size_t>(row_count) * image_width * sizeof(Pixel);
+                inflate_stream.avail_out = chunk_size;
+                inflate_stream.next_out = reinterpret_cast<Bytef *>(rows.data());
+                inflate(&inflate_stream, Z_SYNC_FLUSH);
+                
+                // Anything that didn't decompress is left blank
+                std::fill(reinterpret_cast<std::byte *>(rows.data()) + (chunk_size - inflate_stream.avail_out), reinterpret_cast<std::byte *>(rows.data()) + chunk_size, std::byte());
+                
+                add_rows(rows.data(), row_count);
+            }
+            
+            inflateEnd(&inflate_stream);
         }
-
-        if(image_pixels.empty()) {
-            eprintf_error("Failed to find %s in %s", bitmap_tag.c_str(), bitmap_options.data.string().c_str());
-            eprintf("Valid formats are:\n");
-            for(auto *format : SUPPORTED_FORMATS) {
-                eprintf("    %s\n", format);
+        
+        // Otherwise, find the file
+        else {
+            // Try to figure out the extension
+            bool found = false;
+            auto bitmap_data_path = (data_path / bitmap_tag).string();
+            for(auto i = found_format; i < SUPPORTED_FORMATS_INT_COUNT; i = static_cast<SupportedFormatsInt>(i + 1)) {
+                std::string image_path = bitmap_data_path + SUPPORTED_FORMATS[i];
+                if(std::filesystem::exists(image_path)) {
+                    switch(i) {
+                        case SUPPORTED_FORMATS_TIF:
+                        case SUPPORTED_FORMATS_TIFF:
+                            load_tiff(image_path.c_str(), image_width, image_height, image_size, add_rows);
+                            break;
+                        case SUPPORTED_FORMATS_PNG:
+                        case SUPPORTED_FORMATS_TGA:
+                        case SUPPORTED_FORMATS_BMP:
+                            load_image(image_path.c_str(), image_width, image_height, image_size, add_rows);
+                            break;
+                        default:
+                            std::terminate();
+                            break;
+                    }
+                    found = true;
+                    break;
+                }
             }
-            return EXIT_FAILURE;
+            
+            if(!found) {
+                eprintf_error("Failed to find %s in %s", bitmap_tag.c_str(), bitmap_options.data.string().c_str());
+                eprintf("Valid formats are:\n");
+                for(auto *format : SUPPORTED_FORMATS) {
+                    eprintf("    %s\n", format);
+                }
+                return EXIT_FAILURE;
+            }
+            
+            if(image_size == 0) {
+                eprintf_error("The color plate for %s is empty (%ux%u)", bitmap_tag.c_str(), image_width, image_height);
+                return EXIT_FAILURE;
+            }
+            
+            // Flush the rest of the compressed color plate
+            deflate_color_plate(nullptr, 0, Z_FINISH);
+            deflateEnd(&deflate_stream);
         }
     }
-
-    // Set up sprite parameters
-    std::optional<BitmapProcessorSpriteParameters> sprite_parameters;
-    if(bitmap_options.bitmap_type.value() == BitmapType::BITMAP_TYPE_SPRITES) {
-        sprite_parameters.emplace();
-        auto &p = sprite_parameters.value();
-        p.sprite_budget = bitmap_options.sprite_budget.value();
-        p.sprite_budget_count = bitmap_options.sprite_budget_count.value();
-        p.sprite_usage = bitmap_options.sprite_usage.value();
-        p.sprite_spacing = bitmap_options.sprite_spacing.value();
-        p.force_square_sprite_sheets = bitmap_options.force_square_sprite_sheets;
+    catch (std::exception &e) {
+        eprintf_error("Failed to process the image: %s", e.what());
+        std::exit(1);
     }
-
-    // Do it!
-    auto try_to_scan_color_plate = [&image_pixels, &image_width, &image_height, &bitmap_options, &sprite_parameters]() {
+    
+    auto try_to_scan_color_plate = [&scanner, &bitmap_options, &sprite_parameters]() {
         try {
-            auto scanned_data = ColorPlateScanner::scan_color_plate(image_pixels.data(), image_width, image_height, bitmap_options.bitmap_type.value(), bitmap_options.usage.value(), *bitmap_options.filthy_sprite_bug_fix);
+            auto scanned_data = scanner->finish();
             BitmapProcessor::process_bitmap_data(scanned_data, bitmap_options.bitmap_type.value(), bitmap_options.usage.value(), bitmap_options.bump_height.value(), sprite_parameters, bitmap_options.max_mipmap_count.value(), bitmap_options.mipmap_scale_type.value(), bitmap_options.usage == BitmapUsage::BITMAP_USAGE_DETAIL_MAP ? bitmap_options.mipmap_fade : std::nullopt, bitmap_options.sharpen, bitmap_options.blur, bitmap_options.alpha_bias);
             return scanned_data;
         }
@@ -309,38 +391,6 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
 
     auto scanned_color_plate = try_to_scan_color_plate();
 
-    // Compress the original input blob
-    if(!bitmap_options.regenerate) {
-        // Get ready
-        bitmap_tag_data.compressed_color_plate_data.clear();
-        std::vector<std::byte> compressed_data(image_size * 4);
-        BigEndian<std::uint32_t> decompressed_size;
-        decompressed_size = static_cast<std::uint32_t>(image_size);
-        bitmap_tag_data.color_plate_width = image_width;
-        bitmap_tag_data.color_plate_height = image_height;
-
-        // Set compressed size
-        bitmap_tag_data.compressed_color_plate_data.resize(sizeof(decompressed_size));
-        *reinterpret_cast<BigEndian<std::uint32_t> *>(bitmap_tag_data.compressed_color_plate_data.data()) = decompressed_size;
-
-        // Deflate color plate data
-        compressed_data.resize(image_size * 4);
-        z_stream deflate_stream;
-        deflate_stream.zalloc = Z_NULL;
-        deflate_stream.zfree = Z_NULL;
-        deflate_stream.opaque = Z_NULL;
-        deflate_stream.avail_in = image_size;
-        deflate_stream.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(image_pixels.data()));
-        deflate_stream.avail_out = compressed_data.size();
-        deflate_stream.next_out = reinterpret_cast<Bytef *>(compressed_data.data());
-
-        // Do it
-        deflateInit(&deflate_stream, Z_BEST_COMPRESSION);
-        deflate(&deflate_stream, Z_FINISH);
-        deflateEnd(&deflate_stream);
-        bitmap_tag_data.compressed_color_plate_data.insert(bitmap_tag_data.compressed_color_plate_data.end(), compressed_data.data(), compressed_data.data() + deflate_stream.total_out);
-    }
-
     // Now let's add the actual bitmap data
     #define BYTES_TO_MIB(bytes) (bytes / 1024.0F / 1024.0F)
 
@@ -475,6 +525,7 @@ int main(int argc, char *argv[]) {
     options.emplace_back("budget", 'B', 1, "Set the maximum length of a sprite sheet. Can be 32, 64, 128, 256, 512, or 1024. Default (new tag): 32", "<length>");
     options.emplace_back("budget-count", 'C', 1, "Multiply the maximum length squared to set the maximum number of pixels. Setting this to 0 disables budgeting. Default (new tag): 0", "<count>");
     options.emplace_back("square-sheets", 'S', 0, "Force square sprite sheets (works around particles being incorrectly stretched).");
+    options.emplace_back("sprite-packing", 'k', 1, "Set the sprite sheet packing algorithm. This does not save in .bitmap tags. Can be: legacy or maxrects. Default: legacy", "<algorithm>");
     options.emplace_back("bump-palettize", 'p', 1, "Set the bumpmap palettization setting. Can be: off or on. Default (new tag): off", "<val>");
     options.emplace_back("bump-height", 'H', 1, "Set the apparent bumpmap height from 0.0 to 1.0. Default (new tag): 0.026", "<height>");
     options.emplace_back("alpha-bias", 'A', 1, "Set the alpha bias from -1.0 to 1.0. Default (new tag): 0.0", "<bias>");
@@ -663,6 +714,19 @@ int main(int argc, char *argv[]) {
             case 'S':
                 bitmap_options.force_square_sprite_sheets = true;
                 break;
+                
+            case 'k':
+                if(std::strcmp(arguments[0], "legacy") == 0) {
+                    bitmap_options.sprite_packing_algorithm = BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_LEGACY;
+                }
+                else if(std::strcmp(arguments[0], "maxrects") == 0) {
+                    bitmap_options.sprite_packing_algorithm = BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_MAXRECTS;
+                }
+                else {
+                    eprintf_error("Invalid sprite packing algorithm %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
 
             case 'P':
                 bitmap_options.filesystem_path = true;
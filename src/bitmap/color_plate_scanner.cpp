@@ -1,8 +1,14 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <cassert>
+#include <cstring>
 #include <optional>
 #include <algorithm>
+#include <bit>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <invader/hek/data_type.hpp>
 #include <invader/bitmap/color_plate_scanner.hpp>
@@ -22,353 +28,511 @@ namespace Invader {
 
     #define GET_PIXEL(x,y) (pixels[y * width + x])
 
+    // Pixel with every color channel set and no alpha; ANDing with this drops the alpha channel
+    static inline std::uint32_t color_channels_mask() {
+        Pixel mask = { 0xFF, 0xFF, 0xFF, 0x00 };
+        std::uint32_t value;
+        std::memcpy(&value, &mask, sizeof(value));
+        return value;
+    }
+
+    // Get a color as an integer with no alpha for comparing with masked pixels. If there's no color, return something that can't match.
+    static inline std::uint32_t color_without_opacity(const std::optional<Pixel> &color) {
+        if(!color.has_value()) {
+            return ~color_channels_mask();
+        }
+        std::uint32_t value;
+        std::memcpy(&value, &*color, sizeof(value));
+        return value & color_channels_mask();
+    }
+
+    /**
+     * Set a bit in each mask for every pixel in the row that matches the respective color (ignoring opacity). This reads each pixel once.
+     */
+    static void classify_row(const Pixel *row, std::uint32_t width, const std::uint32_t (&colors)[3], std::uint64_t *const (&masks)[3]) {
+        const auto channels = color_channels_mask();
+        const std::size_t word_count = (static_cast<std::size_t>(width) + 63) / 64;
+
+        #ifdef __SSE2__
+        const auto channels_v = _mm_set1_epi32(static_cast<int>(channels));
+        const __m128i colors_v[3] = { _mm_set1_epi32(static_cast<int>(colors[0])), _mm_set1_epi32(static_cast<int>(colors[1])), _mm_set1_epi32(static_cast<int>(colors[2])) };
+        #endif
+
+        for(std::size_t w = 0; w < word_count; w++) {
+            std::uint64_t bits[3] = {};
+            std::uint32_t x = w * 64;
+            std::uint32_t x_end = std::min(x + 64, width);
+            std::uint32_t bit = 0;
+
+            #ifdef __SSE2__
+            // Four pixels at a time
+            for(; x + 4 <= x_end; x += 4, bit += 4) {
+                auto pixels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x)), channels_v);
+                for(std::size_t c = 0; c < 3; c++) {
+                    bits[c] |= static_cast<std::uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(pixels, colors_v[c])))) << bit;
+                }
+            }
+            #endif
+
+            for(; x < x_end; x++, bit++) {
+                std::uint32_t pixel;
+                std::memcpy(&pixel, row + x, sizeof(pixel));
+                pixel &= channels;
+                for(std::size_t c = 0; c < 3; c++) {
+                    bits[c] |= static_cast<std::uint64_t>(pixel == colors[c]) << bit;
+                }
+            }
+
+            for(std::size_t c = 0; c < 3; c++) {
+                masks[c][w] = bits[c];
+            }
+        }
+    }
+
+    // Find the first bit in [begin, end) that is set (or clear if invert is true). Return end if there isn't one.
+    template <bool invert = false> static std::uint32_t find_bit(const std::uint64_t *mask, std::uint32_t begin, std::uint32_t end) {
+        while(begin < end) {
+            auto word = mask[begin / 64];
+            if constexpr(invert) {
+                word = ~word;
+            }
+            word >>= begin % 64;
+            if(word != 0) {
+                return std::min(begin + static_cast<std::uint32_t>(std::countr_zero(word)), end);
+            }
+            begin = (begin / 64 + 1) * 64;
+        }
+        return end;
+    }
+
+    // Find the last set bit in [begin, end). Return end if there isn't one.
+    static std::uint32_t find_last_bit(const std::uint64_t *mask, std::uint32_t begin, std::uint32_t end) {
+        auto i = end;
+        while(i > begin) {
+            auto last = i - 1;
+            auto word = mask[last / 64] & (~static_cast<std::uint64_t>(0) >> (63 - last % 64));
+            if(word != 0) {
+                auto found = (last / 64) * 64 + 63 - static_cast<std::uint32_t>(std::countl_zero(word));
+                return found >= begin ? found : end;
+            }
+            i = (last / 64) * 64;
+        }
+        return end;
+    }
+
+    static inline bool any_bit(const std::uint64_t *mask, std::uint32_t begin, std::uint32_t end) {
+        return find_bit(mask, begin, end) < end;
+    }
+
+    static inline bool test_bit(const std::uint64_t *mask, std::uint32_t bit) {
+        return (mask[bit / 64] >> (bit % 64)) & 1;
+    }
+
     GeneratedBitmapData ColorPlateScanner::scan_color_plate(const Pixel *pixels, std::uint32_t width, std::uint32_t height, BitmapType type, BitmapUsage usage, bool reg_point_hack) {
+        ColorPlateScanner scanner(width, height, type, usage, reg_point_hack);
+        scanner.add_rows(pixels, height);
+        return scanner.finish();
+    }
+
+    ColorPlateScanner::ColorPlateScanner(std::uint32_t width, std::uint32_t height, BitmapType type, BitmapUsage usage, bool reg_point_hack) : width(width), height(height), reg_point_hack(reg_point_hack) {
         // We don't support this yet
         if(usage == BitmapUsage::BITMAP_USAGE_VECTOR_MAP) {
             eprintf_error("Vector maps are not supported at this time");
             throw std::exception();
         }
-        
-        ColorPlateScanner scanner;
-        GeneratedBitmapData generated_bitmap;
 
-        generated_bitmap.type = type;
-        scanner.power_of_two = (type != BitmapType::BITMAP_TYPE_SPRITES) && (type != BitmapType::BITMAP_TYPE_INTERFACE_BITMAPS);
+        this->generated_bitmap.type = type;
+        this->power_of_two = (type != BitmapType::BITMAP_TYPE_SPRITES) && (type != BitmapType::BITMAP_TYPE_INTERFACE_BITMAPS);
+        this->mask_words_per_row = (static_cast<std::size_t>(width) + 63) / 64;
+    }
 
-        if(width == 0 || height == 0) {
-            return generated_bitmap;
+    void ColorPlateScanner::add_rows(const Pixel *pixels, std::uint32_t row_count) {
+        if(row_count > this->height - this->rows_read) {
+            eprintf_error("Error: Color plate has more than %u rows", this->height);
+            throw InvalidInputBitmapException();
         }
 
-        // Check to see if we have valid color plate data. If so, look for sequences
+        for(std::uint32_t r = 0; r < row_count; r++) {
+            this->add_row(pixels + static_cast<std::size_t>(r) * this->width);
+        }
+    }
+
+    void ColorPlateScanner::read_color_plate_key(const Pixel *row) {
+        // Color plates this small have never produced anything
+        if(width < 4 || height < 2) {
+            this->key = COLOR_PLATE_KEY_TOO_SMALL;
+            return;
+        }
+
+        // Check to see if we have valid color plate data
         bool valid_color_plate_key = true;
-        if(width >= 4 && height >= 2) {
-            // Get the candidate pixels
-            const auto &transparency_candidate = pixels[0];
-            const auto &separator_candidate = pixels[1];
-            const auto &spacing_candidate = pixels[2];
-            
-            // First, check to see if everything on the top row except the first three pixels is transparency
-            for(std::uint32_t x = 3; x < width; x++) {
-                if(!same_color_ignore_opacity(GET_PIXEL(x, 0), transparency_candidate)) {
-                    valid_color_plate_key = false;
-                    break;
-                }
+
+        // Get the candidate pixels
+        const auto &transparency_candidate = row[0];
+        const auto &separator_candidate = row[1];
+        const auto &spacing_candidate = row[2];
+        
+        // First, check to see if everything on the top row except the first three pixels is transparency
+        for(std::uint32_t x = 3; x < width; x++) {
+            if(!same_color_ignore_opacity(row[x], transparency_candidate)) {
+                valid_color_plate_key = false;
+                break;
+            }
+        }
+        
+        // The key is valid maybe?
+        if(valid_color_plate_key) {
+            this->transparency_color = transparency_candidate;
+        
+            // What we need to do next is determine if we have a sequence divider
+            if(!same_color_ignore_opacity(transparency_candidate, separator_candidate)) {
+                this->sequence_divider_color = separator_candidate;
+                this->key = COLOR_PLATE_KEY_SEQUENCE_DIVIDER;
+                
+                // The first sequence starts right after the key (or after a divider on the next row)
+                this->sequence_start = 1;
             }
             
-            // The key is valid maybe?
-            if(valid_color_plate_key) {
-                scanner.transparency_color = transparency_candidate;
+            // If there's no sequence divider color, check if we're blue. If not, we're not a valid key (treat as one bitmap)
+            else if(!this->is_transparency_color(Pixel { 0xFF, 0x00, 0x00, 0xFF } )) {
+                valid_color_plate_key = false;
+            }
             
-                // What we need to do next is determine if we have a sequence divider
-                if(!same_color_ignore_opacity(transparency_candidate, separator_candidate)) {
-                    scanner.sequence_divider_color = separator_candidate;
-                }
-                
-                // If there's no sequence divider color, check if we're blue. If not, we're not a valid key (treat as one bitmap)
-                else if(!scanner.is_transparency_color(Pixel { 0xFF, 0x00, 0x00, 0xFF } )) {
-                    valid_color_plate_key = false;
-                }
+            // Otherwise, it's valid, but we have to look for sequences based on seeing if a horizontal line is fully blue or not
+            //
+            // Basically, transparency IS the sequence divider
+            else {
+                this->key = COLOR_PLATE_KEY_TRANSPARENCY_DIVIDER;
+                this->spacing_color = Pixel { 0xFF, 0xFF, 0x00, 0xFF };
                 
-                // Otherwise, it's valid, but we have to look for sequences based on seeing if a horizontal line is fully blue or not
-                //
-                // Basically, transparency IS the sequence divider
-                else {
-                    // start_y has a value whenever we're inside a sequence
-                    std::optional<std::size_t> start_y;
-                    
-                    auto break_off_sequence = [&start_y, &generated_bitmap](std::size_t y) {
-                        if(start_y.has_value()) {
-                            auto &sequences = generated_bitmap.sequences.emplace_back();
-                            sequences.y_start = *start_y;
-                            sequences.y_end = y;
-                            start_y = std::nullopt;
-                        }
-                        else {
-                            start_y = y;
-                        }
-                    };
-                    
-                    for(std::size_t y = 1; y < height; y++) {
-                        bool all_blue = true;
-                        for(std::size_t x = 0; x < width; x++) {
-                            if(!scanner.is_transparency_color(GET_PIXEL(x,y))) {
-                                all_blue = false;
-                                break;
-                            }
-                        }
-                        
-                        // If it's all blue and we're in a sequence, then the sequence has ended
-                        if(all_blue == start_y.has_value()) {
-                            break_off_sequence(y);
-                        }
-                    }
-                    
-                    break_off_sequence(height);
-                    
-                    scanner.spacing_color = Pixel { 0xFF, 0xFF, 0x00, 0xFF };
-                    
-                    if(!scanner.is_transparency_color(spacing_candidate) && !scanner.is_spacing_color(spacing_candidate)) {
-                        eprintf_error("Error: Spacing color, if set, can only be #00FFFF if sequence divider is not set");
-                        throw InvalidInputBitmapException();
-                    }
+                if(!this->is_transparency_color(spacing_candidate) && !this->is_spacing_color(spacing_candidate)) {
+                    eprintf_error("Error: Spacing color, if set, can only be #00FFFF if sequence divider is not set");
+                    throw InvalidInputBitmapException();
                 }
             }
+        }
+        
+        // Is it still valid? If so, check spacing
+        if(valid_color_plate_key && !this->spacing_color.has_value() && !same_color_ignore_opacity(transparency_candidate, spacing_candidate)) {
+            this->spacing_color = spacing_candidate;
             
-            // If we still have a valid color plate key and we don't have sequences, find them
-            if(valid_color_plate_key && !generated_bitmap.sequences.size()) {
-                // Generate sequences
-                auto *sequence = &generated_bitmap.sequences.emplace_back();
-                
-                auto is_horizontal_bar = [&scanner, &width, &pixels](std::size_t y) {
-                    if(scanner.is_sequence_divider_color(GET_PIXEL(0,y))) {
-                        for(std::size_t x = 1; x < width; x++) {
-                            if(!scanner.is_sequence_divider_color(GET_PIXEL(x,y))) {
-                                eprintf_error("Sequence divider broken at (%zu,%zu)", x, y);
-                                throw InvalidInputBitmapException();
-                            }
-                        }
-                        return true;
-                    }
-                    return false;
-                };
-                
-                sequence->y_start = is_horizontal_bar(1) ? 2 : 1;
-
-                // Next, we need to find all of the sequences
-                for(std::uint32_t y = sequence->y_start; y < height; y++) {
-                    // If we got it, create a new sequence, but not before terminating the last one
-                    if(is_horizontal_bar(y)) {
-                        sequence->y_end = y;
-                        sequence = &generated_bitmap.sequences.emplace_back();
-                        sequence->y_start = y + 1;
+            // Make sure it's valid!
+            if(same_color_ignore_opacity(separator_candidate, spacing_candidate)) {
+                eprintf_error("Spacing and sequence divider colors must not match");
+                throw InvalidInputBitmapException();
+            }
+        }
+
+        // Otherwise, we'll need the whole image as one bitmap
+        if(!valid_color_plate_key) {
+            this->key = COLOR_PLATE_KEY_NONE;
+            this->pending_rows.reserve(static_cast<std::size_t>(this->width) * this->height);
+        }
+    }
+
+    void ColorPlateScanner::add_row(const Pixel *row) {
+        auto y = this->rows_read++;
+
+        // The first row holds the key (if any)
+        if(y == 0) {
+            this->read_color_plate_key(row);
+            if(this->key == COLOR_PLATE_KEY_NONE) {
+                this->pending_rows.insert(this->pending_rows.end(), row, row + this->width);
+            }
+            else if(this->key != COLOR_PLATE_KEY_TOO_SMALL) {
+                this->row_masks.resize(this->mask_words_per_row * 3);
+            }
+            return;
+        }
+
+        // Nothing to read
+        if(this->key == COLOR_PLATE_KEY_TOO_SMALL) {
+            return;
+        }
+
+        // Without a key, we just hold onto everything
+        if(this->key == COLOR_PLATE_KEY_NONE) {
+            this->pending_rows.insert(this->pending_rows.end(), row, row + this->width);
+            return;
+        }
+
+        // Find which pixels are transparency, sequence dividers, and spacing
+        const auto words = this->mask_words_per_row;
+        auto *transparency_mask = this->row_masks.data();
+        auto *divider_mask = transparency_mask + words;
+        auto *spacing_mask = divider_mask + words;
+        classify_row(row, this->width, { color_without_opacity(this->transparency_color), color_without_opacity(this->sequence_divider_color), color_without_opacity(this->spacing_color) }, { transparency_mask, divider_mask, spacing_mask });
+
+        switch(this->key) {
+            case COLOR_PLATE_KEY_SEQUENCE_DIVIDER: {
+                bool horizontal_bar = false;
+                if(test_bit(divider_mask, 0)) {
+                    auto broken_x = find_bit<true>(divider_mask, 1, this->width);
+                    if(broken_x < this->width) {
+                        eprintf_error("Sequence divider broken at (%u,%u)", broken_x, y);
+                        throw InvalidInputBitmapException();
                     }
+                    horizontal_bar = true;
+                }
+
+                // A divider right below the key just moves the first sequence down
+                if(horizontal_bar && y == 1) {
+                    this->sequence_start = 2;
+                    return;
                 }
 
-                // Terminate the last sequence index
-                sequence->y_end = height;
+                // Otherwise, a divider terminates the last sequence and starts a new one
+                else if(horizontal_bar) {
+                    this->end_sequence(y);
+                    this->sequence_start = y + 1;
+                    return;
+                }
+                break;
             }
-            
-            // Is it still valid? If so, check spacing
-            if(valid_color_plate_key && !scanner.spacing_color.has_value() && !same_color_ignore_opacity(transparency_candidate, spacing_candidate)) {
-                scanner.spacing_color = spacing_candidate;
-                
-                // Make sure it's valid!
-                if(same_color_ignore_opacity(separator_candidate, spacing_candidate)) {
-                    eprintf_error("Spacing and sequence divider colors must not match");
-                    throw InvalidInputBitmapException();
+
+            case COLOR_PLATE_KEY_TRANSPARENCY_DIVIDER: {
+                bool all_blue = find_bit<true>(transparency_mask, 0, this->width) == this->width;
+
+                // If it's all blue and we're in a sequence, then the sequence has ended
+                if(all_blue && this->sequence_start.has_value()) {
+                    this->end_sequence(y);
                 }
+
+                // If it isn't and we aren't in one, then a sequence has started
+                else if(!all_blue && !this->sequence_start.has_value()) {
+                    this->sequence_start = y;
+                }
+
+                if(!this->sequence_start.has_value()) {
+                    return;
+                }
+                break;
             }
+
+            case COLOR_PLATE_KEY_NONE:
+            case COLOR_PLATE_KEY_TOO_SMALL:
+            case COLOR_PLATE_KEY_UNKNOWN:
+                std::terminate();
         }
 
-        // If we have valid color plate data, use the color plate data
-        if(valid_color_plate_key) {
-            scanner.read_color_plate(generated_bitmap, pixels, width, reg_point_hack);
+        // Hold onto the row along with which pixels are visible (not transparency or sequence dividers) and which are actual bitmap data (not spacing either)
+        this->pending_rows.insert(this->pending_rows.end(), row, row + this->width);
+        auto trailing_bits = this->width % 64;
+        for(std::size_t w = 0; w < words; w++) {
+            auto valid = (w + 1 == words && trailing_bits != 0) ? ((static_cast<std::uint64_t>(1) << trailing_bits) - 1) : ~static_cast<std::uint64_t>(0);
+            auto visible = ~(transparency_mask[w] | divider_mask[w]) & valid;
+            this->pending_visible_masks.emplace_back(visible);
+            this->pending_content_masks.emplace_back(visible & ~spacing_mask[w]);
         }
+    }
 
-        // Otherwise, read as one bitmap
-        else {
-            auto &new_sequence = generated_bitmap.sequences.emplace_back();
-            new_sequence.bitmap_count = 1;
-            new_sequence.first_bitmap = 0;
-            new_sequence.y_start = 0;
-            new_sequence.y_end = height;
+    void ColorPlateScanner::end_sequence(std::uint32_t y_end) {
+        auto &sequence = this->generated_bitmap.sequences.emplace_back();
+        sequence.y_start = this->sequence_start.value();
+        sequence.y_end = y_end;
+        this->sequence_start = std::nullopt;
 
-            if(type == BitmapType::BITMAP_TYPE_CUBE_MAPS) {
-                scanner.read_unrolled_cubemap(generated_bitmap, pixels, width, height);
-            }
-            else if(type == BitmapType::BITMAP_TYPE_SPRITES) {
-                eprintf_error("Error: Sprite color plates must have a color plate key.\n");
-                throw InvalidInputBitmapException();
-            }
-            else {
-                scanner.read_single_bitmap(generated_bitmap, pixels, width, height);
+        this->read_sequence(sequence, this->pending_rows.data());
+
+        // Keep the capacity around for the next sequence
+        this->pending_rows.clear();
+        this->pending_visible_masks.clear();
+        this->pending_content_masks.clear();
+    }
+
+    GeneratedBitmapData ColorPlateScanner::finish() {
+        if(this->rows_read != this->height) {
+            eprintf_error("Error: Color plate is missing rows (%u / %u)", this->rows_read, this->height);
+            throw InvalidInputBitmapException();
+        }
+
+        if(width == 0 || height == 0) {
+            return std::move(this->generated_bitmap);
+        }
+
+        switch(this->key) {
+            // Terminate the last sequence
+            case COLOR_PLATE_KEY_SEQUENCE_DIVIDER:
+                this->end_sequence(this->height);
+                break;
+
+            case COLOR_PLATE_KEY_TRANSPARENCY_DIVIDER:
+                if(this->sequence_start.has_value()) {
+                    this->end_sequence(this->height);
+                }
+
+                // If everything is blue, we still get a single (empty) sequence
+                else if(this->generated_bitmap.sequences.empty()) {
+                    auto &sequence = this->generated_bitmap.sequences.emplace_back();
+                    sequence.y_start = 1;
+                    sequence.y_end = this->height;
+                    sequence.first_bitmap = this->generated_bitmap.bitmaps.size();
+                    sequence.bitmap_count = 0;
+                }
+                break;
+
+            // Otherwise, read as one bitmap
+            case COLOR_PLATE_KEY_NONE: {
+                auto &new_sequence = this->generated_bitmap.sequences.emplace_back();
+                new_sequence.bitmap_count = 1;
+                new_sequence.first_bitmap = 0;
+                new_sequence.y_start = 0;
+                new_sequence.y_end = height;
+
+                if(this->generated_bitmap.type == BitmapType::BITMAP_TYPE_CUBE_MAPS) {
+                    this->read_unrolled_cubemap(this->generated_bitmap, this->pending_rows.data(), width, height);
+                }
+                else if(this->generated_bitmap.type == BitmapType::BITMAP_TYPE_SPRITES) {
+                    eprintf_error("Error: Sprite color plates must have a color plate key.\n");
+                    throw InvalidInputBitmapException();
+                }
+                else {
+                    this->read_single_bitmap(this->generated_bitmap, this->pending_rows.data(), width, height);
+                }
+                break;
             }
+
+            // No sequences, no bitmaps
+            case COLOR_PLATE_KEY_TOO_SMALL:
+                break;
+
+            case COLOR_PLATE_KEY_UNKNOWN:
+                std::terminate();
         }
 
-        return generated_bitmap;
+        this->pending_rows = std::vector<Pixel>();
+        this->pending_visible_masks = std::vector<std::uint64_t>();
+        this->pending_content_masks = std::vector<std::uint64_t>();
+        return std::move(this->generated_bitmap);
     }
 
-    void ColorPlateScanner::read_color_plate(GeneratedBitmapData &generated_bitmap, const Pixel *pixels, std::uint32_t width, bool reg_point_hack) const {
-        for(auto &sequence : generated_bitmap.sequences) {
-            sequence.first_bitmap = generated_bitmap.bitmaps.size();
-            sequence.bitmap_count = 0;
+    void ColorPlateScanner::read_sequence(GeneratedBitmapDataSequence &sequence, const Pixel *pixels) {
+        auto &generated_bitmap = this->generated_bitmap;
+        const auto width = this->width;
+        const auto words = this->mask_words_per_row;
+
+        sequence.first_bitmap = generated_bitmap.bitmaps.size();
+        sequence.bitmap_count = 0;
+
+        const std::uint32_t Y_START = sequence.y_start;
+        const std::uint32_t Y_END = sequence.y_end;
+        const std::uint32_t ROW_COUNT = Y_END - Y_START;
+
+        // Here, pixels and masks start at the first row of the sequence
+        const auto *visible_masks = this->pending_visible_masks.data();
+        const auto *content_masks = this->pending_content_masks.data();
+        #define GET_SEQUENCE_PIXEL(x,y) GET_PIXEL(x,(y - Y_START))
+        #define VISIBLE_MASK(y) (visible_masks + (y - Y_START) * words)
+        #define CONTENT_MASK(y) (content_masks + (y - Y_START) * words)
+
+        // This is used for the registration point
+        const double MID_Y = (static_cast<double>(Y_START) + static_cast<double>(Y_END)) / 2.0;
+
+        // Find which columns have anything visible and which have bitmap data
+        std::vector<std::uint64_t> visible_columns(words), content_columns(words);
+        for(std::uint32_t r = 0; r < ROW_COUNT; r++) {
+            for(std::size_t w = 0; w < words; w++) {
+                visible_columns[w] |= visible_masks[r * words + w];
+                content_columns[w] |= content_masks[r * words + w];
+            }
+        }
 
-            // Search left and right for bitmap borders
-            const std::uint32_t X_END = width;
-            const std::uint32_t Y_START = sequence.y_start;
-            const std::uint32_t Y_END = sequence.y_end;
+        // Each run of columns with something visible in them is a bitmap (sprites can't possibly be adjacent to each other)
+        for(std::uint32_t x = find_bit(visible_columns.data(), 0, width); x < width; x = find_bit(visible_columns.data(), x, width)) {
+            auto run_end = find_bit<true>(visible_columns.data(), x, width);
 
-            // This is used for the registration point
-            const double MID_Y = (static_cast<double>(Y_START) + static_cast<double>(Y_END)) / 2.0;
+            // If it's all spacing, then continue on
+            auto min_x = find_bit(content_columns.data(), x, run_end);
+            if(min_x == run_end) {
+                x = run_end;
+                continue;
+            }
+            auto max_x = find_last_bit(content_columns.data(), x, run_end);
 
-            // Go through each pixel
-            for(std::uint32_t x = 0; x < X_END; x++) {
-                for(std::uint32_t y = Y_START; y < Y_END; y++) {
-                    auto &pixel = GET_PIXEL(x,y);
+            // Virtual bounds include spacing
+            auto virtual_min_x = x;
+            auto virtual_max_x = run_end - 1;
 
-                    // Ignore? Okay.
-                    if(this->is_transparency_color(pixel) || this->is_sequence_divider_color(pixel)) {
-                        continue;
-                    }
+            // Find the minimum and maximum y
+            std::uint32_t min_y = Y_START, max_y = Y_END - 1, virtual_min_y = Y_START, virtual_max_y = Y_END - 1;
+            while(!any_bit(CONTENT_MASK(min_y), min_x, max_x + 1)) {
+                min_y++;
+            }
+            while(!any_bit(CONTENT_MASK(max_y), min_x, max_x + 1)) {
+                max_y--;
+            }
+            while(!any_bit(VISIBLE_MASK(virtual_min_y), virtual_min_x, run_end)) {
+                virtual_min_y++;
+            }
+            while(!any_bit(VISIBLE_MASK(virtual_max_y), virtual_min_x, run_end)) {
+                virtual_max_y--;
+            }
 
-                    // Begin.
-                    std::optional<std::uint32_t> min_x;
-                    std::optional<std::uint32_t> max_x;
-                    std::optional<std::uint32_t> min_y;
-                    std::optional<std::uint32_t> max_y;
-
-                    std::optional<std::uint32_t> virtual_min_x;
-                    std::optional<std::uint32_t> virtual_max_x;
-                    std::optional<std::uint32_t> virtual_min_y;
-                    std::optional<std::uint32_t> virtual_max_y;
-
-                    // Find the minimum x, y, max x, and max y stuff
-                    for(std::uint32_t xb = x; xb < X_END; xb++) {
-                        // Set this to false if we got something this column
-                        bool ignored_this_x = true;
-
-                        for(std::uint32_t yb = Y_START; yb < Y_END; yb++) {
-                            auto &pixel = GET_PIXEL(xb, yb);
-
-                            // This is for anything that's not a cyan/magenta/blue pixel
-                            if(!this->is_ignored(pixel)) {
-                                if(min_x.has_value()) {
-                                    if(min_x.value() > xb) {
-                                        min_x = xb;
-                                    }
-                                    if(min_y.value() > yb) {
-                                        min_y = yb;
-                                    }
-                                    if(max_x.value() < xb) {
-                                        max_x = xb;
-                                    }
-                                    if(max_y.value() < yb) {
-                                        max_y = yb;
-                                    }
-                                }
-                                else {
-                                    min_x = xb;
-                                    min_y = yb;
-                                    max_x = xb;
-                                    max_y = yb;
-                                }
-                            }
-
-                            // Anything that's not a magenta/blue pixel then
-                            if(!this->is_transparency_color(pixel) && !this->is_sequence_divider_color(pixel)) {
-                                ignored_this_x = false;
-
-                                if(virtual_min_x.has_value()) {
-                                    if(virtual_min_x.value() > xb) {
-                                        virtual_min_x = xb;
-                                    }
-                                    if(virtual_min_y.value() > yb) {
-                                        virtual_min_y = yb;
-                                    }
-                                    if(virtual_max_x.value() < xb) {
-                                        virtual_max_x = xb;
-                                    }
-                                    if(virtual_max_y.value() < yb) {
-                                        virtual_max_y = yb;
-                                    }
-                                }
-                                else {
-                                    virtual_min_x = xb;
-                                    virtual_min_y = yb;
-                                    virtual_max_x = xb;
-                                    virtual_max_y = yb;
-                                }
-                            }
-                        }
-
-                        if(ignored_this_x) {
-                            break;
-                        }
-                    }
+            // Get the width and height
+            std::uint32_t bitmap_width = max_x - min_x + 1;
+            std::uint32_t bitmap_height = max_y - min_y + 1;
 
-                    // If we never got a minimum x, then continue on
-                    if(!min_x.has_value()) {
-                        continue;
-                    }
+            // If we require power-of-two, check
+            if(power_of_two) {
+                if(!HEK::is_power_of_two(bitmap_width)) {
+                    eprintf(ERROR_INVALID_BITMAP_WIDTH, bitmap_width);
+                    throw InvalidInputBitmapException();
+                }
+                if(!HEK::is_power_of_two(bitmap_height)) {
+                    eprintf(ERROR_INVALID_BITMAP_HEIGHT, bitmap_height);
+                    throw InvalidInputBitmapException();
+                }
+            }
 
-                    // Get the width and height
-                    std::uint32_t bitmap_width = max_x.value() - min_x.value() + 1;
-                    std::uint32_t bitmap_height = max_y.value() - min_y.value() + 1;
-
-                    // If we require power-of-two, check
-                    if(power_of_two) {
-                        if(!HEK::is_power_of_two(bitmap_width)) {
-                            eprintf(ERROR_INVALID_BITMAP_WIDTH, bitmap_width);
-                            throw InvalidInputBitmapException();
-                        }
-                        if(!HEK::is_power_of_two(bitmap_height)) {
-                            eprintf(ERROR_INVALID_BITMAP_HEIGHT, bitmap_height);
-                            throw InvalidInputBitmapException();
-                        }
-                    }
+            // Add the bitmap
+            auto &bitmap = generated_bitmap.bitmaps.emplace_back();
+            bitmap.width = bitmap_width;
+            bitmap.height = bitmap_height;
+            bitmap.color_plate_x = min_x;
+            bitmap.color_plate_y = min_y;
+            
+            auto min_x_f = static_cast<double>(min_x);
+            auto min_y_f = static_cast<double>(min_y);
+            auto virtual_min_x_f = static_cast<double>(virtual_min_x);
+            auto virtual_min_y_f = static_cast<double>(virtual_min_y);
+            auto virtual_max_x_f = static_cast<double>(virtual_max_x);
+            auto virtual_max_y_f = static_cast<double>(virtual_max_y);
+
+            // Calculate registration point.
+            const double MID_X = (virtual_max_x_f + virtual_min_x_f) / 2.0;
+
+            // The x point is the midpoint of the width of the bitmap and cyan stuff relative to the left
+            bitmap.registration_point_x = MID_X - min_x_f + 0.5;
+
+            // The y point is the midpoint of the height of the entire sequence relative to the top (or if we have the reg point hack, relative to the top of the bitmap itself)
+            if(!this->reg_point_hack) {
+                bitmap.registration_point_y = MID_Y - min_y_f + 0.5;
+            }
+            else {
+                bitmap.registration_point_y = virtual_min_y_f - min_y_f + (virtual_max_y_f - virtual_min_y_f) / 2.0 + 0.5;
+            }
 
-                    // Add the bitmap
-                    auto &bitmap = generated_bitmap.bitmaps.emplace_back();
-                    bitmap.width = bitmap_width;
-                    bitmap.height = bitmap_height;
-                    bitmap.color_plate_x = min_x.value();
-                    bitmap.color_plate_y = min_y.value();
-                    
-                    assert(min_x.has_value());
-                    assert(min_y.has_value());
-                    assert(virtual_min_x.has_value());
-                    assert(virtual_min_y.has_value());
-                    
-                    assert(max_x.has_value());
-                    assert(max_y.has_value());
-                    assert(virtual_max_x.has_value());
-                    assert(virtual_max_y.has_value());
-                    
-                    auto min_x_f = static_cast<double>(*min_x);
-                    auto min_y_f = static_cast<double>(*min_y);
-                    auto virtual_min_x_f = static_cast<double>(*virtual_min_x);
-                    auto virtual_min_y_f = static_cast<double>(*virtual_min_y);
-                    
-                    //auto max_x_f = static_cast<double>(*max_x);
-                    //auto max_y_f = static_cast<double>(*max_y);
-                    auto virtual_max_x_f = static_cast<double>(*virtual_max_x);
-                    auto virtual_max_y_f = static_cast<double>(*virtual_max_y);
-
-                    // Calculate registration point.
-                    const double MID_X = (virtual_max_x_f + virtual_min_x_f) / 2.0;
-
-                    // The x point is the midpoint of the width of the bitmap and cyan stuff relative to the left
-                    bitmap.registration_point_x = MID_X - min_x_f + 0.5;
-
-                    // The y point is the midpoint of the height of the entire sequence relative to the top (or if we have the reg point hack, relative to the top of the bitmap itself)
-                    if(!reg_point_hack) {
-                        bitmap.registration_point_y = MID_Y - min_y_f + 0.5;
+            // Load the pixels
+            bitmap.pixels.reserve(static_cast<std::size_t>(bitmap_width) * bitmap_height);
+            for(std::uint32_t by = min_y; by <= max_y; by++) {
+                const auto *content_mask = CONTENT_MASK(by);
+                for(std::uint32_t bx = min_x; bx <= max_x; bx++) {
+                    if(test_bit(content_mask, bx)) {
+                        bitmap.pixels.push_back(GET_SEQUENCE_PIXEL(bx, by));
                     }
                     else {
-                        bitmap.registration_point_y = virtual_min_y_f - min_y_f + (virtual_max_y_f - virtual_min_y_f) / 2.0 + 0.5;
-                    }
-
-                    // Load the pixels
-                    for(std::uint32_t by = min_y.value(); by <= max_y.value(); by++) {
-                        for(std::uint32_t bx = min_x.value(); bx <= max_x.value(); bx++) {
-                            auto &pixel = GET_PIXEL(bx, by);
-                            if(this->is_ignored(pixel)) {
-                                bitmap.pixels.push_back(Pixel {});
-                            }
-                            else {
-                                bitmap.pixels.push_back(pixel);
-                            }
-                        }
+                        bitmap.pixels.push_back(Pixel {});
                     }
-
-                    sequence.bitmap_count++;
-
-                    // Set it to the max value. Add 1 since sprites can't possibly be adjacent to each other. Then, the for loop will add 1 again to get to the minimum possible x value.
-                    x = virtual_max_x.value() + 1;
-                    break;
                 }
             }
+
+            sequence.bitmap_count++;
+            x = run_end;
         }
+
+        #undef GET_SEQUENCE_PIXEL
+        #undef VISIBLE_MASK
+        #undef CONTENT_MASK
     }
 
     void ColorPlateScanner::read_unrolled_cubemap(GeneratedBitmapData &generated_bitmap, const Pixel *pixels, std::uint32_t width, std::uint32_t height) const {
@@ -468,8 +632,4 @@ namespace Invader {
     bool ColorPlateScanner::is_spacing_color(const Pixel &color) const {
         return this->spacing_color.has_value() && same_color_ignore_opacity(*this->spacing_color, color);
     }
-
-    bool ColorPlateScanner::is_ignored(const Pixel &color) const {
-        return this->is_transparency_color(color) || this->is_spacing_color(color) || this->is_sequence_divider_color(color);
-    }
 }
@@ -1,14 +1,17 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <tiffio.h>
+#include <algorithm>
+#include <vector>
 #include "image_loader.hpp"
 #include <invader/printf.hpp>
 #include "stb/stb_image.h"
 
 namespace Invader {
-    static std::vector<Pixel> rgba_to_pixel(const std::uint8_t *data, std::size_t pixel_count) {
-        auto pixel_data = std::vector<Pixel>(pixel_count);
+    // Rows passed to the callback at once when the decoder doesn't dictate it
+    static constexpr std::uint32_t ROWS_PER_CHUNK = 64;
 
+    static void rgba_to_pixel(const std::uint8_t *data, Pixel *pixel_data, std::size_t pixel_count) {
         for(std::size_t i = 0; i < pixel_count; i++) {
             pixel_data[i].alpha = data[3];
             pixel_data[i].red = data[0];
@@ -16,14 +19,19 @@ namespace Invader {
             pixel_data[i].blue = data[2];
             data += 4;
         }
-
-        return pixel_data;
     }
 
-    #undef ALLOCATE_PIXELS
+    static void abgr_to_pixel(const std::uint32_t *data, Pixel *pixel_data, std::size_t pixel_count) {
+        for(std::size_t i = 0; i < pixel_count; i++) {
+            pixel_data[i].alpha = TIFFGetA(data[i]);
+            pixel_data[i].red = TIFFGetR(data[i]);
+            pixel_data[i].green = TIFFGetG(data[i]);
+            pixel_data[i].blue = TIFFGetB(data[i]);
+        }
+    }
 
-    std::vector<Pixel> load_image(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size) {
-        // Load it
+    void load_image(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size, const ImageRowCallback &callback) {
+        // Load it (stb_image can't decode incrementally, but we can at least avoid holding a second copy)
         int x = 0, y = 0, channels = 0;
         auto *image_buffer = stbi_load(path, &x, &y, &channels, 4);
         if(!image_buffer) {
@@ -34,18 +42,21 @@ namespace Invader {
         // Get the width and height
         image_width = static_cast<std::uint32_t>(x);
         image_height = static_cast<std::uint32_t>(y);
-        image_size = image_width * image_height * sizeof(Invader::Pixel);
-
-        // Do the thing
-        auto return_value = rgba_to_pixel(reinterpret_cast<std::uint8_t *>(image_buffer), image_width * image_height);
+        image_size = static_cast<std::size_t>(image_width) * image_height * sizeof(Invader::Pixel);
+
+        // Do the thing, a chunk of rows at a time
+        std::vector<Pixel> rows(static_cast<std::size_t>(image_width) * ROWS_PER_CHUNK);
+        for(std::uint32_t row = 0; row < image_height; row += ROWS_PER_CHUNK) {
+            auto row_count = std::min(ROWS_PER_CHUNK, image_height - row);
+            rgba_to_pixel(reinterpret_cast<std::uint8_t *>(image_buffer) + static_cast<std::size_t>(row) * image_width * 4, rows.data(), static_cast<std::size_t>(row_count) * image_width);
+            callback(rows.data(), row_count);
+        }
 
         // Free the buffer
         stbi_image_free(image_buffer);
-
-        return return_value;
     }
 
-    std::vector<Pixel> load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size) {
+    void load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size, const ImageRowCallback &callback) {
         TIFF *image_tiff = TIFFOpen(path, "r");
         if(!image_tiff) {
             eprintf_error("Cannot open %s", path);
@@ -53,8 +64,9 @@ namespace Invader {
         }
         TIFFGetField(image_tiff, TIFFTAG_IMAGEWIDTH, &image_width);
         TIFFGetField(image_tiff, TIFFTAG_IMAGELENGTH, &image_height);
+        image_size = static_cast<std::size_t>(image_width) * image_height * sizeof(Invader::Pixel);
 
-        // Force associated alpha if we have alpha so alpha doesn't get multiplied in TIFFReadRGBAImageOriented
+        // Force associated alpha if we have alpha so alpha doesn't get multiplied when reading RGBA
         std::uint16_t count;
         std::uint16_t *attributes;
         int defined = TIFFGetField(image_tiff, TIFFTAG_EXTRASAMPLES, &count, &attributes);
@@ -65,22 +77,78 @@ namespace Invader {
             }
         }
 
-        // Read it all
-        image_size = image_width * image_height * sizeof(Invader::Pixel);
-        auto image_pixels = std::vector<Invader::Pixel>(image_size);
-        TIFFReadRGBAImageOriented(image_tiff, image_width, image_height, reinterpret_cast<std::uint32_t *>(image_pixels.data()), ORIENTATION_TOPLEFT);
+        auto read_failed = [&image_tiff, &path]() {
+            eprintf_error("Failed to read %s", path);
+            TIFFClose(image_tiff);
+            exit(EXIT_FAILURE);
+        };
+
+        // Strips and tiles are read as they're stored, so anything not stored top-down, left-to-right has to be decoded all at once and reoriented
+        std::uint16_t orientation = ORIENTATION_TOPLEFT;
+        TIFFGetFieldDefaulted(image_tiff, TIFFTAG_ORIENTATION, &orientation);
+
+        // Read a strip (or a row of tiles) at a time. libtiff gives us each block bottom-up.
+        std::vector<Pixel> rows;
+        if(orientation != ORIENTATION_TOPLEFT) {
+            std::vector<std::uint32_t> image(static_cast<std::size_t>(image_width) * image_height);
+            if(!TIFFReadRGBAImageOriented(image_tiff, image_width, image_height, image.data(), ORIENTATION_TOPLEFT)) {
+                read_failed();
+            }
 
-        // Close the TIFF
-        TIFFClose(image_tiff);
+            rows.resize(static_cast<std::size_t>(image_width) * ROWS_PER_CHUNK);
+            for(std::uint32_t row = 0; row < image_height; row += ROWS_PER_CHUNK) {
+                auto row_count = std::min(ROWS_PER_CHUNK, image_height - row);
+                abgr_to_pixel(image.data() + static_cast<std::size_t>(row) * image_width, rows.data(), static_cast<std::size_t>(row_count) * image_width);
+                callback(rows.data(), row_count);
+            }
+        }
+        else if(TIFFIsTiled(image_tiff)) {
+            std::uint32_t tile_width = 0, tile_height = 0;
+            TIFFGetField(image_tiff, TIFFTAG_TILEWIDTH, &tile_width);
+            TIFFGetField(image_tiff, TIFFTAG_TILELENGTH, &tile_height);
+            if(tile_width == 0 || tile_height == 0) {
+                read_failed();
+            }
+
+            std::vector<std::uint32_t> tile(static_cast<std::size_t>(tile_width) * tile_height);
+            rows.resize(static_cast<std::size_t>(image_width) * tile_height);
+
+            for(std::uint32_t row = 0; row < image_height; row += tile_height) {
+                auto row_count = std::min(tile_height, image_height - row);
+                for(std::uint32_t column = 0; column < image_width; column += tile_width) {
+                    if(!TIFFReadRGBATile(image_tiff, column, row, tile.data())) {
+                        read_failed();
+                    }
+                    auto column_count = std::min(tile_width, image_width - column);
+                    for(std::uint32_t r = 0; r < row_count; r++) {
+                        abgr_to_pixel(tile.data() + static_cast<std::size_t>(tile_height - 1 - r) * tile_width, rows.data() + static_cast<std::size_t>(r) * image_width + column, column_count);
+                    }
+                }
+                callback(rows.data(), row_count);
+            }
+        }
+        else {
+            std::uint32_t rows_per_strip = 0;
+            if(!TIFFGetFieldDefaulted(image_tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip) || rows_per_strip == 0 || rows_per_strip > image_height) {
+                rows_per_strip = image_height;
+            }
 
-        // Swap red and blue channels
-        for(std::size_t i = 0; i < image_size / 4; i++) {
-            Invader::Pixel swapped = image_pixels[i];
-            swapped.red = image_pixels[i].blue;
-            swapped.blue = image_pixels[i].red;
-            image_pixels[i] = swapped;
+            std::vector<std::uint32_t> strip(static_cast<std::size_t>(image_width) * rows_per_strip);
+            rows.resize(strip.size());
+
+            for(std::uint32_t row = 0; row < image_height; row += rows_per_strip) {
+                auto row_count = std::min(rows_per_strip, image_height - row);
+                if(!TIFFReadRGBAStrip(image_tiff, row, strip.data())) {
+                    read_failed();
+                }
+                for(std::uint32_t r = 0; r < row_count; r++) {
+                    abgr_to_pixel(strip.data() + static_cast<std::size_t>(row_count - 1 - r) * image_width, rows.data() + static_cast<std::size_t>(r) * image_width, image_width);
+                }
+                callback(rows.data(), row_count);
+            }
         }
 
-        return image_pixels;
+        // Close the TIFF
+        TIFFClose(image_tiff);
     }
 }
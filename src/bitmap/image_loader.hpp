@@ -4,12 +4,17 @@
 #define INVADER__BITMAP__IMAGE_LOADER_HPP
 
 #include <invader/bitmap/pixel.hpp>
-#include <vector>
+#include <functional>
 #include <cstdint>
 
 namespace Invader {
-    std::vector<Pixel> load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size);
-    std::vector<Pixel> load_image(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size);
+    /**
+     * Receives decoded rows from top to bottom. The image dimensions are set before the first call.
+     */
+    using ImageRowCallback = std::function<void (const Pixel *rows, std::uint32_t row_count)>;
+
+    void load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size, const ImageRowCallback &callback);
+    void load_image(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size, const ImageRowCallback &callback);
 }
 
 #endif
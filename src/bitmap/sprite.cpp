@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <cassert>
+#include <algorithm>
+#include <climits>
 
 #include <invader/bitmap/bitmap_processor.hpp>
 #include <invader/hek/data_type.hpp>
@@ -22,6 +24,9 @@ namespace Invader {
         // The sprite sheet is locked (no more sprites can be added)
         bool locked = false;
         
+        // Algorithm used to place sprites
+        BitmapSpritePackingAlgorithm packing_algorithm;
+        
         struct Sprite {
             const GeneratedBitmapDataBitmap *bitmap_data;
             const SpriteSheet *sheet;
@@ -177,6 +182,134 @@ namespace Invader {
         
         std::vector<Sprite> sprites;
         
+        // Pack all of the given sprites into the sheet with MaxRects (best short side fit), largest sprites first. Returns false if they don't all fit.
+        bool pack_maxrects(std::vector<Sprite> &sprites_to_pack) const {
+            struct Rectangle {
+                unsigned int x;
+                unsigned int y;
+                unsigned int width;
+                unsigned int height;
+                
+                bool contains(const Rectangle &other) const noexcept {
+                    return other.x >= this->x && other.y >= this->y && other.x + other.width <= this->x + this->width && other.y + other.height <= this->y + this->height;
+                }
+                
+                bool intersects(const Rectangle &other) const noexcept {
+                    return other.x < this->x + this->width && other.x + other.width > this->x && other.y < this->y + this->height && other.y + other.height > this->y;
+                }
+            };
+            
+            // Longest side first, then shortest side; stable so equal sprites stay in sequence order
+            std::stable_sort(sprites_to_pack.begin(), sprites_to_pack.end(), [](const Sprite &a, const Sprite &b) {
+                auto a_width = a.effective_width(), a_height = a.effective_height();
+                auto b_width = b.effective_width(), b_height = b.effective_height();
+                auto a_long = std::max(a_width, a_height), b_long = std::max(b_width, b_height);
+                if(a_long != b_long) {
+                    return a_long > b_long;
+                }
+                return std::min(a_width, a_height) > std::min(b_width, b_height);
+            });
+            
+            std::vector<Rectangle> free_rectangles = { Rectangle { 0, 0, this->max_length, this->max_length } };
+            std::vector<Rectangle> split_rectangles;
+            
+            for(auto &sprite : sprites_to_pack) {
+                auto width = sprite.effective_width();
+                auto height = sprite.effective_height();
+                
+                // Find the free rectangle that leaves the least space on its shorter side
+                std::optional<Rectangle> best;
+                unsigned int best_short_side = UINT_MAX;
+                unsigned int best_long_side = UINT_MAX;
+                for(auto &f : free_rectangles) {
+                    if(width > f.width || height > f.height) {
+                        continue;
+                    }
+                    
+                    auto leftover_x = f.width - width;
+                    auto leftover_y = f.height - height;
+                    auto short_side = std::min(leftover_x, leftover_y);
+                    auto long_side = std::max(leftover_x, leftover_y);
+                    
+                    if(short_side < best_short_side || (short_side == best_short_side && long_side < best_long_side)) {
+                        best = Rectangle { f.x, f.y, width, height };
+                        best_short_side = short_side;
+                        best_long_side = long_side;
+                    }
+                }
+                
+                // Doesn't fit
+                if(!best.has_value()) {
+                    return false;
+                }
+                
+                auto &placed = *best;
+                sprite.x = placed.x;
+                sprite.y = placed.y;
+                
+                // Split each free rectangle the sprite overlaps into the (up to) four rectangles around it
+                split_rectangles.clear();
+                for(auto &f : free_rectangles) {
+                    if(!f.intersects(placed)) {
+                        split_rectangles.emplace_back(f);
+                        continue;
+                    }
+                    
+                    auto f_end_x = f.x + f.width;
+                    auto f_end_y = f.y + f.height;
+                    auto placed_end_x = placed.x + placed.width;
+                    auto placed_end_y = placed.y + placed.height;
+                    
+                    if(placed.x > f.x) {
+                        split_rectangles.emplace_back(Rectangle { f.x, f.y, placed.x - f.x, f.height });
+                    }
+                    if(placed_end_x < f_end_x) {
+                        split_rectangles.emplace_back(Rectangle { placed_end_x, f.y, f_end_x - placed_end_x, f.height });
+                    }
+                    if(placed.y > f.y) {
+                        split_rectangles.emplace_back(Rectangle { f.x, f.y, f.width, placed.y - f.y });
+                    }
+                    if(placed_end_y < f_end_y) {
+                        split_rectangles.emplace_back(Rectangle { f.x, placed_end_y, f.width, f_end_y - placed_end_y });
+                    }
+                }
+                
+                // Drop free rectangles that are contained in another one (keeping the first of any duplicates)
+                free_rectangles.clear();
+                auto split_count = split_rectangles.size();
+                for(std::size_t i = 0; i < split_count; i++) {
+                    bool redundant = false;
+                    for(std::size_t j = 0; j < split_count; j++) {
+                        if(i != j && split_rectangles[j].contains(split_rectangles[i]) && (j < i || !split_rectangles[i].contains(split_rectangles[j]))) {
+                            redundant = true;
+                            break;
+                        }
+                    }
+                    if(!redundant) {
+                        free_rectangles.emplace_back(split_rectangles[i]);
+                    }
+                }
+            }
+            
+            return true;
+        }
+        
+        // Repack the sheet with the given sprites added to it. If they don't fit, the sheet is left untouched.
+        bool repack_with_sprites(const std::vector<std::size_t> &sprite_indices, std::size_t sequence) {
+            auto packed = this->sprites;
+            for(auto sprite : sprite_indices) {
+                auto bitmap_index = bitmap_data->sequences[sequence].sprites[sprite].bitmap_index;
+                packed.emplace_back(bitmap_data->bitmaps[bitmap_index], *this, sprite, sequence);
+            }
+            
+            if(!this->pack_maxrects(packed)) {
+                return false;
+            }
+            
+            this->sprites = std::move(packed);
+            return true;
+        }
+        
         std::vector<Pixel> bake_sprite_sheet(HEK::BitmapSpriteUsage sprite_usage) const {
             Pixel background_color;
             
@@ -256,10 +389,17 @@ namespace Invader {
                 return false;
             }
             
-            auto s = this->best_place_to_add_sprite(sprite, sequence);
-            if(s.has_value()) {
-                this->sprites.emplace_back(*s);
-                return true;
+            if(this->packing_algorithm == BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_MAXRECTS) {
+                if(this->repack_with_sprites({ sprite }, sequence)) {
+                    return true;
+                }
+            }
+            else {
+                auto s = this->best_place_to_add_sprite(sprite, sequence);
+                if(s.has_value()) {
+                    this->sprites.emplace_back(*s);
+                    return true;
+                }
             }
             
             // Check if we can add it without spacing
@@ -323,6 +463,11 @@ namespace Invader {
                     return this->add_sprite_to_sheet_and_lock_if_needed(0, sequence);
                 }
                 
+                // MaxRects packs the whole sequence at once
+                else if(this->packing_algorithm == BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_MAXRECTS) {
+                    return this->repack_with_sprites(sprite_indices, sequence);
+                }
+                
                 // Try adding everything.
                 else {
                     auto sprite_data_backup = this->sprites;
@@ -338,6 +483,11 @@ namespace Invader {
                 }
             }
             
+            // MaxRects repacks everything in the sheet along with the new sequence
+            else if(this->packing_algorithm == BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_MAXRECTS) {
+                return this->repack_with_sprites(sprite_indices, sequence);
+            }
+            
             // Otherwise, we'll need to sort everything by height and attempt to add everything that way
             else {
                 // Sprite, sequence
@@ -452,6 +602,18 @@ namespace Invader {
                     this->max_length >>= 1;
                     this->sprites.clear();
                     
+                    // MaxRects repacks everything at the smaller size
+                    if(this->packing_algorithm == BitmapSpritePackingAlgorithm::BITMAP_SPRITE_PACKING_ALGORITHM_MAXRECTS) {
+                        auto repacked = old_sprites;
+                        if(!this->pack_maxrects(repacked)) {
+                            this->max_length = old_max_length;
+                            this->sprites = old_sprites;
+                            goto done_brute_forcing_sprites;
+                        }
+                        this->sprites = std::move(repacked);
+                        continue;
+                    }
+                    
                     // Go through each sprite and see if we can re-add all of them again
                     for(auto s : old_sprites) {
                         // Fail - copy back in old values
@@ -482,7 +644,7 @@ namespace Invader {
             }
         }
         
-        SpriteSheet(unsigned int spacing, const GeneratedBitmapData &bitmap_data, unsigned max_length) : spacing(spacing), max_length(max_length), bitmap_data(&bitmap_data) {}
+        SpriteSheet(unsigned int spacing, const GeneratedBitmapData &bitmap_data, unsigned max_length, BitmapSpritePackingAlgorithm packing_algorithm) : spacing(spacing), max_length(max_length), bitmap_data(&bitmap_data), packing_algorithm(packing_algorithm) {}
         
         SpriteSheet(const SpriteSheet &other) {
             *this = other;
@@ -494,6 +656,7 @@ namespace Invader {
             this->max_height = other.max_height;
             this->bitmap_data = other.bitmap_data;
             this->locked = other.locked;
+            this->packing_algorithm = other.packing_algorithm;
             for(auto &s : other.sprites) {
                 this->sprites.emplace_back(s).sheet = this;
             }
@@ -501,7 +664,7 @@ namespace Invader {
         }
     };
     
-    std::vector<SpriteSheet> generate_sheets(std::size_t max_length, std::size_t max_sheet_count, unsigned int spacing, GeneratedBitmapData &bitmap) {
+    std::vector<SpriteSheet> generate_sheets(std::size_t max_length, std::size_t max_sheet_count, unsigned int spacing, BitmapSpritePackingAlgorithm packing_algorithm, GeneratedBitmapData &bitmap) {
         // Reserve it
         std::vector<SpriteSheet> sprite_sheets;
         sprite_sheets.reserve(max_sheet_count); // reserve the max sheet count (performance)
@@ -522,27 +685,15 @@ namespace Invader {
             auto &seq = bitmap.sequences[si];
             auto &sorted = sorted_sprites[si];
             auto sprite_count = seq.sprites.size();
-            sorted.reserve(sprite_count);
-            
+            sorted.resize(sprite_count);
             for(std::size_t s = 0; s < sprite_count; s++) {
-                bool added = false;
-                auto &sprite = seq.sprites[s];
-                auto height = bitmap.bitmaps[sprite.original_bitmap_index].height;
-                
-                for(auto &s_other : sorted) {
-                    auto index_other = &s_other - sorted.data();
-                    
-                    auto height_other = bitmap.bitmaps[seq.sprites[s_other].original_bitmap_index].height;
-                    if(height > height_other) {
-                        added = true;
-                        sorted.insert(sorted.begin() + index_other, s);
-                        break;
-                    }
-                }
-                if(!added) {
-                    sorted.emplace_back(s);
-                }
+                sorted[s] = s;
             }
+            
+            // Stable so sprites of equal height stay in color plate order
+            std::stable_sort(sorted.begin(), sorted.end(), [&seq, &bitmap](std::size_t a, std::size_t b) {
+                return bitmap.bitmaps[seq.sprites[a].original_bitmap_index].height > bitmap.bitmaps[seq.sprites[b].original_bitmap_index].height;
+            });
         }
         
         // Number of split across sprite sequences (hopefully zero but entirely possible)
@@ -551,7 +702,7 @@ namespace Invader {
         // Place them now
         for(std::size_t si = 0; si < sequence_count; si++) {
             // Make a new sprite sheet if we have to
-            SpriteSheet new_sprite_sheet(spacing, bitmap, max_length);
+            SpriteSheet new_sprite_sheet(spacing, bitmap, max_length, packing_algorithm);
             
             // Get our indices
             auto &sorted = sorted_sprites[si];
@@ -574,8 +725,8 @@ namespace Invader {
                 split_across++;
                 
                 auto sprite_count = sorted.size();
-                auto make_new_sheet = [&spacing, &bitmap, &max_length, &sprite_sheets]() {
-                    return &sprite_sheets.emplace_back(spacing, bitmap, max_length);
+                auto make_new_sheet = [&spacing, &bitmap, &max_length, &packing_algorithm, &sprite_sheets]() {
+                    return &sprite_sheets.emplace_back(spacing, bitmap, max_length, packing_algorithm);
                 };
                 auto *next_sheet = make_new_sheet();
                 
@@ -670,7 +821,7 @@ namespace Invader {
             }
         }
         
-        auto sheets = generate_sheets(max_sheet_length, max_sheet_count, spacing, generated_bitmap);
+        auto sheets = generate_sheets(max_sheet_length, max_sheet_count, spacing, parameters.sprite_packing_algorithm, generated_bitmap);
         unsigned long long total_pixel_usage = 0;
         unsigned long long max_pixel_usage = max_sheet_length * max_sheet_length * max_sheet_count;
         
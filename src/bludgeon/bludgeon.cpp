@@ -9,9 +9,10 @@
 #include <invader/tag/hek/definition.hpp>
 #include <invader/command_line_option.hpp>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/tag/parser/tag_arena.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/tag_batch.hpp>
 #include <thread>
-#include <mutex>
 
 #include "bludgeoner.hpp"
 
@@ -89,38 +90,33 @@ enum WaysToFuckUpTheTag : std::uint64_t {
 #define BROKEN_STRINGS_FIX "invalid-strings"
 #define EVERYTHING_FIX "everything"
 
-// Singleton the printf!
-static std::mutex bad_code_design_mutex;
-#define badly_designed_printf(function, ...) bad_code_design_mutex.lock(); \
-                                             function(__VA_ARGS__); \
-                                             bad_code_design_mutex.unlock();
-
-static int bludgeon_tag(const std::filesystem::path &file_path, std::uint64_t fixes, bool &bludgeoned) {
+static Invader::File::TagBatch::Result bludgeon_tag(const std::filesystem::path &file_path, std::uint64_t fixes, Invader::File::TagBatch::Output &output) {
     using namespace Invader::Bludgeoner;
     using namespace Invader::HEK;
     using namespace Invader::File;
 
-    bludgeoned = false;
-
     // Open the tag
     auto tag = open_file(file_path);
     if(!tag.has_value()) {
-        badly_designed_printf(eprintf_error, "Failed to open %s", file_path.string().c_str());
-        return EXIT_FAILURE;
+        output.error("Failed to open %s", file_path.string().c_str());
+        return TagBatch::RESULT_FAILED;
     }
 
+    // Each thread reuses the same memory for every tag it parses
+    static thread_local Invader::Parser::TagArena tag_arena;
+
     // Get the header
     std::vector<std::byte> file_data;
     try {
         const auto *header = reinterpret_cast<const TagFileHeader *>(tag->data());
         Invader::HEK::TagFileHeader::validate_header(header, tag->size());
-        auto parsed_data = Invader::Parser::ParserStruct::parse_hek_tag_file(tag->data(), tag->size());
+        auto parsed_data = Invader::Parser::ParserStruct::parse_hek_tag_file(tag->data(), tag->size(), false, tag_arena.next_tag(tag->size()));
 
         // No fixes; try to detect things
         bool issues_present = false;
         if(fixes == WaysToFuckUpTheTag::NO_FIXES) {
             #define check_fix(fix, fix_message) if(fix(parsed_data.get(), false)) { \
-                badly_designed_printf(oprintf_success_warn, "%s: " fix_message, file_path.string().c_str()); \
+                output.success_warn("%s: " fix_message, file_path.string().c_str()); \
                 issues_present = true; \
             }
             
@@ -141,7 +137,7 @@ static int bludgeon_tag(const std::filesystem::path &file_path, std::uint64_t fi
         }
         else {
             #define apply_fix(fix, fix_enum, fix_name) if((fixes & fix_enum) && fix(parsed_data.get(), true)) { \
-                badly_designed_printf(oprintf_success, "%s: Fixed " fix_name, file_path.string().c_str()); \
+                output.success("%s: Fixed " fix_name, file_path.string().c_str()); \
                 issues_present = true; \
             }
             
@@ -163,28 +159,32 @@ static int bludgeon_tag(const std::filesystem::path &file_path, std::uint64_t fi
 
         // No issues? OK
         if(!issues_present) {
-            return EXIT_SUCCESS;
+            return TagBatch::RESULT_UNCHANGED;
         }
-        
-        bludgeoned = true;
 
         // Exit out of here
         if(fixes == WaysToFuckUpTheTag::NO_FIXES) {
-            return EXIT_SUCCESS;
+            return TagBatch::RESULT_CHANGED;
         }
 
-        // Do it!
+        // Do it! (unless the fixes didn't actually change anything once regenerated)
         file_data = parsed_data->generate_hek_tag_data(header->tag_fourcc, true);
-        if(!Invader::File::save_file(file_path, file_data)) {
-            badly_designed_printf(eprintf_error, "Error: Failed to write to %s.", file_path.string().c_str());
-            return EXIT_FAILURE;
+        auto saved = TagBatch::save_if_changed(file_path, file_data, &*tag);
+        if(saved == TagBatch::SAVE_RESULT_FAILED) {
+            output.error("Error: Failed to write to %s.", file_path.string().c_str());
+            return TagBatch::RESULT_FAILED;
         }
 
-        return EXIT_SUCCESS;
+        if(saved == TagBatch::SAVE_RESULT_UNCHANGED) {
+            output.message("%s: Tag data is unchanged, so it was not saved", file_path.string().c_str());
+            return TagBatch::RESULT_UNCHANGED;
+        }
+
+        return TagBatch::RESULT_CHANGED;
     }
     catch(std::exception &e) {
-        badly_designed_printf(eprintf_error, "Error: Failed to bludgeon %s: %s", file_path.string().c_str(), e.what());
-        return EXIT_FAILURE;
+        output.error("Error: Failed to bludgeon %s: %s", file_path.string().c_str(), e.what());
+        return TagBatch::RESULT_FAILED;
     }
 }
 
@@ -228,10 +228,11 @@ int main(int argc, char * const *argv) {
                 break;
             case 'j':
                 try {
-                    bludgeon_options.max_threads = std::stoi(arguments[0]);
-                    if(bludgeon_options.max_threads < 1) {
+                    auto threads = std::stoi(arguments[0]);
+                    if(threads < 1) {
                         throw std::exception();
                     }
+                    bludgeon_options.max_threads = static_cast<std::size_t>(threads);
                 }
                 catch(std::exception &) {
                     eprintf_error("Invalid number of threads %s\n", arguments[0]);
@@ -316,47 +317,12 @@ int main(int argc, char * const *argv) {
             return EXIT_FAILURE;
         }
 
-        std::size_t success = 0;
-        
         auto all_tags = Invader::File::load_virtual_tag_folder(std::vector<std::filesystem::path>(&*bludgeon_options.tags, &*bludgeon_options.tags + 1));
-        std::mutex thread_mutex;
-        std::vector<std::thread> threads;
-        std::size_t tag_index = 0;
-        threads.reserve(bludgeon_options.max_threads);
-        
-        auto bludgeon_worker = [](auto *all_tags, std::size_t *tag_index, std::mutex *thread_mutex, std::size_t *success, auto *fixes) {
-            while(true) {
-                thread_mutex->lock();
-                std::size_t this_index = *tag_index;
-                if(this_index == all_tags->size()) {
-                    thread_mutex->unlock();
-                    return;
-                }
-                (*tag_index)++;
-                thread_mutex->unlock();
-                
-                // Bludgeon
-                bool bludgeoned;
-                bludgeon_tag(all_tags->data()[this_index].full_path, *fixes, bludgeoned);
-                
-                // Increment
-                thread_mutex->lock();
-                (*success) += bludgeoned;
-                thread_mutex->unlock();
-            }
-        };
-        
-        // Go through each tag
-        for(std::size_t i = 0; i < bludgeon_options.max_threads; i++) {
-            threads.emplace_back(bludgeon_worker, &all_tags, &tag_index, &thread_mutex, &success, &fixes);
-        }
-        
-        // Wait for all threads to end
-        for(auto &i : threads) {
-            i.join();
-        }
+        auto summary = Invader::File::TagBatch::run(all_tags.size(), [&all_tags, fixes](std::size_t index, Invader::File::TagBatch::Output &output) {
+            return bludgeon_tag(all_tags[index].full_path, fixes, output);
+        }, bludgeon_options.max_threads);
 
-        oprintf("Bludgeoned %zu out of %zu tag%s\n", success, tag_index, tag_index == 1 ? "" : "s");
+        oprintf("Bludgeoned %zu out of %zu tag%s\n", summary.changed, all_tags.size(), all_tags.size() == 1 ? "" : "s");
 
         return EXIT_SUCCESS;
     }
@@ -373,11 +339,12 @@ int main(int argc, char * const *argv) {
             file_path = std::filesystem::path(*bludgeon_options.tags) / Invader::File::halo_path_to_preferred_path(remaining_arguments[0]);
         }
         std::string file_path_str = file_path.string();
-        bool bludgeoned;
-        int result = bludgeon_tag(file_path_str.c_str(), fixes, bludgeoned);
-        if(result == EXIT_SUCCESS && !bludgeoned) {
+        Invader::File::TagBatch::Output output;
+        auto result = bludgeon_tag(file_path, fixes, output);
+        if(output.empty()) {
             oprintf("%s: No issues detected\n", file_path_str.c_str());
         }
-        return result;
+        output.print();
+        return result == Invader::File::TagBatch::RESULT_FAILED ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 }
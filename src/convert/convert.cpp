@@ -3,6 +3,8 @@
 #include <filesystem>
 #include <invader/command_line_option.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/tag_batch.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
 #include <invader/tag/parser/parser.hpp>
@@ -26,6 +28,7 @@ int main(int argc, const char **argv) {
         bool match_all = false;
         bool overwrite = false;
         bool use_filesystem_path = false;
+        std::size_t max_threads = ThreadPool::default_thread_count();
         std::vector<std::string> tags_to_convert;
     } convert_options;
 
@@ -38,6 +41,7 @@ int main(int argc, const char **argv) {
     options.emplace_back("output-tags", 'o', 1, "Set the output tags directory.", "<dir>");
     options.emplace_back("type", 'T', 1, "Type of conversion. Can be: gbxmodel-to-model (g2m), model-to-gbxmodel (m2g), chicago-extended-to-chicago (x2c)", "<type>");
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the tag path if specifying a tag.");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for parallel conversion. Default: CPU thread count");
 
     static constexpr char DESCRIPTION[] = "Convert from one tag type to another.";
     static constexpr char USAGE[] = "[options] <--all | -s <tag>>";
@@ -87,6 +91,20 @@ int main(int argc, const char **argv) {
             case 't':
                 compare_options.tags = args[0];
                 break;
+                
+            case 'j':
+                try {
+                    auto threads = std::stoi(args[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    compare_options.max_threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", args[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
         }
     });
     
@@ -174,26 +192,26 @@ int main(int argc, const char **argv) {
     }
     
     // Let's begin
-    std::size_t success = 0;
-    std::size_t total = paths.size();
-    for(auto &i : paths) {
+    auto summary = File::TagBatch::run(paths.size(), [&convert_options, &paths, output_class](std::size_t index, File::TagBatch::Output &output) {
+        auto &i = paths[index];
         auto path_from = convert_options.tags / i.join();
         auto path_to = *convert_options.output_tags / File::TagFilePath(i.path, output_class).join();
-        
+
+        if(!convert_options.overwrite && std::filesystem::exists(path_to)) {
+            output.warning("Skipping %s...", i.join().c_str());
+            return File::TagBatch::RESULT_UNCHANGED;
+        }
+
         try {
             auto tag_file = File::open_file(path_from);
             if(!tag_file.has_value()) {
-                eprintf_error("Failed to read %s", path_from.string().c_str());
+                output.error("Failed to read %s", path_from.string().c_str());
+                return File::TagBatch::RESULT_FAILED;
             }
             
             auto input_struct = Parser::ParserStruct::parse_hek_tag_file(tag_file->data(), tag_file->size());
             std::unique_ptr<Parser::ParserStruct> output_struct;
             
-            if(!convert_options.overwrite && std::filesystem::exists(path_to)) {
-                eprintf_warn("Skipping %s...", i.join().c_str());
-                continue;
-            }
-            
             switch(*convert_options.conversion) {
                 case GBXMODEL_TO_MODEL:
                     output_struct = std::make_unique<Parser::Model>(Parser::convert_gbxmodel_to_model(dynamic_cast<Parser::GBXModel &>(*input_struct)));
@@ -213,21 +231,28 @@ int main(int argc, const char **argv) {
             std::error_code ec;
             std::filesystem::create_directories(path_to.parent_path(), ec);
 
-            // Save
-            if(File::save_file(path_to, final_data)) {
-                oprintf_success("Saved %s", path_to.string().c_str());
-                success++;
-            }
-            else {
-                eprintf_error("Failed to write to %s", path_to.string().c_str());
+            // Save (if overwriting, an output tag that's already the same is left alone)
+            switch(File::TagBatch::save_if_changed(path_to, final_data)) {
+                case File::TagBatch::SAVE_RESULT_FAILED:
+                    output.error("Failed to write to %s", path_to.string().c_str());
+                    return File::TagBatch::RESULT_FAILED;
+                case File::TagBatch::SAVE_RESULT_UNCHANGED:
+                    output.message("%s is already up to date", path_to.string().c_str());
+                    return File::TagBatch::RESULT_UNCHANGED;
+                default:
+                    output.success("Saved %s", path_to.string().c_str());
+                    return File::TagBatch::RESULT_CHANGED;
             }
         }
         catch(std::exception &e) {
-            eprintf_error("Failed to convert %s: %s", i.join().c_str(), e.what());
+            output.error("Failed to convert %s: %s", i.join().c_str(), e.what());
+            return File::TagBatch::RESULT_FAILED;
         }
-    }
+    }, convert_options.max_threads);
     
     // Report results
+    std::size_t success = summary.changed;
+    std::size_t total = paths.size();
     if(success) {
         oprintf_success("Converted %zu of %zu tag%s", success, total, total == 1 ? "" : "s");
     }
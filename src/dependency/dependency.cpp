@@ -6,6 +6,7 @@
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
 #include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/dependency/dependency_index.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/map/map.hpp>
 #include <invader/command_line_option.hpp>
@@ -18,6 +19,7 @@ int main(int argc, char * const *argv) {
     options.emplace_back("reverse", 'R', 0, "Find all tags that depend on the tag, instead.");
     options.emplace_back("recursive", 'r', 0, "Recursively get all depended tags.");
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the tag.");
+    options.emplace_back("index", 'I', 1, "Use the specified dependency index, creating or updating it as needed. Only tags changed since the last run are read, and --recursive also works with --reverse.", "<file>");
 
     static constexpr char DESCRIPTION[] = "Check dependencies for a tag.";
     static constexpr char USAGE[] = "[options] <tag.class>";
@@ -27,6 +29,7 @@ int main(int argc, char * const *argv) {
         bool recursive = false;
         std::vector<std::filesystem::path> tags;
         bool use_filesystem_path = false;
+        std::optional<std::filesystem::path> index;
     } dependency_options;
 
     auto remaining_arguments = Invader::CommandLineOption::parse_arguments<DependencyOption &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, dependency_options, [](char opt, const auto &arguments, auto &dependency_options) {
@@ -46,6 +49,9 @@ int main(int argc, char * const *argv) {
             case 'P':
                 dependency_options.use_filesystem_path = true;
                 break;
+            case 'I':
+                dependency_options.index = arguments[0];
+                break;
         }
     });
 
@@ -80,7 +86,19 @@ int main(int argc, char * const *argv) {
 
     // Here's an array we can use to hold what we got
     bool success;
-    auto found_tags = Invader::FoundTagDependency::find_dependencies(tag_path_split->path.c_str(), tag_path_split->fourcc, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success);
+    std::vector<Invader::FoundTagDependency> found_tags;
+    if(dependency_options.index.has_value()) {
+        auto index = Invader::DependencyIndex::load(*dependency_options.index);
+        index.update(dependency_options.tags);
+        if(!index.save(*dependency_options.index)) {
+            eprintf_error("Failed to save %s", dependency_options.index->string().c_str());
+            return EXIT_FAILURE;
+        }
+        found_tags = Invader::FoundTagDependency::find_dependencies(tag_path_split->path.c_str(), tag_path_split->fourcc, index, dependency_options.reverse, dependency_options.recursive, success);
+    }
+    else {
+        found_tags = Invader::FoundTagDependency::find_dependencies(tag_path_split->path.c_str(), tag_path_split->fourcc, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success);
+    }
 
     if(!success) {
         return EXIT_FAILURE;
@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+#include <unordered_set>
+#include <invader/dependency/dependency_index.hpp>
+#include <invader/tag/parser/view_struct.hpp>
+#include <invader/thread_pool.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader {
+    static constexpr char INDEX_MAGIC[8] = { 'i', 'n', 'v', 'd', 'e', 'p', 'i', 'x' };
+    static constexpr std::uint32_t INDEX_VERSION = 2;
+
+    template<typename T> static void write_integer(std::vector<std::byte> &data, T value) {
+        const auto *bytes = reinterpret_cast<const std::byte *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(value));
+    }
+
+    static void write_string(std::vector<std::byte> &data, const std::string &string) {
+        write_integer(data, static_cast<std::uint32_t>(string.size()));
+        const auto *bytes = reinterpret_cast<const std::byte *>(string.data());
+        data.insert(data.end(), bytes, bytes + string.size());
+    }
+
+    // Reads the index file, throwing if anything is out of bounds
+    class IndexReader {
+    public:
+        template<typename T> T read_integer() {
+            T value;
+            std::memcpy(&value, this->read_bytes(sizeof(value)), sizeof(value));
+            return value;
+        }
+
+        std::string read_string() {
+            auto size = this->read_integer<std::uint32_t>();
+            return std::string(reinterpret_cast<const char *>(this->read_bytes(size)), size);
+        }
+
+        const std::byte *read_bytes(std::size_t size) {
+            if(size > static_cast<std::size_t>(this->end - this->position)) {
+                throw OutOfBoundsException();
+            }
+            const auto *bytes = this->position;
+            this->position += size;
+            return bytes;
+        }
+
+        bool at_end() const noexcept {
+            return this->position == this->end;
+        }
+
+        IndexReader(const std::vector<std::byte> &data) noexcept : position(data.data()), end(data.data() + data.size()) {}
+
+    private:
+        const std::byte *position;
+        const std::byte *end;
+    };
+
+    DependencyIndex DependencyIndex::load(const std::filesystem::path &path) {
+        DependencyIndex index;
+
+        // If there's no index yet, it'll just be made when updated
+        auto data = File::open_file(path);
+        if(!data.has_value()) {
+            return index;
+        }
+
+        try {
+            IndexReader reader(*data);
+            if(std::memcmp(reader.read_bytes(sizeof(INDEX_MAGIC)), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || reader.read_integer<std::uint32_t>() != INDEX_VERSION) {
+                throw InvalidTagDataException();
+            }
+
+            auto tag_count = reader.read_integer<std::uint64_t>();
+            for(std::uint64_t t = 0; t < tag_count; t++) {
+                auto &tag = index.tags.emplace_back();
+                tag.tag.path = reader.read_string();
+                tag.tag.fourcc = static_cast<TagFourCC>(reader.read_integer<std::uint32_t>());
+                tag.file_path = reader.read_string();
+                tag.modified = reader.read_integer<std::int64_t>();
+                tag.size = reader.read_integer<std::uint64_t>();
+                tag.invalid = reader.read_integer<std::uint8_t>() != 0;
+
+                auto dependency_count = reader.read_integer<std::uint32_t>();
+                for(std::uint32_t d = 0; d < dependency_count; d++) {
+                    auto dependency_path = reader.read_string();
+                    auto dependency_fourcc = static_cast<TagFourCC>(reader.read_integer<std::uint32_t>());
+                    tag.dependencies.emplace_back(dependency_path, dependency_fourcc);
+                }
+            }
+
+            if(!reader.at_end()) {
+                throw InvalidTagDataException();
+            }
+        }
+        catch(std::exception &) {
+            eprintf_warn("%s is not a valid dependency index, so it will be rebuilt", path.string().c_str());
+            return DependencyIndex();
+        }
+
+        index.build_lookups();
+        return index;
+    }
+
+    bool DependencyIndex::save(const std::filesystem::path &path) const {
+        std::vector<std::byte> data;
+        const auto *magic = reinterpret_cast<const std::byte *>(INDEX_MAGIC);
+        data.insert(data.end(), magic, magic + sizeof(INDEX_MAGIC));
+        write_integer(data, INDEX_VERSION);
+        write_integer(data, static_cast<std::uint64_t>(this->tags.size()));
+
+        for(auto &tag : this->tags) {
+            write_string(data, tag.tag.path);
+            write_integer(data, static_cast<std::uint32_t>(tag.tag.fourcc));
+            write_string(data, tag.file_path.string());
+            write_integer(data, tag.modified);
+            write_integer(data, tag.size);
+            write_integer(data, static_cast<std::uint8_t>(tag.invalid));
+            write_integer(data, static_cast<std::uint32_t>(tag.dependencies.size()));
+            for(auto &dependency : tag.dependencies) {
+                write_string(data, dependency.path);
+                write_integer(data, static_cast<std::uint32_t>(dependency.fourcc));
+            }
+        }
+
+        return File::save_file(path, data);
+    }
+
+    static void read_tag_dependencies(DependencyIndex::IndexedTag &tag) {
+        auto tag_data = File::open_file(tag.file_path);
+        if(!tag_data.has_value()) {
+            eprintf_warn("Warning: Failed to read tag %s", tag.file_path.string().c_str());
+            tag.invalid = true;
+            return;
+        }
+
+        try {
+            std::unordered_set<std::string> found;
+            for(auto &dependency : Parser::View::get_hek_tag_file_dependencies(tag_data->data(), tag_data->size())) {
+                // Skip anything referencing ourselves
+                if(dependency == tag.tag) {
+                    continue;
+                }
+                if(found.insert(dependency.join()).second) {
+                    tag.dependencies.emplace_back(std::move(dependency));
+                }
+            }
+        }
+        catch(std::exception &e) {
+            eprintf_warn("Warning: Failed to read tag %s: %s", tag.file_path.string().c_str(), e.what());
+            tag.invalid = true;
+            tag.dependencies.clear();
+        }
+    }
+
+    DependencyIndex::UpdateResult DependencyIndex::update(const std::vector<std::filesystem::path> &tags_directories) {
+        UpdateResult result;
+        auto all_tags = File::load_virtual_tag_folder(tags_directories);
+
+        std::vector<IndexedTag> new_tags;
+        new_tags.reserve(all_tags.size());
+        std::vector<std::size_t> tags_to_read;
+
+        for(auto &file : all_tags) {
+            auto tag_path = File::split_tag_class_extension(File::preferred_path_to_halo_path(file.tag_path));
+            if(!tag_path.has_value()) {
+                continue;
+            }
+
+            auto &tag = new_tags.emplace_back();
+            tag.tag = std::move(*tag_path);
+            tag.file_path = file.full_path;
+
+            std::error_code ec;
+            tag.size = static_cast<std::uint64_t>(std::filesystem::file_size(file.full_path, ec));
+            tag.modified = static_cast<std::int64_t>(std::filesystem::last_write_time(file.full_path, ec).time_since_epoch().count());
+
+            // Keep what we have if it's the same file and it hasn't changed
+            auto old = this->tag_indices.find(tag.tag.join());
+            if(old != this->tag_indices.end()) {
+                auto &old_tag = this->tags[old->second];
+                if(old_tag.file_path == tag.file_path && old_tag.modified == tag.modified && old_tag.size == tag.size) {
+                    tag.invalid = old_tag.invalid;
+                    tag.dependencies = std::move(old_tag.dependencies);
+                    result.unchanged++;
+                    continue;
+                }
+            }
+
+            // Tags of classes that can't reference anything don't need to be read
+            if(!Parser::View::hek_tag_class_has_dependencies(tag.tag.fourcc)) {
+                result.read++;
+                continue;
+            }
+
+            tags_to_read.emplace_back(new_tags.size() - 1);
+        }
+
+        // Read everything that changed
+        if(!tags_to_read.empty()) {
+            static constexpr std::size_t TAGS_PER_TASK = 64;
+            ThreadPool thread_pool;
+            std::vector<std::future<void>> futures;
+            for(std::size_t first = 0; first < tags_to_read.size(); first += TAGS_PER_TASK) {
+                futures.emplace_back(thread_pool.submit([&new_tags, &tags_to_read, first]() {
+                    std::size_t last = std::min(first + TAGS_PER_TASK, tags_to_read.size());
+                    for(std::size_t i = first; i < last; i++) {
+                        read_tag_dependencies(new_tags[tags_to_read[i]]);
+                    }
+                }));
+            }
+            thread_pool.wait_all(futures);
+            result.read += tags_to_read.size();
+        }
+
+        auto old_tags = std::move(this->tags);
+        this->tags = std::move(new_tags);
+        this->build_lookups();
+
+        for(auto &old_tag : old_tags) {
+            if(this->tag_indices.find(old_tag.tag.join()) == this->tag_indices.end()) {
+                result.removed++;
+            }
+        }
+
+        return result;
+    }
+
+    void DependencyIndex::build_lookups() {
+        this->tag_indices.clear();
+        this->dependents.clear();
+        this->tag_indices.reserve(this->tags.size());
+
+        for(std::size_t t = 0; t < this->tags.size(); t++) {
+            auto &tag = this->tags[t];
+            this->tag_indices.emplace(tag.tag.join(), t);
+            for(auto &dependency : tag.dependencies) {
+                this->dependents[dependency.join()].emplace_back(t);
+            }
+        }
+    }
+
+    const DependencyIndex::IndexedTag *DependencyIndex::get_tag(const File::TagFilePath &tag) const {
+        auto found = this->tag_indices.find(tag.join());
+        if(found == this->tag_indices.end()) {
+            return nullptr;
+        }
+        return &this->tags[found->second];
+    }
+
+    std::vector<const DependencyIndex::IndexedTag *> DependencyIndex::get_dependents(const File::TagFilePath &tag) const {
+        std::vector<const IndexedTag *> found_tags;
+        auto found = this->dependents.find(tag.join());
+        if(found != this->dependents.end()) {
+            for(auto t : found->second) {
+                found_tags.emplace_back(&this->tags[t]);
+            }
+        }
+        return found_tags;
+    }
+
+    std::vector<File::TagFilePath> DependencyIndex::get_dependencies_recursive(const File::TagFilePath &tag) const {
+        std::vector<File::TagFilePath> found_tags;
+        std::unordered_set<std::string> found;
+
+        auto find_dependencies = [this, &found_tags, &found](const File::TagFilePath &tag, auto &find_dependencies) -> void {
+            const auto *indexed_tag = this->get_tag(tag);
+            if(indexed_tag == nullptr) {
+                return;
+            }
+            for(auto &dependency : indexed_tag->dependencies) {
+                if(found.insert(dependency.join()).second) {
+                    found_tags.emplace_back(dependency);
+                    find_dependencies(dependency, find_dependencies);
+                }
+            }
+        };
+
+        find_dependencies(tag, find_dependencies);
+        return found_tags;
+    }
+
+    std::vector<const DependencyIndex::IndexedTag *> DependencyIndex::get_dependents_recursive(const File::TagFilePath &tag) const {
+        std::vector<const IndexedTag *> found_tags;
+        std::unordered_set<std::string> found = { tag.join() };
+
+        // Go through each tag found, adding whatever references it to the end
+        auto add_dependents = [this, &found_tags, &found](const File::TagFilePath &tag) {
+            for(const auto *dependent : this->get_dependents(tag)) {
+                if(found.insert(dependent->tag.join()).second) {
+                    found_tags.emplace_back(dependent);
+                }
+            }
+        };
+
+        add_dependents(tag);
+        for(std::size_t i = 0; i < found_tags.size(); i++) {
+            add_dependents(found_tags[i]->tag);
+        }
+
+        return found_tags;
+    }
+}
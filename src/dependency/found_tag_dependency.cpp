@@ -1,27 +1,19 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/dependency/dependency_index.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
-#include <invader/build/build_workload.hpp>
+#include <invader/tag/parser/view_struct.hpp>
 
 #include <filesystem>
 
 namespace Invader {
-    static std::vector<File::TagFilePath> get_dependencies(const BuildWorkload &tag_compiled) {
-        std::vector<File::TagFilePath> dependencies;
-        for(auto &s : tag_compiled.structs) {
-            for(auto &d : s.dependencies) {
-                // Skip anything referencing ourselves
-                if(d.tag_index == 0) {
-                    continue;
-                }
+    static std::vector<File::TagFilePath> get_dependencies(const std::vector<std::byte> &tag_data, const File::TagFilePath &tag) {
+        auto dependencies = Parser::View::get_hek_tag_file_dependencies(tag_data.data(), tag_data.size());
 
-                // Continue
-                auto &tag = tag_compiled.tags[d.tag_index];
-                dependencies.emplace_back(tag.path, tag.tag_fourcc);
-            }
-        }
+        // Skip anything referencing ourselves
+        std::erase(dependencies, tag);
         return dependencies;
     }
 
@@ -44,7 +36,7 @@ namespace Invader {
                     }
 
                     try {
-                        auto dependencies = get_dependencies(BuildWorkload::compile_single_tag(tag_data->data(), tag_data->size()));
+                        auto dependencies = get_dependencies(*tag_data, File::TagFilePath(File::preferred_path_to_halo_path(tag_path_to_find), tag_int_to_find));
                         for(auto &dependency : dependencies) {
                             // Make sure it's not in found_tags
                             bool dupe = false;
@@ -82,7 +74,7 @@ namespace Invader {
                         break;
                     }
                     catch (std::exception &e) {
-                        eprintf_error("Failed to compile tag %s: %s", tag_path.string().c_str(), e.what());
+                        eprintf_error("Failed to read tag %s: %s", tag_path.string().c_str(), e.what());
                         success = false;
                         return;
                     }
@@ -148,7 +140,7 @@ namespace Invader {
 
                             // Attempt to parse
                             try {
-                                auto dependencies = get_dependencies(BuildWorkload::compile_single_tag(tag_data->data(), tag_data->size()));
+                                auto dependencies = get_dependencies(*tag_data, File::TagFilePath(dir_tag_path, fourcc));
                                 for(auto &dependency : dependencies) {
                                     if(dependency.path == tag_path_to_find && dependency.fourcc == tag_int_to_find) {
                                         found_tags.emplace_back(dir_tag_path, fourcc, false, file.path());
@@ -157,7 +149,7 @@ namespace Invader {
                                 }
                             }
                             catch (std::exception &e) {
-                                eprintf_warn("Warning: Failed to compile tag %s: %s", file.path().string().c_str(), e.what());
+                                eprintf_warn("Warning: Failed to read tag %s: %s", file.path().string().c_str(), e.what());
                             }
                         }
                     }
@@ -171,4 +163,43 @@ namespace Invader {
         success = true;
         return found_tags;
     }
+
+    std::vector<FoundTagDependency> FoundTagDependency::find_dependencies(const char *tag_path_to_find_2, Invader::TagFourCC tag_int_to_find, const DependencyIndex &index, bool reverse, bool recursive, bool &success) {
+        std::vector<FoundTagDependency> found_tags;
+        success = true;
+
+        File::TagFilePath tag_to_find(File::preferred_path_to_halo_path(tag_path_to_find_2), tag_int_to_find);
+
+        if(!reverse) {
+            const auto *tag = index.get_tag(tag_to_find);
+            if(tag == nullptr) {
+                eprintf_error("Failed to open tag %s.%s.", File::halo_path_to_preferred_path(tag_to_find.path).c_str(), tag_fourcc_to_extension(tag_int_to_find));
+                success = false;
+                return found_tags;
+            }
+
+            // Tags that couldn't be read were already reported when the index was updated
+            success = !tag->invalid;
+
+            auto dependencies = recursive ? index.get_dependencies_recursive(tag_to_find) : tag->dependencies;
+            for(auto &dependency : dependencies) {
+                const auto *dependency_tag = index.get_tag(dependency);
+                if(dependency_tag == nullptr) {
+                    found_tags.emplace_back(dependency.path, dependency.fourcc, true, std::nullopt);
+                    continue;
+                }
+                found_tags.emplace_back(dependency.path, dependency.fourcc, false, dependency_tag->file_path);
+                if(recursive && dependency_tag->invalid) {
+                    success = false;
+                }
+            }
+        }
+        else {
+            for(const auto *tag : recursive ? index.get_dependents_recursive(tag_to_find) : index.get_dependents(tag_to_find)) {
+                found_tags.emplace_back(tag->tag.path, tag->tag.fourcc, false, tag->file_path);
+            }
+        }
+
+        return found_tags;
+    }
 }
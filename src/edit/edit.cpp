@@ -7,7 +7,10 @@
 #include <invader/file/file.hpp>
 #include <invader/tag/hek/header.hpp>
 #include "../crc/crc32.h"
+#include <cctype>
+#include <map>
 #include <string>
+#include <unordered_map>
 
 #ifdef __linux__
 #include <sys/ioctl.h>
@@ -250,25 +253,35 @@ static void require_writable_only(const std::vector<Invader::Parser::ParserStruc
     }
 }
 
-static std::vector<Invader::Parser::ParserStructValue> get_values_for_key(Invader::Parser::ParserStruct *ps, std::string key, std::string &bitfield, bool writable_only) {
+// Values found for a key, along with the bitfield or range at the end of it
+struct ResolvedKey {
     std::vector<Invader::Parser::ParserStructValue> values;
-    build_array(ps, key, values, &bitfield, nullptr);
-    require_writable_only(values, writable_only);
-    return values;
-}
+    std::string bitfield;
+    std::pair<std::size_t, std::size_t> range;
+};
 
-static std::vector<Invader::Parser::ParserStructValue> get_values_for_key(Invader::Parser::ParserStruct *ps, std::string key, std::pair<std::size_t, std::size_t> &range, bool writable_only) {
-    std::vector<Invader::Parser::ParserStructValue> values;
-    build_array(ps, key, values, nullptr, &range);
-    require_writable_only(values, writable_only);
-    return values;
-}
+enum KeyType {
+    KEY_TYPE_VALUE,
+    KEY_TYPE_ARRAY,
+    KEY_TYPE_RANGE
+};
 
-static std::vector<Invader::Parser::ParserStructValue> get_values_for_key(Invader::Parser::ParserStruct *ps, std::string key, bool writable_only) {
-    std::vector<Invader::Parser::ParserStructValue> values;
-    build_array(ps, key, values, nullptr, nullptr);
-    require_writable_only(values, writable_only);
-    return values;
+// Keys already resolved for a tag; this needs to be cleared whenever any arrays in the tag are resized or reordered
+using KeyCache = std::unordered_map<std::string, ResolvedKey>;
+
+static ResolvedKey &get_values_for_key(Invader::Parser::ParserStruct *ps, const std::string &key, KeyType type, bool writable_only, KeyCache &cache) {
+    std::string full_key = key == "" ? "" : (std::string(".") + key);
+    auto cache_key = std::to_string(type) + full_key;
+    
+    auto found = cache.find(cache_key);
+    if(found == cache.end()) {
+        ResolvedKey resolved;
+        build_array(ps, full_key, resolved.values, type == KeyType::KEY_TYPE_VALUE ? &resolved.bitfield : nullptr, type == KeyType::KEY_TYPE_RANGE ? &resolved.range : nullptr);
+        found = cache.emplace(std::move(cache_key), std::move(resolved)).first;
+    }
+    
+    require_writable_only(found->second.values, writable_only);
+    return found->second;
 }
 
 static std::string get_value(const Invader::Parser::ParserStructValue &value, const std::string &bitmask) {
@@ -728,6 +741,493 @@ static void list_everything(Invader::Parser::ParserStruct &ps, std::vector<std::
     }
 }
 
+// Do an action on a tag, setting modified if the tag was changed
+static void do_action(const Actions &i, Invader::Parser::ParserStruct &tag_struct, Invader::HEK::TagFourCC tag_class, bool check_read_only, KeyCache &cache, std::vector<std::string> &output, bool &modified) {
+    switch(i.type) {
+        case ActionType::ACTION_TYPE_LIST: {
+            list_everything(populate_struct(*Invader::Parser::ParserStruct::generate_base_struct(tag_class)), output, false);
+            break;
+        }
+        case ActionType::ACTION_TYPE_LIST_ALL_VALUES: {
+            list_everything(tag_struct, output, true);
+            break;
+        }
+        case ActionType::ACTION_TYPE_GET: {
+            auto &resolved = get_values_for_key(&tag_struct, i.key, KeyType::KEY_TYPE_VALUE, false, cache);
+            for(auto &k : resolved.values) {
+                output.emplace_back(get_value(k, resolved.bitfield));
+            }
+            break;
+        }
+        case ActionType::ACTION_TYPE_SET: {
+            modified = true;
+            auto &resolved = get_values_for_key(&tag_struct, i.key, KeyType::KEY_TYPE_VALUE, check_read_only, cache);
+            for(auto &k : resolved.values) {
+                set_value(k, i.value, resolved.bitfield);
+            }
+            break;
+        }
+        case ActionType::ACTION_TYPE_COUNT: {
+            auto &resolved = get_values_for_key(&tag_struct, i.key, KeyType::KEY_TYPE_ARRAY, false, cache);
+            for(auto &k : resolved.values) {
+                if(k.get_type() == Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
+                    output.emplace_back(std::to_string(k.get_array_size()));
+                }
+                else {
+                    eprintf_error("%s is not an array", k.get_member_name());
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        }
+        case ActionType::ACTION_TYPE_INSERT: {
+            modified = true;
+            auto values = get_values_for_key(&tag_struct, i.key, KeyType::KEY_TYPE_ARRAY, check_read_only, cache).values;
+            cache.clear();
+            for(auto &k : values) {
+                if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
+                    eprintf_error("%s is not an array", k.get_member_name());
+                    std::exit(EXIT_FAILURE);
+                }
+                try {
+                    if(i.count + k.get_array_size() > k.get_array_maximum_size()) {
+                        eprintf_error("%s's maximum size of %zu exceeded", k.get_member_name(), k.get_array_maximum_size());
+                        std::exit(EXIT_FAILURE);
+                    }
+                    k.insert_objects_in_array(i.position == SIZE_MAX ? k.get_array_size() : i.position, i.count);
+                }
+                catch(std::exception &) {
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        }
+        case ActionType::ACTION_TYPE_DELETE: {
+            modified = true;
+            auto resolved = get_values_for_key(&tag_struct, i.key, KeyType::KEY_TYPE_RANGE, check_read_only, cache);
+            auto &range = resolved.range;
+            cache.clear();
+            for(auto &k : resolved.values) {
+                if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
+                    eprintf_error("%s is not an array", k.get_member_name());
+                    std::exit(EXIT_FAILURE);
+                }
+                try {
+                    std::size_t iterations = range.second - range.first + 1;
+                    if(k.get_array_size() - iterations < k.get_array_minimum_size()) {
+                        eprintf_error("%s's minimum size of %zu exceeded", k.get_member_name(), k.get_array_maximum_size());
+                        std::exit(EXIT_FAILURE);
+                    }
+                    k.delete_objects_in_array(range.first, iterations);
+                }
+                catch(std::exception &) {
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        }
+        case ActionType::ACTION_TYPE_MOVE: {
+            modified = true;
+            auto resolved = get_values_for_key(&tag_struct, i.key, KeyType::KEY_TYPE_RANGE, check_read_only, cache);
+            auto &range = resolved.range;
+            cache.clear();
+            for(auto &k : resolved.values) {
+                if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
+                    eprintf_error("%s is not an array", k.get_member_name());
+                    std::exit(EXIT_FAILURE);
+                }
+                try {
+                    std::size_t to = i.position == SIZE_MAX ? k.get_array_size() : i.position;
+                    std::size_t iterations = range.second - range.first + 1;
+                    if(to == range.first) {
+                        continue; // we can ignore if it's trying to swap itself
+                    }
+                    k.swap_objects_in_array(range.first, to, iterations);
+                }
+                catch(std::exception &) {
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        }
+        case ActionType::ACTION_TYPE_COPY: {
+            modified = true;
+            auto resolved = get_values_for_key(&tag_struct, i.key, KeyType::KEY_TYPE_RANGE, check_read_only, cache);
+            auto &range = resolved.range;
+            cache.clear();
+            for(auto &k : resolved.values) {
+                if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
+                    eprintf_error("%s is not an array", k.get_member_name());
+                    std::exit(EXIT_FAILURE);
+                }
+                try {
+                    std::size_t to = i.position == SIZE_MAX ? k.get_array_size() : i.position;
+                    std::size_t iterations = range.second - range.first + 1;
+                    
+                    if(iterations + k.get_array_size() > k.get_array_maximum_size()) {
+                        eprintf_error("%s's maximum size of %zu exceeded", k.get_member_name(), k.get_array_maximum_size());
+                        std::exit(EXIT_FAILURE);
+                    }
+                    
+                    k.duplicate_objects_in_array(range.first, to, iterations);
+                }
+                catch(std::exception &) {
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        }
+        default:
+            eprintf_error("Unimplemented");
+            std::exit(EXIT_FAILURE);
+    }
+}
+
+// Line of the batch being run, if any, so it can be reported if an action fails
+static std::size_t batch_line_number = 0;
+
+static void report_failed_batch() {
+    if(batch_line_number != 0) {
+        eprintf_error("Batch failed on line %zu. No tags were saved.", batch_line_number);
+    }
+}
+
+// Read a JSON object with string, number, or boolean values from one line of a batch
+static std::unordered_map<std::string, std::string> parse_batch_line(const std::string &line) {
+    std::unordered_map<std::string, std::string> fields;
+    const char *c = line.c_str();
+    
+    auto skip_whitespace = [&c]() {
+        while(*c == ' ' || *c == '\t' || *c == '\r') {
+            c++;
+        }
+    };
+    
+    auto fail = [](const char *what) {
+        eprintf_error("Invalid JSON: %s", what);
+        std::exit(EXIT_FAILURE);
+    };
+    
+    auto read_string = [&c, &fail]() {
+        std::string string;
+        c++;
+        while(*c != '"') {
+            if(*c == 0) {
+                fail("unterminated string");
+            }
+            else if(*c != '\\') {
+                string += *(c++);
+                continue;
+            }
+            
+            c++;
+            switch(*(c++)) {
+                case '"':
+                    string += '"';
+                    break;
+                case '\\':
+                    string += '\\';
+                    break;
+                case '/':
+                    string += '/';
+                    break;
+                case 'b':
+                    string += '\b';
+                    break;
+                case 'f':
+                    string += '\f';
+                    break;
+                case 'n':
+                    string += '\n';
+                    break;
+                case 'r':
+                    string += '\r';
+                    break;
+                case 't':
+                    string += '\t';
+                    break;
+                case 'u': {
+                    // Only characters in the basic multilingual plane are supported, encoded as UTF-8
+                    char hex[5] = {};
+                    for(std::size_t h = 0; h < 4; h++) {
+                        if(!std::isxdigit(static_cast<unsigned char>(*c))) {
+                            fail("invalid \\u escape");
+                        }
+                        hex[h] = *(c++);
+                    }
+                    auto code_point = static_cast<std::uint32_t>(std::strtoul(hex, nullptr, 16));
+                    if(code_point >= 0xD800 && code_point < 0xE000) {
+                        fail("surrogate pairs are not supported");
+                    }
+                    else if(code_point < 0x80) {
+                        string += static_cast<char>(code_point);
+                    }
+                    else if(code_point < 0x800) {
+                        string += static_cast<char>(0xC0 | (code_point >> 6));
+                        string += static_cast<char>(0x80 | (code_point & 0x3F));
+                    }
+                    else {
+                        string += static_cast<char>(0xE0 | (code_point >> 12));
+                        string += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                        string += static_cast<char>(0x80 | (code_point & 0x3F));
+                    }
+                    break;
+                }
+                default:
+                    fail("invalid escape");
+            }
+        }
+        c++;
+        return string;
+    };
+    
+    skip_whitespace();
+    if(*c != '{') {
+        fail("expected an object");
+    }
+    c++;
+    skip_whitespace();
+    
+    while(*c != '}') {
+        if(!fields.empty()) {
+            if(*c != ',') {
+                fail("expected a comma");
+            }
+            c++;
+            skip_whitespace();
+        }
+        
+        if(*c != '"') {
+            fail("expected a key");
+        }
+        auto key = read_string();
+        skip_whitespace();
+        if(*c != ':') {
+            fail("expected a colon");
+        }
+        c++;
+        skip_whitespace();
+        
+        // Numbers and booleans are kept as they were written
+        std::string value;
+        if(*c == '"') {
+            value = read_string();
+        }
+        else {
+            auto *start = c;
+            while(*c == '-' || *c == '+' || *c == '.' || std::isalnum(static_cast<unsigned char>(*c))) {
+                c++;
+            }
+            value = std::string(start, c);
+            if(value.empty()) {
+                fail("expected a string, number, or boolean");
+            }
+        }
+        
+        if(!fields.emplace(std::move(key), std::move(value)).second) {
+            fail("duplicate key");
+        }
+        skip_whitespace();
+    }
+    
+    c++;
+    skip_whitespace();
+    if(*c != 0) {
+        fail("expected the end of the line");
+    }
+    
+    return fields;
+}
+
+// Tag opened while running a batch
+struct BatchTag {
+    std::unique_ptr<Invader::Parser::ParserStruct> tag_struct;
+    Invader::HEK::TagFourCC tag_class;
+    KeyCache cache;
+    bool modified = false;
+};
+
+// Run a batch of actions, one JSON object per line, keeping every tag open and saving modified tags once at the end
+static int run_batch(std::FILE *input, const std::filesystem::path &tags, bool use_filesystem_path, bool check_read_only) {
+    std::map<std::filesystem::path, BatchTag> open_tags;
+    std::vector<std::string> output;
+    std::atexit(report_failed_batch);
+    
+    std::string line;
+    std::size_t line_number = 0;
+    for(int c = std::fgetc(input); c != EOF || !line.empty(); c = std::fgetc(input)) {
+        if(c != '\n' && c != EOF) {
+            line += static_cast<char>(c);
+            continue;
+        }
+        
+        // Skip blank lines
+        batch_line_number = ++line_number;
+        if(line.find_first_not_of(" \t\r") == std::string::npos) {
+            line.clear();
+            continue;
+        }
+        
+        auto fields = parse_batch_line(line);
+        line.clear();
+        
+        auto get_field = [&fields](const char *name) -> const std::string & {
+            auto found = fields.find(name);
+            if(found == fields.end()) {
+                eprintf_error("Expected \"%s\"", name);
+                std::exit(EXIT_FAILURE);
+            }
+            return found->second;
+        };
+        
+        auto get_number = [&get_field](const char *name, bool allow_end) -> std::size_t {
+            auto &value = get_field(name);
+            if(allow_end && value == "end") {
+                return SIZE_MAX;
+            }
+            try {
+                std::size_t characters;
+                auto number = std::stoul(value, &characters);
+                if(characters != value.size()) {
+                    throw std::exception();
+                }
+                return number;
+            }
+            catch(std::exception &) {
+                eprintf_error("Expected a valid %s", name);
+                std::exit(EXIT_FAILURE);
+            }
+        };
+        
+        // Open the tag if it isn't already
+        auto &tag_path = get_field("tag");
+        std::filesystem::path file_path = use_filesystem_path ? std::filesystem::path(tag_path) : (tags / Invader::File::halo_path_to_preferred_path(tag_path));
+        auto &action_name = get_field("action");
+        auto &tag = open_tags[file_path];
+        
+        if(action_name == "new") {
+            try {
+                tag.tag_class = Invader::File::split_tag_class_extension(file_path.string()).value().fourcc;
+                tag.tag_struct = Invader::Parser::ParserStruct::generate_base_struct(tag.tag_class);
+            }
+            catch (std::exception &) {
+                eprintf_error("Failed to create a new tag %s. Make sure the extension is correct.", file_path.string().c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            tag.cache.clear();
+            tag.modified = true;
+            continue;
+        }
+        
+        if(!tag.tag_struct) {
+            auto value = Invader::File::open_file(file_path);
+            if(!value.has_value()) {
+                eprintf_error("Failed to read %s", file_path.string().c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            
+            try {
+                tag.tag_struct = Invader::Parser::ParserStruct::parse_hek_tag_file(value->data(), value->size());
+            }
+            catch (std::exception &e) {
+                eprintf_error("Failed to parse %s: %s", file_path.string().c_str(), e.what());
+                std::exit(EXIT_FAILURE);
+            }
+            
+            tag.tag_class = reinterpret_cast<const Invader::HEK::TagFileHeader *>(value->data())->tag_fourcc;
+        }
+        
+        Actions action = {};
+        if(action_name == "get") {
+            action = Actions { ActionType::ACTION_TYPE_GET, get_field("key"), {}, 0, 0 };
+        }
+        else if(action_name == "set") {
+            action = Actions { ActionType::ACTION_TYPE_SET, get_field("key"), get_field("value"), 0, 0 };
+        }
+        else if(action_name == "count") {
+            action = Actions { ActionType::ACTION_TYPE_COUNT, get_field("key"), {}, 0, 0 };
+        }
+        else if(action_name == "insert") {
+            action = Actions { ActionType::ACTION_TYPE_INSERT, get_field("key"), {}, get_number("count", false), get_number("position", true) };
+        }
+        else if(action_name == "erase") {
+            action = Actions { ActionType::ACTION_TYPE_DELETE, get_field("key"), {}, 0, 0 };
+        }
+        else if(action_name == "move") {
+            action = Actions { ActionType::ACTION_TYPE_MOVE, get_field("key"), {}, 0, get_number("position", true) };
+        }
+        else if(action_name == "copy") {
+            action = Actions { ActionType::ACTION_TYPE_COPY, get_field("key"), {}, 0, get_number("position", true) };
+        }
+        else {
+            eprintf_error("Unknown action %s", action_name.c_str());
+            std::exit(EXIT_FAILURE);
+        }
+        
+        do_action(action, *tag.tag_struct, tag.tag_class, check_read_only, tag.cache, output, tag.modified);
+        for(auto &i : output) {
+            std::printf("%s\n", i.c_str());
+        }
+        output.clear();
+    }
+    batch_line_number = 0;
+    
+    // Generate everything first, writing each modified tag to a temporary file next to it
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> temporary_files;
+    auto remove_temporary_files = [&temporary_files]() {
+        for(auto &i : temporary_files) {
+            std::error_code ec;
+            std::filesystem::remove(i.second, ec);
+        }
+    };
+    
+    for(auto &[file_path, tag] : open_tags) {
+        if(!tag.modified) {
+            continue;
+        }
+        
+        bool can_save = true;
+        try {
+            can_save = Invader::File::split_tag_class_extension(file_path.string()).value().fourcc == tag.tag_class;
+        }
+        catch(std::exception &) {
+            can_save = false;
+        }
+        
+        if(!can_save) {
+            eprintf_error("Cannot save: %s does not have the correct .%s extension. No tags were saved.", file_path.string().c_str(), Invader::HEK::tag_fourcc_to_extension(tag.tag_class));
+            remove_temporary_files();
+            return EXIT_FAILURE;
+        }
+        
+        auto temporary_path = file_path;
+        temporary_path += ".tmp";
+        temporary_files.emplace_back(file_path, temporary_path);
+        if(!Invader::File::save_file(temporary_path, tag.tag_struct->generate_hek_tag_data(tag.tag_class))) {
+            eprintf_error("Unable to write to %s. No tags were saved.", temporary_path.string().c_str());
+            remove_temporary_files();
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // Then replace each tag with its temporary file, which is atomic
+    for(std::size_t i = 0; i < temporary_files.size(); i++) {
+        std::error_code ec;
+        std::filesystem::rename(temporary_files[i].second, temporary_files[i].first, ec);
+        if(ec) {
+            eprintf_error("Unable to write to %s: %s", temporary_files[i].first.string().c_str(), ec.message().c_str());
+            if(i > 0) {
+                eprintf_warn("%zu tag%s saved before this", i, i == 1 ? " was" : "s were");
+            }
+            temporary_files.erase(temporary_files.begin(), temporary_files.begin() + i);
+            remove_temporary_files();
+            return EXIT_FAILURE;
+        }
+    }
+    
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char * const *argv) {
     #ifdef _WIN32
     SetConsoleOutputCP(65001);
@@ -754,9 +1254,10 @@ int main(int argc, char * const *argv) {
     options.emplace_back("erase", 'E', 1, "Delete the selected struct(s).", "<key>");
     options.emplace_back("copy", 'c', 2, "Copy the selected struct(s) to the given index or \"end\" if the end of the array.", "<key> <pos>");
     options.emplace_back("no-safeguards", 'n', 0, "Allow all tag data to be edited (proceed at your own risk)");
+    options.emplace_back("batch", 'B', 1, "Run actions on any number of tags from a file (or - for stdin) with one JSON object per line. Each has \"tag\", \"action\" (new, get, set, count, insert, erase, move, or copy), and the action's \"key\", \"value\", \"count\", and \"position\". Modified tags are saved once at the end if every action succeeds.", "<file>");
 
     static constexpr char DESCRIPTION[] = "Edit tags via command-line.";
-    static constexpr char USAGE[] = "[options] <tag.class>";
+    static constexpr char USAGE[] = "[options] <-B file | tag.class>";
 
     struct EditOptions {
         std::filesystem::path tags = "tags";
@@ -767,9 +1268,10 @@ int main(int argc, char * const *argv) {
         bool verify_checksum = false;
         bool view_checksum = false;
         std::optional<std::variant<std::string, std::filesystem::path>> overwrite_path;
+        std::optional<std::string> batch;
     } edit_options;
 
-    auto remaining_arguments = Invader::CommandLineOption::parse_arguments<EditOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, edit_options, [](char opt, const std::vector<const char *> &arguments, auto &edit_options) {
+    auto remaining_arguments = Invader::CommandLineOption::parse_arguments<EditOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, edit_options, [](char opt, const std::vector<const char *> &arguments, auto &edit_options) {
         switch(opt) {
             case 't':
                 edit_options.tags = arguments[0];
@@ -834,6 +1336,9 @@ int main(int argc, char * const *argv) {
             case 'O':
                 edit_options.overwrite_path = std::string(arguments[0]);
                 break;
+            case 'B':
+                edit_options.batch = arguments[0];
+                break;
             case 'c':
                 try {
                     edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_COPY, arguments[0], {}, 0, std::strcmp(arguments[1], "end") == 0 ? SIZE_MAX : std::stoul(arguments[1]) });
@@ -846,6 +1351,32 @@ int main(int argc, char * const *argv) {
         }
     });
 
+    // Batch mode takes its tags and actions from the batch instead
+    if(edit_options.batch.has_value()) {
+        if(remaining_arguments.size() != 0 || !edit_options.actions.empty() || edit_options.new_tag || edit_options.overwrite_path.has_value() || edit_options.verify_checksum || edit_options.view_checksum) {
+            eprintf_error("--batch can only be used with --fs-path, --no-safeguards, and --tags");
+            return EXIT_FAILURE;
+        }
+        
+        if(*edit_options.batch == "-") {
+            return run_batch(stdin, edit_options.tags, edit_options.use_filesystem_path, edit_options.check_read_only);
+        }
+        
+        std::FILE *input = std::fopen(edit_options.batch->c_str(), "rb");
+        if(!input) {
+            eprintf_error("Failed to open %s", edit_options.batch->c_str());
+            return EXIT_FAILURE;
+        }
+        auto result = run_batch(input, edit_options.tags, edit_options.use_filesystem_path, edit_options.check_read_only);
+        std::fclose(input);
+        return result;
+    }
+    
+    if(remaining_arguments.size() == 0) {
+        eprintf_error("Expected --batch to be used OR a tag path. Use -h for more information.");
+        return EXIT_FAILURE;
+    }
+    
     std::filesystem::path file_path;
     if(edit_options.use_filesystem_path) {
         file_path = std::string(remaining_arguments[0]);
@@ -922,143 +1453,9 @@ int main(int argc, char * const *argv) {
     std::vector<std::string> output;
     bool should_save = edit_options.new_tag; // by default only save if making a new tag. this will be set to true if --set, --insert, --copy, --move, or --delete are used too
     
+    KeyCache cache;
     for(auto &i : edit_options.actions) {
-        switch(i.type) {
-            case ActionType::ACTION_TYPE_LIST: {
-                list_everything(populate_struct(*Invader::Parser::ParserStruct::generate_base_struct(tag_class)), output, false);
-                break;
-            }
-            case ActionType::ACTION_TYPE_LIST_ALL_VALUES: {
-                list_everything(*tag_struct, output, true);
-                break;
-            }
-            case ActionType::ACTION_TYPE_GET: {
-                std::string bitfield;
-                auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), bitfield, false);
-                for(auto &k : arr) {
-                    output.emplace_back(get_value(k, bitfield));
-                }
-                break;
-            }
-            case ActionType::ACTION_TYPE_SET: {
-                std::string bitfield;
-                should_save = true;
-                auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), bitfield, edit_options.check_read_only);
-                for(auto &k : arr) {
-                    set_value(k, i.value, bitfield);
-                }
-                break;
-            }
-            case ActionType::ACTION_TYPE_COUNT: {
-                auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), false);
-                for(auto &k : arr) {
-                    if(k.get_type() == Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
-                        output.emplace_back(std::to_string(k.get_array_size()));
-                    }
-                    else {
-                        eprintf_error("%s is not an array", k.get_member_name());
-                        std::exit(EXIT_FAILURE);
-                    }
-                }
-                break;
-            }
-            case ActionType::ACTION_TYPE_INSERT: {
-                should_save = true;
-                auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), edit_options.check_read_only);
-                for(auto &k : arr) {
-                    if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
-                        eprintf_error("%s is not an array", k.get_member_name());
-                        std::exit(EXIT_FAILURE);
-                    }
-                    try {
-                        if(i.count + k.get_array_size() > k.get_array_maximum_size()) {
-                            eprintf_error("%s's maximum size of %zu exceeded", k.get_member_name(), k.get_array_maximum_size());
-                            std::exit(EXIT_FAILURE);
-                        }
-                        k.insert_objects_in_array(i.position == SIZE_MAX ? k.get_array_size() : i.position, i.count);
-                    }
-                    catch(std::exception &) {
-                        std::exit(EXIT_FAILURE);
-                    }
-                }
-                break;
-            }
-            case ActionType::ACTION_TYPE_DELETE: {
-                should_save = true;
-                std::pair<std::size_t, std::size_t> range;
-                auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), range, edit_options.check_read_only);
-                for(auto &k : arr) {
-                    if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
-                        eprintf_error("%s is not an array", k.get_member_name());
-                        std::exit(EXIT_FAILURE);
-                    }
-                    try {
-                        std::size_t iterations = range.second - range.first + 1;
-                        if(k.get_array_size() - iterations < k.get_array_minimum_size()) {
-                            eprintf_error("%s's minimum size of %zu exceeded", k.get_member_name(), k.get_array_maximum_size());
-                            std::exit(EXIT_FAILURE);
-                        }
-                        k.delete_objects_in_array(range.first, iterations);
-                    }
-                    catch(std::exception &) {
-                        std::exit(EXIT_FAILURE);
-                    }
-                }
-                break;
-            }
-            case ActionType::ACTION_TYPE_MOVE: {
-                should_save = true;
-                std::pair<std::size_t, std::size_t> range;
-                auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), range, edit_options.check_read_only);
-                for(auto &k : arr) {
-                    if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
-                        eprintf_error("%s is not an array", k.get_member_name());
-                        std::exit(EXIT_FAILURE);
-                    }
-                    try {
-                        std::size_t to = i.position == SIZE_MAX ? k.get_array_size() : i.position;
-                        std::size_t iterations = range.second - range.first + 1;
-                        if(to == range.first) {
-                            continue; // we can ignore if it's trying to swap itself
-                        }
-                        k.swap_objects_in_array(range.first, to, iterations);
-                    }
-                    catch(std::exception &) {
-                        std::exit(EXIT_FAILURE);
-                    }
-                }
-                break;
-            }
-            case ActionType::ACTION_TYPE_COPY: {
-                should_save = true;
-                std::pair<std::size_t, std::size_t> range;
-                auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), range, edit_options.check_read_only);
-                for(auto &k : arr) {
-                    if(k.get_type() != Invader::Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE) {
-                        eprintf_error("%s is not an array", k.get_member_name());
-                        std::exit(EXIT_FAILURE);
-                    }
-                    try {
-                        std::size_t to = i.position == SIZE_MAX ? k.get_array_size() : i.position;
-                        std::size_t iterations = range.second - range.first + 1;
-                        
-                        if(iterations + k.get_array_size() > k.get_array_maximum_size()) {
-                            eprintf_error("%s's maximum size of %zu exceeded", k.get_member_name(), k.get_array_maximum_size());
-                            std::exit(EXIT_FAILURE);
-                        }
-                        
-                        k.duplicate_objects_in_array(range.first, to, iterations);
-                    }
-                    catch(std::exception &) {
-                        std::exit(EXIT_FAILURE);
-                    }
-                }
-                break;
-            }
-            default:
-                eprintf_error("Unimplemented");
-                std::exit(EXIT_FAILURE);
-        }
+        do_action(i, *tag_struct, tag_class, edit_options.check_read_only, cache, output, should_save);
     }
     
     for(auto &i : output) {
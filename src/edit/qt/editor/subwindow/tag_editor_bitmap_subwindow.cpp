@@ -21,7 +21,7 @@
 #define GET_PIXEL(x,y) (x + y * real_width)
 
 namespace Invader::EditQt {
-    void TagEditorBitmapSubwindow::set_values(TagEditorBitmapSubwindow *what, QComboBox *bitmaps, QComboBox *mipmaps, QComboBox *colors, QComboBox *scale, QComboBox *sequence, QComboBox *sprite, QScrollArea *images, std::vector<Parser::BitmapGroupSequence> *all_sequences) {
+    void TagEditorBitmapSubwindow::set_values(TagEditorBitmapSubwindow *what, QComboBox *bitmaps, QComboBox *mipmaps, QComboBox *colors, QComboBox *scale, QComboBox *sequence, QComboBox *sprite, QScrollArea *images, std::pmr::vector<Parser::BitmapGroupSequence> *all_sequences) {
         what->mipmaps = mipmaps;
         what->colors = colors;
         what->bitmaps = bitmaps;
@@ -97,7 +97,7 @@ namespace Invader::EditQt {
         colors->blockSignals(false);
     }
 
-    template<typename T> static void generate_main_widget(TagEditorBitmapSubwindow *subwindow, T *bitmap_data, void (*set_values)(TagEditorBitmapSubwindow *, QComboBox *, QComboBox *, QComboBox *, QComboBox *, QComboBox *, QComboBox *, QScrollArea *, std::vector<Parser::BitmapGroupSequence> *)) {
+    template<typename T> static void generate_main_widget(TagEditorBitmapSubwindow *subwindow, T *bitmap_data, void (*set_values)(TagEditorBitmapSubwindow *, QComboBox *, QComboBox *, QComboBox *, QComboBox *, QComboBox *, QComboBox *, QScrollArea *, std::pmr::vector<Parser::BitmapGroupSequence> *)) {
         // Set up the main widget
         auto *main_widget = new QWidget();
         subwindow->setCentralWidget(main_widget);
@@ -325,7 +325,7 @@ namespace Invader::EditQt {
         return view;
     }
     
-    QGraphicsView *TagEditorBitmapSubwindow::draw_bitmap_to_widget(Parser::BitmapData *bitmap_data, std::size_t mipmap, std::size_t index, Colors mode, int scale, const std::vector<std::byte> *pixel_data) {
+    QGraphicsView *TagEditorBitmapSubwindow::draw_bitmap_to_widget(Parser::BitmapData *bitmap_data, std::size_t mipmap, std::size_t index, Colors mode, int scale, const std::pmr::vector<std::byte> *pixel_data) {
         // Get the dimensions of the mipmap
         std::size_t width = static_cast<std::size_t>(bitmap_data->width);
         std::size_t height = static_cast<std::size_t>(bitmap_data->height);
@@ -727,7 +727,7 @@ namespace Invader::EditQt {
         // Get the data
         Parser::Bitmap *bitmap = dynamic_cast<Parser::Bitmap *>(this->get_parent_window()->get_parser_data());
         Parser::BitmapData *bitmap_data = nullptr;
-        std::vector<std::byte> *pixel_data = nullptr;
+        std::pmr::vector<std::byte> *pixel_data = nullptr;
         auto *parent_window = this->get_parent_window();
         
         if(color_plate) {
@@ -857,7 +857,7 @@ namespace Invader::EditQt {
                 std::size_t height = 0;
                 std::size_t width = 0;
                 auto &sprite = sequence.sprites[i];
-                std::vector<Parser::BitmapData> *bitmap_data;
+                std::pmr::vector<Parser::BitmapData> *bitmap_data;
                 auto *parent_window = this->get_parent_window();
                 switch(parent_window->get_file().tag_fourcc) {
                     case TagFourCC::TAG_FOURCC_BITMAP:
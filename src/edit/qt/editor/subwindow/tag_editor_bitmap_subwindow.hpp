@@ -56,16 +56,16 @@ namespace Invader::EditQt {
             COLOR_BLUE
         };
 
-        std::vector<Parser::BitmapGroupSequence> *all_sequences;
+        std::pmr::vector<Parser::BitmapGroupSequence> *all_sequences;
 
-        static void set_values(TagEditorBitmapSubwindow *what, QComboBox *bitmaps, QComboBox *mipmaps, QComboBox *colors, QComboBox *scale, QComboBox *sequence, QComboBox *sprite, QScrollArea *images, std::vector<Parser::BitmapGroupSequence> *all_sequences);
+        static void set_values(TagEditorBitmapSubwindow *what, QComboBox *bitmaps, QComboBox *mipmaps, QComboBox *colors, QComboBox *scale, QComboBox *sequence, QComboBox *sprite, QScrollArea *images, std::pmr::vector<Parser::BitmapGroupSequence> *all_sequences);
         void refresh_data();
         void reload_view();
         
         void generate_colors_array(bool monochrome);
 
         QGraphicsView *draw_color_plate(Parser::Bitmap *bitmap_data, Colors colors, int scale);
-        QGraphicsView *draw_bitmap_to_widget(Parser::BitmapData *bitmap_data, std::size_t mipmap, std::size_t index, Colors mode, int scale, const std::vector<std::byte> *pixel_data);
+        QGraphicsView *draw_bitmap_to_widget(Parser::BitmapData *bitmap_data, std::size_t mipmap, std::size_t index, Colors mode, int scale, const std::pmr::vector<std::byte> *pixel_data);
         void highlight_sprite(std::uint32_t *data, std::size_t real_width, std::size_t real_height);
         void show_channel(std::uint32_t *data, std::size_t real_width, std::size_t real_height, Colors mode);
         void scale_bitmap(int scale, std::size_t &real_width, std::size_t &real_height, std::size_t &pixel_count, std::vector<std::uint32_t> &data);
@@ -22,11 +22,11 @@ namespace Invader::EditQt {
         QPlainTextEdit *text_view;
         QComboBox *combo_box;
         
-        std::vector<const std::vector<std::byte> *> lists;
+        std::vector<const std::pmr::vector<std::byte> *> lists;
         bool utf16;
         void selection_changed();
         
-        QString decode_string(const std::vector<std::byte> *data, bool first_line_only);
+        QString decode_string(const std::pmr::vector<std::byte> *data, bool first_line_only);
         void refresh_string();
     };
 }
@@ -15,6 +15,8 @@
 #include <QDesktopServices>
 #include <QInputDialog>
 #include <QThread>
+#include <QStandardPaths>
+#include <QTimer>
 #include "tag_tree_window.hpp"
 #include "tag_tree_widget.hpp"
 #include "tag_tree_dialog.hpp"
@@ -263,12 +265,21 @@ namespace Invader::EditQt {
     void TagFetcherThread::run() {
         // Function for loading it
         std::size_t error_count;
-        auto load_it = [&error_count](std::vector<File::TagFile> *to, std::vector<std::filesystem::path> *all_paths, std::pair<std::mutex, std::size_t> *statuser) {
-            *to = Invader::File::load_virtual_tag_folder(*all_paths, false, statuser, &error_count);
+        this->tag_index = std::make_unique<File::TagIndex>(this->all_paths);
+        auto load_it = [&error_count](std::vector<File::TagFile> *to, File::TagIndex *tag_index, const std::optional<std::filesystem::path> *cache_path, std::pair<std::mutex, std::size_t> *statuser) {
+            error_count = tag_index->load(*cache_path, statuser);
+            *to = tag_index->get_all_tags();
+
+            // Save it so we only have to look at what changed next time
+            if(cache_path->has_value()) {
+                std::error_code ec;
+                std::filesystem::create_directories((*cache_path)->parent_path(), ec);
+                tag_index->save(**cache_path);
+            }
         };
 
         // Run this in parallel
-        QThread *t = QThread::create(load_it, &this->all_tags, &this->all_paths, &this->statuser);
+        QThread *t = QThread::create(load_it, &this->all_tags, this->tag_index.get(), &this->cache_path, &this->statuser);
         t->start();
         std::size_t last_tag_count = 0;
         while(!t->isFinished()) {
@@ -286,7 +297,54 @@ namespace Invader::EditQt {
         emit fetch_finished(&this->all_tags, static_cast<int>(error_count));
     }
 
-    TagFetcherThread::TagFetcherThread(QObject *parent, const std::vector<std::filesystem::path> &all_paths) : QThread(parent), all_paths(all_paths) {}
+    TagFetcherThread::TagFetcherThread(QObject *parent, const std::vector<std::filesystem::path> &all_paths, const std::optional<std::filesystem::path> &cache_path) : QThread(parent), all_paths(all_paths), cache_path(cache_path) {}
+
+    // Get where to cache the listing of a set of tags directories, if anywhere
+    static std::optional<std::filesystem::path> tag_index_cache_path(const std::vector<std::filesystem::path> &paths) {
+        auto cache_directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        if(cache_directory.isEmpty()) {
+            return std::nullopt;
+        }
+
+        std::string all_paths;
+        for(auto &i : paths) {
+            std::error_code ec;
+            all_paths += std::filesystem::absolute(i, ec).string() + "\n";
+        }
+
+        char cache_name[64];
+        std::snprintf(cache_name, sizeof(cache_name), "tag-index-%016zx.bin", std::hash<std::string>()(all_paths));
+        return std::filesystem::path(cache_directory.toStdString()) / cache_name;
+    }
+
+    void TagTreeWindow::watch_tag_index() {
+        if(!this->tag_index) {
+            return;
+        }
+
+        // If we're told what changed, checking is just reading what we were told, so we can do it often; otherwise, we have to check the
+        // modification time of every directory
+        bool watching = this->tag_index->watch();
+        this->tag_index_timer = new QTimer(this);
+        connect(this->tag_index_timer, &QTimer::timeout, this, &TagTreeWindow::update_tag_index);
+        this->tag_index_timer->start(watching ? 250 : 5000);
+
+        // Catch anything that changed while we were listing
+        this->update_tag_index();
+    }
+
+    void TagTreeWindow::stop_watching_tag_index() {
+        delete this->tag_index_timer;
+        this->tag_index_timer = nullptr;
+        this->tag_index.reset();
+    }
+
+    void TagTreeWindow::update_tag_index() {
+        if(this->tag_index && this->tag_index->update()) {
+            this->all_tags = this->tag_index->get_all_tags();
+            this->reload_tags(false);
+        }
+    }
 
     void TagTreeWindow::reload_tags(bool reiterate_directories) {
         // Ensure we only reload once
@@ -296,6 +354,7 @@ namespace Invader::EditQt {
         
         // If we have fast listing mode, we don't need to do much
         if(this->fast_listing) {
+            this->stop_watching_tag_index();
             this->tags_reloaded_finished(nullptr, 0);
             return;
         }
@@ -308,9 +367,15 @@ namespace Invader::EditQt {
         // Clear all tags
         if(reiterate_directories) {
             // Now... let's do this
-            this->fetcher_thread = new TagFetcherThread(this, this->paths);
+            this->stop_watching_tag_index();
+            auto *fetcher_thread = new TagFetcherThread(this, this->paths, tag_index_cache_path(this->paths));
+            this->fetcher_thread = fetcher_thread;
             connect(this->fetcher_thread, &TagFetcherThread::tag_count_changed, this, &TagTreeWindow::tag_count_changed);
-            connect(this->fetcher_thread, &TagFetcherThread::fetch_finished, this, &TagTreeWindow::tags_reloaded_finished);
+            connect(this->fetcher_thread, &TagFetcherThread::fetch_finished, this, [this, fetcher_thread](const std::vector<File::TagFile> *result, int error_count) {
+                this->tag_index = fetcher_thread->take_tag_index();
+                this->tags_reloaded_finished(result, error_count);
+                this->watch_tag_index();
+            });
             connect(this->fetcher_thread, &TagFetcherThread::finished, this->fetcher_thread, &TagFetcherThread::deleteLater);
             this->fetcher_thread->start();
         }
@@ -10,12 +10,14 @@
 #include <QObject>
 #include <QThread>
 #include <invader/file/file.hpp>
+#include <invader/file/tag_index.hpp>
 
 #include "../editor/tag_editor_window.hpp"
 
 class QTreeWidget;
 class QMenu;
 class QLabel;
+class QTimer;
 
 namespace Invader::EditQt {
     class TagTreeWidget;
@@ -23,7 +25,15 @@ namespace Invader::EditQt {
     class TagFetcherThread : public QThread {
         Q_OBJECT
     public:
-        TagFetcherThread(QObject *parent, const std::vector<std::filesystem::path> &all_paths);
+        TagFetcherThread(QObject *parent, const std::vector<std::filesystem::path> &all_paths, const std::optional<std::filesystem::path> &cache_path);
+
+        /**
+         * Take the index of the tags that were fetched
+         * @return tag index
+         */
+        std::unique_ptr<File::TagIndex> take_tag_index() noexcept {
+            return std::move(this->tag_index);
+        }
 
     signals:
         void tag_count_changed(std::pair<std::mutex, std::size_t> *new_count);
@@ -32,6 +42,8 @@ namespace Invader::EditQt {
     private:
         void run() override;
         std::vector<std::filesystem::path> all_paths;
+        std::optional<std::filesystem::path> cache_path;
+        std::unique_ptr<File::TagIndex> tag_index;
         std::vector<File::TagFile> all_tags;
         std::pair<std::mutex, std::size_t> statuser;
         std::size_t last_tag_count;
@@ -165,6 +177,15 @@ namespace Invader::EditQt {
         /** We're done */
         void tags_reloaded_finished(const std::vector<File::TagFile> *result, int error_count);
 
+        /** Start keeping the tags up to date with the tag index */
+        void watch_tag_index();
+
+        /** Stop keeping the tags up to date */
+        void stop_watching_tag_index();
+
+        /** Update the tags if anything was added or removed */
+        void update_tag_index();
+
         /** We're done */
         void tag_count_changed(std::pair<std::mutex, std::size_t> *count);
 
@@ -207,6 +228,9 @@ namespace Invader::EditQt {
         bool opening_tag = false;
 
         TagFetcherThread *fetcher_thread;
+
+        std::unique_ptr<File::TagIndex> tag_index;
+        QTimer *tag_index_timer = nullptr;
         QWidget *filter_widget;
         QLineEdit *filter_textbox;
         
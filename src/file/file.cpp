@@ -6,11 +6,15 @@
 
 #include <invader/file/file.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
+#include "list_directory.hpp"
 
 #include <cstdio>
 #include <filesystem>
 #include <cstring>
 #include <climits>
+#include <deque>
+#include <unordered_map>
 
 namespace Invader::File {
     std::optional<std::vector<std::byte>> open_file(const std::filesystem::path &path) {
@@ -249,10 +253,19 @@ namespace Invader::File {
         }
     }
 
+    namespace {
+        /** Tags found in a directory along with its subdirectories, kept separate so directories can be listed in parallel */
+        struct VirtualTagDirectory {
+            /** Tags in this directory, in the order they were listed */
+            std::vector<TagFile> tags;
+
+            /** Subdirectories, each with the number of tags listed before it */
+            std::vector<std::pair<std::size_t, std::unique_ptr<VirtualTagDirectory>>> subdirectories;
+        };
+    }
+
     std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates, std::pair<std::mutex, std::size_t> *status, std::size_t *errors) {
-        std::vector<TagFile> all_tags;
-        
-        std::size_t new_errors = 0;
+        std::atomic<std::size_t> new_errors = 0;
 
         std::pair<std::mutex, std::size_t> status_r;
         if(status == nullptr) {
@@ -261,138 +274,111 @@ namespace Invader::File {
         status->first.lock();
         status->second = 0;
         status->first.unlock();
-        
-        #define maybe_iterate_directories(file_path, ...) try { \
-            iterate_directories(__VA_ARGS__); \
-        } \
-        catch(std::exception &e) { \
-            eprintf_error("Error listing %s: %s", file_path.string().c_str(), e.what()); \
-            new_errors++; \
-        }
-        
-        // win32 implementation because Windows I/O is AWFUL
-        #ifdef _WIN32
-        auto iterate_directories = [&all_tags, &status, &new_errors](const std::filesystem::path &dir, auto &iterate_directories, int depth, std::size_t priority, const std::vector<std::filesystem::path> &main_dir) -> void {
+
+        // Each directory is listed in its own task, so track them all so we know when we're done
+        ThreadPool thread_pool;
+        std::mutex tasks_mutex;
+        std::deque<std::future<void>> tasks;
+
+        auto iterate_directories = [&thread_pool, &tasks_mutex, &tasks, &status, &new_errors](VirtualTagDirectory &directory, std::filesystem::path dir, std::string tag_path, int depth, std::size_t priority, auto &iterate_directories) -> void {
             if(++depth == 256) {
                 return;
             }
-            
-            WIN32_FIND_DATA find_data;
-            HANDLE file = FindFirstFileA((dir / "*").string().c_str(), &find_data);
-            bool found = file != nullptr;
-            
-            std::size_t tags_found = 0;
-            
-            while(found) {
-                if(std::strcmp(find_data.cFileName, ".") != 0 && std::strcmp(find_data.cFileName, "..") != 0) {
-                    auto file_path = dir / find_data.cFileName;
-                    if(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                        maybe_iterate_directories(file_path, file_path, iterate_directories, depth, priority, main_dir);
-                    }
-                    else {
-                        auto extension = file_path.extension().string();
-                        auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
-
-                        // First, make sure it's valid
-                        if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
-                            goto spaghetti_next_tag;
-                        }
-
-                        // Next, add it
-                        TagFile file;
-                        file.full_path = file_path;
-                        file.tag_fourcc = tag_fourcc;
-                        file.tag_directory = priority;
-                        file.tag_path = Invader::File::file_path_to_tag_path(file_path.string(), main_dir).value();
-                        all_tags.emplace_back(std::move(file));
-                        
-                        tags_found++;
+
+            try {
+                list_directory(dir, [&](const char *name, bool is_directory) {
+                    auto file_path = dir / name;
+
+                    // Queue subdirectories so other threads can pick them up
+                    if(is_directory) {
+                        auto &subdirectory = *directory.subdirectories.emplace_back(directory.tags.size(), std::make_unique<VirtualTagDirectory>()).second;
+                        auto subdirectory_tag_path = tag_path + name + static_cast<char>(std::filesystem::path::preferred_separator);
+                        std::scoped_lock<std::mutex> lock(tasks_mutex);
+                        tasks.emplace_back(thread_pool.submit([&subdirectory, file_path, subdirectory_tag_path, depth, priority, &iterate_directories]() {
+                            iterate_directories(subdirectory, file_path, subdirectory_tag_path, depth, priority, iterate_directories);
+                        }));
+                        return;
                     }
-                }
-                
-                spaghetti_next_tag:
-                found = FindNextFileA(file, &find_data);
-            }
-            
-            // Update the find count
-            if(tags_found) {
-                status->first.lock();
-                status->second += tags_found;
-                status->first.unlock();
-            }
-        };
-        #else
-        auto iterate_directories = [&all_tags, &status, &new_errors](const std::filesystem::path &dir, auto &iterate_directories, int depth, std::size_t priority, const std::vector<std::filesystem::path> &main_dir) -> void {
-            if(++depth == 256) {
-                return;
-            }
-            
-            std::size_t tags_found = 0;
-
-            for(auto &d : std::filesystem::directory_iterator(dir)) {
-                auto file_path = d.path();
-                
-                if(d.is_directory()) {
-                    maybe_iterate_directories(file_path, d, iterate_directories, depth, priority, main_dir);
-                }
-                else if(file_path.has_extension() && std::filesystem::is_regular_file(file_path)) {
-                    auto extension = file_path.extension().string();
-                    auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
 
                     // First, make sure it's valid
+                    const char *extension = std::strrchr(name, '.');
+                    if(extension == nullptr || extension == name) {
+                        return;
+                    }
+                    auto tag_fourcc = HEK::tag_extension_to_fourcc(extension + 1);
                     if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
-                        continue;
+                        return;
                     }
 
                     // Next, add it
-                    TagFile file;
-                    file.full_path = file_path;
+                    auto &file = directory.tags.emplace_back();
+                    file.full_path = std::move(file_path);
                     file.tag_fourcc = tag_fourcc;
                     file.tag_directory = priority;
-                    file.tag_path = Invader::File::file_path_to_tag_path(file_path.string(), main_dir).value();
-                    all_tags.emplace_back(std::move(file));
-                    tags_found++;
-                }
+                    file.tag_path = tag_path + name;
+                });
+            }
+            catch(std::exception &e) {
+                eprintf_error("Error listing %s: %s", dir.string().c_str(), e.what());
+                new_errors++;
             }
-            
+
             // Update the find count
-            if(tags_found) {
+            if(!directory.tags.empty()) {
                 status->first.lock();
-                status->second += tags_found;
+                status->second += directory.tags.size();
                 status->first.unlock();
             }
         };
-        #endif
 
         // Go through each directory
         std::size_t dir_count = tags.size();
+        std::vector<VirtualTagDirectory> tags_directories(dir_count);
         for(std::size_t i = 0; i < dir_count; i++) {
             auto d = std::filesystem::path(remove_trailing_slashes(tags[i].string()));
-            maybe_iterate_directories(d, d, iterate_directories, 0, i, std::vector<std::filesystem::path>(&d, &d + 1));
+            std::scoped_lock<std::mutex> lock(tasks_mutex);
+            tasks.emplace_back(thread_pool.submit([&tags_directories, d, i, &iterate_directories]() {
+                iterate_directories(tags_directories[i], d, std::string(), 0, i, iterate_directories);
+            }));
         }
-        
-        // Remove duplicates
-        if(filter_duplicates) {
-            for(std::size_t i = 0; i < all_tags.size(); i++) {
-                for(std::size_t j = 0; j < i; j++) {
-                    auto &tagi = all_tags[i];
-                    auto &tagj = all_tags[j];
-                    
-                    if(tagi.tag_fourcc == tagj.tag_fourcc && tagi.tag_path == tagj.tag_path) {
-                        if(tagi.tag_directory > tagj.tag_directory) {
-                            all_tags.erase(all_tags.begin() + i);
-                        }
-                        else {
-                            all_tags.erase(all_tags.begin() + j);
-                        }
-                        
-                        i--;
-                        break;
-                    }
+
+        // Tasks are queued before the task queuing them finishes, so once there are none left, everything has been listed
+        while(true) {
+            std::future<void> task;
+            {
+                std::scoped_lock<std::mutex> lock(tasks_mutex);
+                if(tasks.empty()) {
+                    break;
                 }
+                task = std::move(tasks.front());
+                tasks.pop_front();
             }
+            thread_pool.wait(task);
         }
-        
+
+        // Put everything together in the order it was listed
+        std::vector<TagFile> all_tags;
+        auto add_tags = [&all_tags](VirtualTagDirectory &directory, auto &add_tags) -> void {
+            std::size_t next_tag = 0;
+            auto add_tags_until = [&all_tags, &directory, &next_tag](std::size_t end) {
+                all_tags.insert(all_tags.end(), std::make_move_iterator(directory.tags.begin() + next_tag), std::make_move_iterator(directory.tags.begin() + end));
+                next_tag = end;
+            };
+            for(auto &subdirectory : directory.subdirectories) {
+                add_tags_until(subdirectory.first);
+                add_tags(*subdirectory.second, add_tags);
+            }
+            add_tags_until(directory.tags.size());
+        };
+        for(auto &d : tags_directories) {
+            add_tags(d, add_tags);
+        }
+
+        // Remove duplicates
+        if(filter_duplicates) {
+            remove_duplicate_tags(all_tags);
+        }
+
         // Change error count if errors was specified
         if(errors) {
             *errors = new_errors;
@@ -401,6 +387,33 @@ namespace Invader::File {
         return all_tags;
     }
 
+    void remove_duplicate_tags(std::vector<TagFile> &tags) {
+        // The tag path includes the extension, so it also distinguishes tag classes
+        std::unordered_map<std::string, std::size_t> tags_to_keep;
+        tags_to_keep.reserve(tags.size());
+        for(std::size_t i = 0; i < tags.size(); i++) {
+            auto [kept, added] = tags_to_keep.try_emplace(tags[i].tag_path, i);
+            if(!added && tags[i].tag_directory < tags[kept->second].tag_directory) {
+                kept->second = i;
+            }
+        }
+
+        if(tags_to_keep.size() == tags.size()) {
+            return;
+        }
+
+        std::size_t kept_count = 0;
+        for(std::size_t i = 0; i < tags.size(); i++) {
+            if(tags_to_keep[tags[i].tag_path] == i) {
+                if(kept_count != i) {
+                    tags[kept_count] = std::move(tags[i]);
+                }
+                kept_count++;
+            }
+        }
+        tags.resize(kept_count);
+    }
+
     std::vector<std::string> TagFile::split_tag_path() {
         std::vector<std::string> elements;
         auto halo_path = preferred_path_to_halo_path(this->tag_path);
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__LIST_DIRECTORY_HPP
+#define INVADER__FILE__LIST_DIRECTORY_HPP
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+
+namespace Invader::File {
+    /**
+     * Call a function with the name of each file and directory in a directory (following symlinks) without needing to stat each one
+     * @param dir      directory to list
+     * @param callback function to call with the name of each entry and whether it's a directory
+     * @throws         std::system_error if the directory can't be opened
+     */
+    template<typename Callback> void list_directory(const std::filesystem::path &dir, Callback &&callback) {
+        // win32 implementation because Windows I/O is AWFUL
+        #ifdef _WIN32
+        WIN32_FIND_DATA find_data;
+        HANDLE file = FindFirstFileA((dir / "*").string().c_str(), &find_data);
+        if(file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+
+        do {
+            if(std::strcmp(find_data.cFileName, ".") != 0 && std::strcmp(find_data.cFileName, "..") != 0) {
+                callback(find_data.cFileName, (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+            }
+        }
+        while(FindNextFileA(file, &find_data));
+
+        FindClose(file);
+        #else
+        std::unique_ptr<DIR, int (*)(DIR *)> directory(opendir(dir.string().c_str()), closedir);
+        if(!directory) {
+            throw std::system_error(errno, std::generic_category());
+        }
+
+        while(auto *entry = readdir(directory.get())) {
+            const char *name = entry->d_name;
+            if(std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
+                continue;
+            }
+
+            // Use the type from the directory entry if we have it; otherwise (or if it's a symlink) we have to stat it
+            #ifdef DT_DIR
+            if(entry->d_type == DT_DIR) {
+                callback(name, true);
+                continue;
+            }
+            else if(entry->d_type == DT_REG) {
+                callback(name, false);
+                continue;
+            }
+            #endif
+
+            struct stat file_status;
+            if(stat((dir / name).string().c_str(), &file_status) != 0) {
+                continue;
+            }
+            else if(S_ISDIR(file_status.st_mode)) {
+                callback(name, true);
+            }
+            else if(S_ISREG(file_status.st_mode)) {
+                callback(name, false);
+            }
+        }
+        #endif
+    }
+}
+
+#endif
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <invader/file/tag_batch.hpp>
+#include <invader/file/file.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader::File {
+    void TagBatch::Output::add(Level level, const char *format, std::va_list args) {
+        std::va_list args_copy;
+        va_copy(args_copy, args);
+        int length = std::vsnprintf(nullptr, 0, format, args_copy);
+        va_end(args_copy);
+        if(length < 0) {
+            return;
+        }
+
+        std::string message(static_cast<std::size_t>(length), '\0');
+        std::vsnprintf(message.data(), message.size() + 1, format, args);
+        this->messages.emplace_back(level, std::move(message));
+    }
+
+    #define ADD_MESSAGE(name, level) void TagBatch::Output::name(const char *format, ...) { \
+        std::va_list args; \
+        va_start(args, format); \
+        this->add(level, format, args); \
+        va_end(args); \
+    }
+
+    ADD_MESSAGE(message, LEVEL_MESSAGE)
+    ADD_MESSAGE(success, LEVEL_SUCCESS)
+    ADD_MESSAGE(success_warn, LEVEL_SUCCESS_WARN)
+    ADD_MESSAGE(warning, LEVEL_WARNING)
+    ADD_MESSAGE(error, LEVEL_ERROR)
+
+    #undef ADD_MESSAGE
+
+    void TagBatch::Output::print() {
+        for(auto &[level, message] : this->messages) {
+            const char *message_str = message.c_str();
+            switch(level) {
+                case LEVEL_MESSAGE:
+                    oprintf("%s\n", message_str);
+                    break;
+                case LEVEL_SUCCESS:
+                    oprintf_success("%s", message_str);
+                    break;
+                case LEVEL_SUCCESS_WARN:
+                    oprintf_success_warn("%s", message_str);
+                    break;
+                case LEVEL_WARNING:
+                    eprintf_warn("%s", message_str);
+                    break;
+                case LEVEL_ERROR:
+                    eprintf_error("%s", message_str);
+                    break;
+            }
+        }
+        this->messages.clear();
+    }
+
+    TagBatch::Summary TagBatch::run(std::size_t tag_count, const Function &function, std::size_t thread_count) {
+        struct Slot {
+            Result result = RESULT_FAILED;
+            Output output;
+            std::atomic<bool> done = false;
+        };
+
+        Summary summary;
+        if(tag_count == 0) {
+            return summary;
+        }
+
+        auto slots = std::make_unique<Slot[]>(tag_count);
+        std::atomic<std::size_t> next_tag = 0;
+
+        auto worker = [&function, &slots, &next_tag, tag_count]() {
+            for(std::size_t t; (t = next_tag.fetch_add(1, std::memory_order_relaxed)) < tag_count;) {
+                auto &slot = slots[t];
+                try {
+                    slot.result = function(t, slot.output);
+                }
+                catch(std::exception &e) {
+                    slot.output.error("Error: %s", e.what());
+                    slot.result = RESULT_FAILED;
+                }
+                slot.done.store(true, std::memory_order_release);
+                slot.done.notify_one();
+            }
+        };
+
+        // This thread only prints, so every worker can be busy with a tag
+        std::vector<std::thread> threads;
+        thread_count = std::clamp(thread_count, static_cast<std::size_t>(1), tag_count);
+        threads.reserve(thread_count);
+        for(std::size_t i = 0; i < thread_count; i++) {
+            threads.emplace_back(worker);
+        }
+
+        for(std::size_t t = 0; t < tag_count; t++) {
+            auto &slot = slots[t];
+            slot.done.wait(false, std::memory_order_acquire);
+            slot.output.print();
+            switch(slot.result) {
+                case RESULT_FAILED:
+                    summary.failed++;
+                    break;
+                case RESULT_UNCHANGED:
+                    summary.unchanged++;
+                    break;
+                case RESULT_CHANGED:
+                    summary.changed++;
+                    break;
+            }
+        }
+
+        for(auto &thread : threads) {
+            thread.join();
+        }
+
+        return summary;
+    }
+
+    TagBatch::SaveResult TagBatch::save_if_changed(const std::filesystem::path &path, const std::vector<std::byte> &data, const std::vector<std::byte> *original) {
+        // Only read the file if it could be the same
+        std::optional<std::vector<std::byte>> current;
+        if(original == nullptr) {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(path, ec);
+            if(!ec && size == data.size()) {
+                current = open_file(path);
+                if(current.has_value()) {
+                    original = &*current;
+                }
+            }
+        }
+
+        if(original != nullptr && *original == data) {
+            return SAVE_RESULT_UNCHANGED;
+        }
+
+        return save_file(path, data) ? SAVE_RESULT_SAVED : SAVE_RESULT_FAILED;
+    }
+}
@@ -0,0 +1,557 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/file/tag_index.hpp>
+#include <invader/thread_pool.hpp>
+#include <invader/printf.hpp>
+#include <invader/error.hpp>
+#include "list_directory.hpp"
+
+#include <cstring>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Invader::File {
+    static constexpr char CACHE_MAGIC[8] = { 'i', 'n', 'v', 't', 'a', 'g', 'i', 'x' };
+    static constexpr std::uint32_t CACHE_VERSION = 1;
+
+    // Tags can't be more than this deep, same as load_virtual_tag_folder()
+    static constexpr std::uint32_t MAX_DEPTH = 256;
+
+    #ifdef __linux__
+    // Only adding, removing, and renaming change what's in a directory
+    static constexpr std::uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    #endif
+
+    static std::int64_t get_modified(const std::string &path) {
+        std::error_code ec;
+        auto modified = std::filesystem::last_write_time(path, ec);
+        if(ec) {
+            return INT64_MIN;
+        }
+        return static_cast<std::int64_t>(modified.time_since_epoch().count());
+    }
+
+    TagIndex::TagIndex(const std::vector<std::filesystem::path> &tags_directories) : tags_directories(tags_directories) {}
+
+    TagIndex::~TagIndex() {
+        this->stop_watching();
+    }
+
+    void TagIndex::read_directory(const std::string &path, Directory &directory, [[maybe_unused]] int watch_descriptor) {
+        // Watch and get the modification time before listing so anything changed while listing isn't missed
+        #ifdef __linux__
+        if(watch_descriptor != -1 && directory.watch == -1) {
+            directory.watch = inotify_add_watch(watch_descriptor, path.c_str(), WATCH_MASK);
+        }
+        #endif
+        directory.modified = get_modified(path);
+        directory.subdirectories.clear();
+        directory.tags.clear();
+
+        list_directory(path, [&path, &directory](const char *name, bool is_directory) {
+            if(is_directory) {
+                directory.subdirectories.emplace_back(name);
+                return;
+            }
+
+            // First, make sure it's valid
+            const char *extension = std::strrchr(name, '.');
+            if(extension == nullptr || extension == name) {
+                return;
+            }
+            auto tag_fourcc = HEK::tag_extension_to_fourcc(extension + 1);
+            if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
+                return;
+            }
+
+            // Next, add it
+            auto &file = directory.tags.emplace_back();
+            file.full_path = std::filesystem::path(path) / name;
+            file.tag_fourcc = tag_fourcc;
+            file.tag_directory = directory.priority;
+            file.tag_path = directory.tag_path + name;
+        });
+    }
+
+    void TagIndex::add_directories(std::vector<std::pair<std::string, Directory>> directories_to_add) {
+        std::optional<ThreadPool> thread_pool;
+        bool watch_failed = false;
+
+        // List a level of directories at a time, putting the next level in directories_to_add
+        while(!directories_to_add.empty()) {
+            auto list_directory_to_add = [this](std::pair<std::string, Directory> &directory) -> std::optional<std::string> {
+                try {
+                    read_directory(directory.first, directory.second, this->watch_descriptor);
+                    return std::nullopt;
+                }
+                catch(std::exception &e) {
+                    return e.what();
+                }
+            };
+
+            // Don't bother with threads if there's only one
+            std::vector<std::optional<std::string>> listing_errors;
+            if(directories_to_add.size() == 1) {
+                listing_errors.emplace_back(list_directory_to_add(directories_to_add[0]));
+            }
+            else {
+                if(!thread_pool.has_value()) {
+                    thread_pool.emplace();
+                }
+                std::vector<std::future<std::optional<std::string>>> futures;
+                futures.reserve(directories_to_add.size());
+                for(auto &d : directories_to_add) {
+                    futures.emplace_back(thread_pool->submit([&list_directory_to_add, &d]() { return list_directory_to_add(d); }));
+                }
+                listing_errors = thread_pool->wait_all(futures);
+            }
+
+            std::vector<std::pair<std::string, Directory>> next_directories_to_add;
+            std::size_t tags_found = 0;
+            for(std::size_t i = 0; i < directories_to_add.size(); i++) {
+                auto &[path, directory] = directories_to_add[i];
+                if(listing_errors[i].has_value()) {
+                    eprintf_error("Error listing %s: %s", path.c_str(), listing_errors[i]->c_str());
+                    this->errors++;
+                }
+
+                if(this->watch_descriptor != -1) {
+                    if(directory.watch == -1 && !listing_errors[i].has_value()) {
+                        watch_failed = true;
+                    }
+                    else {
+                        this->watches[directory.watch] = path;
+                    }
+                }
+
+                if(directory.depth + 1 < MAX_DEPTH) {
+                    for(auto &name : directory.subdirectories) {
+                        auto &subdirectory = next_directories_to_add.emplace_back((std::filesystem::path(path) / name).string(), Directory()).second;
+                        subdirectory.priority = directory.priority;
+                        subdirectory.depth = directory.depth + 1;
+                        subdirectory.tag_path = directory.tag_path + name + static_cast<char>(std::filesystem::path::preferred_separator);
+                    }
+                }
+
+                tags_found += directory.tags.size();
+                this->directories[path] = std::move(directory);
+            }
+
+            // Update the find count
+            if(this->status != nullptr && tags_found) {
+                this->status->first.lock();
+                this->status->second += tags_found;
+                this->status->first.unlock();
+            }
+
+            directories_to_add = std::move(next_directories_to_add);
+        }
+
+        if(watch_failed) {
+            eprintf_warn("Warning: Failed to watch some tags directories for changes; modification times will be checked instead");
+            this->stop_watching();
+        }
+    }
+
+    void TagIndex::remove_directory(const std::string &path) {
+        auto remove = [this](std::map<std::string, Directory>::iterator directory) {
+            #ifdef __linux__
+            // A directory that was moved keeps its watch, so if its new path was already listed, the watch belongs to that path now
+            if(directory->second.watch != -1 && this->watch_descriptor != -1) {
+                if(auto watch = this->watches.find(directory->second.watch); watch != this->watches.end() && watch->second == directory->first) {
+                    inotify_rm_watch(this->watch_descriptor, watch->first);
+                    this->watches.erase(watch);
+                }
+            }
+            #endif
+            return this->directories.erase(directory);
+        };
+
+        if(auto directory = this->directories.find(path); directory != this->directories.end()) {
+            remove(directory);
+        }
+
+        auto prefix = path + static_cast<char>(std::filesystem::path::preferred_separator);
+        for(auto directory = this->directories.lower_bound(prefix); directory != this->directories.end() && directory->first.compare(0, prefix.size(), prefix) == 0;) {
+            directory = remove(directory);
+        }
+    }
+
+    bool TagIndex::relist_directory(const std::string &path) {
+        auto found = this->directories.find(path);
+        if(found == this->directories.end()) {
+            return false;
+        }
+
+        auto &directory = found->second;
+        Directory listed;
+        listed.priority = directory.priority;
+        listed.depth = directory.depth;
+        listed.tag_path = directory.tag_path;
+        listed.watch = directory.watch;
+
+        try {
+            read_directory(path, listed, this->watch_descriptor);
+        }
+        catch(std::exception &) {
+            // If it's gone, take it out (but keep the tags directories themselves so they're listed if they come back)
+            bool changed = !directory.tags.empty() || !directory.subdirectories.empty();
+            if(directory.depth > 1) {
+                this->remove_directory(path);
+                return true;
+            }
+            for(auto &name : directory.subdirectories) {
+                this->remove_directory((std::filesystem::path(path) / name).string());
+            }
+            directory.tags.clear();
+            directory.subdirectories.clear();
+            directory.modified = listed.modified;
+            return changed;
+        }
+
+        // See if the tags are the same
+        bool changed = listed.tags.size() != directory.tags.size();
+        for(std::size_t i = 0; !changed && i < listed.tags.size(); i++) {
+            changed = listed.tags[i].tag_path != directory.tags[i].tag_path;
+        }
+
+        // Remove subdirectories that are gone and add ones that are new
+        std::unordered_set<std::string> old_subdirectories(directory.subdirectories.begin(), directory.subdirectories.end());
+        std::unordered_set<std::string> new_subdirectories(listed.subdirectories.begin(), listed.subdirectories.end());
+        std::vector<std::pair<std::string, Directory>> directories_to_add;
+
+        for(auto &name : directory.subdirectories) {
+            if(new_subdirectories.find(name) == new_subdirectories.end()) {
+                this->remove_directory((std::filesystem::path(path) / name).string());
+                changed = true;
+            }
+        }
+        for(auto &name : listed.subdirectories) {
+            if(old_subdirectories.find(name) == old_subdirectories.end()) {
+                changed = true;
+                if(directory.depth + 1 < MAX_DEPTH) {
+                    auto &subdirectory = directories_to_add.emplace_back((std::filesystem::path(path) / name).string(), Directory()).second;
+                    subdirectory.priority = directory.priority;
+                    subdirectory.depth = directory.depth + 1;
+                    subdirectory.tag_path = directory.tag_path + name + static_cast<char>(std::filesystem::path::preferred_separator);
+                }
+            }
+        }
+
+        if(listed.watch != -1) {
+            this->watches[listed.watch] = path;
+        }
+        directory = std::move(listed);
+
+        if(!directories_to_add.empty()) {
+            this->add_directories(std::move(directories_to_add));
+        }
+
+        return changed;
+    }
+
+    bool TagIndex::check_directories() {
+        std::vector<std::string> directories_to_relist;
+        for(auto &[path, directory] : this->directories) {
+            if(get_modified(path) != directory.modified) {
+                directories_to_relist.emplace_back(path);
+            }
+        }
+
+        bool changed = false;
+        for(auto &path : directories_to_relist) {
+            changed = this->relist_directory(path) || changed;
+        }
+        return changed;
+    }
+
+    std::size_t TagIndex::load(const std::optional<std::filesystem::path> &cache_path, std::pair<std::mutex, std::size_t> *status) {
+        this->errors = 0;
+        this->status = status;
+        if(status != nullptr) {
+            status->first.lock();
+            status->second = 0;
+            status->first.unlock();
+        }
+
+        // Only directories modified since the cache was saved need to be listed
+        if(cache_path.has_value() && this->load_cache(*cache_path)) {
+            this->check_directories();
+        }
+        else {
+            this->stop_watching();
+            this->directories.clear();
+
+            std::vector<std::pair<std::string, Directory>> directories_to_add;
+            for(std::size_t i = 0; i < this->tags_directories.size(); i++) {
+                auto &directory = directories_to_add.emplace_back(remove_trailing_slashes(this->tags_directories[i].string()), Directory()).second;
+                directory.priority = i;
+            }
+            this->add_directories(std::move(directories_to_add));
+        }
+
+        this->gather_tags();
+        if(status != nullptr) {
+            status->first.lock();
+            status->second = this->all_tags.size();
+            status->first.unlock();
+        }
+        this->status = nullptr;
+
+        return this->errors;
+    }
+
+    bool TagIndex::watch() {
+        #ifdef __linux__
+        if(this->watch_descriptor != -1) {
+            return true;
+        }
+
+        this->watch_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(this->watch_descriptor == -1) {
+            return false;
+        }
+
+        for(auto &[path, directory] : this->directories) {
+            directory.watch = inotify_add_watch(this->watch_descriptor, path.c_str(), WATCH_MASK);
+            if(directory.watch == -1) {
+                eprintf_warn("Warning: Failed to watch tags directories for changes (%s); modification times will be checked instead", std::strerror(errno));
+                this->stop_watching();
+                return false;
+            }
+            this->watches[directory.watch] = path;
+        }
+
+        // Anything changed before we started watching would otherwise be missed
+        this->check_all_directories = true;
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    void TagIndex::stop_watching() {
+        #ifdef __linux__
+        if(this->watch_descriptor != -1) {
+            close(this->watch_descriptor);
+            this->watch_descriptor = -1;
+        }
+        #endif
+
+        this->watches.clear();
+        for(auto &directory : this->directories) {
+            directory.second.watch = -1;
+        }
+    }
+
+    bool TagIndex::update() {
+        #ifdef __linux__
+        if(this->watch_descriptor != -1) {
+            alignas(inotify_event) char events[16384];
+            ssize_t length;
+            while((length = read(this->watch_descriptor, events, sizeof(events))) > 0) {
+                for(char *e = events; e < events + length;) {
+                    const auto *event = reinterpret_cast<const inotify_event *>(e);
+                    e += sizeof(*event) + event->len;
+
+                    if(event->mask & IN_Q_OVERFLOW) {
+                        this->check_all_directories = true;
+                        continue;
+                    }
+
+                    auto watch = this->watches.find(event->wd);
+                    if(watch == this->watches.end()) {
+                        continue;
+                    }
+
+                    // The watch is gone (its directory was deleted), so whatever contains it will be listed again
+                    if(event->mask & IN_IGNORED) {
+                        if(auto directory = this->directories.find(watch->second); directory != this->directories.end() && directory->second.watch == event->wd) {
+                            directory->second.watch = -1;
+                        }
+                        this->watches.erase(watch);
+                        continue;
+                    }
+
+                    this->changed_directories.insert(watch->second);
+                }
+            }
+        }
+        else {
+            this->check_all_directories = true;
+        }
+        #else
+        this->check_all_directories = true;
+        #endif
+
+        bool changed = false;
+        if(this->check_all_directories) {
+            this->check_all_directories = false;
+            this->changed_directories.clear();
+            changed = this->check_directories();
+        }
+        else {
+            // Parents are listed before their subdirectories since they're sorted by path
+            auto changed_directories = std::move(this->changed_directories);
+            this->changed_directories.clear();
+            for(auto &path : changed_directories) {
+                changed = this->relist_directory(path) || changed;
+            }
+        }
+
+        if(changed) {
+            this->gather_tags();
+        }
+
+        return changed;
+    }
+
+    void TagIndex::gather_tags() {
+        this->all_tags.clear();
+        for(auto &directory : this->directories) {
+            this->all_tags.insert(this->all_tags.end(), directory.second.tags.begin(), directory.second.tags.end());
+        }
+    }
+
+    std::vector<TagFile> TagIndex::get_tags() const {
+        auto tags = this->all_tags;
+        remove_duplicate_tags(tags);
+        return tags;
+    }
+
+    template<typename T> static void write_integer(std::vector<std::byte> &data, T value) {
+        const auto *bytes = reinterpret_cast<const std::byte *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(value));
+    }
+
+    static void write_string(std::vector<std::byte> &data, const std::string &string) {
+        write_integer(data, static_cast<std::uint32_t>(string.size()));
+        const auto *bytes = reinterpret_cast<const std::byte *>(string.data());
+        data.insert(data.end(), bytes, bytes + string.size());
+    }
+
+    bool TagIndex::save(const std::filesystem::path &cache_path) const {
+        std::vector<std::byte> data;
+        const auto *magic = reinterpret_cast<const std::byte *>(CACHE_MAGIC);
+        data.insert(data.end(), magic, magic + sizeof(CACHE_MAGIC));
+        write_integer(data, CACHE_VERSION);
+
+        write_integer(data, static_cast<std::uint32_t>(this->tags_directories.size()));
+        for(auto &tags_directory : this->tags_directories) {
+            write_string(data, tags_directory.string());
+        }
+
+        write_integer(data, static_cast<std::uint64_t>(this->directories.size()));
+        for(auto &[path, directory] : this->directories) {
+            write_string(data, path);
+            write_integer(data, static_cast<std::uint32_t>(directory.priority));
+            write_integer(data, directory.depth);
+            write_string(data, directory.tag_path);
+            write_integer(data, directory.modified);
+
+            write_integer(data, static_cast<std::uint32_t>(directory.subdirectories.size()));
+            for(auto &name : directory.subdirectories) {
+                write_string(data, name);
+            }
+
+            write_integer(data, static_cast<std::uint32_t>(directory.tags.size()));
+            for(auto &tag : directory.tags) {
+                write_string(data, tag.full_path.filename().string());
+                write_integer(data, static_cast<std::uint32_t>(tag.tag_fourcc));
+            }
+        }
+
+        return save_file(cache_path, data);
+    }
+
+    bool TagIndex::load_cache(const std::filesystem::path &cache_path) {
+        auto data = open_file(cache_path);
+        if(!data.has_value()) {
+            return false;
+        }
+
+        const auto *position = data->data();
+        const auto *end = data->data() + data->size();
+        auto read_bytes = [&position, &end](std::size_t size) {
+            if(size > static_cast<std::size_t>(end - position)) {
+                throw OutOfBoundsException();
+            }
+            const auto *bytes = position;
+            position += size;
+            return bytes;
+        };
+        auto read_u32 = [&read_bytes]() {
+            std::uint32_t value;
+            std::memcpy(&value, read_bytes(sizeof(value)), sizeof(value));
+            return value;
+        };
+        auto read_string = [&read_bytes, &read_u32]() {
+            auto size = read_u32();
+            return std::string(reinterpret_cast<const char *>(read_bytes(size)), size);
+        };
+
+        std::map<std::string, Directory> directories;
+
+        try {
+            if(std::memcmp(read_bytes(sizeof(CACHE_MAGIC)), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || read_u32() != CACHE_VERSION) {
+                throw InvalidTagDataException();
+            }
+
+            // If it was made for different tags directories, don't use it
+            if(read_u32() != this->tags_directories.size()) {
+                return false;
+            }
+            for(auto &tags_directory : this->tags_directories) {
+                if(read_string() != tags_directory.string()) {
+                    return false;
+                }
+            }
+
+            std::uint64_t directory_count;
+            std::memcpy(&directory_count, read_bytes(sizeof(directory_count)), sizeof(directory_count));
+            for(std::uint64_t d = 0; d < directory_count; d++) {
+                auto path = read_string();
+                auto &directory = directories[path];
+                directory.priority = read_u32();
+                directory.depth = read_u32();
+                directory.tag_path = read_string();
+                std::memcpy(&directory.modified, read_bytes(sizeof(directory.modified)), sizeof(directory.modified));
+
+                if(directory.priority >= this->tags_directories.size()) {
+                    throw InvalidTagDataException();
+                }
+
+                auto subdirectory_count = read_u32();
+                for(std::uint32_t s = 0; s < subdirectory_count; s++) {
+                    directory.subdirectories.emplace_back(read_string());
+                }
+
+                auto tag_count = read_u32();
+                for(std::uint32_t t = 0; t < tag_count; t++) {
+                    auto name = read_string();
+                    auto &tag = directory.tags.emplace_back();
+                    tag.tag_fourcc = static_cast<TagFourCC>(read_u32());
+                    tag.full_path = std::filesystem::path(path) / name;
+                    tag.tag_directory = directory.priority;
+                    tag.tag_path = directory.tag_path + name;
+                }
+            }
+
+            if(position != end) {
+                throw InvalidTagDataException();
+            }
+        }
+        catch(std::exception &) {
+            eprintf_warn("Warning: %s is not a valid tag index cache, so the tags directories will be listed again", cache_path.string().c_str());
+            return false;
+        }
+
+        this->stop_watching();
+        this->directories = std::move(directories);
+        return true;
+    }
+}
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <numeric>
+#include <utility>
+
+#include <invader/hek/bulk_swap.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define INVADER_BULK_SWAP_SSSE3
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define INVADER_BULK_SWAP_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Invader::HEK {
+    // Shuffle mask value for zeroing a byte (works for both pshufb and tbl)
+    static constexpr std::uint8_t ZERO_BYTE = 0x80;
+
+    // Each 16-byte block of output is shuffled from the 32 bytes of input starting 8 bytes before it, so fields up to 8 bytes wide can cross
+    // block boundaries. Each block has two masks: one for the low 16 bytes of input and one for the high 16 bytes.
+    static constexpr std::size_t WINDOW_BEFORE = 8;
+    static constexpr std::size_t MASKS_PER_BLOCK = 32;
+
+    #if defined(INVADER_BULK_SWAP_SSSE3)
+    __attribute__((target("ssse3"))) static void shuffle_blocks_ssse3(const std::byte *input, std::byte *output, std::size_t begin, std::size_t end, const std::uint8_t *masks, std::size_t mask_count) {
+        std::size_t m = (begin / 16 * MASKS_PER_BLOCK) % mask_count;
+        for(std::size_t o = begin; o < end; o += 16) {
+            auto low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + o - WINDOW_BEFORE));
+            auto high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + o - WINDOW_BEFORE + 16));
+            auto low_mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks + m));
+            auto high_mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks + m + 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + o), _mm_or_si128(_mm_shuffle_epi8(low, low_mask), _mm_shuffle_epi8(high, high_mask)));
+            m += MASKS_PER_BLOCK;
+            if(m == mask_count) {
+                m = 0;
+            }
+        }
+    }
+    #elif defined(INVADER_BULK_SWAP_NEON)
+    static void shuffle_blocks_neon(const std::byte *input, std::byte *output, std::size_t begin, std::size_t end, const std::uint8_t *masks, std::size_t mask_count) {
+        std::size_t m = (begin / 16 * MASKS_PER_BLOCK) % mask_count;
+        for(std::size_t o = begin; o < end; o += 16) {
+            auto low = vld1q_u8(reinterpret_cast<const std::uint8_t *>(input + o - WINDOW_BEFORE));
+            auto high = vld1q_u8(reinterpret_cast<const std::uint8_t *>(input + o - WINDOW_BEFORE + 16));
+            auto low_mask = vld1q_u8(masks + m);
+            auto high_mask = vld1q_u8(masks + m + 16);
+            vst1q_u8(reinterpret_cast<std::uint8_t *>(output + o), vorrq_u8(vqtbl1q_u8(low, low_mask), vqtbl1q_u8(high, high_mask)));
+            m += MASKS_PER_BLOCK;
+            if(m == mask_count) {
+                m = 0;
+            }
+        }
+    }
+    #endif
+
+    /**
+     * Shuffle whole 16-byte blocks of the array, if the CPU can. The first block and whatever is left at the end aren't shuffled, since the
+     * input window would go outside of the array.
+     * @return range of bytes shuffled
+     */
+    static std::pair<std::size_t, std::size_t> shuffle_blocks([[maybe_unused]] const std::byte *input, [[maybe_unused]] std::byte *output, [[maybe_unused]] std::size_t length, [[maybe_unused]] const std::vector<std::uint8_t> &masks) {
+        std::size_t begin = 16;
+        if(masks.empty() || length < begin + 16 + (32 - 16 - WINDOW_BEFORE)) {
+            return { 0, 0 };
+        }
+        std::size_t end = begin + (length - begin - (32 - 16 - WINDOW_BEFORE)) / 16 * 16;
+
+        #if defined(INVADER_BULK_SWAP_SSSE3)
+        static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+        if(has_ssse3) {
+            shuffle_blocks_ssse3(input, output, begin, end, masks.data(), masks.size());
+            return { begin, end };
+        }
+        #elif defined(INVADER_BULK_SWAP_NEON)
+        shuffle_blocks_neon(input, output, begin, end, masks.data(), masks.size());
+        return { begin, end };
+        #endif
+
+        return { 0, 0 };
+    }
+
+    BulkSwap::BulkSwap(const std::int32_t *source, std::size_t struct_size) : struct_size(struct_size), source(source, source + struct_size) {
+        // The pattern repeats every lcm(struct size, 16) bytes. If a byte comes from outside of its block's input window, we can't use masks.
+        std::size_t period = std::lcm(struct_size, static_cast<std::size_t>(16));
+        std::vector<std::uint8_t> masks(period / 16 * MASKS_PER_BLOCK, ZERO_BYTE);
+        for(std::size_t o = 0; o < period; o++) {
+            std::size_t struct_offset = o % struct_size;
+            auto from = this->source[struct_offset];
+            if(from < 0) {
+                continue;
+            }
+
+            // Work out where it is in the window (offset by a period so it doesn't go below 0)
+            std::size_t block = o - o % 16;
+            std::size_t from_offset = period + o - struct_offset + static_cast<std::size_t>(from);
+            std::size_t window = period + block - WINDOW_BEFORE;
+            if(from_offset < window || from_offset >= window + 32) {
+                return;
+            }
+            std::size_t window_offset = from_offset - window;
+            std::size_t mask_offset = block / 16 * MASKS_PER_BLOCK + o % 16 + (window_offset < 16 ? 0 : 16);
+            masks[mask_offset] = static_cast<std::uint8_t>(window_offset % 16);
+        }
+        this->masks = std::move(masks);
+    }
+
+    void BulkSwap::swap_bytes(const std::byte *input, std::byte *output, std::size_t begin, std::size_t end) const {
+        const auto *source = this->source.data();
+        std::size_t struct_offset = begin % this->struct_size;
+        std::size_t struct_start = begin - struct_offset;
+        for(std::size_t o = begin; o < end; o++) {
+            auto from = source[struct_offset];
+            output[o] = from < 0 ? std::byte() : input[struct_start + static_cast<std::size_t>(from)];
+            if(++struct_offset == this->struct_size) {
+                struct_offset = 0;
+                struct_start += this->struct_size;
+            }
+        }
+    }
+
+    void BulkSwap::swap(const std::byte *input, std::byte *output, std::size_t count) const {
+        if(this->convert_each) {
+            return this->convert_each(input, output, count);
+        }
+
+        // Shuffle what we can, then do whatever's left one byte at a time
+        std::size_t length = count * this->struct_size;
+        auto [begin, end] = shuffle_blocks(input, output, length, this->masks);
+        this->swap_bytes(input, output, 0, begin);
+        this->swap_bytes(input, output, end, length);
+    }
+}
@@ -18,6 +18,7 @@ set(INVADER_PARSER_FILES
     "${CMAKE_CURRENT_BINARY_DIR}/parser-scan-padding.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/bitfield.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/enum.cpp"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/invader/tag/parser/view.hpp"
 )
 
 # Sound stuff
@@ -33,6 +34,7 @@ if(${INVADER_USE_AUDIO})
         src/sound/sound_reader_ogg.cpp
         src/sound/sound_reader_wav.cpp
         src/sound/sound_reader_xbox_adpcm.cpp
+        src/sound/sound_resampler.cpp
         src/sound/adpcm_xq/adpcm-lib.c
     )
 else()
@@ -68,13 +70,17 @@ set(INVADER_SOURCE_FILES
 
     src/error.cpp
     src/hek/fourcc.cpp
+    src/hek/bulk_swap.cpp
     src/hek/data_type.cpp
     src/hek/map.cpp
     src/resource/resource_map.cpp
+    src/dependency/dependency_index.cpp
     src/dependency/found_tag_dependency.cpp
     src/map/map.cpp
     src/map/tag.cpp
     src/file/file.cpp
+    src/file/tag_batch.cpp
+    src/file/tag_index.cpp
     src/build/build_workload.cpp
     src/build/build_workload_dedupe.cpp
     src/bitmap/swizzle.cpp
@@ -84,16 +90,19 @@ set(INVADER_SOURCE_FILES
     src/bitmap/sprite.cpp
     src/error_handler/error_handler.cpp
     src/model/jms.cpp
+    src/model/triangle_strip.cpp
     src/script/compiler.cpp
     src/script/script_tree.cpp
     src/script/tokenizer.cpp
     src/compress/compression.cpp
     src/tag/hek/header.cpp
     src/tag/hek/class/bitmap.cpp
+    src/tag/hek/class/model_collision_geometry/bsp_query.cpp
     src/tag/hek/class/model_collision_geometry/intersection_check.cpp
     src/tag/hek/class/model_collision_geometry/model_collision_geometry.cpp
     src/extract/extraction.cpp
     src/tag/parser/parser_struct.cpp
+    src/tag/parser/view.cpp
     src/tag/parser/post_cache_deformat.cpp
     src/tag/parser/compile/actor.cpp
     src/tag/parser/compile/antenna.cpp
@@ -160,7 +169,7 @@ add_custom_target(invader-header-version
     SOURCES "${CMAKE_CURRENT_BINARY_DIR}/version_str.hpp"
 )
 add_custom_target(invader-header-gen
-    SOURCES "${CMAKE_CURRENT_SOURCE_DIR}/include/invader/tag/hek/definition.hpp" "${CMAKE_CURRENT_SOURCE_DIR}/include/invader/tag/parser/parser.hpp"
+    SOURCES "${CMAKE_CURRENT_SOURCE_DIR}/include/invader/tag/hek/definition.hpp" "${CMAKE_CURRENT_SOURCE_DIR}/include/invader/tag/parser/parser.hpp" "${CMAKE_CURRENT_SOURCE_DIR}/include/invader/tag/parser/view.hpp"
 )
 add_dependencies(invader invader-header-gen invader-header-version)
 
@@ -1,14 +1,23 @@
 #include "actions.hpp"
+#include "baker.hpp"
+#include "binary_mesh.hpp"
 
 #include <invader/file/file.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/map/map.hpp>
+#include <invader/bitmap/bitmap_encode.hpp>
+#include <invader/bitmap/pixel.hpp>
+#include <invader/tag/hek/class/bitmap.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <map>
 
 using namespace Invader;
+namespace BinaryMesh = Invader::Lightmap::BinaryMesh;
 
 static constexpr const std::size_t MESH_FORMAT_VERSION = 1;
 
@@ -17,6 +26,10 @@ struct ExportedVertex {
     float i, j, k;
 };
 
+struct ExportedLightmapVertex {
+    float u, v;
+};
+
 struct ExportedTriangle {
     std::size_t material;
     std::size_t a, b, c;
@@ -42,6 +55,8 @@ struct ExportedMaterial {
 struct ExportedLightmap {
     std::size_t first_triangle_index;
     std::size_t triangle_count;
+    std::size_t bitmap;
+    bool has_lightmap_vertices;
 };
 
 struct ExportedModel {
@@ -49,6 +64,7 @@ struct ExportedModel {
     std::vector<ExportedMaterial> materials;
     std::vector<ExportedTriangle> triangles;
     std::vector<ExportedVertex> vertices;
+    std::vector<ExportedLightmapVertex> lightmap_vertices; // BSPs only; one for each vertex
     std::vector<ExportedLightmap> lightmaps;
 };
 
@@ -126,12 +142,21 @@ static ExportedModel read_bsp(const Tag &tag, std::vector<ExportedMaterial> &mat
         std::size_t materials_count = lightmap.materials.count;
         const Parser::ScenarioStructureBSPMaterial::struct_little *materials = reinterpret_cast<const Parser::ScenarioStructureBSPMaterial::struct_little *>(tag.data(lightmap.materials.pointer, sizeof(*materials) * materials_count));
         auto first_triangle_index_this_lightmap = exported_model.triangles.size();
+        bool has_lightmap_vertices = true;
         
         // Go through each lightmap
         for(std::size_t m = 0; m < materials_count; m++) {
             auto &material = materials[m];
             std::size_t rendered_vertices_count = material.rendered_vertices_count;
-            const Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little *uncompressed_vertices = reinterpret_cast<const Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little *>(tag.data(material.uncompressed_vertices.pointer, sizeof(*uncompressed_vertices) * rendered_vertices_count));
+            std::size_t lightmap_vertices_count = material.lightmap_vertices_count;
+            if(lightmap_vertices_count != rendered_vertices_count) {
+                has_lightmap_vertices = false;
+                lightmap_vertices_count = 0;
+            }
+            
+            // Lightmap vertices come right after the rendered vertices
+            const Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little *uncompressed_vertices = reinterpret_cast<const Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little *>(tag.data(material.uncompressed_vertices.pointer, sizeof(*uncompressed_vertices) * rendered_vertices_count + sizeof(Parser::ScenarioStructureBSPMaterialUncompressedLightmapVertex::struct_little) * lightmap_vertices_count));
+            const Parser::ScenarioStructureBSPMaterialUncompressedLightmapVertex::struct_little *uncompressed_lightmap_vertices = reinterpret_cast<const Parser::ScenarioStructureBSPMaterialUncompressedLightmapVertex::struct_little *>(uncompressed_vertices + rendered_vertices_count);
             
             std::size_t material_index = add_shader_to_materials(map.get_tag(material.shader.tag_id.read().index), materials_arr);
             std::size_t offset = exported_model.vertices.size();
@@ -144,6 +169,15 @@ static ExportedModel read_bsp(const Tag &tag, std::vector<ExportedMaterial> &mat
                 vertex.i = uv.normal.i;
                 vertex.j = uv.normal.j;
                 vertex.k = uv.normal.k;
+                
+                auto &lightmap_vertex = exported_model.lightmap_vertices.emplace_back();
+                if(v < lightmap_vertices_count) {
+                    lightmap_vertex.u = uncompressed_lightmap_vertices[v].texture_coords.x;
+                    lightmap_vertex.v = uncompressed_lightmap_vertices[v].texture_coords.y;
+                }
+                else {
+                    lightmap_vertex = {};
+                }
             }
             
             std::size_t initial_surface = material.surfaces;
@@ -165,6 +199,8 @@ static ExportedModel read_bsp(const Tag &tag, std::vector<ExportedMaterial> &mat
             auto &lm = exported_model.lightmaps.emplace_back();
             lm.first_triangle_index = first_triangle_index_this_lightmap;
             lm.triangle_count = exported_model.triangles.size() - first_triangle_index_this_lightmap;
+            lm.bitmap = lightmap.bitmap;
+            lm.has_lightmap_vertices = has_lightmap_vertices;
         }
     }
     
@@ -323,21 +359,28 @@ template<typename GeometryStruct, typename PartStruct, typename ModelStruct> sta
     return exported_model;
 }
 
-std::string Invader::Lightmap::export_lightmap_mesh(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
-    BuildWorkload::BuildParameters parameters;
-    parameters.verbosity = BuildWorkload::BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET;
-    parameters.tags_directories = tags_directories;
-    parameters.scenario = scenario;
-    parameters.details.build_compress = false;
-    
-    std::vector<std::string> lines;
+struct ExportedScene {
     std::vector<ExportedMaterial> materials;
     std::vector<ExportedModel> models;
     std::vector<ExportedModel> bsps;
     std::vector<ExportedObject> objects;
     std::vector<ExportedSky> skies;
+    std::string lightmaps_bitmap_path;
+};
+
+static ExportedScene read_scene(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
+    BuildWorkload::BuildParameters parameters;
+    parameters.verbosity = BuildWorkload::BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET;
+    parameters.tags_directories = tags_directories;
+    parameters.scenario = scenario;
+    parameters.details.build_compress = false;
     
-#define ADD_LINE(...) lines.emplace_back(__VA_ARGS__)
+    ExportedScene scene;
+    auto &materials = scene.materials;
+    auto &models = scene.models;
+    auto &bsps = scene.bsps;
+    auto &objects = scene.objects;
+    auto &skies = scene.skies;
     
     try {
         auto map = Map::map_with_move(BuildWorkload::compile_map(parameters));
@@ -367,6 +410,11 @@ std::string Invader::Lightmap::export_lightmap_mesh(const char *scenario, const
             if(std::strcmp(bsp_tag_name, bsp_name) == 0) {
                 bsp_index = b;
                 bsps.emplace_back(read_bsp(bsp_tag, materials, skies)); // add the BSP
+                
+                auto lightmaps_bitmap_id = bsp_tag.get_base_struct<HEK::ScenarioStructureBSP>().lightmaps_bitmap.tag_id.read();
+                if(!lightmaps_bitmap_id.is_null()) {
+                    scene.lightmaps_bitmap_path = map.get_tag(lightmaps_bitmap_id.index).get_path();
+                }
                 break;
             }
         }
@@ -449,6 +497,20 @@ std::string Invader::Lightmap::export_lightmap_mesh(const char *scenario, const
         std::exit(EXIT_FAILURE);
     }
     
+    return scene;
+}
+
+static std::string write_text_mesh(const ExportedScene &scene) {
+    auto &materials = scene.materials;
+    auto &models = scene.models;
+    auto &bsps = scene.bsps;
+    auto &objects = scene.objects;
+    auto &skies = scene.skies;
+    
+    std::vector<std::string> lines;
+    
+#define ADD_LINE(...) lines.emplace_back(__VA_ARGS__)
+    
     auto float_to_str = [](const auto &f) -> std::string {
         std::string fstr = std::to_string(f);
         
@@ -465,12 +527,6 @@ std::string Invader::Lightmap::export_lightmap_mesh(const char *scenario, const
     // Put the version in it
     ADD_LINE("version 1 unbaked");
     
-    // Check skies
-    if(skies.size() > 1) {
-        eprintf_error("Only 1 sky per BSP is currently allowed maximum for this operation");
-        std::exit(EXIT_FAILURE);
-    }
-    
     // Add skies
     for(auto &s : skies) {
         ADD_LINE(std::string("sky \"") + s.path + "\" " + float_to_str(s.outdoor_power) + " " + float_to_str(s.outdoor_red) + " " + float_to_str(s.outdoor_green) + " " + float_to_str(s.outdoor_blue) + " {");
@@ -523,12 +579,193 @@ std::string Invader::Lightmap::export_lightmap_mesh(const char *scenario, const
     return str;
 }
 
+/**
+ * Build a binary mesh, laying out each array after the header in order
+ */
+class BinaryMeshWriter {
+public:
+    BinaryMeshWriter(std::uint32_t flags) {
+        this->header.magic = BinaryMesh::MAGIC;
+        this->header.version = BinaryMesh::VERSION;
+        this->header.flags = flags;
+        this->header.reserved = 0;
+    }
+    
+    BinaryMesh::String add_string(const std::string &string) {
+        BinaryMesh::String s;
+        s.offset = static_cast<std::uint32_t>(this->strings.size());
+        s.length = static_cast<std::uint32_t>(string.size());
+        this->strings.insert(this->strings.end(), reinterpret_cast<const std::byte *>(string.data()), reinterpret_cast<const std::byte *>(string.data() + string.size()));
+        return s;
+    }
+    
+    std::vector<BinaryMesh::Sky> skies;
+    std::vector<BinaryMesh::SkyLight> sky_lights;
+    std::vector<BinaryMesh::Material> materials;
+    std::vector<BinaryMesh::Model> models;
+    std::vector<BinaryMesh::Vertex> vertices;
+    std::vector<BinaryMesh::LightmapVertex> lightmap_vertices;
+    std::vector<BinaryMesh::Triangle> triangles;
+    std::vector<BinaryMesh::Lightmap> lightmaps;
+    std::vector<BinaryMesh::Object> objects;
+    std::vector<BinaryMesh::Texel> texels;
+    
+    std::vector<std::byte> finish() {
+        std::vector<std::byte> output(sizeof(this->header));
+        auto add_array = [&output](BinaryMesh::Array &array, const auto &elements, std::size_t element_size) {
+            output.resize((output.size() + 3) / 4 * 4);
+            array.offset = static_cast<std::uint32_t>(output.size());
+            array.count = static_cast<std::uint32_t>(elements.size());
+            auto *first = reinterpret_cast<const std::byte *>(elements.data());
+            output.insert(output.end(), first, first + elements.size() * element_size);
+        };
+        
+        add_array(this->header.strings, this->strings, 1);
+        add_array(this->header.skies, this->skies, sizeof(this->skies[0]));
+        add_array(this->header.sky_lights, this->sky_lights, sizeof(this->sky_lights[0]));
+        add_array(this->header.materials, this->materials, sizeof(this->materials[0]));
+        add_array(this->header.models, this->models, sizeof(this->models[0]));
+        add_array(this->header.vertices, this->vertices, sizeof(this->vertices[0]));
+        add_array(this->header.lightmap_vertices, this->lightmap_vertices, sizeof(this->lightmap_vertices[0]));
+        add_array(this->header.triangles, this->triangles, sizeof(this->triangles[0]));
+        add_array(this->header.lightmaps, this->lightmaps, sizeof(this->lightmaps[0]));
+        add_array(this->header.objects, this->objects, sizeof(this->objects[0]));
+        add_array(this->header.texels, this->texels, sizeof(this->texels[0]));
+        
+        std::memcpy(output.data(), &this->header, sizeof(this->header));
+        return output;
+    }
+    
+private:
+    BinaryMesh::Header header;
+    std::vector<std::byte> strings;
+};
+
+static std::vector<std::byte> write_binary_mesh(const ExportedScene &scene) {
+    BinaryMeshWriter writer(0);
+    
+    for(auto &s : scene.skies) {
+        auto &sky = writer.skies.emplace_back();
+        sky.path = writer.add_string(s.path);
+        sky.first_light = static_cast<std::uint32_t>(writer.sky_lights.size());
+        sky.light_count = static_cast<std::uint32_t>(s.lights.size());
+        sky.outdoor_power = s.outdoor_power;
+        sky.outdoor_red = s.outdoor_red;
+        sky.outdoor_green = s.outdoor_green;
+        sky.outdoor_blue = s.outdoor_blue;
+        for(auto &l : s.lights) {
+            auto &light = writer.sky_lights.emplace_back();
+            light.power = l.power;
+            light.red = l.red;
+            light.green = l.green;
+            light.blue = l.blue;
+            light.yaw = l.yaw;
+            light.pitch = l.pitch;
+        }
+    }
+    
+    for(auto &m : scene.materials) {
+        auto &material = writer.materials.emplace_back();
+        material.path = writer.add_string(m.path);
+        material.type = static_cast<std::uint32_t>(m.type);
+        material.power = m.power;
+        material.emission_red = m.emission_red;
+        material.emission_green = m.emission_green;
+        material.emission_blue = m.emission_blue;
+    }
+    
+    auto write_model = [&writer](const ExportedModel &m, bool bsp) {
+        auto &model = writer.models.emplace_back();
+        model.path = writer.add_string(m.path);
+        model.flags = bsp ? static_cast<std::uint32_t>(BinaryMesh::MODEL_FLAG_BSP) : 0;
+        model.first_vertex = static_cast<std::uint32_t>(writer.vertices.size());
+        model.vertex_count = static_cast<std::uint32_t>(m.vertices.size());
+        model.first_lightmap_vertex = static_cast<std::uint32_t>(writer.lightmap_vertices.size());
+        model.lightmap_vertex_count = static_cast<std::uint32_t>(m.lightmap_vertices.size());
+        model.first_triangle = static_cast<std::uint32_t>(writer.triangles.size());
+        model.triangle_count = static_cast<std::uint32_t>(m.triangles.size());
+        model.first_lightmap = static_cast<std::uint32_t>(writer.lightmaps.size());
+        model.lightmap_count = static_cast<std::uint32_t>(m.lightmaps.size());
+        
+        for(auto &v : m.vertices) {
+            auto &vertex = writer.vertices.emplace_back();
+            vertex.x = v.x;
+            vertex.y = v.y;
+            vertex.z = v.z;
+            vertex.i = v.i;
+            vertex.j = v.j;
+            vertex.k = v.k;
+        }
+        for(auto &v : m.lightmap_vertices) {
+            auto &vertex = writer.lightmap_vertices.emplace_back();
+            vertex.u = v.u;
+            vertex.v = v.v;
+        }
+        for(auto &t : m.triangles) {
+            auto &triangle = writer.triangles.emplace_back();
+            triangle.a = static_cast<std::uint32_t>(t.a);
+            triangle.b = static_cast<std::uint32_t>(t.b);
+            triangle.c = static_cast<std::uint32_t>(t.c);
+            triangle.material = static_cast<std::uint32_t>(t.material);
+        }
+        for(auto &l : m.lightmaps) {
+            auto &lightmap = writer.lightmaps.emplace_back();
+            lightmap.first_triangle = static_cast<std::uint32_t>(l.first_triangle_index);
+            lightmap.triangle_count = static_cast<std::uint32_t>(l.triangle_count);
+            lightmap.bitmap = static_cast<std::uint32_t>(l.bitmap);
+            lightmap.width = 0;
+            lightmap.height = 0;
+            lightmap.first_texel = 0;
+            lightmap.texel_count = 0;
+        }
+    };
+    
+    for(auto &m : scene.bsps) {
+        write_model(m, true);
+    }
+    
+    for(auto &m : scene.models) {
+        write_model(m, false);
+    }
+    
+    for(auto &o : scene.objects) {
+        auto &object = writer.objects.emplace_back();
+        object.model = static_cast<std::uint32_t>(o.model);
+        object.x = o.x;
+        object.y = o.y;
+        object.z = o.z;
+        object.yaw = o.yaw;
+        object.pitch = o.pitch;
+        object.roll = o.roll;
+    }
+    
+    return writer.finish();
+}
+
+std::vector<std::byte> Invader::Lightmap::export_lightmap_mesh(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories, bool text) {
+    auto scene = read_scene(scenario, bsp_name, tags_directories);
+    
+    // Check skies
+    if(scene.skies.size() > 1) {
+        eprintf_error("Only 1 sky per BSP is currently allowed maximum for this operation");
+        std::exit(EXIT_FAILURE);
+    }
+    
+    if(!text) {
+        return write_binary_mesh(scene);
+    }
+    
+    auto str = write_text_mesh(scene);
+    auto *data = reinterpret_cast<const std::byte *>(str.data());
+    return std::vector<std::byte>(data, data + str.size());
+}
+
 struct ImportedBSPVertex {
     float u, v;
 };
 
 struct ImportedBSPTriangle {
-    std::size_t vertices[3];
+    std::size_t a, b, c;
 };
 
 struct ImportedBSPLightmap {
@@ -543,9 +780,9 @@ struct ImportedBSP {
     std::vector<ImportedBSPLightmap> lightmaps;
 };
     
-void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const std::filesystem::path &mesh_path, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
-    auto size = mesh_data.size();
-    auto *data = mesh_data.data();
+template<typename Vertex, typename Triangle, typename Lightmap> static std::string import_lightmap_uvs(const std::string &mesh_bsp_path, const Vertex *vertices, std::size_t vertex_count, const Triangle *imported_triangles_all, std::size_t triangle_count, const Lightmap *lightmaps, std::size_t lightmap_count, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories);
+
+static void import_text_mesh(const char *data, std::size_t size, const std::filesystem::path &mesh_path, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
     auto *data_end = data + size;
     
     const char *token_start = nullptr;
@@ -728,18 +965,25 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
         std::exit(EXIT_FAILURE);
     }
     
-    // Bounds checking
     auto &bsp = bsps[0];
-    for(auto &t : bsp.triangles) {
-        for(auto &v : t.vertices) {
-            if(v >= bsp.vertices.size()) {
+    import_lightmap_uvs(bsp.path, bsp.vertices.data(), bsp.vertices.size(), bsp.triangles.data(), bsp.triangles.size(), bsp.lightmaps.data(), bsp.lightmaps.size(), scenario, bsp_name, tags_directories);
+}
+
+template<typename Vertex, typename Triangle, typename Lightmap> static std::string import_lightmap_uvs(const std::string &mesh_bsp_path, const Vertex *vertices, std::size_t vertex_count, const Triangle *imported_triangles_all, std::size_t triangle_count, const Lightmap *lightmaps, std::size_t lightmap_count, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
+    // Bounds checking
+    for(std::size_t t = 0; t < triangle_count; t++) {
+        auto &triangle = imported_triangles_all[t];
+        for(std::size_t v : { static_cast<std::size_t>(triangle.a), static_cast<std::size_t>(triangle.b), static_cast<std::size_t>(triangle.c) }) {
+            if(v >= vertex_count) {
                 eprintf_error("Input mesh has an out-of-bounds vertex");
                 std::exit(EXIT_FAILURE);
             }
         }
     }
-    for(auto &l : bsp.lightmaps) {
-        if(l.first_triangle >= bsp.triangles.size() || bsp.triangles.size() - l.first_triangle < l.triangle_count) {
+    for(std::size_t l = 0; l < lightmap_count; l++) {
+        std::size_t first_triangle = lightmaps[l].first_triangle;
+        std::size_t lightmap_triangle_count = lightmaps[l].triangle_count;
+        if(first_triangle >= triangle_count || triangle_count - first_triangle < lightmap_triangle_count) {
             eprintf_error("Input mesh has an out-of-bounds lightmap");
             std::exit(EXIT_FAILURE);
         }
@@ -789,8 +1033,8 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
         eprintf_error("Scenario tag does not have a BSP named %s", bsp_name);
         std::exit(EXIT_FAILURE);
     }
-    if(bsp_path != bsp.path) {
-        eprintf_error("Input mesh refers to a different BSP tag (\"%s\", not \"%s\")", bsp.path.c_str(), bsp_path->c_str());
+    if(bsp_path != mesh_bsp_path) {
+        eprintf_error("Input mesh refers to a different BSP tag (\"%s\", not \"%s\")", mesh_bsp_path.c_str(), bsp_path->c_str());
         std::exit(EXIT_FAILURE);
     }
     
@@ -819,13 +1063,13 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
     }
     
     // UVs
-    auto *uvs = bsp.vertices.data();
-    auto *tris = bsp.triangles.data();
+    auto *uvs = vertices;
+    auto *tris = imported_triangles_all;
     
     // Check this stuff
     auto *bsp_surfaces = scenario_bsp->surfaces.data();
     auto bsp_surface_count = scenario_bsp->surfaces.size();
-    if(bsp.triangles.size() > bsp_surface_count) {
+    if(triangle_count > bsp_surface_count) {
         eprintf_error("BSP mismatch: Incorrect number of triangles");
         std::exit(EXIT_FAILURE);
     }
@@ -835,7 +1079,7 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
         if(lm.bitmap == NULL_INDEX) {
             continue;
         }
-        if(lm.bitmap >= bsp.lightmaps.size()) {
+        if(lm.bitmap >= lightmap_count) {
             eprintf_error("BSP mismatch: Incorrect number of lightmaps");
             std::exit(EXIT_FAILURE);
         }
@@ -859,6 +1103,10 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
                 eprintf_error("BSP surfaces are out of bounds");
                 std::exit(EXIT_FAILURE);
             }
+            if(last_surface > triangle_count) {
+                eprintf_error("BSP mismatch: Incorrect number of triangles");
+                std::exit(EXIT_FAILURE);
+            }
             
             auto *triangles = bsp_surfaces + first_surface;
             auto *triangles_end = bsp_surfaces + last_surface;
@@ -883,15 +1131,15 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
                 };
                 
                 // Do this
-                dupe_it_all_to_hell(t->vertex0_index, imported_triangles->vertices[0]);
-                dupe_it_all_to_hell(t->vertex1_index, imported_triangles->vertices[1]);
-                dupe_it_all_to_hell(t->vertex2_index, imported_triangles->vertices[2]);
+                dupe_it_all_to_hell(t->vertex0_index, imported_triangles->a);
+                dupe_it_all_to_hell(t->vertex1_index, imported_triangles->b);
+                dupe_it_all_to_hell(t->vertex2_index, imported_triangles->c);
             }
             
             // Insert the stuff
             mat.rendered_vertices_count = uncompressed_vertices_duped.size();
             mat.rendered_vertices_offset = 0;
-            mat.uncompressed_vertices = std::vector<std::byte>(reinterpret_cast<std::byte *>(uncompressed_vertices_duped.data()), reinterpret_cast<std::byte *>(uncompressed_vertices_duped.data() + mat.rendered_vertices_count));
+            mat.uncompressed_vertices.assign(reinterpret_cast<std::byte *>(uncompressed_vertices_duped.data()), reinterpret_cast<std::byte *>(uncompressed_vertices_duped.data() + mat.rendered_vertices_count));
             
             mat.lightmap_vertices_count = uncompressed_lightmap_vertices_duped.size();
             mat.lightmap_vertices_offset = mat.uncompressed_vertices.size();
@@ -900,4 +1148,411 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
     }
     
     File::save_file(*bsp_path_file, scenario_bsp->generate_hek_tag_data(HEK::TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP));
+    
+    return scenario_bsp->lightmaps_bitmap.path;
+}
+
+static Lightmap::BakeVector angles_to_direction(float yaw, float pitch) noexcept {
+    return { std::cos(pitch) * std::cos(yaw), std::cos(pitch) * std::sin(yaw), std::sin(pitch) };
+}
+
+static std::vector<Lightmap::BakeVector> make_lightmap_image(const Lightmap::BakeTexel *texels, const Lightmap::BakeVector *light, std::size_t texel_count, std::size_t width, std::size_t height) {
+    std::vector<Lightmap::BakeVector> colors(width * height);
+    std::vector<bool> set(width * height);
+    for(std::size_t t = 0; t < texel_count; t++) {
+        auto index = texels[t].y * width + texels[t].x;
+        colors[index] = light[t];
+        set[index] = true;
+    }
+    
+    // Bleed the edges of each chart out so bilinear filtering and mipmaps don't pull in black
+    static constexpr std::size_t DILATION_PASSES = 8;
+    for(std::size_t p = 0; p < DILATION_PASSES; p++) {
+        auto colors_before = colors;
+        auto set_before = set;
+        for(std::size_t y = 0; y < height; y++) {
+            for(std::size_t x = 0; x < width; x++) {
+                if(set_before[y * width + x]) {
+                    continue;
+                }
+                Lightmap::BakeVector sum = {};
+                std::size_t count = 0;
+                for(std::size_t ny = (y > 0 ? y - 1 : y); ny <= y + 1 && ny < height; ny++) {
+                    for(std::size_t nx = (x > 0 ? x - 1 : x); nx <= x + 1 && nx < width; nx++) {
+                        if(set_before[ny * width + nx]) {
+                            for(std::size_t c = 0; c < 3; c++) {
+                                sum[c] += colors_before[ny * width + nx][c];
+                            }
+                            count++;
+                        }
+                    }
+                }
+                if(count) {
+                    for(std::size_t c = 0; c < 3; c++) {
+                        colors[y * width + x][c] = sum[c] / count;
+                    }
+                    set[y * width + x] = true;
+                }
+            }
+        }
+    }
+    
+    return colors;
+}
+
+static std::vector<Pixel> make_lightmap_pixels(std::vector<Lightmap::BakeVector> colors, std::size_t width, std::size_t height, std::size_t mipmap_count) {
+    auto to_pixel = [](const Lightmap::BakeVector &color) -> Pixel {
+        auto to_channel = [](float value) -> std::uint8_t {
+            return static_cast<std::uint8_t>(std::clamp(value * 255.0F + 0.5F, 0.0F, 255.0F));
+        };
+        return { to_channel(color[2]), to_channel(color[1]), to_channel(color[0]), 0xFF };
+    };
+    
+    std::vector<Pixel> pixels;
+    for(auto &c : colors) {
+        pixels.emplace_back(to_pixel(c));
+    }
+    
+    // Box filter each mipmap from the one before it
+    for(std::size_t m = 0; m < mipmap_count; m++) {
+        std::size_t mip_width = std::max<std::size_t>(width / 2, 1);
+        std::size_t mip_height = std::max<std::size_t>(height / 2, 1);
+        std::vector<Lightmap::BakeVector> mip_colors(mip_width * mip_height);
+        for(std::size_t y = 0; y < mip_height; y++) {
+            for(std::size_t x = 0; x < mip_width; x++) {
+                auto &color = mip_colors[y * mip_width + x];
+                for(std::size_t sy = y * 2; sy < std::min(y * 2 + 2, height); sy++) {
+                    for(std::size_t sx = x * 2; sx < std::min(x * 2 + 2, width); sx++) {
+                        for(std::size_t c = 0; c < 3; c++) {
+                            color[c] += colors[sy * width + sx][c];
+                        }
+                    }
+                }
+                float samples = static_cast<float>((std::min(y * 2 + 2, height) - y * 2) * (std::min(x * 2 + 2, width) - x * 2));
+                for(std::size_t c = 0; c < 3; c++) {
+                    color[c] /= samples;
+                }
+                pixels.emplace_back(to_pixel(color));
+            }
+        }
+        colors = std::move(mip_colors);
+        width = mip_width;
+        height = mip_height;
+    }
+    
+    return pixels;
+}
+
+struct LightmapsBitmap {
+    std::filesystem::path file_path;
+    std::unique_ptr<Parser::ParserStruct> tag;
+    Parser::Bitmap *bitmap;
+};
+
+static LightmapsBitmap open_lightmaps_bitmap(const std::string &tag_path, const std::vector<std::filesystem::path> &tags_directories) {
+    LightmapsBitmap lightmaps_bitmap;
+    
+    auto bitmap_path = tag_path + ".bitmap";
+    auto bitmap_path_file = File::tag_path_to_file_path(bitmap_path, tags_directories);
+    if(!bitmap_path_file.has_value()) {
+        eprintf_error("Cannot find lightmaps bitmap tag %s", bitmap_path.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    lightmaps_bitmap.file_path = *bitmap_path_file;
+    
+    auto bitmap_data = File::open_file(*bitmap_path_file);
+    if(!bitmap_data.has_value()) {
+        eprintf_error("Failed to open lightmaps bitmap. Make sure you have read permission!");
+        std::exit(EXIT_FAILURE);
+    }
+    
+    try {
+        lightmaps_bitmap.tag = Parser::ParserStruct::parse_hek_tag_file(bitmap_data->data(), bitmap_data->size());
+        lightmaps_bitmap.bitmap = dynamic_cast<Parser::Bitmap *>(lightmaps_bitmap.tag.get());
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to parse lightmaps bitmap: %s", e.what());
+        std::exit(EXIT_FAILURE);
+    }
+    if(!lightmaps_bitmap.bitmap) {
+        eprintf_error("%s is not a bitmap tag", bitmap_path.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    
+    return lightmaps_bitmap;
+}
+
+static void write_lightmap(Parser::Bitmap &bitmap, std::size_t index, std::vector<Lightmap::BakeVector> colors) {
+    auto &data = bitmap.bitmap_data[index];
+    switch(data.format) {
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8:
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_X8R8G8B8:
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_R5G6B5:
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A1R5G5B5:
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A4R4G4B4:
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
+        case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
+            break;
+        default:
+            eprintf_error("Lightmap bitmap #%zu uses an unsupported format (%s)", index, HEK::bitmap_data_format_name(data.format));
+            std::exit(EXIT_FAILURE);
+    }
+    
+    // Write it in the format it already uses
+    auto pixels = make_lightmap_pixels(std::move(colors), data.width, data.height, data.mipmap_count);
+    auto encoded = BitmapEncode::encode_bitmap(reinterpret_cast<const std::byte *>(pixels.data()), HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, data.format, data.width, data.height, 1, data.type, data.mipmap_count);
+    
+    std::size_t offset = data.pixel_data_offset;
+    if(encoded.size() != data.pixel_data_size || offset > bitmap.processed_pixel_data.size() || bitmap.processed_pixel_data.size() - offset < encoded.size()) {
+        eprintf_error("Lightmap bitmap #%zu pixel data is the wrong size", index);
+        std::exit(EXIT_FAILURE);
+    }
+    std::memcpy(bitmap.processed_pixel_data.data() + offset, encoded.data(), encoded.size());
+}
+
+static void save_lightmaps_bitmap(const LightmapsBitmap &lightmaps_bitmap) {
+    if(!File::save_file(lightmaps_bitmap.file_path, lightmaps_bitmap.bitmap->generate_hek_tag_data(HEK::TagFourCC::TAG_FOURCC_BITMAP))) {
+        eprintf_error("Failed to save %s", lightmaps_bitmap.file_path.string().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    oprintf_success("Saved %s", lightmaps_bitmap.file_path.string().c_str());
+}
+
+void Invader::Lightmap::bake_lightmaps(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories, std::size_t sample_count, std::size_t thread_count) {
+    auto scene = read_scene(scenario, bsp_name, tags_directories);
+    auto &bsp = scene.bsps[0];
+    
+    if(scene.skies.size() > 1) {
+        eprintf_error("Only 1 sky per BSP is currently allowed maximum for this operation");
+        std::exit(EXIT_FAILURE);
+    }
+    if(scene.lightmaps_bitmap_path.empty()) {
+        eprintf_error("BSP %s does not reference a lightmaps bitmap", bsp_name);
+        std::exit(EXIT_FAILURE);
+    }
+    
+    // Add everything that blocks or emits light
+    BakeScene bake_scene;
+    auto add_triangles = [&bake_scene, &scene](const ExportedModel &model, const auto &transform) {
+        for(auto &t : model.triangles) {
+            auto &material = scene.materials[t.material];
+            if(material.type != ExportedMaterialType::EXPORTED_MATERIAL_TYPE_OPAQUE) {
+                continue;
+            }
+            auto &triangle = bake_scene.triangles.emplace_back();
+            triangle.a = transform(model.vertices[t.a]);
+            triangle.b = transform(model.vertices[t.b]);
+            triangle.c = transform(model.vertices[t.c]);
+            triangle.emission = { material.emission_red * material.power, material.emission_green * material.power, material.emission_blue * material.power };
+        }
+    };
+    
+    add_triangles(bsp, [](const ExportedVertex &v) -> BakeVector {
+        return { v.x, v.y, v.z };
+    });
+    
+    for(auto &o : scene.objects) {
+        // Rotate by yaw, then pitch, then roll
+        auto forward = angles_to_direction(o.yaw, o.pitch);
+        BakeVector left = { -std::sin(o.yaw), std::cos(o.yaw), 0.0F };
+        BakeVector up = { -std::sin(o.pitch) * std::cos(o.yaw), -std::sin(o.pitch) * std::sin(o.yaw), std::cos(o.pitch) };
+        float roll_cos = std::cos(o.roll), roll_sin = std::sin(o.roll);
+        BakeVector rolled_left, rolled_up;
+        for(std::size_t c = 0; c < 3; c++) {
+            rolled_left[c] = left[c] * roll_cos + up[c] * roll_sin;
+            rolled_up[c] = up[c] * roll_cos - left[c] * roll_sin;
+        }
+        
+        add_triangles(scene.models[o.model], [&forward, &rolled_left, &rolled_up, &o](const ExportedVertex &v) -> BakeVector {
+            return {
+                forward[0] * v.x + rolled_left[0] * v.y + rolled_up[0] * v.z + o.x,
+                forward[1] * v.x + rolled_left[1] * v.y + rolled_up[1] * v.z + o.y,
+                forward[2] * v.x + rolled_left[2] * v.y + rolled_up[2] * v.z + o.z
+            };
+        });
+    }
+    
+    for(auto &s : scene.skies) {
+        for(auto &l : s.lights) {
+            bake_scene.lights.push_back({ angles_to_direction(l.yaw, l.pitch), { l.red * l.power, l.green * l.power, l.blue * l.power } });
+        }
+        bake_scene.ambient = { s.outdoor_red * s.outdoor_power, s.outdoor_green * s.outdoor_power, s.outdoor_blue * s.outdoor_power };
+    }
+    
+    // Open the lightmaps bitmap
+    auto lightmaps_bitmap = open_lightmaps_bitmap(scene.lightmaps_bitmap_path, tags_directories);
+    auto *bitmap = lightmaps_bitmap.bitmap;
+    
+    // Find which texels each lightmap covers, using the BSP's lightmap UVs and the sizes of the bitmaps it already has
+    struct LightmapTexels {
+        std::size_t bitmap;
+        std::size_t first_texel;
+        std::size_t texel_count;
+    };
+    std::vector<LightmapTexels> lightmap_texels;
+    std::vector<BakeTexel> texels;
+    
+    for(auto &lm : bsp.lightmaps) {
+        if(!lm.has_lightmap_vertices) {
+            eprintf_error("BSP %s does not have lightmap UVs to bake onto; use --export-mesh and --import-mesh instead", bsp_name);
+            std::exit(EXIT_FAILURE);
+        }
+        if(lm.bitmap >= bitmap->bitmap_data.size()) {
+            eprintf_error("BSP mismatch: Lightmap bitmap #%zu is out of bounds", lm.bitmap);
+            std::exit(EXIT_FAILURE);
+        }
+        auto &data = bitmap->bitmap_data[lm.bitmap];
+        if(data.type != HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE || data.width == 0 || data.height == 0) {
+            eprintf_error("Lightmap bitmap #%zu is not a 2D texture", lm.bitmap);
+            std::exit(EXIT_FAILURE);
+        }
+        
+        std::vector<BakeSurfaceTriangle> surface_triangles;
+        for(std::size_t t = lm.first_triangle_index; t < lm.first_triangle_index + lm.triangle_count; t++) {
+            auto &triangle = bsp.triangles[t];
+            auto &surface_triangle = surface_triangles.emplace_back();
+            std::size_t corners[3] = { triangle.a, triangle.b, triangle.c };
+            for(std::size_t c = 0; c < 3; c++) {
+                auto &vertex = bsp.vertices[corners[c]];
+                auto &lightmap_vertex = bsp.lightmap_vertices[corners[c]];
+                surface_triangle[c] = { { vertex.x, vertex.y, vertex.z }, { vertex.i, vertex.j, vertex.k }, lightmap_vertex.u, lightmap_vertex.v };
+            }
+        }
+        
+        auto lightmap_texels_found = rasterize_texels(surface_triangles, data.width, data.height);
+        lightmap_texels.push_back({ lm.bitmap, texels.size(), lightmap_texels_found.size() });
+        texels.insert(texels.end(), lightmap_texels_found.begin(), lightmap_texels_found.end());
+    }
+    
+    oprintf("Baking %zu texel%s in %zu lightmap%s (%zu triangle%s)\n", texels.size(), texels.size() == 1 ? "" : "s", lightmap_texels.size(), lightmap_texels.size() == 1 ? "" : "s", bake_scene.triangles.size(), bake_scene.triangles.size() == 1 ? "" : "s");
+    auto light = bake_texels(bake_scene, texels, sample_count, thread_count);
+    
+    // Write them into the bitmap
+    for(auto &lt : lightmap_texels) {
+        auto &data = bitmap->bitmap_data[lt.bitmap];
+        write_lightmap(*bitmap, lt.bitmap, make_lightmap_image(texels.data() + lt.first_texel, light.data() + lt.first_texel, lt.texel_count, data.width, data.height));
+    }
+    
+    save_lightmaps_bitmap(lightmaps_bitmap);
+}
+
+template<typename T> static const T *get_binary_mesh_array(const std::byte *data, std::size_t size, const BinaryMesh::Array &array, const char *name) {
+    std::size_t offset = array.offset;
+    std::size_t count = array.count;
+    if(offset % 4 != 0 || offset > size || (size - offset) / sizeof(T) < count) {
+        eprintf_error("Input mesh has an out-of-bounds %s array", name);
+        std::exit(EXIT_FAILURE);
+    }
+    return reinterpret_cast<const T *>(data + offset);
+}
+
+static void import_binary_mesh(const std::byte *data, std::size_t size, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
+    const auto &header = *reinterpret_cast<const BinaryMesh::Header *>(data);
+    if(header.version != BinaryMesh::VERSION) {
+        eprintf_error("Input mesh does not have a supported version");
+        std::exit(EXIT_FAILURE);
+    }
+    if(!(header.flags & BinaryMesh::HEADER_FLAG_BAKED)) {
+        eprintf_error("Input mesh is not baked");
+        std::exit(EXIT_FAILURE);
+    }
+    
+    // Everything is used in place
+    auto *strings = get_binary_mesh_array<char>(data, size, header.strings, "string");
+    auto *models = get_binary_mesh_array<BinaryMesh::Model>(data, size, header.models, "model");
+    auto *lightmap_vertices = get_binary_mesh_array<BinaryMesh::LightmapVertex>(data, size, header.lightmap_vertices, "lightmap vertex");
+    auto *triangles = get_binary_mesh_array<BinaryMesh::Triangle>(data, size, header.triangles, "triangle");
+    auto *lightmaps = get_binary_mesh_array<BinaryMesh::Lightmap>(data, size, header.lightmaps, "lightmap");
+    auto *texels = get_binary_mesh_array<BinaryMesh::Texel>(data, size, header.texels, "texel");
+    
+    auto check_range = [](std::size_t first, std::size_t count, std::size_t total, const char *name) {
+        if(first > total || total - first < count) {
+            eprintf_error("Input mesh has an out-of-bounds %s", name);
+            std::exit(EXIT_FAILURE);
+        }
+    };
+    
+    // Find the BSP
+    const BinaryMesh::Model *bsp = nullptr;
+    for(std::size_t m = 0; m < header.models.count; m++) {
+        if(models[m].flags & BinaryMesh::MODEL_FLAG_BSP) {
+            if(bsp) {
+                eprintf_error("Input mesh has more than 1 BSP (only 1 is supported at this time).");
+                std::exit(EXIT_FAILURE);
+            }
+            bsp = models + m;
+        }
+    }
+    if(!bsp) {
+        eprintf_error("Input mesh does have any BSPs.");
+        std::exit(EXIT_FAILURE);
+    }
+    
+    check_range(bsp->path.offset, bsp->path.length, header.strings.count, "string");
+    check_range(bsp->first_lightmap_vertex, bsp->lightmap_vertex_count, header.lightmap_vertices.count, "lightmap vertex range");
+    check_range(bsp->first_triangle, bsp->triangle_count, header.triangles.count, "triangle range");
+    check_range(bsp->first_lightmap, bsp->lightmap_count, header.lightmaps.count, "lightmap range");
+    
+    std::string bsp_path(strings + bsp->path.offset, bsp->path.length);
+    auto *bsp_lightmaps = lightmaps + bsp->first_lightmap;
+    std::size_t bsp_lightmap_count = bsp->lightmap_count;
+    auto lightmaps_bitmap_path = import_lightmap_uvs(bsp_path, lightmap_vertices + bsp->first_lightmap_vertex, bsp->lightmap_vertex_count, triangles + bsp->first_triangle, bsp->triangle_count, bsp_lightmaps, bsp_lightmap_count, scenario, bsp_name, tags_directories);
+    
+    // If it was baked with texels, write them to the bitmap, too
+    bool has_texels = false;
+    for(std::size_t l = 0; l < bsp_lightmap_count; l++) {
+        has_texels = has_texels || bsp_lightmaps[l].texel_count > 0;
+    }
+    if(!has_texels) {
+        return;
+    }
+    
+    if(lightmaps_bitmap_path.empty()) {
+        eprintf_error("BSP %s does not reference a lightmaps bitmap", bsp_name);
+        std::exit(EXIT_FAILURE);
+    }
+    auto lightmaps_bitmap = open_lightmaps_bitmap(lightmaps_bitmap_path, tags_directories);
+    auto &bitmap = *lightmaps_bitmap.bitmap;
+    
+    for(std::size_t l = 0; l < bsp_lightmap_count; l++) {
+        auto &lightmap = bsp_lightmaps[l];
+        std::size_t texel_count = lightmap.texel_count;
+        if(texel_count == 0) {
+            continue;
+        }
+        
+        std::size_t width = lightmap.width;
+        std::size_t height = lightmap.height;
+        std::size_t bitmap_index = lightmap.bitmap;
+        check_range(lightmap.first_texel, texel_count, header.texels.count, "texel range");
+        if(bitmap_index >= bitmap.bitmap_data.size()) {
+            eprintf_error("BSP mismatch: Lightmap #%zu uses bitmap #%zu, which is out of bounds", l, bitmap_index);
+            std::exit(EXIT_FAILURE);
+        }
+        auto &data = bitmap.bitmap_data[bitmap_index];
+        if(texel_count != width * height || data.type != HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE || data.width != width || data.height != height) {
+            eprintf_error("Lightmap #%zu is %zux%zu, but bitmap #%zu is %zux%zu", l, width, height, bitmap_index, static_cast<std::size_t>(data.width), static_cast<std::size_t>(data.height));
+            std::exit(EXIT_FAILURE);
+        }
+        
+        std::vector<Lightmap::BakeVector> colors(texel_count);
+        auto *lightmap_texels = texels + lightmap.first_texel;
+        for(std::size_t t = 0; t < texel_count; t++) {
+            colors[t] = { lightmap_texels[t].red, lightmap_texels[t].green, lightmap_texels[t].blue };
+        }
+        write_lightmap(bitmap, bitmap_index, std::move(colors));
+    }
+    
+    save_lightmaps_bitmap(lightmaps_bitmap);
+}
+
+void Invader::Lightmap::import_lightmap_mesh(const std::vector<std::byte> &mesh_data, const std::filesystem::path &mesh_path, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
+    // Binary meshes start with a magic number; anything else is a text mesh
+    if(mesh_data.size() >= sizeof(BinaryMesh::Header) && reinterpret_cast<const BinaryMesh::Header *>(mesh_data.data())->magic == BinaryMesh::MAGIC) {
+        import_binary_mesh(mesh_data.data(), mesh_data.size(), scenario, bsp_name, tags_directories);
+    }
+    else {
+        import_text_mesh(reinterpret_cast<const char *>(mesh_data.data()), mesh_data.size(), mesh_path, scenario, bsp_name, tags_directories);
+    }
 }
@@ -1,13 +1,15 @@
 #ifndef INVADER__LIGHTMAP__LIGHTMAP_HPP
 #define INVADER__LIGHTMAP__LIGHTMAP_HPP
 
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <filesystem>
 
 namespace Invader::Lightmap {
-    std::string export_lightmap_mesh(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories);
-    void import_lightmap_mesh(const std::string &mesh_data, const std::filesystem::path &mesh_path, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories);
+    std::vector<std::byte> export_lightmap_mesh(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories, bool text);
+    void import_lightmap_mesh(const std::vector<std::byte> &mesh_data, const std::filesystem::path &mesh_path, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories);
+    void bake_lightmaps(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories, std::size_t sample_count, std::size_t thread_count);
 }
 
 #endif
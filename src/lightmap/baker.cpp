@@ -0,0 +1,509 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+#include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
+
+#include "baker.hpp"
+
+namespace Invader::Lightmap {
+    namespace {
+        // How far to move points off of a surface before tracing rays from them, in world units
+        static constexpr float SURFACE_OFFSET = 0.001F;
+
+        // Fraction of light reflected by surfaces for the bounce (we don't sample the shaders' textures)
+        static constexpr float ALBEDO = 0.5F;
+
+        // Texels baked per thread pool task
+        static constexpr std::size_t TEXELS_PER_TASK = 1024;
+
+        // Triangles per BVH leaf before it's worth splitting, and the number of bins to evaluate splits with
+        static constexpr std::size_t BVH_LEAF_SIZE = 2;
+        static constexpr std::size_t BVH_BIN_COUNT = 16;
+
+        // Deepest a BVH can go (this bounds the traversal stack)
+        static constexpr std::size_t BVH_MAX_DEPTH = 60;
+
+        BakeVector operator+(const BakeVector &a, const BakeVector &b) noexcept {
+            return { a[0] + b[0], a[1] + b[1], a[2] + b[2] };
+        }
+
+        BakeVector operator-(const BakeVector &a, const BakeVector &b) noexcept {
+            return { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+        }
+
+        BakeVector operator*(const BakeVector &a, float b) noexcept {
+            return { a[0] * b, a[1] * b, a[2] * b };
+        }
+
+        float dot(const BakeVector &a, const BakeVector &b) noexcept {
+            return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        }
+
+        BakeVector cross(const BakeVector &a, const BakeVector &b) noexcept {
+            return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+        }
+
+        BakeVector normalize(const BakeVector &a) noexcept {
+            float length = std::sqrt(dot(a, a));
+            return length > 0.0F ? a * (1.0F / length) : a;
+        }
+
+        BakeVector face_normal(const BakeTriangle &triangle) noexcept {
+            return normalize(cross(triangle.b - triangle.a, triangle.c - triangle.a));
+        }
+
+        // Small counter-based RNG so every sample can be seeded independently of which thread bakes it
+        class SampleRandom {
+        public:
+            SampleRandom(std::uint64_t texel, std::uint64_t sample) noexcept : state(texel * 0x9E3779B97F4A7C15ULL ^ (sample + 1) * 0xD1B54A32D192ED03ULL) {}
+
+            float next() noexcept {
+                std::uint64_t z = (this->state += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                z ^= z >> 31;
+                return static_cast<float>(z >> 40) * (1.0F / static_cast<float>(1ULL << 24));
+            }
+
+        private:
+            std::uint64_t state;
+        };
+
+        struct Bounds {
+            BakeVector min = { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
+            BakeVector max = { -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+
+            void add(const BakeVector &point) noexcept {
+                for(std::size_t i = 0; i < 3; i++) {
+                    this->min[i] = std::min(this->min[i], point[i]);
+                    this->max[i] = std::max(this->max[i], point[i]);
+                }
+            }
+
+            void add(const Bounds &bounds) noexcept {
+                for(std::size_t i = 0; i < 3; i++) {
+                    this->min[i] = std::min(this->min[i], bounds.min[i]);
+                    this->max[i] = std::max(this->max[i], bounds.max[i]);
+                }
+            }
+
+            float surface_area() const noexcept {
+                auto size = this->max - this->min;
+                if(size[0] < 0.0F) {
+                    return 0.0F;
+                }
+                return 2.0F * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+            }
+        };
+
+        struct RayHit {
+            float distance;
+            std::size_t triangle;
+        };
+
+        /**
+         * Bounding volume hierarchy built with binned SAH and stored flat. Interior nodes have their two children next to each other.
+         */
+        class BVH {
+        public:
+            BVH(const std::vector<BakeTriangle> &triangles) {
+                std::size_t triangle_count = triangles.size();
+                std::vector<Bounds> triangle_bounds(triangle_count);
+                std::vector<BakeVector> centroids(triangle_count);
+                std::vector<std::uint32_t> indices(triangle_count);
+                for(std::size_t t = 0; t < triangle_count; t++) {
+                    auto &triangle = triangles[t];
+                    triangle_bounds[t].add(triangle.a);
+                    triangle_bounds[t].add(triangle.b);
+                    triangle_bounds[t].add(triangle.c);
+                    centroids[t] = (triangle.a + triangle.b + triangle.c) * (1.0F / 3.0F);
+                    indices[t] = static_cast<std::uint32_t>(t);
+                }
+
+                struct BuildTask {
+                    std::size_t node;
+                    std::size_t begin;
+                    std::size_t end;
+                    std::size_t depth;
+                };
+
+                this->nodes.reserve(triangle_count * 2 + 1);
+                this->nodes.emplace_back();
+                std::vector<BuildTask> tasks = { { 0, 0, triangle_count, 0 } };
+
+                while(!tasks.empty()) {
+                    auto task = tasks.back();
+                    tasks.pop_back();
+
+                    Bounds bounds, centroid_bounds;
+                    for(std::size_t i = task.begin; i < task.end; i++) {
+                        bounds.add(triangle_bounds[indices[i]]);
+                        centroid_bounds.add(centroids[indices[i]]);
+                    }
+
+                    auto make_leaf = [this, &task, &bounds]() {
+                        auto &node = this->nodes[task.node];
+                        node.min = bounds.min;
+                        node.max = bounds.max;
+                        node.first = static_cast<std::uint32_t>(task.begin);
+                        node.count = static_cast<std::uint32_t>(task.end - task.begin);
+                    };
+
+                    std::size_t count = task.end - task.begin;
+                    if(count <= BVH_LEAF_SIZE || task.depth >= BVH_MAX_DEPTH) {
+                        make_leaf();
+                        continue;
+                    }
+
+                    // Find the cheapest split
+                    float best_cost = std::numeric_limits<float>::infinity();
+                    std::size_t best_axis = 0, best_bin = 0;
+                    for(std::size_t axis = 0; axis < 3; axis++) {
+                        float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+                        if(!(extent > 0.0F)) {
+                            continue;
+                        }
+                        float scale = BVH_BIN_COUNT / extent;
+
+                        Bounds bins[BVH_BIN_COUNT];
+                        std::size_t bin_counts[BVH_BIN_COUNT] = {};
+                        for(std::size_t i = task.begin; i < task.end; i++) {
+                            auto bin = std::min(static_cast<std::size_t>((centroids[indices[i]][axis] - centroid_bounds.min[axis]) * scale), BVH_BIN_COUNT - 1);
+                            bins[bin].add(triangle_bounds[indices[i]]);
+                            bin_counts[bin]++;
+                        }
+
+                        // Sweep from the right to get the cost of everything after each split, then from the left
+                        float right_costs[BVH_BIN_COUNT];
+                        Bounds right;
+                        std::size_t right_count = 0;
+                        for(std::size_t b = BVH_BIN_COUNT - 1; b > 0; b--) {
+                            right.add(bins[b]);
+                            right_count += bin_counts[b];
+                            right_costs[b] = right.surface_area() * right_count;
+                        }
+
+                        Bounds left;
+                        std::size_t left_count = 0;
+                        for(std::size_t b = 0; b < BVH_BIN_COUNT - 1; b++) {
+                            left.add(bins[b]);
+                            left_count += bin_counts[b];
+                            float cost = left.surface_area() * left_count + right_costs[b + 1];
+                            if(left_count > 0 && left_count < count && cost < best_cost) {
+                                best_cost = cost;
+                                best_axis = axis;
+                                best_bin = b;
+                            }
+                        }
+                    }
+
+                    // Stop if splitting isn't any better than testing every triangle
+                    if(!(best_cost < bounds.surface_area() * count)) {
+                        make_leaf();
+                        continue;
+                    }
+
+                    float extent = centroid_bounds.max[best_axis] - centroid_bounds.min[best_axis];
+                    float scale = BVH_BIN_COUNT / extent;
+                    auto *middle = std::partition(indices.data() + task.begin, indices.data() + task.end, [&](std::uint32_t index) {
+                        return std::min(static_cast<std::size_t>((centroids[index][best_axis] - centroid_bounds.min[best_axis]) * scale), BVH_BIN_COUNT - 1) <= best_bin;
+                    });
+                    std::size_t split = middle - indices.data();
+
+                    std::size_t left_node = this->nodes.size();
+                    this->nodes.emplace_back();
+                    this->nodes.emplace_back();
+
+                    auto &node = this->nodes[task.node];
+                    node.min = bounds.min;
+                    node.max = bounds.max;
+                    node.first = static_cast<std::uint32_t>(left_node);
+                    node.count = 0;
+
+                    tasks.push_back({ left_node + 1, split, task.end, task.depth + 1 });
+                    tasks.push_back({ left_node, task.begin, split, task.depth + 1 });
+                }
+
+                // Store triangles in leaf order so leaves read them sequentially
+                this->triangles.reserve(triangle_count);
+                for(auto i : indices) {
+                    auto &triangle = triangles[i];
+                    this->triangles.push_back({ triangle.a, triangle.b - triangle.a, triangle.c - triangle.a, i });
+                }
+            }
+
+            /**
+             * Trace a ray through the scene
+             * @param origin       origin of the ray
+             * @param direction    normalized direction of the ray
+             * @param max_distance maximum distance to check
+             * @param hit          if set, find the closest hit and store it here; otherwise stop at any hit
+             * @return             true if anything was hit
+             */
+            bool trace(const BakeVector &origin, const BakeVector &direction, float max_distance, RayHit *hit) const noexcept {
+                if(this->triangles.empty()) {
+                    return false;
+                }
+
+                BakeVector inverse_direction = { 1.0F / direction[0], 1.0F / direction[1], 1.0F / direction[2] };
+                float closest = max_distance;
+                bool found = false;
+
+                std::uint32_t stack[BVH_MAX_DEPTH + 2];
+                std::size_t stack_size = 0;
+                stack[stack_size++] = 0;
+
+                while(stack_size > 0) {
+                    auto &node = this->nodes[stack[--stack_size]];
+                    if(node.count > 0) {
+                        auto *triangle = this->triangles.data() + node.first;
+                        auto *triangle_end = triangle + node.count;
+                        for(; triangle < triangle_end; triangle++) {
+                            float distance;
+                            if(intersect_triangle(*triangle, origin, direction, closest, distance)) {
+                                if(!hit) {
+                                    return true;
+                                }
+                                closest = distance;
+                                hit->distance = distance;
+                                hit->triangle = triangle->index;
+                                found = true;
+                            }
+                        }
+                        continue;
+                    }
+
+                    // Visit the nearer child first
+                    auto &left = this->nodes[node.first];
+                    auto &right = this->nodes[node.first + 1];
+                    float left_distance = intersect_bounds(left, origin, inverse_direction, closest);
+                    float right_distance = intersect_bounds(right, origin, inverse_direction, closest);
+                    bool left_hit = left_distance < closest;
+                    bool right_hit = right_distance < closest;
+                    if(left_hit && right_hit) {
+                        if(left_distance <= right_distance) {
+                            stack[stack_size++] = node.first + 1;
+                            stack[stack_size++] = node.first;
+                        }
+                        else {
+                            stack[stack_size++] = node.first;
+                            stack[stack_size++] = node.first + 1;
+                        }
+                    }
+                    else if(left_hit) {
+                        stack[stack_size++] = node.first;
+                    }
+                    else if(right_hit) {
+                        stack[stack_size++] = node.first + 1;
+                    }
+                }
+
+                return found;
+            }
+
+        private:
+            struct Node {
+                BakeVector min;
+                std::uint32_t first;
+                BakeVector max;
+                std::uint32_t count;
+            };
+
+            struct Triangle {
+                BakeVector a, ab, ac;
+                std::uint32_t index;
+            };
+
+            std::vector<Node> nodes;
+            std::vector<Triangle> triangles;
+
+            static float intersect_bounds(const Node &node, const BakeVector &origin, const BakeVector &inverse_direction, float max_distance) noexcept {
+                float near = 0.0F, far = max_distance;
+                for(std::size_t i = 0; i < 3; i++) {
+                    float t0 = (node.min[i] - origin[i]) * inverse_direction[i];
+                    float t1 = (node.max[i] - origin[i]) * inverse_direction[i];
+                    if(t0 > t1) {
+                        std::swap(t0, t1);
+                    }
+                    near = t0 > near ? t0 : near;
+                    far = t1 < far ? t1 : far;
+                }
+                return near <= far ? near : std::numeric_limits<float>::infinity();
+            }
+
+            static bool intersect_triangle(const Triangle &triangle, const BakeVector &origin, const BakeVector &direction, float max_distance, float &distance) noexcept {
+                auto p = cross(direction, triangle.ac);
+                float determinant = dot(triangle.ab, p);
+                if(std::fabs(determinant) < 1.0E-12F) {
+                    return false;
+                }
+                float inverse_determinant = 1.0F / determinant;
+                auto t = origin - triangle.a;
+                float u = dot(t, p) * inverse_determinant;
+                if(u < 0.0F || u > 1.0F) {
+                    return false;
+                }
+                auto q = cross(t, triangle.ab);
+                float v = dot(direction, q) * inverse_determinant;
+                if(v < 0.0F || u + v > 1.0F) {
+                    return false;
+                }
+                distance = dot(triangle.ac, q) * inverse_determinant;
+                return distance > 0.0F && distance < max_distance;
+            }
+        };
+
+        // Light arriving directly from the scene's lights
+        BakeVector direct_light(const BakeScene &scene, const BVH &bvh, const BakeVector &position, const BakeVector &normal) noexcept {
+            BakeVector light = {};
+            for(auto &l : scene.lights) {
+                float cosine = dot(normal, l.direction);
+                if(cosine > 0.0F && !bvh.trace(position, l.direction, std::numeric_limits<float>::infinity(), nullptr)) {
+                    light = light + l.color * cosine;
+                }
+            }
+            return light;
+        }
+
+        // Light arriving from a random direction in the hemisphere (cosine weighted, so averaging samples gives the irradiance over pi)
+        BakeVector sample_hemisphere(const BakeScene &scene, const BVH &bvh, const BakeTexel &texel, SampleRandom &random) noexcept {
+            // Build a basis around the normal
+            auto &n = texel.normal;
+            float sign = std::copysign(1.0F, n[2]);
+            float a = -1.0F / (sign + n[2]);
+            float b = n[0] * n[1] * a;
+            BakeVector tangent = { 1.0F + sign * n[0] * n[0] * a, sign * b, -sign * n[0] };
+            BakeVector bitangent = { b, sign + n[1] * n[1] * a, -n[1] };
+
+            float r1 = random.next();
+            float r2 = random.next();
+            float radius = std::sqrt(r1);
+            float angle = 2.0F * std::numbers::pi_v<float> * r2;
+            auto direction = normalize(tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) + n * std::sqrt(std::max(0.0F, 1.0F - r1)));
+
+            RayHit hit = {};
+            if(!bvh.trace(texel.position, direction, std::numeric_limits<float>::infinity(), &hit)) {
+                return scene.ambient;
+            }
+
+            // Hit something; take its emission plus one bounce of the direct light on it
+            auto &triangle = scene.triangles[hit.triangle];
+            auto normal = face_normal(triangle);
+            if(dot(normal, direction) > 0.0F) {
+                normal = normal * -1.0F;
+            }
+            auto hit_position = texel.position + direction * hit.distance + normal * SURFACE_OFFSET;
+            return triangle.emission + direct_light(scene, bvh, hit_position, normal) * ALBEDO;
+        }
+    }
+
+    std::vector<BakeTexel> rasterize_texels(const std::vector<BakeSurfaceTriangle> &triangles, std::size_t width, std::size_t height) {
+        std::vector<BakeTexel> texels;
+        std::vector<bool> covered(width * height);
+
+        for(auto &triangle : triangles) {
+            float x[3], y[3];
+            for(std::size_t i = 0; i < 3; i++) {
+                x[i] = triangle[i].u * width;
+                y[i] = triangle[i].v * height;
+            }
+
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if(!(std::fabs(area) > 1.0E-12F)) {
+                continue;
+            }
+
+            auto geometric_normal = face_normal({ triangle[0].position, triangle[1].position, triangle[2].position, {} });
+
+            // Go through every texel center in the bounding box
+            auto min_x = static_cast<long>(std::floor(std::max(std::min({ x[0], x[1], x[2] }), 0.0F)));
+            auto min_y = static_cast<long>(std::floor(std::max(std::min({ y[0], y[1], y[2] }), 0.0F)));
+            auto max_x = static_cast<long>(std::ceil(std::min(std::max({ x[0], x[1], x[2] }), static_cast<float>(width))));
+            auto max_y = static_cast<long>(std::ceil(std::min(std::max({ y[0], y[1], y[2] }), static_cast<float>(height))));
+
+            for(long py = min_y; py < max_y; py++) {
+                for(long px = min_x; px < max_x; px++) {
+                    std::size_t texel_index = static_cast<std::size_t>(py) * width + static_cast<std::size_t>(px);
+                    if(covered[texel_index]) {
+                        continue;
+                    }
+
+                    float cx = px + 0.5F, cy = py + 0.5F;
+                    float w0 = ((x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy)) / area;
+                    float w1 = ((x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy)) / area;
+                    float w2 = 1.0F - w0 - w1;
+                    if(w0 < 0.0F || w1 < 0.0F || w2 < 0.0F) {
+                        continue;
+                    }
+
+                    auto normal = normalize(triangle[0].normal * w0 + triangle[1].normal * w1 + triangle[2].normal * w2);
+                    if(!(dot(normal, normal) > 0.0F)) {
+                        normal = geometric_normal;
+                    }
+
+                    // Move off of the surface on the side the normal faces
+                    auto offset = dot(geometric_normal, normal) < 0.0F ? geometric_normal * -SURFACE_OFFSET : geometric_normal * SURFACE_OFFSET;
+                    auto position = triangle[0].position * w0 + triangle[1].position * w1 + triangle[2].position * w2 + offset;
+
+                    covered[texel_index] = true;
+                    texels.push_back({ position, normal, static_cast<std::uint32_t>(px), static_cast<std::uint32_t>(py) });
+                }
+            }
+        }
+
+        return texels;
+    }
+
+    std::vector<BakeVector> bake_texels(const BakeScene &scene, const std::vector<BakeTexel> &texels, std::size_t sample_count, std::size_t thread_count) {
+        BVH bvh(scene.triangles);
+
+        std::size_t texel_count = texels.size();
+        std::vector<BakeVector> direct(texel_count);
+        std::vector<BakeVector> indirect(texel_count);
+
+        ThreadPool pool(thread_count);
+        auto run_tasks = [&pool, &texel_count](auto &&bake_range) {
+            std::vector<std::future<void>> tasks;
+            for(std::size_t begin = 0; begin < texel_count; begin += TEXELS_PER_TASK) {
+                std::size_t end = std::min(begin + TEXELS_PER_TASK, texel_count);
+                tasks.emplace_back(pool.submit([&bake_range, begin, end]() { bake_range(begin, end); }));
+            }
+            pool.wait_all(tasks);
+        };
+
+        // Direct light doesn't need more than one sample since it comes from one direction
+        run_tasks([&](std::size_t begin, std::size_t end) {
+            for(std::size_t t = begin; t < end; t++) {
+                direct[t] = direct_light(scene, bvh, texels[t].position, texels[t].normal);
+            }
+        });
+
+        // Then progressively add hemisphere samples
+        for(std::size_t first_sample = 0; first_sample < sample_count; first_sample += BAKE_SAMPLES_PER_PASS) {
+            std::size_t last_sample = std::min(first_sample + BAKE_SAMPLES_PER_PASS, sample_count);
+            run_tasks([&](std::size_t begin, std::size_t end) {
+                for(std::size_t t = begin; t < end; t++) {
+                    auto sum = indirect[t];
+                    for(std::size_t s = first_sample; s < last_sample; s++) {
+                        SampleRandom random(t, s);
+                        sum = sum + sample_hemisphere(scene, bvh, texels[t], random);
+                    }
+                    indirect[t] = sum;
+                }
+            });
+            oprintf("Baked %zu / %zu samples\n", last_sample, sample_count);
+        }
+
+        std::vector<BakeVector> light(texel_count);
+        float scale = sample_count > 0 ? 1.0F / sample_count : 0.0F;
+        for(std::size_t t = 0; t < texel_count; t++) {
+            light[t] = direct[t] + indirect[t] * scale;
+        }
+        return light;
+    }
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__LIGHTMAP__BAKER_HPP
+#define INVADER__LIGHTMAP__BAKER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Invader::Lightmap {
+    using BakeVector = std::array<float, 3>;
+
+    /** Number of samples per texel taken in each progressive pass */
+    static constexpr std::size_t BAKE_SAMPLES_PER_PASS = 16;
+
+    /**
+     * Opaque world space triangle that blocks light (and emits it if emission is non-zero)
+     */
+    struct BakeTriangle {
+        BakeVector a, b, c;
+        BakeVector emission;
+    };
+
+    /**
+     * Directional light (such as a sky light)
+     */
+    struct BakeLight {
+        /** Normalized direction towards the light */
+        BakeVector direction;
+
+        /** Color multiplied by power */
+        BakeVector color;
+    };
+
+    /**
+     * Everything that's lit or casts light
+     */
+    struct BakeScene {
+        std::vector<BakeTriangle> triangles;
+        std::vector<BakeLight> lights;
+
+        /** Light coming from anywhere rays escape the scene (ambient color multiplied by power) */
+        BakeVector ambient = {};
+    };
+
+    /**
+     * Vertex of a triangle being rasterized into a lightmap
+     */
+    struct BakeSurfaceVertex {
+        BakeVector position;
+        BakeVector normal;
+        float u, v;
+    };
+
+    /**
+     * Triangle being rasterized into a lightmap
+     */
+    using BakeSurfaceTriangle = std::array<BakeSurfaceVertex, 3>;
+
+    /**
+     * Lightmap texel to bake
+     */
+    struct BakeTexel {
+        BakeVector position;
+        BakeVector normal;
+        std::uint32_t x, y;
+    };
+
+    /**
+     * Find the texels covered by the triangles. If more than one triangle covers a texel, the first one is used.
+     * @param triangles triangles to rasterize
+     * @param width     width of the lightmap in texels
+     * @param height    height of the lightmap in texels
+     * @return          covered texels
+     */
+    std::vector<BakeTexel> rasterize_texels(const std::vector<BakeSurfaceTriangle> &triangles, std::size_t width, std::size_t height);
+
+    /**
+     * Bake the incoming light of each texel, tracing rays through a BVH of the scene on a thread pool.
+     *
+     * Texels are baked in progressive passes of BAKE_SAMPLES_PER_PASS samples. Each sample is seeded from its texel and sample index, so the
+     * result does not depend on the thread count, and the first N samples are the same regardless of how many are taken in total.
+     *
+     * @param scene        scene to bake
+     * @param texels       texels to bake
+     * @param sample_count number of hemisphere samples per texel
+     * @param thread_count number of threads to use
+     * @return             light of each texel
+     */
+    std::vector<BakeVector> bake_texels(const BakeScene &scene, const std::vector<BakeTexel> &texels, std::size_t sample_count, std::size_t thread_count);
+}
+
+#endif
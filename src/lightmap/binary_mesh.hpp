@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__LIGHTMAP__BINARY_MESH_HPP
+#define INVADER__LIGHTMAP__BINARY_MESH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <invader/hek/endian.hpp>
+
+/**
+ * Binary lightmap mesh format
+ *
+ * Everything is little endian. The file starts with a Header, which points to flat arrays elsewhere in the file by byte offset and element
+ * count, so a reader can use the arrays in place (such as from a memory mapped file) without parsing anything. Arrays are 4-byte aligned.
+ *
+ * An unbaked mesh (written by --export-mesh) has everything in it. A baked mesh only needs the BSP's model, its lightmap vertices and
+ * triangles, and its lightmaps; if a lightmap has texels, they're written into the lightmaps bitmap on import.
+ */
+namespace Invader::Lightmap::BinaryMesh {
+    using HEK::LittleEndian;
+
+    /** "LMSH" */
+    static constexpr std::uint32_t MAGIC = 0x48534D4C;
+
+    /** Version of the binary format (2 added Lightmap::bitmap) */
+    static constexpr std::uint32_t VERSION = 2;
+
+    enum HeaderFlags : std::uint32_t {
+        /** The mesh was baked */
+        HEADER_FLAG_BAKED = 1 << 0
+    };
+
+    enum ModelFlags : std::uint32_t {
+        /** The model is the BSP being lightmapped */
+        MODEL_FLAG_BSP = 1 << 0
+    };
+
+    /** Material index of triangles in a baked mesh, which don't need one */
+    static constexpr std::uint32_t NULL_MATERIAL = 0xFFFFFFFF;
+
+    /** Array stored somewhere in the file */
+    struct Array {
+        LittleEndian<std::uint32_t> offset;
+        LittleEndian<std::uint32_t> count;
+    };
+    static_assert(sizeof(Array) == 0x8);
+
+    /** UTF-8 string stored in the strings array (not null terminated) */
+    struct String {
+        LittleEndian<std::uint32_t> offset;
+        LittleEndian<std::uint32_t> length;
+    };
+    static_assert(sizeof(String) == 0x8);
+
+    struct Header {
+        LittleEndian<std::uint32_t> magic;
+        LittleEndian<std::uint32_t> version;
+        LittleEndian<std::uint32_t> flags;
+        LittleEndian<std::uint32_t> reserved;
+
+        /** Array of bytes */
+        Array strings;
+
+        /** Array of Sky */
+        Array skies;
+
+        /** Array of SkyLight */
+        Array sky_lights;
+
+        /** Array of Material */
+        Array materials;
+
+        /** Array of Model */
+        Array models;
+
+        /** Array of Vertex */
+        Array vertices;
+
+        /** Array of LightmapVertex */
+        Array lightmap_vertices;
+
+        /** Array of Triangle */
+        Array triangles;
+
+        /** Array of Lightmap */
+        Array lightmaps;
+
+        /** Array of Object */
+        Array objects;
+
+        /** Array of Texel */
+        Array texels;
+    };
+    static_assert(sizeof(Header) == 0x68);
+
+    struct Sky {
+        String path;
+        LittleEndian<std::uint32_t> first_light;
+        LittleEndian<std::uint32_t> light_count;
+        LittleEndian<float> outdoor_power;
+        LittleEndian<float> outdoor_red;
+        LittleEndian<float> outdoor_green;
+        LittleEndian<float> outdoor_blue;
+    };
+    static_assert(sizeof(Sky) == 0x20);
+
+    struct SkyLight {
+        LittleEndian<float> power;
+        LittleEndian<float> red;
+        LittleEndian<float> green;
+        LittleEndian<float> blue;
+        LittleEndian<float> yaw;
+        LittleEndian<float> pitch;
+    };
+    static_assert(sizeof(SkyLight) == 0x18);
+
+    struct Material {
+        String path;
+
+        /** 0 = opaque, 1 = invisible */
+        LittleEndian<std::uint32_t> type;
+        LittleEndian<float> power;
+        LittleEndian<float> emission_red;
+        LittleEndian<float> emission_green;
+        LittleEndian<float> emission_blue;
+    };
+    static_assert(sizeof(Material) == 0x1C);
+
+    /**
+     * Model. Triangles and lightmaps are relative to first_triangle; triangle vertex indices are relative to first_vertex, or to
+     * first_lightmap_vertex if the mesh is baked.
+     */
+    struct Model {
+        String path;
+        LittleEndian<std::uint32_t> flags;
+        LittleEndian<std::uint32_t> first_vertex;
+        LittleEndian<std::uint32_t> vertex_count;
+        LittleEndian<std::uint32_t> first_lightmap_vertex;
+        LittleEndian<std::uint32_t> lightmap_vertex_count;
+        LittleEndian<std::uint32_t> first_triangle;
+        LittleEndian<std::uint32_t> triangle_count;
+        LittleEndian<std::uint32_t> first_lightmap;
+        LittleEndian<std::uint32_t> lightmap_count;
+    };
+    static_assert(sizeof(Model) == 0x2C);
+
+    struct Vertex {
+        LittleEndian<float> x, y, z;
+        LittleEndian<float> i, j, k;
+    };
+    static_assert(sizeof(Vertex) == 0x18);
+
+    struct LightmapVertex {
+        LittleEndian<float> u, v;
+    };
+    static_assert(sizeof(LightmapVertex) == 0x8);
+
+    struct Triangle {
+        LittleEndian<std::uint32_t> a, b, c;
+        LittleEndian<std::uint32_t> material;
+    };
+    static_assert(sizeof(Triangle) == 0x10);
+
+    /**
+     * Lightmap. If texel_count is non-zero, it must be width * height, and the texels are stored in rows starting at the top left.
+     */
+    struct Lightmap {
+        LittleEndian<std::uint32_t> first_triangle;
+        LittleEndian<std::uint32_t> triangle_count;
+
+        /** Index of the bitmap in the lightmaps bitmap tag that the texels are written to */
+        LittleEndian<std::uint32_t> bitmap;
+
+        LittleEndian<std::uint32_t> width;
+        LittleEndian<std::uint32_t> height;
+        LittleEndian<std::uint32_t> first_texel;
+        LittleEndian<std::uint32_t> texel_count;
+    };
+    static_assert(sizeof(Lightmap) == 0x1C);
+
+    struct Object {
+        LittleEndian<std::uint32_t> model;
+        LittleEndian<float> x, y, z;
+        LittleEndian<float> yaw, pitch, roll;
+    };
+    static_assert(sizeof(Object) == 0x1C);
+
+    /** Linear light color of a texel */
+    struct Texel {
+        LittleEndian<float> red, green, blue;
+    };
+    static_assert(sizeof(Texel) == 0xC);
+}
+
+#endif
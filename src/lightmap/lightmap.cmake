@@ -8,6 +8,7 @@ if(${INVADER_LIGHTMAP})
     add_executable(invader-lightmap
         src/lightmap/lightmap.cpp
         src/lightmap/actions.cpp
+        src/lightmap/baker.cpp
     )
     target_link_libraries(invader-lightmap invader)
 
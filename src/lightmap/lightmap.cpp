@@ -9,12 +9,14 @@
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
 #include <invader/version.hpp>
+#include <invader/thread_pool.hpp>
 
 #include "actions.hpp"
 
 enum LightmapMode {
     LIGHTMAP_EXPORT,
-    LIGHTMAP_IMPORT
+    LIGHTMAP_IMPORT,
+    LIGHTMAP_BAKE
 };
 
 int main(int argc, const char **argv) {
@@ -25,21 +27,28 @@ int main(int argc, const char **argv) {
         std::vector<std::filesystem::path> tags;
         //std::filesystem::path data = "data";
         bool filesystem_path = false;
+        bool text_mesh = false;
         std::filesystem::path data = "data";
         
         std::optional<LightmapMode> mode;
+        std::size_t samples = 64;
+        std::size_t max_threads = ThreadPool::default_thread_count();
     } shadowmouse_options;
     
     std::vector<CommandLineOption> options = {
         CommandLineOption("tags", 't', 1, "Use the specified tags directory. Additional tags directories can be specified for searching shaders, but the tag will be output to the first one.", "<dir>"),
         CommandLineOption("data", 'd', 1, "Use the specified data directory.", "<dir>"),
         CommandLineOption("export-mesh", 'E', 0, "Export a lightmap mesh to be imported and baked using an external program."),
-        CommandLineOption("import-mesh", 'I', 0, "Import a lightmap mesh that was baked."),
+        CommandLineOption("import-mesh", 'I', 0, "Import a lightmap mesh that was baked. Binary and text meshes are both accepted."),
+        CommandLineOption("text-mesh", 'T', 0, "Export the lightmap mesh as text instead of binary. This is much larger and slower, and is meant for debugging."),
+        CommandLineOption("bake", 'B', 0, "Bake the lightmaps directly into the BSP's lightmaps bitmap. The BSP must already have lightmap UVs."),
+        CommandLineOption("samples", 's', 1, "Set the number of samples per texel to take when baking, taken 16 at a time. Default: 64", "<#>"),
+        CommandLineOption("threads", 'j', 1, "Set the number of threads to use when baking. Default: CPU thread count", "<#>"),
         CommandLineOption("fs-path", 'P', 0, "Use a filesystem path for the tag."),
         CommandLineOption("info", 'i', 0, "Show credits, source info, and other info.")
     };
 
-    static constexpr char DESCRIPTION[] = "Generate meshes to bake lightmaps using Blender's Cycles renderer.";
+    static constexpr char DESCRIPTION[] = "Bake lightmaps, or generate meshes to bake lightmaps using Blender's Cycles renderer.";
     static constexpr char USAGE[] = "<options> <scenario-path> <bsp-name>";
 
     auto remaining_arguments = Invader::CommandLineOption::parse_arguments<LightmapOptions &>(argc, argv, options, USAGE, DESCRIPTION, 2, 2, shadowmouse_options, [](char opt, const auto &args, LightmapOptions &shadowmouse_options) {
@@ -56,9 +65,41 @@ int main(int argc, const char **argv) {
             case 'E':
                 shadowmouse_options.mode = LightmapMode::LIGHTMAP_EXPORT;
                 break;
+            case 'B':
+                shadowmouse_options.mode = LightmapMode::LIGHTMAP_BAKE;
+                break;
+            case 's':
+                try {
+                    auto samples = std::stoi(args[0]);
+                    if(samples < 0) {
+                        throw std::exception();
+                    }
+                    shadowmouse_options.samples = static_cast<std::size_t>(samples);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of samples %s", args[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':
+                try {
+                    auto threads = std::stoi(args[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    shadowmouse_options.max_threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", args[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
             case 'P':
                 shadowmouse_options.filesystem_path = true;
                 break;
+            case 'T':
+                shadowmouse_options.text_mesh = true;
+                break;
             case 'i':
                 show_version_info();
                 std::exit(EXIT_SUCCESS);
@@ -99,10 +140,8 @@ int main(int argc, const char **argv) {
     
     switch(*shadowmouse_options.mode) {
         case LightmapMode::LIGHTMAP_EXPORT: {
-            auto output = export_lightmap_mesh(scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags);
-            auto *data = reinterpret_cast<const std::byte *>(output.c_str());
-            auto *data_end = data + output.size();
-            if(!File::save_file(mesh_file, std::vector<std::byte>(data, data_end))) {
+            auto output = export_lightmap_mesh(scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags, shadowmouse_options.text_mesh);
+            if(!File::save_file(mesh_file, output)) {
                 eprintf_error("Failed to save %s", mesh_file.string().c_str());
                 return EXIT_FAILURE;
             }
@@ -110,10 +149,16 @@ int main(int argc, const char **argv) {
             break;
         }
         case LightmapMode::LIGHTMAP_IMPORT: {
-            auto input_bytes = Invader::File::open_file(mesh_file).value();
-            auto input = std::string(reinterpret_cast<const char *>(input_bytes.data()), input_bytes.size());
-            import_lightmap_mesh(input, mesh_file, scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags);
+            auto input = Invader::File::open_file(mesh_file);
+            if(!input.has_value()) {
+                eprintf_error("Failed to open %s", mesh_file.string().c_str());
+                return EXIT_FAILURE;
+            }
+            import_lightmap_mesh(*input, mesh_file, scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags);
             break;
         }
+        case LightmapMode::LIGHTMAP_BAKE:
+            bake_lightmaps(scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags, shadowmouse_options.samples, shadowmouse_options.max_threads);
+            break;
     }
 }
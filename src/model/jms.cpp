@@ -1,15 +1,14 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 #include <invader/model/jms.hpp>
 
 namespace Invader {
-#define SET_CURSOR const char *cursor = next_character(string);
-#define SET_END    if(end != nullptr) { \
-                       *end = cursor; \
-                   }
-                
     static const char CRLF[] = "\r\n";
     static const char TAB[] = "\t";
     static const constexpr std::uint32_t JMS_VERSION = 8200;
@@ -48,72 +47,146 @@ namespace Invader {
         return str;
     }
     
-    // Skip to the next character that can be read
-    static const char *next_character(const char *string) {
-        if(string) {
-            while(*string == '\r' || *string == '\t' || *string == '\n') {
-                string++;
+    namespace {
+        /**
+         * Cursor over a JMS file's text. Everything is read in place in one pass; nothing is copied except for the strings that are kept.
+         */
+        struct JMSReader {
+            const char *cursor;
+            const char *end;
+            
+            JMSReader(const char *string, const char *end) : cursor(string), end(end) {
+                if(string == nullptr) {
+                    throw std::invalid_argument("null string given");
+                }
             }
-            if(*string == 0) {
-                throw std::invalid_argument("no character afterwards");
+            
+            static JMSReader from_c_string(const char *string) {
+                return JMSReader(string, string == nullptr ? nullptr : string + std::strlen(string));
             }
-            return string;
-        }
-        
-        throw std::invalid_argument("null string given");
-    }
-    
-    static std::string string_from_string(const char *&string, bool limit_31_characters) {
-        string = next_character(string);
-        const char *end_of_string = string;
-        while(*end_of_string && *end_of_string != '\r' && *end_of_string != '\n' && *end_of_string != '\t') {
-            end_of_string++;
-        }
-        
-        if(limit_31_characters && end_of_string - string > 31) {
-            throw std::out_of_range(std::string("maximum string length (") + std::to_string(end_of_string - string) + " > 31) exceeded");
-        }
-        
-        // Make a substring out of this
-        std::string value = std::string(string, end_of_string);
-        
-        // Strings get lowercased
-        for(auto &c : value) {
-            c = std::tolower(c);
-        }
-        
-        // Set pointer to end of this string
-        string = end_of_string;
-        
-        // Done!
-        return value;
-    }
-    
-    static float read_next_float(const char *&string) {
-        string = next_character(string);
-        auto *old_str = string;
-        float value = std::strtof(string, const_cast<char **>(&string));
-        if(old_str == string) {
-            auto string_copy = string;
-            throw std::invalid_argument("cannot convert string `" + string_from_string(string_copy, false) + "` to a number");
-        }
-        return value;
-    }
-    
-    static std::int32_t read_next_int32(const char *&string) {
-        string = next_character(string);
-        auto *old_str = string;
-        std::int32_t value = std::strtol(string, const_cast<char **>(&string), 10);
-        if(old_str == string) {
-            auto string_copy = string;
-            throw std::invalid_argument("cannot convert string `" + string_from_string(string_copy, false) + "` to an integer");
-        }
-        return value;
-    }
-    
-    static std::uint32_t read_next_uint32(const char *&string) {
-        std::uint32_t value = static_cast<std::uint32_t>(read_next_int32(string));
-        return value;
+            
+            // Skip to the next character that can be read
+            void next_character() {
+                while(this->cursor < this->end && (*this->cursor == '\r' || *this->cursor == '\t' || *this->cursor == '\n')) {
+                    this->cursor++;
+                }
+                if(this->cursor == this->end || *this->cursor == 0) {
+                    throw std::invalid_argument("no character afterwards");
+                }
+            }
+            
+            // Find the end of the current line/field
+            const char *end_of_field() const noexcept {
+                const char *end_of_string = this->cursor;
+                while(end_of_string < this->end && *end_of_string && *end_of_string != '\r' && *end_of_string != '\n' && *end_of_string != '\t') {
+                    end_of_string++;
+                }
+                return end_of_string;
+            }
+            
+            std::string read_string(bool limit_31_characters) {
+                this->next_character();
+                const char *end_of_string = this->end_of_field();
+                
+                if(limit_31_characters && end_of_string - this->cursor > 31) {
+                    throw std::out_of_range(std::string("maximum string length (") + std::to_string(end_of_string - this->cursor) + " > 31) exceeded");
+                }
+                
+                // Make a substring out of this
+                std::string value = std::string(this->cursor, end_of_string);
+                
+                // Strings get lowercased
+                for(auto &c : value) {
+                    c = std::tolower(c);
+                }
+                
+                // Set pointer to end of this string
+                this->cursor = end_of_string;
+                
+                // Done!
+                return value;
+            }
+            
+            // Skip to the start of a number, returning where its digits start
+            const char *start_number() {
+                this->next_character();
+                while(this->cursor < this->end && *this->cursor == ' ') {
+                    this->cursor++;
+                }
+                return this->cursor < this->end && *this->cursor == '+' ? this->cursor + 1 : this->cursor;
+            }
+            
+            [[noreturn]] void throw_not_a_number(const char *what) const {
+                throw std::invalid_argument(std::string("cannot convert string `") + std::string(this->cursor, this->end_of_field()) + "` to " + what);
+            }
+            
+            float read_float() {
+                const char *start = this->start_number();
+                double value = 0.0;
+                auto result = std::from_chars(start, this->end, value);
+                if(result.ec == std::errc::invalid_argument) {
+                    this->throw_not_a_number("a number");
+                }
+                
+                // Too big or small for a double; let strtod saturate it like it used to
+                if(result.ec == std::errc::result_out_of_range) {
+                    value = std::strtod(std::string(start, result.ptr).c_str(), nullptr);
+                }
+                
+                this->cursor = result.ptr;
+                return static_cast<float>(value);
+            }
+            
+            std::int32_t read_int32() {
+                const char *start = this->start_number();
+                std::int64_t value = 0;
+                auto result = std::from_chars(start, this->end, value, 10);
+                if(result.ec == std::errc::invalid_argument) {
+                    this->throw_not_a_number("an integer");
+                }
+                if(result.ec == std::errc::result_out_of_range) {
+                    throw std::out_of_range("integer out of range");
+                }
+                this->cursor = result.ptr;
+                return static_cast<std::int32_t>(value);
+            }
+            
+            std::uint32_t read_uint32() {
+                return static_cast<std::uint32_t>(this->read_int32());
+            }
+            
+            HEK::Quaternion<HEK::NativeEndian> read_quaternion() {
+                HEK::Quaternion<HEK::NativeEndian> v;
+                v.i = this->read_float();
+                v.j = this->read_float();
+                v.k = this->read_float();
+                v.w = this->read_float();
+                return v;
+            }
+            
+            HEK::Vector3D<HEK::NativeEndian> read_vector3d() {
+                HEK::Vector3D<HEK::NativeEndian> v;
+                v.i = this->read_float();
+                v.j = this->read_float();
+                v.k = this->read_float();
+                return v;
+            }
+            
+            HEK::Point2D<HEK::NativeEndian> read_point2d() {
+                HEK::Point2D<HEK::NativeEndian> v;
+                v.x = this->read_float();
+                v.y = this->read_float();
+                return v;
+            }
+            
+            HEK::Point3D<HEK::NativeEndian> read_point3d() {
+                HEK::Point3D<HEK::NativeEndian> v;
+                v.x = this->read_float();
+                v.y = this->read_float();
+                v.z = this->read_float();
+                return v;
+            }
+        };
     }
     
     template <typename T> static std::string array_to_string(const std::vector<T> &vector) {
@@ -124,16 +197,6 @@ namespace Invader {
         return rval;
     }
     
-    template <typename T> static std::vector<T> array_from_string(const char *&string) {
-        std::vector<T> arr;
-        auto count = read_next_uint32(string);
-        arr.reserve(count);
-        for(std::size_t i = 0; i < count; i++) {
-            arr.emplace_back(T::from_string(string, &string));
-        }
-        return arr;
-    }
-    
     static std::string vector_to_string(const HEK::Vector3D<HEK::NativeEndian> &vector) {
         return precise_double_str(vector.i.read()) + TAB + precise_double_str(vector.j.read()) + TAB + precise_double_str(vector.k.read());
     }
@@ -150,62 +213,129 @@ namespace Invader {
         return precise_double_str(vector.i.read()) + TAB + precise_double_str(vector.j.read())+ TAB + precise_double_str(vector.k.read())+ TAB + precise_double_str(vector.w.read());
     }
     
-    static HEK::Quaternion<HEK::NativeEndian> quaternion_from_string(const char *&string) {
-        HEK::Quaternion<HEK::NativeEndian> v;
-        v.i = read_next_float(string);
-        v.j = read_next_float(string);
-        v.k = read_next_float(string);
-        v.w = read_next_float(string);
-        return v;
+    static JMS::Node read_node(JMSReader &reader) {
+        JMS::Node n;
+        n.name = reader.read_string(true);
+        n.first_child = reader.read_uint32();
+        n.sibling_node = reader.read_uint32();
+        n.rotation = reader.read_quaternion();
+        n.position = reader.read_point3d() / 100.0F;
+        return n;
     }
     
-    static HEK::Vector3D<HEK::NativeEndian> vector3d_from_string(const char *&string) {
-        HEK::Vector3D<HEK::NativeEndian> v;
-        v.i = read_next_float(string);
-        v.j = read_next_float(string);
-        v.k = read_next_float(string);
-        return v;
+    static JMS::Material read_material(JMSReader &reader) {
+        JMS::Material m;
+        m.name = reader.read_string(false);
+        m.tif_path = reader.read_string(false);
+        return m;
     }
     
-    static HEK::Point2D<HEK::NativeEndian> point2d_from_string(const char *&string) {
-        HEK::Point2D<HEK::NativeEndian> v;
-        v.x = read_next_float(string);
-        v.y = read_next_float(string);
-        return v;
+    static JMS::Marker read_marker(JMSReader &reader) {
+        JMS::Marker m;
+        m.name = reader.read_string(true);
+        m.region = reader.read_uint32();
+        if(m.region == NULL_INDEX) {
+            m.region = 0;
+        }
+        m.node = reader.read_uint32();
+        if(m.node == NULL_INDEX) {
+            m.node = 0;
+        }
+        m.rotation = reader.read_quaternion();
+        m.position = reader.read_point3d() / 100.0F;
+        m.radius = reader.read_float();
+        return m;
     }
     
-    static HEK::Point3D<HEK::NativeEndian> point3d_from_string(const char *&string) {
-        HEK::Point3D<HEK::NativeEndian> v;
-        v.x = read_next_float(string);
-        v.y = read_next_float(string);
-        v.z = read_next_float(string);
+    static JMS::Region read_region(JMSReader &reader) {
+        JMS::Region r;
+        r.name = reader.read_string(true);
+        return r;
+    }
+    
+    static JMS::Vertex read_vertex(JMSReader &reader) {
+        JMS::Vertex v;
+        v.node0 = reader.read_uint32();
+        v.position = reader.read_point3d() / 100.0F;
+        v.normal = reader.read_vector3d().normalize();
+        v.node1 = reader.read_uint32();
+        v.node1_weight = reader.read_float();
+        v.texture_coordinates = reader.read_point2d();
+        v.texture_coordinates.y = 1.0F - v.texture_coordinates.y; // this is flipped for some reason
+        reader.read_float();
         return v;
     }
     
-    JMS JMS::from_string(const char *string, const char **end) {
-        try {
-            SET_CURSOR
-            auto version = read_next_int32(cursor);
-            if(version != JMS_VERSION) {
-                throw std::invalid_argument("invalid version");
-            }
-            
-            // Build our JMS struct
-            JMS jms;
-            jms.node_list_checksum = read_next_uint32(cursor); // skip
-            jms.nodes = array_from_string<Node>(cursor);
-            jms.materials = array_from_string<Material>(cursor);
-            jms.markers = array_from_string<Marker>(cursor);
-            jms.regions = array_from_string<Region>(cursor);
-            jms.vertices = array_from_string<Vertex>(cursor);
-            jms.triangles = array_from_string<Triangle>(cursor);
-            SET_END
-            return jms;
+    static JMS::Triangle read_triangle(JMSReader &reader) {
+        JMS::Triangle t;
+        t.region = reader.read_uint32();
+        if(t.region == NULL_INDEX) {
+            t.region = 0; // -1 = 0 I guess
+        }
+        t.shader = reader.read_uint32();
+        if(t.shader == NULL_INDEX) {
+            t.shader = 0;
+        }
+        t.vertices[0] = reader.read_uint32();
+        t.vertices[2] = reader.read_uint32();
+        t.vertices[1] = reader.read_uint32();
+        return t;
+    }
+    
+    template <typename T> static std::vector<T> read_array(JMSReader &reader, T (*read_element)(JMSReader &)) {
+        std::vector<T> arr;
+        auto count = reader.read_uint32();
+        
+        // Don't trust the count for reserving; each element needs at least two bytes, so anything more than that can't be right
+        arr.reserve(std::min<std::size_t>(count, (reader.end - reader.cursor) / 2));
+        for(std::size_t i = 0; i < count; i++) {
+            arr.emplace_back(read_element(reader));
         }
-        catch (std::exception &) {
-            throw;
+        return arr;
+    }
+    
+    // Read a single element from a null-terminated string
+    template <typename T> static T read_one(const char *string, const char **end, T (*read_element)(JMSReader &)) {
+        auto reader = JMSReader::from_c_string(string);
+        auto element = read_element(reader);
+        if(end != nullptr) {
+            *end = reader.cursor;
+        }
+        return element;
+    }
+    
+    static JMS read_jms(JMSReader &reader) {
+        auto version = reader.read_int32();
+        if(version != JMS_VERSION) {
+            throw std::invalid_argument("invalid version");
+        }
+        
+        // Build our JMS struct
+        JMS jms;
+        jms.node_list_checksum = reader.read_uint32(); // skip
+        jms.nodes = read_array(reader, read_node);
+        jms.materials = read_array(reader, read_material);
+        jms.markers = read_array(reader, read_marker);
+        jms.regions = read_array(reader, read_region);
+        jms.vertices = read_array(reader, read_vertex);
+        jms.triangles = read_array(reader, read_triangle);
+        return jms;
+    }
+    
+    JMS JMS::from_string(const char *string, const char **end) {
+        auto reader = JMSReader::from_c_string(string);
+        auto jms = read_jms(reader);
+        if(end != nullptr) {
+            *end = reader.cursor;
         }
+        return jms;
     }
+    
+    JMS JMS::from_string(const char *string, std::size_t length) {
+        JMSReader reader(string, string + length);
+        return read_jms(reader);
+    }
+    
     std::string JMS::string() const {
         std::string r;
         
@@ -222,22 +352,7 @@ namespace Invader {
     }
     
     JMS::Marker JMS::Marker::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Marker m;
-        m.name = string_from_string(cursor, true);
-        m.region = read_next_uint32(cursor);
-        if(m.region == NULL_INDEX) {
-            m.region = 0;
-        }
-        m.node = read_next_uint32(cursor);
-        if(m.node == NULL_INDEX) {
-            m.node = 0;
-        }
-        m.rotation = quaternion_from_string(cursor);
-        m.position = point3d_from_string(cursor) / 100.0F;
-        m.radius = read_next_float(cursor);
-        SET_END
-        return m;
+        return read_one(string, end, read_marker);
     }
     std::string JMS::Marker::string() const {
         return this->name + CRLF +
@@ -249,15 +364,7 @@ namespace Invader {
     }
     
     JMS::Node JMS::Node::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Node n;
-        n.name = string_from_string(cursor, true);
-        n.first_child = read_next_uint32(cursor);
-        n.sibling_node = read_next_uint32(cursor);
-        n.rotation = quaternion_from_string(cursor);
-        n.position = point3d_from_string(cursor) / 100.0F;
-        SET_END
-        return n;
+        return read_one(string, end, read_node);
     }
     std::string JMS::Node::string() const {
         return this->name + CRLF +
@@ -268,42 +375,21 @@ namespace Invader {
     }
     
     JMS::Material JMS::Material::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Material m;
-        m.name = string_from_string(cursor, false);
-        m.tif_path = string_from_string(cursor, false);
-        
-        SET_END
-        return m;
+        return read_one(string, end, read_material);
     }
     std::string JMS::Material::string() const {
         return this->name + CRLF + this->tif_path;
     }
     
     JMS::Region JMS::Region::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Region r;
-        r.name = string_from_string(cursor, true);
-        SET_END
-        return r;
+        return read_one(string, end, read_region);
     }
     std::string JMS::Region::string() const {
         return this->name + CRLF;
     }
     
     JMS::Vertex JMS::Vertex::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Vertex v;
-        v.node0 = read_next_uint32(cursor);
-        v.position = point3d_from_string(cursor) / 100.0F;
-        v.normal = vector3d_from_string(cursor).normalize();
-        v.node1 = read_next_uint32(cursor);
-        v.node1_weight = read_next_float(cursor);
-        v.texture_coordinates = point2d_from_string(cursor);
-        v.texture_coordinates.y = 1.0F - v.texture_coordinates.y; // this is flipped for some reason
-        read_next_float(cursor);
-        SET_END
-        return v;
+        return read_one(string, end, read_vertex);
     }
     std::string JMS::Vertex::string() const {
         auto modified_texture_coordinates = this->texture_coordinates;
@@ -318,21 +404,7 @@ namespace Invader {
     }
     
     JMS::Triangle JMS::Triangle::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Triangle t;
-        t.region = read_next_uint32(cursor);
-        if(t.region == NULL_INDEX) {
-            t.region = 0; // -1 = 0 I guess
-        }
-        t.shader = read_next_uint32(cursor);
-        if(t.shader == NULL_INDEX) {
-            t.shader = 0;
-        }
-        t.vertices[0] = read_next_uint32(cursor);
-        t.vertices[2] = read_next_uint32(cursor);
-        t.vertices[1] = read_next_uint32(cursor);
-        SET_END
-        return t;
+        return read_one(string, end, read_triangle);
     }
     std::string JMS::Triangle::string() const {
         return std::to_string(static_cast<std::int16_t>(this->region)) + CRLF +
@@ -342,35 +414,60 @@ namespace Invader {
                std::to_string(static_cast<std::int16_t>(this->vertices[1]));
     }
     
-    void JMS::optimize() {
-        // Here we go
-        auto erase_vertex = [](JMS *jms, std::size_t vertex, std::size_t new_vertex = 0) {
-            jms->vertices.erase(jms->vertices.begin() + vertex);
-                    
-            // Go through each triangle and associate the triangles with the new vertex if they use the old one
-            // Or decrease their index by 1 if they reference a vertex after it
-            for(auto &t : jms->triangles) {
-                for(auto &t2 : t.vertices) {
-                    if(t2 == vertex) {
-                        t2 = new_vertex;
-                    }
-                    else if(t2 > vertex) {
-                        t2--;
-                    }
-                }
+    namespace {
+        struct VertexHash {
+            static std::size_t hash_float(float value) noexcept {
+                // 0.0 and -0.0 compare equal, so they have to hash the same, too
+                return std::hash<float>()(value == 0.0F ? 0.0F : value);
+            }
+
+            std::size_t operator()(const JMS::Vertex &vertex) const noexcept {
+                std::size_t hash = 0;
+                auto combine = [&hash](std::size_t value) {
+                    hash ^= value + 0x9E3779B97F4A7C15 + (hash << 6) + (hash >> 2);
+                };
+                combine(vertex.node0);
+                combine(vertex.node1);
+                combine(hash_float(vertex.node1_weight));
+                combine(hash_float(vertex.position.x));
+                combine(hash_float(vertex.position.y));
+                combine(hash_float(vertex.position.z));
+                combine(hash_float(vertex.normal.i));
+                combine(hash_float(vertex.normal.j));
+                combine(hash_float(vertex.normal.k));
+                combine(hash_float(vertex.texture_coordinates.x));
+                combine(hash_float(vertex.texture_coordinates.y));
+                return hash;
             }
         };
-        
-        // Optimize vertices by deduping
+    }
+
+    void JMS::optimize() {
+        // Map each vertex to the first vertex that's the same as it, keeping the unique vertices in their original order
+        std::unordered_map<Vertex, std::size_t, VertexHash> unique_vertices;
+        unique_vertices.reserve(this->vertices.size());
+        std::vector<std::size_t> remap(this->vertices.size());
+        std::size_t unique_vertex_count = 0;
+
         for(std::size_t v = 0; v < this->vertices.size(); v++) {
-            for(std::size_t v2 = v + 1; v2 < this->vertices.size(); v2++) {
-                // If it's the same, we can optimize it
-                if(this->vertices[v] == this->vertices[v2]) {
-                    // Delete vertex if needed
-                    erase_vertex(this, v2, v);
-                    
-                    // Decrement
-                    v2--;
+            auto [it, inserted] = unique_vertices.try_emplace(this->vertices[v], unique_vertex_count);
+            if(inserted) {
+                this->vertices[unique_vertex_count++] = this->vertices[v];
+            }
+            remap[v] = it->second;
+        }
+
+        // Nothing to do?
+        if(unique_vertex_count == this->vertices.size()) {
+            return;
+        }
+        this->vertices.resize(unique_vertex_count);
+
+        // Point every triangle at the vertices that were kept
+        for(auto &t : this->triangles) {
+            for(auto &t2 : t.vertices) {
+                if(t2 < remap.size()) {
+                    t2 = static_cast<HEK::Index>(remap[t2]);
                 }
             }
         }
@@ -3,7 +3,6 @@
 #include <vector>
 #include <cstring>
 #include <regex>
-#include <list>
 #include <cmath>
 
 #include <invader/version.hpp>
@@ -11,6 +10,8 @@
 #include <invader/file/file.hpp>
 #include <invader/command_line_option.hpp>
 #include <invader/model/jms.hpp>
+#include <invader/model/triangle_strip.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/tag/parser/compile/model.hpp>
 
@@ -24,7 +25,7 @@ const char *MODEL_EXTENSIONS[] = {
     ".gbxmodel"
 };
 
-template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> make_model_tag(const std::filesystem::path &path, const std::vector<std::filesystem::path> &tags, const Invader::JMSMap &map) {
+template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> make_model_tag(const std::filesystem::path &path, const std::vector<std::filesystem::path> &tags, Invader::JMSMap &&map, bool optimize_vertex_cache, std::size_t thread_count) {
     using namespace Invader;
     
     // Load the tag if possible
@@ -97,9 +98,18 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
     // Get regions and shaders
     std::vector<std::string> regions;
     
+    // Weld each JMS's vertices in parallel
+    ThreadPool thread_pool(thread_count);
+    std::vector<std::future<void>> optimize_tasks;
     for(auto &jms : map) {
-        auto jms_data_copy = jms.second;
-        jms_data_copy.optimize();
+        optimize_tasks.emplace_back(thread_pool.submit([&jms_data = jms.second]() {
+            jms_data.optimize();
+        }));
+    }
+    thread_pool.wait_all(optimize_tasks);
+    
+    for(auto &jms : map) {
+        auto &jms_data = jms.second;
         
         auto lod = LoD::LOD_SUPERHIGH;
         std::string permutation = jms.first;
@@ -136,35 +146,35 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
         }
         
         // Make sure it has nodes!
-        if(jms_data_copy.nodes.empty()) {
+        if(jms_data.nodes.empty()) {
             eprintf_error("Permutation %s's %s LoD has no nodes", permutation.c_str(), lod_str);
             std::exit(EXIT_FAILURE);
         }
         
         // If we haven't added nodes, add them
         if(nodes.empty()) {
-            nodes = jms_data_copy.nodes;
+            nodes = jms_data.nodes;
             top_permutation = permutation;
             top_lod = lod_str;
         }
         
         // Otherwise, make sure we have the same nodes
-        if(nodes != jms_data_copy.nodes) {
+        if(nodes != jms_data.nodes) {
             eprintf_error("Permutation %s's %s LoD does not match permutation %s's %s LoD's node", permutation.c_str(), lod_str, top_permutation.c_str(), top_lod);
             std::exit(EXIT_FAILURE);
         }
         
         // Regions
-        for(auto &r : jms_data_copy.regions) {
+        for(auto &r : jms_data.regions) {
             if(r.name == "unnamed") {
                 r.name = "__unnamed";
             }
         }
         
         // Bounds check!
-        auto material_count = jms_data_copy.materials.size();
-        auto region_count = jms_data_copy.regions.size();
-        for(auto &i : jms_data_copy.triangles) {
+        auto material_count = jms_data.materials.size();
+        auto region_count = jms_data.regions.size();
+        for(auto &i : jms_data.triangles) {
             if(i.shader >= material_count) {
                 eprintf_error("Permutation %s's %s LoD has an out-of-bounds shader index", permutation.c_str(), lod_str);
                 std::exit(EXIT_FAILURE);
@@ -175,12 +185,10 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
             }
         }
         
-        auto triangle_count = jms_data_copy.triangles.size();
-        auto marker_count = jms_data_copy.markers.size();
-        
         // Add any regions it may have
+        std::vector<std::size_t> region_remap(region_count);
         for(std::size_t i = 0; i < region_count; i++) {
-            auto &r = jms_data_copy.regions[i];
+            auto &r = jms_data.regions[i];
             std::size_t new_region_index = 0;
             auto iterator = regions.begin();
             bool has_it = false;
@@ -202,22 +210,23 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
                 regions.insert(iterator, r.name);
             }
             
-            // Fix all the triangles and markers to point to the new region
-            for(std::size_t t = 0; t < triangle_count; t++) {
-                if(jms.second.triangles[t].region == i) {
-                    jms_data_copy.triangles[t].region = new_region_index;
-                }
-            }
-            for(std::size_t m = 0; m < marker_count; m++) {
-                if(jms.second.markers[m].region == i) {
-                    jms_data_copy.markers[m].region = new_region_index;
-                }
+            region_remap[i] = new_region_index;
+        }
+        
+        // Fix all the triangles and markers to point to the new regions
+        for(auto &t : jms_data.triangles) {
+            t.region = region_remap[t.region];
+        }
+        for(auto &m : jms_data.markers) {
+            if(m.region < region_count) {
+                m.region = region_remap[m.region];
             }
         }
         
         // Add any shaders it may have, too
+        std::vector<std::size_t> shader_remap(material_count);
         for(std::size_t mat = 0; mat < material_count; mat++) {
-            auto shader_name = jms_data_copy.materials[mat].name;
+            auto shader_name = jms_data.materials[mat].name;
             if(shader_name.empty()) {
                 eprintf_error("Permutation %s's %s LoD has an empty shader name", permutation.c_str(), lod_str);
                 std::exit(EXIT_FAILURE);
@@ -225,7 +234,7 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
             
             // Check to see if this shader is even used
             bool shader_is_used = false;
-            for(auto &t : jms_data_copy.triangles) {
+            for(auto &t : jms_data.triangles) {
                 if(t.shader == mat) {
                     shader_is_used = true;
                     break;
@@ -287,16 +296,15 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
                 shader.permutation = shader_index;
             }
             
-            // Fix all the triangles to point to the new material
-            auto tri_count = jms_data_copy.triangles.size();
-            for(std::size_t t = 0; t < tri_count; t++) {
-                if(jms.second.triangles[t].shader == mat) { // check the original copy in case we changed the shader index previously
-                    jms_data_copy.triangles[t].shader = new_shader_index;
-                }
-            }
+            shader_remap[mat] = new_shader_index;
+        }
+        
+        // Fix all the triangles to point to the new materials
+        for(auto &t : jms_data.triangles) {
+            t.shader = shader_remap[t.shader];
         }
         
-        permutation_map.emplace(lod, jms_data_copy); // Now add it
+        permutation_map.emplace(lod, std::move(jms_data)); // Now add it
     }
     
     // List permutations
@@ -394,6 +402,219 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
     
     std::size_t triangle_count = 0;
     
+    // Geometries are built on the thread pool; everything else is done in order
+    using Geometry = typename std::remove_pointer<decltype(model_tag->geometries.data())>::type;
+    struct BuiltGeometry {
+        Geometry geometry;
+        std::size_t triangle_count = 0;
+        std::string report;
+    };
+    struct GeometryTarget {
+        std::size_t region;
+        std::size_t permutation_index;
+        LoD lod;
+    };
+    std::vector<std::future<BuiltGeometry>> geometry_tasks;
+    std::vector<GeometryTarget> geometry_targets;
+    
+    auto build_geometry = [optimize_vertex_cache, &regions](const JMS &jms, std::size_t r, const std::string &permutation_name, const char *lod_name) {
+        BuiltGeometry built;
+        auto &geometry = built.geometry;
+        
+        // Now for the shader indices
+        std::vector<std::size_t> shaders_we_use;
+        for(auto &t : jms.triangles) {
+            if(t.region == r) {
+                bool shader_in_it = false;
+                for(auto &s : shaders_we_use) {
+                    if(s == t.shader) {
+                        shader_in_it = true;
+                        break;
+                    }
+                }
+                if(!shader_in_it) {
+                    shaders_we_use.emplace_back(t.shader);
+                }
+            }
+        }
+        
+        // Go through each shader. Add a part thing
+        for(auto &s : shaders_we_use) {
+            auto &part = geometry.parts.emplace_back();
+            part.prev_filthy_part_index = ~0;
+            part.next_filthy_part_index = ~0;
+            part.shader_index = s;
+            
+            // Isolate all triangles
+            std::vector<JMS::Triangle> all_triangles_here;
+            for(auto &t : jms.triangles) {
+                if(t.region == r && t.shader == s) {
+                    all_triangles_here.emplace_back(t);
+                }
+            }
+            
+            // Isolate all vertices
+            std::map<std::size_t, std::size_t> all_vertices_here_indexed;
+            std::vector<JMS::Vertex> all_vertices_here;
+            for(auto &t : all_triangles_here) {
+                for(auto &v : t.vertices) {
+                    // Add the vertex. Note the index of it
+                    if(all_vertices_here_indexed.find(v) == all_vertices_here_indexed.end()) {
+                        if(v >= jms.vertices.size()) {
+                            eprintf_error("Vertex index out of bounds");
+                            throw OutOfBoundsException();
+                        }
+                        
+                        all_vertices_here_indexed[v] = all_vertices_here.size();
+                        all_vertices_here.emplace_back(jms.vertices[v]);
+                    }
+                }
+            }
+            
+            // Set the vertices now
+            for(auto &t : all_triangles_here) {
+                for(auto &v : t.vertices) {
+                    v = all_vertices_here_indexed[v];
+                }
+            }
+            
+            // Add all vertices
+            for(auto &v : all_vertices_here) {
+                auto &vm = part.uncompressed_vertices.emplace_back();
+                vm.position = v.position;
+                vm.normal = v.normal;
+                vm.texture_coords = v.texture_coordinates;
+                vm.node0_index = v.node0;
+                vm.node0_weight = 1.0F - v.node1_weight;
+                vm.node1_index = v.node1;
+                vm.node1_weight = v.node1_weight;
+            }
+            
+            // Calculate binormal/tangent (most of this is from the MEK @ https://github.com/Sigmmma/reclaimer/blob/e9900716d1962f4a172f517791c2f6b7900898c5/reclaimer/model/jms.py - thanks MosesofEgypt!)
+            for(auto &t : all_triangles_here) {
+                static constexpr const std::size_t range = sizeof(t.vertices) / sizeof(*t.vertices);
+                static_assert(range == 3);
+                
+                for(std::size_t v = 0; v < range; v++) {
+                    // Get our vertices, binormal, and tangent
+                    auto &vertex0 = part.uncompressed_vertices[t.vertices[(v + 0) % range]];
+                    auto &vertex1 = part.uncompressed_vertices[t.vertices[(v + 1) % range]];
+                    auto &vertex2 = part.uncompressed_vertices[t.vertices[(v + 2) % range]];
+                    
+                    auto &b = vertex0.binormal;
+                    auto &t = vertex0.tangent;
+                    
+                    // Subtract the x/y/z from the other two vertices
+                    float x1 = vertex1.position.x - vertex0.position.x;
+                    float x2 = vertex2.position.x - vertex0.position.x;
+                    float y1 = vertex1.position.y - vertex0.position.y;
+                    float y2 = vertex2.position.y - vertex0.position.y;
+                    float z1 = vertex1.position.z - vertex0.position.z;
+                    float z2 = vertex2.position.z - vertex0.position.z;
+                    
+                    // Do the same thing with the texture coordinates
+                    float u1 = vertex1.texture_coords.x - vertex0.texture_coords.x;
+                    float u2 = vertex2.texture_coords.x - vertex0.texture_coords.x;
+                    
+                    // Since it's flipped, subtract v from 1 to flip it back.
+                    float v1 = (1.0F - vertex1.texture_coords.y) - (1.0F - vertex0.texture_coords.y);
+                    float v2 = (1.0F - vertex2.texture_coords.y) - (1.0F - vertex0.texture_coords.y);
+                    
+                    float r = u1 * v2 - u2 * v1;
+                    if(r == 0) {
+                        continue;
+                    }
+                    
+                    r = 1.0 / r;
+                    
+                    // Binormal
+                    float bi = -(u1 * x2 - u2 * x1) * r;
+                    float bj = -(u1 * y2 - u2 * y1) * r;
+                    float bk = -(u1 * z2 - u2 * z1) * r;
+                    float b_len = std::sqrt(bi*bi + bj*bj + bk*bk);
+                    
+                    // Tangent
+                    float ti = (v2 * x1 - v1 * x2) * r;
+                    float tj = (v2 * y1 - v1 * y2) * r;
+                    float tk = (v2 * z1 - v1 * z2) * r;
+                    float t_len = std::sqrt(ti*ti + tj*tj + tk*tk);
+                    
+                    if(b_len > 0) {
+                        b.i = b.i + bi / b_len;
+                        b.j = b.j + bj / b_len;
+                        b.k = b.k + bk / b_len;
+                    }
+                    
+                    if(t_len > 0) {
+                        t.i = t.i + ti / t_len;
+                        t.j = t.j + tj / t_len;
+                        t.k = t.k + tk / t_len;
+                    }
+                }
+            }
+            
+            // Normalize vectors
+            for(auto &v : part.uncompressed_vertices) {
+                v.binormal = v.binormal.normalize();
+                v.tangent = v.tangent.normalize();
+            }
+            
+            // Now let's... do this horrible monstrosity, triangle strips!
+            //
+            // Basically, triangles in Halo are stored like this:
+            //
+            // A B C D          A          B          C          D
+            // 0 1 2 3 4 5 6 = (0, 1, 2); (1, 3, 2); (2, 3, 4); (3, 5, 4); (4, 5, 6)
+            //
+            // It can save lots of space, but only if everything is nicely sequenced like this.
+            // If not, you can lose space by having to add degenerate triangles.
+            // On average, it saves a decent amount of space... as far as 16-bit integers go at least.
+            
+            std::vector<TriangleStrip::Triangle> strip_triangles;
+            strip_triangles.reserve(all_triangles_here.size());
+            for(auto &t : all_triangles_here) {
+                strip_triangles.push_back({ t.vertices[0], t.vertices[1], t.vertices[2] });
+            }
+            
+            // Reorder the triangles and vertices for the vertex cache if we want to. The strip is then built in this order.
+            if(optimize_vertex_cache) {
+                auto vertex_order = TriangleStrip::optimize_vertex_cache(strip_triangles, part.uncompressed_vertices.size());
+                auto old_vertices = std::move(part.uncompressed_vertices);
+                part.uncompressed_vertices.clear();
+                part.uncompressed_vertices.reserve(vertex_order.size());
+                for(auto v : vertex_order) {
+                    part.uncompressed_vertices.emplace_back(std::move(old_vertices[v]));
+                }
+            }
+            
+            auto triangle_man = TriangleStrip::make_triangle_strip(strip_triangles);
+            char report_line[512];
+            std::snprintf(report_line, sizeof(report_line), "    %s %s %s part %zu: %zu triangles, %zu strip indices, ACMR %.03f\n", permutation_name.c_str(), lod_name, regions[r].c_str(), geometry.parts.size() - 1, strip_triangles.size(), triangle_man.size(), TriangleStrip::calculate_acmr(triangle_man));
+            built.report += report_line;
+            
+            // Add triangle count
+            if(triangle_man.size() > 2) {
+                built.triangle_count += triangle_man.size() - 2;
+            }
+            
+            // Add null's
+            while(triangle_man.size() % 3 > 0) {
+                triangle_man.emplace_back(NULL_INDEX);
+            }
+            
+            // Add the triangles
+            part.triangles.resize(triangle_man.size() / 3);
+            std::size_t q = 0;
+            for(auto &t : part.triangles) {
+                t.vertex0_index = triangle_man[q++];
+                t.vertex1_index = triangle_man[q++];
+                t.vertex2_index = triangle_man[q++];
+            }
+        }
+        
+        return built;
+    };
+    
     // Go through each permutation now
     for(auto &i : permutations) {
         for(auto &lod : i.second) {
@@ -454,298 +675,67 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
                     }
                 }
                 
-                // Instantiate our new geometry
-                typename std::remove_pointer<decltype(model_tag->geometries.data())>::type geometry;
-                
-                // Now for the shader indices
-                std::vector<std::size_t> shaders_we_use;
-                for(auto &t : jms.triangles) {
-                    if(t.region == r) {
-                        bool shader_in_it = false;
-                        for(auto &s : shaders_we_use) {
-                            if(s == t.shader) {
-                                shader_in_it = true;
-                                break;
-                            }
-                        }
-                        if(!shader_in_it) {
-                            shaders_we_use.emplace_back(t.shader);
-                        }
-                    }
-                }
-                
-                // Go through each shader. Add a part thing
-                for(auto &s : shaders_we_use) {
-                    auto &part = geometry.parts.emplace_back();
-                    part.prev_filthy_part_index = ~0;
-                    part.next_filthy_part_index = ~0;
-                    part.shader_index = s;
-                    
-                    // Isolate all triangles
-                    std::vector<JMS::Triangle> all_triangles_here;
-                    for(auto &t : jms.triangles) {
-                        if(t.region == r && t.shader == s) {
-                            all_triangles_here.emplace_back(t);
-                        }
-                    }
-                    
-                    // Isolate all vertices
-                    std::map<std::size_t, std::size_t> all_vertices_here_indexed;
-                    std::vector<JMS::Vertex> all_vertices_here;
-                    for(auto &t : all_triangles_here) {
-                        for(auto &v : t.vertices) {
-                            // Add the vertex. Note the index of it
-                            if(all_vertices_here_indexed.find(v) == all_vertices_here_indexed.end()) {
-                                if(v >= jms.vertices.size()) {
-                                    eprintf_error("Vertex index out of bounds");
-                                    std::exit(EXIT_FAILURE);
-                                }
-                                
-                                all_vertices_here_indexed[v] = all_vertices_here.size();
-                                all_vertices_here.emplace_back(jms.vertices[v]);
-                            }
-                        }
-                    }
-                    
-                    // Set the vertices now
-                    for(auto &t : all_triangles_here) {
-                        for(auto &v : t.vertices) {
-                            v = all_vertices_here_indexed[v];
-                        }
-                    }
-                    
-                    // Add all vertices
-                    for(auto &v : all_vertices_here) {
-                        auto &vm = part.uncompressed_vertices.emplace_back();
-                        vm.position = v.position;
-                        vm.normal = v.normal;
-                        vm.texture_coords = v.texture_coordinates;
-                        vm.node0_index = v.node0;
-                        vm.node0_weight = 1.0F - v.node1_weight;
-                        vm.node1_index = v.node1;
-                        vm.node1_weight = v.node1_weight;
-                    }
-                    
-                    // Calculate binormal/tangent (most of this is from the MEK @ https://github.com/Sigmmma/reclaimer/blob/e9900716d1962f4a172f517791c2f6b7900898c5/reclaimer/model/jms.py - thanks MosesofEgypt!)
-                    for(auto &t : all_triangles_here) {
-                        static constexpr const std::size_t range = sizeof(t.vertices) / sizeof(*t.vertices);
-                        static_assert(range == 3);
-                        
-                        for(std::size_t v = 0; v < range; v++) {
-                            // Get our vertices, binormal, and tangent
-                            auto &vertex0 = part.uncompressed_vertices[t.vertices[(v + 0) % range]];
-                            auto &vertex1 = part.uncompressed_vertices[t.vertices[(v + 1) % range]];
-                            auto &vertex2 = part.uncompressed_vertices[t.vertices[(v + 2) % range]];
-                            
-                            auto &b = vertex0.binormal;
-                            auto &t = vertex0.tangent;
-                            
-                            // Subtract the x/y/z from the other two vertices
-                            float x1 = vertex1.position.x - vertex0.position.x;
-                            float x2 = vertex2.position.x - vertex0.position.x;
-                            float y1 = vertex1.position.y - vertex0.position.y;
-                            float y2 = vertex2.position.y - vertex0.position.y;
-                            float z1 = vertex1.position.z - vertex0.position.z;
-                            float z2 = vertex2.position.z - vertex0.position.z;
-                            
-                            // Do the same thing with the texture coordinates
-                            float u1 = vertex1.texture_coords.x - vertex0.texture_coords.x;
-                            float u2 = vertex2.texture_coords.x - vertex0.texture_coords.x;
-                            
-                            // Since it's flipped, subtract v from 1 to flip it back.
-                            float v1 = (1.0F - vertex1.texture_coords.y) - (1.0F - vertex0.texture_coords.y);
-                            float v2 = (1.0F - vertex2.texture_coords.y) - (1.0F - vertex0.texture_coords.y);
-                            
-                            float r = u1 * v2 - u2 * v1;
-                            if(r == 0) {
-                                continue;
-                            }
-                            
-                            r = 1.0 / r;
-                            
-                            // Binormal
-                            float bi = -(u1 * x2 - u2 * x1) * r;
-                            float bj = -(u1 * y2 - u2 * y1) * r;
-                            float bk = -(u1 * z2 - u2 * z1) * r;
-                            float b_len = std::sqrt(bi*bi + bj*bj + bk*bk);
-                            
-                            // Tangent
-                            float ti = (v2 * x1 - v1 * x2) * r;
-                            float tj = (v2 * y1 - v1 * y2) * r;
-                            float tk = (v2 * z1 - v1 * z2) * r;
-                            float t_len = std::sqrt(ti*ti + tj*tj + tk*tk);
-                            
-                            if(b_len > 0) {
-                                b.i = b.i + bi / b_len;
-                                b.j = b.j + bj / b_len;
-                                b.k = b.k + bk / b_len;
-                            }
-                            
-                            if(t_len > 0) {
-                                t.i = t.i + ti / t_len;
-                                t.j = t.j + tj / t_len;
-                                t.k = t.k + tk / t_len;
-                            }
-                        }
-                    }
-                    
-                    // Normalize vectors
-                    for(auto &v : part.uncompressed_vertices) {
-                        v.binormal = v.binormal.normalize();
-                        v.tangent = v.tangent.normalize();
-                    }
-                    
-                    // Now let's... do this horrible monstrosity, triangle strips!
-                    //
-                    // Basically, triangles in Halo are stored like this:
-                    //
-                    // A B C D          A          B          C          D
-                    // 0 1 2 3 4 5 6 = (0, 1, 2); (1, 3, 2); (2, 3, 4); (3, 5, 4); (4, 5, 6)
-                    //
-                    // It can save lots of space, but only if everything is nicely sequenced like this.
-                    // If not, you can lose space by having to add degenerate triangles.
-                    // On average, it saves a decent amount of space... as far as 16-bit integers go at least.
-                    
-                    // Add the first triangle
-                    std::vector<HEK::Index> triangle_man = { all_triangles_here[0].vertices[0], all_triangles_here[0].vertices[1], all_triangles_here[0].vertices[2] };
-                    
-                    // Our remaining triangles
-                    std::list<JMS::Triangle> remaining_triangles = std::list<JMS::Triangle>(all_triangles_here.begin() + 1, all_triangles_here.end());
-                    
-                    // Add the rest
-                    while(remaining_triangles.size() > 0) {
-                        bool normals_flipped = (triangle_man.size() % 2) == 1;
-                        
-                        HEK::Index current_triangle[3] = {};
-                        auto a_index = 0;
-                        
-                        auto b_index = normals_flipped ? 2 : 1;
-                        auto c_index = normals_flipped ? 1 : 2;
-                        
-                        auto a_index_next = a_index;
-                        auto b_index_next = c_index;
-                        auto c_index_next = b_index;
-                        
-                        auto &a = current_triangle[a_index];
-                        auto &b = current_triangle[b_index];
-                        
-                        a = triangle_man[triangle_man.size() - 2];
-                        b = triangle_man[triangle_man.size() - 1];
-                        
-                        // Let's try to find a triangle that can simply go next with only one index
-                        bool triangle_found = false;
-                        for(auto rt = remaining_triangles.begin(); rt != remaining_triangles.end(); rt++) {
-                            // ABC ; BDC -> A B C D
-                            if(rt->vertices[a_index] == a && rt->vertices[b_index] == b) {
-                                triangle_found = true;
-                                triangle_man.emplace_back(rt->vertices[c_index]);
-                                remaining_triangles.erase(rt);
-                                break;
-                            }
-                        }
-                        if(triangle_found) {
-                            continue;
-                        }
-                        
-                        // Try a triangle that can go next but requires two indices
-                        for(auto rt = remaining_triangles.begin(); rt != remaining_triangles.end(); rt++) {
-                            // ABC ; CBD -> A B C B D
-                            if(rt->vertices[a_index_next] == b && rt->vertices[b_index_next] == a) {
-                                triangle_man.emplace_back(rt->vertices[b_index_next]);
-                                triangle_man.emplace_back(rt->vertices[c_index_next]);
-                                triangle_found = true;
-                                remaining_triangles.erase(rt);
-                                break;
-                            }
-                        }
-                        if(triangle_found) {
-                            continue;
-                        }
-                        
-                        // Try a triangle that can go next but requires three indices
-                        for(auto rt = remaining_triangles.begin(); rt != remaining_triangles.end(); rt++) {
-                            // ABC ; CDE -> A B C C E D
-                            if(rt->vertices[a_index] == b) {
-                                triangle_man.emplace_back(b);
-                                triangle_man.emplace_back(rt->vertices[b_index]);
-                                triangle_man.emplace_back(rt->vertices[c_index]);
-                                triangle_found = true;
-                                remaining_triangles.erase(rt);
-                                break;
-                            }
-                        }
-                        if(triangle_found) {
-                            continue;
-                        }
-                        
-                        // Last resort - Guarantees we can get the triangle in place but requires five indices
-                        // ABC; DEF -> A B C C D D F E
-                        triangle_man.emplace_back(b);
-                        auto first_triangle = *remaining_triangles.begin();
-                        remaining_triangles.erase(remaining_triangles.begin());
-                        triangle_man.emplace_back(first_triangle.vertices[a_index]);
-                        triangle_man.emplace_back(first_triangle.vertices[a_index]);
-                        triangle_man.emplace_back(first_triangle.vertices[b_index]);
-                        triangle_man.emplace_back(first_triangle.vertices[c_index]);
-                    }
-                    
-                    // Add triangle count
-                    if(triangle_man.size() > 2) {
-                        triangle_count += triangle_man.size() - 2;
-                    }
-                    
-                    // Add null's
-                    while(triangle_man.size() % 3 > 0) {
-                        triangle_man.emplace_back(NULL_INDEX);
-                    }
-                    
-                    // Add the triangles
-                    part.triangles.resize(triangle_man.size() / 3);
-                    std::size_t q = 0;
-                    for(auto &t : part.triangles) {
-                        t.vertex0_index = triangle_man[q++];
-                        t.vertex1_index = triangle_man[q++];
-                        t.vertex2_index = triangle_man[q++];
-                    }
-                }
-                
-                // See if we've already made this exact geometry before
-                std::size_t new_geometry_index;
-                for(new_geometry_index = 0; new_geometry_index < model_tag->geometries.size(); new_geometry_index++) {
-                    if(model_tag->geometries[new_geometry_index] == geometry) {
-                        break; // found a duplicate
-                    }
-                }
-                
-                // If we didn't find it, we have to add it then
-                if(new_geometry_index == model_tag->geometries.size()) {
-                    model_tag->geometries.emplace_back(geometry);
-                }
-                
-                // Set the index
-                switch(lod.first) {
-                    case LoD::LOD_SUPERHIGH:
-                        p.super_high = new_geometry_index;
-                        break;
-                    case LoD::LOD_HIGH:
-                        p.high = new_geometry_index;
-                        break;
-                    case LoD::LOD_MEDIUM:
-                        p.medium = new_geometry_index;
-                        break;
-                    case LoD::LOD_LOW:
-                        p.low = new_geometry_index;
-                        break;
-                    case LoD::LOD_SUPERLOW:
-                        p.super_low = new_geometry_index;
-                        break;
-                    default:
-                        eprintf_error("Eep!");
-                        std::terminate();
-                }
-                
+                // Build the geometry on the thread pool
+                geometry_targets.push_back({ r, permutation_index, lod.first });
+                geometry_tasks.emplace_back(thread_pool.submit([&build_geometry, &jms, r, &permutation_name = i.first, lod_name = lods[lod.first]]() {
+                    return build_geometry(jms, r, permutation_name, lod_name);
+                }));
+            }
+        }
+    }
+    
+    // Add the geometries in order, reusing identical ones, so the result doesn't depend on the thread count
+    std::vector<BuiltGeometry> built_geometries;
+    try {
+        built_geometries = thread_pool.wait_all(geometry_tasks);
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to build geometry: %s", e.what());
+        std::exit(EXIT_FAILURE);
+    }
+    
+    oprintf("Triangle strips:\n");
+    for(std::size_t g = 0; g < built_geometries.size(); g++) {
+        auto &geometry = built_geometries[g].geometry;
+        auto &target = geometry_targets[g];
+        oprintf("%s", built_geometries[g].report.c_str());
+        triangle_count += built_geometries[g].triangle_count;
+        
+        // See if we've already made this exact geometry before
+        std::size_t new_geometry_index;
+        for(new_geometry_index = 0; new_geometry_index < model_tag->geometries.size(); new_geometry_index++) {
+            if(model_tag->geometries[new_geometry_index] == geometry) {
+                break; // found a duplicate
             }
         }
+        
+        // If we didn't find it, we have to add it then
+        if(new_geometry_index == model_tag->geometries.size()) {
+            model_tag->geometries.emplace_back(std::move(geometry));
+        }
+        
+        // Set the index
+        auto &p = model_tag->regions[target.region].permutations[target.permutation_index];
+        switch(target.lod) {
+            case LoD::LOD_SUPERHIGH:
+                p.super_high = new_geometry_index;
+                break;
+            case LoD::LOD_HIGH:
+                p.high = new_geometry_index;
+                break;
+            case LoD::LOD_MEDIUM:
+                p.medium = new_geometry_index;
+                break;
+            case LoD::LOD_LOW:
+                p.low = new_geometry_index;
+                break;
+            case LoD::LOD_SUPERLOW:
+                p.super_low = new_geometry_index;
+                break;
+            default:
+                eprintf_error("Eep!");
+                std::terminate();
+        }
     }
     
     // Get everything
@@ -934,6 +924,8 @@ int main(int argc, const char **argv) {
         std::vector<std::filesystem::path> tags;
         std::filesystem::path data = "data";
         bool filesystem_path = false;
+        bool optimize_vertex_cache = false;
+        std::size_t max_threads = ThreadPool::default_thread_count();
     } model_options;
 
     std::vector<Invader::CommandLineOption> options;
@@ -942,6 +934,8 @@ int main(int argc, const char **argv) {
     options.emplace_back("type", 'T', 1, "Specify the type of model. Can be: model, gbxmodel", "<type>");
     options.emplace_back("data", 'd', 1, "Use the specified data directory.", "<dir>");
     options.emplace_back("tags", 't', 1, "Use the specified tags directory. Additional tags directories can be specified for searching shaders, but the tag will be output to the first one.", "<dir>");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for building geometry. Default: CPU thread count", "<#>");
+    options.emplace_back("optimize-vertex-cache", 'O', 0, "Reorder triangles and vertices to make better use of the vertex cache before making triangle strips.");
 
     static constexpr char DESCRIPTION[] = "Compile a model tag.";
     static constexpr char USAGE[] = "[options] <model-tag>";
@@ -972,6 +966,22 @@ int main(int argc, const char **argv) {
             case 't':
                 model_options.tags.emplace_back(args[0]);
                 break;
+            case 'O':
+                model_options.optimize_vertex_cache = true;
+                break;
+            case 'j':
+                try {
+                    auto threads = std::stoi(args[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    model_options.max_threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", args[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
         }
     });
     
@@ -1055,7 +1065,7 @@ int main(int argc, const char **argv) {
                     }
                     
                     // Add it
-                    jms_files.emplace(model_name, JMS::from_string(std::string(reinterpret_cast<const char *>(file->data()), file->size()).c_str()));
+                    jms_files.emplace(model_name, JMS::from_string(reinterpret_cast<const char *>(file->data()), file->size()));
                 }
                 catch(std::exception &e) {
                     eprintf_error("Failed to parse %s: %s", path.string().c_str(), e.what());
@@ -1081,10 +1091,10 @@ int main(int argc, const char **argv) {
     
     switch(*model_options.type) {
         case ModelType::MODEL_TYPE_MODEL:
-            tag_data = make_model_tag<Parser::Model, TagFourCC::TAG_FOURCC_MODEL>(file_path, model_options.tags, jms_files);
+            tag_data = make_model_tag<Parser::Model, TagFourCC::TAG_FOURCC_MODEL>(file_path, model_options.tags, std::move(jms_files), model_options.optimize_vertex_cache, model_options.max_threads);
             break;
         case ModelType::MODEL_TYPE_GBXMODEL:
-            tag_data = make_model_tag<Parser::GBXModel, TagFourCC::TAG_FOURCC_GBXMODEL>(file_path, model_options.tags, jms_files);
+            tag_data = make_model_tag<Parser::GBXModel, TagFourCC::TAG_FOURCC_GBXMODEL>(file_path, model_options.tags, std::move(jms_files), model_options.optimize_vertex_cache, model_options.max_threads);
             break;
         default:
             std::terminate();
@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <invader/model/triangle_strip.hpp>
+#include <invader/printf.hpp>
+#include <invader/error.hpp>
+
+namespace Invader::TriangleStrip {
+    static bool is_degenerate(const Triangle &triangle) noexcept {
+        return triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2];
+    }
+
+    namespace {
+        /**
+         * Triangles using each vertex. Triangles can be removed as they're used up, so each vertex's list only ever holds what's left.
+         */
+        class VertexTriangles {
+        public:
+            VertexTriangles(const std::vector<Triangle> &triangles, std::size_t vertex_count) : offsets(vertex_count + 1), live_count(vertex_count) {
+                for(auto &t : triangles) {
+                    if(!is_degenerate(t)) {
+                        for(auto v : t) {
+                            this->offsets[v + 1]++;
+                        }
+                    }
+                }
+                for(std::size_t v = 0; v < vertex_count; v++) {
+                    this->live_count[v] = this->offsets[v + 1];
+                    this->offsets[v + 1] += this->offsets[v];
+                }
+
+                this->entries.resize(this->offsets[vertex_count]);
+                std::vector<std::size_t> fill(this->offsets.begin(), this->offsets.end() - 1);
+                for(std::size_t t = 0; t < triangles.size(); t++) {
+                    if(!is_degenerate(triangles[t])) {
+                        for(auto v : triangles[t]) {
+                            this->entries[fill[v]++] = t;
+                        }
+                    }
+                }
+            }
+
+            /**
+             * Get the remaining triangles using the vertex
+             * @param  vertex vertex index
+             * @return        pointer to the first triangle index and the number of them
+             */
+            std::pair<std::size_t *, std::size_t> get(std::size_t vertex) noexcept {
+                return { this->entries.data() + this->offsets[vertex], this->live_count[vertex] };
+            }
+
+            /**
+             * Remove a triangle from the vertex's list
+             * @param vertex   vertex index
+             * @param triangle triangle index
+             */
+            void remove(std::size_t vertex, std::size_t triangle) noexcept {
+                auto [list, count] = this->get(vertex);
+                for(std::size_t i = 0; i < count; i++) {
+                    if(list[i] == triangle) {
+                        list[i] = list[count - 1];
+                        this->live_count[vertex]--;
+                        return;
+                    }
+                }
+            }
+
+        private:
+            std::vector<std::size_t> offsets;
+            std::vector<std::size_t> entries;
+            std::vector<std::size_t> live_count;
+        };
+    }
+
+    std::vector<HEK::Index> make_triangle_strip(const std::vector<Triangle> &triangles) {
+        std::vector<HEK::Index> strip;
+
+        std::size_t vertex_count = 0;
+        for(auto &t : triangles) {
+            for(auto v : t) {
+                vertex_count = std::max(vertex_count, static_cast<std::size_t>(v) + 1);
+            }
+        }
+
+        VertexTriangles vertex_triangles(triangles, vertex_count);
+        std::vector<bool> used(triangles.size());
+        auto use_triangle = [&used, &vertex_triangles, &triangles](std::size_t triangle) {
+            used[triangle] = true;
+            for(auto v : triangles[triangle]) {
+                vertex_triangles.remove(v, triangle);
+            }
+        };
+
+        // Find a remaining triangle with the directed edge from -> to, returning it and its other vertex
+        auto find_edge = [&vertex_triangles, &triangles](HEK::Index from, HEK::Index to) -> std::optional<std::pair<std::size_t, HEK::Index>> {
+            auto [list, count] = vertex_triangles.get(from);
+            for(std::size_t i = 0; i < count; i++) {
+                auto &t = triangles[list[i]];
+                for(std::size_t k = 0; k < 3; k++) {
+                    if(t[k] == from && t[(k + 1) % 3] == to) {
+                        return std::pair(list[i], t[(k + 2) % 3]);
+                    }
+                }
+            }
+            return std::nullopt;
+        };
+
+        // Rotate a triangle so the strip can continue from its last edge, if possible
+        auto rotate_for_continuation = [&find_edge](Triangle triangle) -> Triangle {
+            for(std::size_t k = 0; k < 3; k++) {
+                Triangle rotated = { triangle[k], triangle[(k + 1) % 3], triangle[(k + 2) % 3] };
+                if(find_edge(rotated[2], rotated[1]).has_value()) {
+                    return rotated;
+                }
+            }
+            return triangle;
+        };
+
+        // Put the rest of a triangle in once its first vertex was put in, accounting for the winding flipping on odd triangles
+        auto finish_triangle = [&strip](const Triangle &triangle) {
+            if((strip.size() - 1) % 2 == 0) {
+                strip.emplace_back(triangle[1]);
+                strip.emplace_back(triangle[2]);
+            }
+            else {
+                strip.emplace_back(triangle[2]);
+                strip.emplace_back(triangle[1]);
+            }
+        };
+
+        std::size_t next_start = 0;
+        while(true) {
+            // Continue the strip through its last edge if we can (one index)
+            if(strip.size() >= 2) {
+                auto a = strip[strip.size() - 2];
+                auto b = strip[strip.size() - 1];
+                bool odd = (strip.size() - 2) % 2 == 1;
+                auto next = odd ? find_edge(b, a) : find_edge(a, b);
+                if(next.has_value()) {
+                    use_triangle(next->first);
+                    strip.emplace_back(next->second);
+                    continue;
+                }
+
+                // Otherwise, try to start a new strip at a triangle using the last vertex (three indices: ABC ; CDE -> A B C C D E)
+                auto [list, count] = vertex_triangles.get(b);
+                if(count > 0) {
+                    auto triangle_index = list[0];
+                    auto &t = triangles[triangle_index];
+                    std::size_t k = t[0] == b ? 0 : t[1] == b ? 1 : 2;
+                    Triangle rotated = { t[k], t[(k + 1) % 3], t[(k + 2) % 3] };
+                    use_triangle(triangle_index);
+                    strip.emplace_back(b);
+                    finish_triangle(rotated);
+                    continue;
+                }
+            }
+
+            // Start a new strip at the next remaining triangle
+            while(next_start < triangles.size() && (used[next_start] || is_degenerate(triangles[next_start]))) {
+                next_start++;
+            }
+            if(next_start == triangles.size()) {
+                break;
+            }
+
+            use_triangle(next_start);
+            auto rotated = rotate_for_continuation(triangles[next_start]);
+
+            // Join it with degenerate triangles if there's already a strip (five indices: ABC ; DEF -> A B C C D D E F)
+            if(!strip.empty()) {
+                strip.emplace_back(strip.back());
+                strip.emplace_back(rotated[0]);
+            }
+            strip.emplace_back(rotated[0]);
+            finish_triangle(rotated);
+        }
+
+        return strip;
+    }
+
+    std::vector<std::size_t> optimize_vertex_cache(std::vector<Triangle> &triangles, std::size_t vertex_count) {
+        static constexpr float CACHE_DECAY_POWER = 1.5F;
+        static constexpr float LAST_TRIANGLE_SCORE = 0.75F;
+        static constexpr float VALENCE_BOOST_SCALE = 2.0F;
+        static constexpr float VALENCE_BOOST_POWER = 0.5F;
+
+        for(auto &t : triangles) {
+            for(auto v : t) {
+                if(v >= vertex_count) {
+                    eprintf_error("Vertex index %zu is out of bounds (%zu vertices)", static_cast<std::size_t>(v), vertex_count);
+                    throw OutOfBoundsException();
+                }
+            }
+        }
+
+        VertexTriangles vertex_triangles(triangles, vertex_count);
+        std::vector<int> cache_position(vertex_count, -1);
+        std::vector<float> vertex_score(vertex_count);
+
+        // Vertices that are used soon after they were last used and vertices with fewer triangles left get higher scores
+        auto update_vertex_score = [&](std::size_t vertex) {
+            auto remaining = vertex_triangles.get(vertex).second;
+            if(remaining == 0) {
+                vertex_score[vertex] = -1.0F;
+                return;
+            }
+
+            float score = 0.0F;
+            auto position = cache_position[vertex];
+            if(position >= 0) {
+                if(position < 3) {
+                    score = LAST_TRIANGLE_SCORE;
+                }
+                else {
+                    score = std::pow(1.0F - static_cast<float>(position - 3) / (VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+                }
+            }
+            vertex_score[vertex] = score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining), -VALENCE_BOOST_POWER);
+        };
+        auto triangle_score = [&](std::size_t triangle) {
+            auto &t = triangles[triangle];
+            return vertex_score[t[0]] + vertex_score[t[1]] + vertex_score[t[2]];
+        };
+
+        std::vector<bool> added(triangles.size());
+        std::optional<std::size_t> best_triangle;
+        float best_score = -1.0F;
+        for(std::size_t v = 0; v < vertex_count; v++) {
+            update_vertex_score(v);
+        }
+        for(std::size_t t = 0; t < triangles.size(); t++) {
+            if(is_degenerate(triangles[t])) {
+                continue;
+            }
+            auto score = triangle_score(t);
+            if(score > best_score) {
+                best_score = score;
+                best_triangle = t;
+            }
+        }
+
+        std::vector<Triangle> new_triangles;
+        new_triangles.reserve(triangles.size());
+        std::vector<std::size_t> cache, new_cache;
+        std::size_t next_triangle = 0;
+
+        while(new_triangles.size() < triangles.size()) {
+            // If nothing in the cache has anything left, take the next triangle we haven't added
+            if(!best_triangle.has_value()) {
+                while(added[next_triangle]) {
+                    next_triangle++;
+                }
+                best_triangle = next_triangle;
+            }
+
+            auto triangle = *best_triangle;
+            auto &t = triangles[triangle];
+            added[triangle] = true;
+            new_triangles.emplace_back(t);
+
+            // Degenerate triangles aren't in the cache or the vertex lists, so they just go wherever
+            if(is_degenerate(t)) {
+                best_triangle = std::nullopt;
+                continue;
+            }
+
+            // Move this triangle's vertices to the front of the cache
+            new_cache.clear();
+            for(auto v : t) {
+                vertex_triangles.remove(v, triangle);
+                new_cache.emplace_back(v);
+            }
+            for(auto v : cache) {
+                if(v != t[0] && v != t[1] && v != t[2]) {
+                    new_cache.emplace_back(v);
+                }
+            }
+            std::swap(cache, new_cache);
+
+            for(std::size_t i = 0; i < cache.size(); i++) {
+                cache_position[cache[i]] = i < VERTEX_CACHE_SIZE ? static_cast<int>(i) : -1;
+                update_vertex_score(cache[i]);
+            }
+
+            // Find the best triangle using anything we just updated
+            best_triangle = std::nullopt;
+            best_score = -1.0F;
+            for(auto v : cache) {
+                auto [list, count] = vertex_triangles.get(v);
+                for(std::size_t i = 0; i < count; i++) {
+                    auto score = triangle_score(list[i]);
+                    if(score > best_score) {
+                        best_score = score;
+                        best_triangle = list[i];
+                    }
+                }
+            }
+
+            if(cache.size() > VERTEX_CACHE_SIZE) {
+                cache.resize(VERTEX_CACHE_SIZE);
+            }
+        }
+
+        triangles = std::move(new_triangles);
+
+        // Renumber vertices in the order they're first used. Anything unused goes at the end.
+        constexpr std::size_t UNASSIGNED = ~static_cast<std::size_t>(0);
+        std::vector<std::size_t> new_index(vertex_count, UNASSIGNED);
+        std::vector<std::size_t> order;
+        order.reserve(vertex_count);
+        for(auto &t : triangles) {
+            for(auto v : t) {
+                if(new_index[v] == UNASSIGNED) {
+                    new_index[v] = order.size();
+                    order.emplace_back(v);
+                }
+            }
+        }
+        for(std::size_t v = 0; v < vertex_count; v++) {
+            if(new_index[v] == UNASSIGNED) {
+                new_index[v] = order.size();
+                order.emplace_back(v);
+            }
+        }
+        for(auto &t : triangles) {
+            for(auto &v : t) {
+                v = static_cast<HEK::Index>(new_index[v]);
+            }
+        }
+
+        return order;
+    }
+
+    double calculate_acmr(const std::vector<HEK::Index> &strip, std::size_t cache_size) {
+        std::vector<HEK::Index> cache;
+        std::size_t cache_start = 0;
+        std::size_t misses = 0;
+        std::size_t triangle_count = 0;
+
+        for(std::size_t i = 0; i < strip.size(); i++) {
+            auto v = strip[i];
+            if(std::find(cache.begin(), cache.end(), v) == cache.end()) {
+                misses++;
+                if(cache.size() < cache_size) {
+                    cache.emplace_back(v);
+                }
+                else {
+                    cache[cache_start] = v;
+                    cache_start = (cache_start + 1) % cache_size;
+                }
+            }
+
+            if(i >= 2 && !is_degenerate({ strip[i - 2], strip[i - 1], v })) {
+                triangle_count++;
+            }
+        }
+
+        return triangle_count == 0 ? 0.0 : static_cast<double>(misses) / triangle_count;
+    }
+}
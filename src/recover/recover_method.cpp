@@ -509,7 +509,7 @@ namespace Invader::Recover {
         // "tell_lies" pretends that we recovered it (if it matched what was on disk)
         auto recover_script = [](const std::filesystem::path &scripts_directory, const auto &script, bool tell_lies) {
             auto hsc_path = scripts_directory / (std::string(script.name.string) + ".hsc");
-            if(tell_lies || File::save_file(hsc_path, script.source)) {
+            if(tell_lies || File::save_file(hsc_path, std::vector<std::byte>(script.source.begin(), script.source.end()))) {
                 oprintf_success("Recovered %s", hsc_path.string().c_str());
             }
             else {
@@ -535,7 +535,8 @@ namespace Invader::Recover {
                     
                     // Check if it matches
                     try {
-                        matches = File::open_file(script_path).value() == i.source;
+                        auto existing_script = File::open_file(script_path).value();
+                        matches = std::equal(existing_script.begin(), existing_script.end(), i.source.begin(), i.source.end());
                     }
                     catch(std::exception &e) {
                         eprintf_error("Failed to open %s: %s", script_path.string().c_str(), e.what());
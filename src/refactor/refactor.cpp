@@ -3,13 +3,17 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <unordered_set>
 #include <invader/printf.hpp>
 #include <invader/version.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/hek/definition.hpp>
 #include <invader/command_line_option.hpp>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/tag/parser/tag_arena.hpp>
+#include <invader/tag/parser/view_struct.hpp>
 #include <invader/file/file.hpp>
+#include <invader/dependency/dependency_index.hpp>
 
 using namespace Invader::File;
 
@@ -21,6 +25,9 @@ std::size_t refactor_tags(const std::filesystem::path &file_path, const std::vec
         std::exit(EXIT_FAILURE);
     }
 
+    // Reuse the same memory for every tag we parse
+    static Invader::Parser::TagArena tag_arena;
+
     // Get the header
     std::vector<std::byte> file_data;
     std::size_t count = 0;
@@ -29,7 +36,24 @@ std::size_t refactor_tags(const std::filesystem::path &file_path, const std::vec
         const auto *header = reinterpret_cast<const Invader::HEK::TagFileHeader *>(tag->data());
         Invader::HEK::TagFileHeader::validate_header(header, tag->size());
 
-        auto tag_data = Invader::Parser::ParserStruct::parse_hek_tag_file(tag->data(), tag->size());
+        // Most tags don't reference anything being refactored, so check the references before parsing the whole tag
+        bool referenced = false;
+        for(auto &dependency : Invader::Parser::View::get_hek_tag_file_dependencies(tag->data(), tag->size())) {
+            for(auto &i : replacements) {
+                if(i.first == dependency) {
+                    referenced = true;
+                    break;
+                }
+            }
+            if(referenced) {
+                break;
+            }
+        }
+        if(!referenced) {
+            return count;
+        }
+
+        auto tag_data = Invader::Parser::ParserStruct::parse_hek_tag_file(tag->data(), tag->size(), false, tag_arena.next_tag(tag->size()));
         count = tag_data->refactor_references(replacements);
         if(count) {
             file_data = tag_data->generate_hek_tag_data(header->tag_fourcc);
@@ -71,6 +95,7 @@ int main(int argc, char * const *argv) {
     options.emplace_back("tag", 'T', 2, "Refactor an individual tag. This can be specified multiple times but cannot be used with --recursive.", "<f> <t>");
     options.emplace_back("class", 'c', 2, "Refactor all tags of a given class to another class. All tags in the destination class must exist. This can be specified multiple times but cannot be used with --recursive or -M move.", "<f> <t>");
     options.emplace_back("single-tag", 's', 1, "Make changes to a single tag, only, rather than the whole tags directory.", "<path>");
+    options.emplace_back("index", 'I', 1, "Use the specified dependency index to find which tags need to be changed, creating or updating it as needed. Only tags changed since the last run are read.", "<file>");
     options.emplace_back("replace-string", 'R', 2, "Replaces all instances in a path of <a> with <b>. This can be used multiple times for multiple replacements. If --class or --recursive are used, this applies to the output of those. Otherwise, it applies to all tags.", "<a> <b>");
 
     static constexpr char DESCRIPTION[] = "Find and replace tag references.";
@@ -82,6 +107,7 @@ int main(int argc, char * const *argv) {
         std::optional<RefactorMode> mode;
         const char *single_tag = nullptr;
         bool unsafe = false;
+        std::optional<std::filesystem::path> index;
 
         std::vector<std::pair<std::string, std::string>> string_replacements;
         std::vector<std::pair<TagFilePath, TagFilePath>> replacements;
@@ -147,6 +173,9 @@ int main(int argc, char * const *argv) {
             case 's':
                 refactor_options.single_tag = arguments[0];
                 return;
+            case 'I':
+                refactor_options.index = arguments[0];
+                return;
             case 'R':
                 refactor_options.string_replacements.emplace_back(Invader::File::preferred_path_to_halo_path(arguments[0]), Invader::File::preferred_path_to_halo_path(arguments[1]));
                 return;
@@ -470,6 +499,23 @@ int main(int argc, char * const *argv) {
         all_tags = load_virtual_tag_folder(refactor_options.tags);
     }
 
+    // If we have an index, only tags referencing something being refactored need to be opened
+    std::optional<std::unordered_set<std::string>> referencing_tags;
+    if(refactor_options.index.has_value()) {
+        auto index = Invader::DependencyIndex::load(*refactor_options.index);
+        index.update(refactor_options.tags);
+        if(!index.save(*refactor_options.index)) {
+            eprintf_warn("Warning: Failed to save %s", refactor_options.index->string().c_str());
+        }
+
+        auto &found = referencing_tags.emplace();
+        for(auto &i : replacements) {
+            for(const auto *tag : index.get_dependents(i.first)) {
+                found.emplace(tag->tag.join());
+            }
+        }
+    }
+
     // Go through all the tags and see what needs edited
     std::size_t total_tags = 0;
     std::size_t total_replaced = 0;
@@ -512,6 +558,10 @@ int main(int argc, char * const *argv) {
             default:
                 break;
         }
+
+        if(!skip && referencing_tags.has_value() && referencing_tags->find(Invader::File::preferred_path_to_halo_path(tag.tag_path)) == referencing_tags->end()) {
+            skip = true;
+        }
         
         if(!skip && refactor_tags(tag.full_path.string().c_str(), replacements, true, refactor_options.dry_run)) {
             tags_to_do.emplace_back(&tag);
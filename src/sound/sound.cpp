@@ -1,17 +1,24 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <deque>
 #include <filesystem>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <thread>
+#include <unistd.h>
 #include <invader/command_line_option.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/sound/sound_reader.hpp>
+#include <invader/sound/sound_resampler.hpp>
 #include <invader/version.hpp>
+#include <invader/thread_pool.hpp>
 #include <vorbis/vorbisenc.h>
-#include <samplerate.h>
-#include <atomic>
-#include <thread>
 
 using namespace Invader;
 using namespace Invader::HEK;
@@ -27,11 +34,27 @@ struct SoundOptions {
     std::optional<SoundClass> sound_class;
     std::optional<std::uint32_t> sample_rate;
     std::optional<std::uint16_t> bitrate;
-    std::size_t max_threads = std::thread::hardware_concurrency() < 1 ? 1 : std::thread::hardware_concurrency();
+    std::size_t adpcm_lookahead = SoundEncoder::DEFAULT_XBOX_ADPCM_LOOKAHEAD;
+    SoundResamplerQuality resample_quality = SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_BEST;
+    std::optional<std::filesystem::path> resample_cache;
+    std::size_t max_threads = ThreadPool::default_thread_count();
 };
 
-static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count);
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size);
+static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, std::vector<std::filesystem::path> &permutation_paths, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count);
+
+/**
+ * Decode, convert, and resample a permutation
+ * @param  permutation           permutation to process; its format is updated to the output's format
+ * @param  path                  path to the permutation's file
+ * @param  highest_sample_rate   sample rate to resample to
+ * @param  format                format it will be encoded to
+ * @param  highest_channel_count channel count to convert to
+ * @param  fit_adpcm_block_size  fit the permutation to the Xbox ADPCM block size (this needs the whole permutation, so output can't be set)
+ * @param  sound_options         sound options
+ * @param  output                if set, PCM is passed to this as it's made instead of being stored in permutation.pcm
+ * @return                       size of the output PCM in bytes
+ */
+static std::size_t process_permutation(SoundReader::Sound &permutation, const std::filesystem::path &path, std::uint32_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, const SoundOptions &sound_options, const std::function<void (const std::byte *pcm, std::size_t size)> &output);
 
 template<typename T> static std::vector<std::byte> make_sound_tag(const std::filesystem::path &tag_path, const std::filesystem::path &data_path, SoundOptions &sound_options) {
     static constexpr std::size_t XBOX_ADPCM_SPLIT_SIZE = 65520;
@@ -113,7 +136,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     // Clear the old one
     for(auto &old_pitch_range : sound_tag.pitch_ranges) {
         for(auto &permutation : old_pitch_range.permutations) {
-            permutation.samples = std::vector<std::byte>();
+            permutation.samples = std::pmr::vector<std::byte>(permutation.samples.get_allocator());
         }
     }
 
@@ -153,6 +176,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     std::uint16_t highest_channel_count = 0;
     std::uint32_t highest_sample_rate = 0;
     std::vector<std::pair<std::vector<SoundReader::Sound>, std::string>> pitch_ranges;
+    std::vector<std::vector<std::filesystem::path>> permutation_paths;
 
     oprintf("Loading sounds... ");
     oflush();
@@ -160,7 +184,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     // Load the sounds
     if(contains_files) {
         auto &pitch_range = pitch_ranges.emplace_back(std::vector<SoundReader::Sound>(), "default");
-        populate_pitch_range(pitch_range.first, data_path, highest_sample_rate, highest_channel_count);
+        populate_pitch_range(pitch_range.first, permutation_paths.emplace_back(), data_path, highest_sample_rate, highest_channel_count);
     }
     else if(contains_directories) {
         std::size_t i = 0;
@@ -171,7 +195,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
                 std::exit(EXIT_FAILURE);
             }
             auto &pitch_range = pitch_ranges.emplace_back(std::vector<SoundReader::Sound>(), path.filename().string());
-            populate_pitch_range(pitch_range.first, path, highest_sample_rate, highest_channel_count);
+            populate_pitch_range(pitch_range.first, permutation_paths.emplace_back(), path, highest_sample_rate, highest_channel_count);
             if(i == NULL_INDEX) {
                 eprintf_error("%u or more pitch ranges are present", NULL_INDEX);
                 std::exit(EXIT_FAILURE);
@@ -229,40 +253,31 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
         std::exit(EXIT_FAILURE);
     }
 
-    // Resample permutations when needed
-    oprintf("Processing sounds... ");
-    oflush();
     std::size_t total_sound_count = 0;
-    std::atomic<std::size_t> thread_count = 0;
+    for(auto &pitch_range : pitch_ranges) {
+        total_sound_count += pitch_range.first.size();
+    }
 
-    // Wait until we have 0 threads working
-    auto wait_until_threads_are_done = [&thread_count]() {
-        while(thread_count > 0) {
-            std::this_thread::sleep_for(std::chrono::microseconds(1000));
-        }
-    };
+    // Encoded samples and the buffer size
+    using EncodedPermutation = std::pair<std::vector<std::byte>, std::size_t>;
 
-    // Wait until we have room for more threads
-    auto wait_until_threads_are_open = [&thread_count, &sound_options]() {
-        while(thread_count >= sound_options.max_threads) {
-            std::this_thread::sleep_for(std::chrono::microseconds(1000));
-        }
+    // A chunk of a permutation being encoded. If the permutation's processing task had to wait on it, the result is held here.
+    struct EncodingChunk {
+        std::future<EncodedPermutation> task;
+        std::optional<EncodedPermutation> result;
     };
 
-    // Process things!
-    for(auto &pitch_range : pitch_ranges) {
-        for(auto &permutation : pitch_range.first) {
-            total_sound_count++;
-            wait_until_threads_are_open();
-            thread_count++;
-            std::thread(process_permutation_thread, &permutation, highest_sample_rate, format, highest_channel_count, &thread_count, sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE).detach();
-        }
-    }
-
-    // Wait until done
-    wait_until_threads_are_done();
+    // A permutation being decoded, converted, and resampled, and the chunks it has been handed to the encoder in so far
+    struct PermutationJob {
+        std::size_t pitch_range;
+        std::size_t permutation;
+        std::future<std::size_t> processing;
+        std::vector<EncodingChunk> chunks;
+    };
+    std::deque<PermutationJob> jobs;
 
-    oprintf("done!\n");
+    // Resampling and encoding both run on this. Anything it still has queued is finished before the data it refers to goes out of scope.
+    ThreadPool thread_pool(sound_options.max_threads);
 
     // Remove pitch ranges that are present in the tag but not in what we found
     while(true) {
@@ -318,19 +333,15 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
     // Make the sound tag
     const char *output_name = nullptr;
-    bool enable_threading_split_permutation_encoding = true;
     switch(format) {
         case SoundFormat::SOUND_FORMAT_16_BIT_PCM:
             output_name = "16-bit PCM";
-            enable_threading_split_permutation_encoding = false;
             break;
         case SoundFormat::SOUND_FORMAT_IMA_ADPCM:
             output_name = "IMA ADPCM";
-            enable_threading_split_permutation_encoding = false;
             break;
         case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
             output_name = "Xbox ADPCM";
-            enable_threading_split_permutation_encoding = false;
             break;
         case SoundFormat::SOUND_FORMAT_OGG_VORBIS:
             output_name = "Ogg Vorbis";
@@ -359,273 +370,292 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
     if(is_dialogue && split) {
         eprintf_error("Split dialogue is unsupported.");
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
-    // Make sure we don't completely blow things up
-    std::mutex encoding_mutex;
+    // Encode a permutation, returning the encoded samples and the buffer size
+    auto encode_permutation = [is_dialogue, format, &sound_options, &thread_pool](const std::vector<std::byte> &pcm, const SoundReader::Sound &permutation) -> std::pair<std::vector<std::byte>, std::size_t> {
+        auto generate_mouth_data = [&permutation](const std::vector<std::uint8_t> &pcm_8_bit) -> std::vector<std::byte> {
+            // Basically, take the sample rate, multiply by channel count, divide by tick rate (30 Hz), and round the result
+            std::size_t samples_per_tick = static_cast<std::size_t>((permutation.sample_rate * permutation.channel_count) / TICK_RATE + 0.5);
+            std::size_t sample_count = pcm_8_bit.size();
+
+            // Generate samples, adding an extra tick for incomplete ticks
+            std::size_t tick_count = (sample_count + samples_per_tick - 1) / samples_per_tick;
+            std::vector<std::byte> mouth_data = std::vector<std::byte>(tick_count);
+            auto *pcm_data = pcm_8_bit.data();
+
+            // Get max and total
+            std::uint8_t max = 0;
+            double mouth_total = 0;
+            for(std::size_t t = 0; t < tick_count; t++) {
+                // Get the sample range, accounting for when there aren't enough ticks
+                std::size_t first_sample = t * samples_per_tick;
+                std::size_t sample_count_to_check = sample_count - first_sample;
+                if(sample_count_to_check > samples_per_tick) {
+                    sample_count_to_check = samples_per_tick;
+                }
+                std::size_t last_sample = first_sample + sample_count_to_check;
+                double total = 0;
+                for(std::size_t s = first_sample; s < last_sample; s++) {
+                    total += pcm_data[s];
+                }
 
-    // Encode this
-    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
-        encoding_mutex.lock();
-        auto &pitch_range = sound_tag.pitch_ranges[pitch_range_index[pr]];
-        auto &permutations = pitch_ranges[pr].first;
-        auto actual_permutation_count = permutations.size();
-        pitch_range.actual_permutation_count = actual_permutation_count;
-        pitch_range.permutations.resize(actual_permutation_count);
-        encoding_mutex.unlock();
+                // Divide by samples per tick
+                double average = total / samples_per_tick;
+                mouth_total += average;
+                mouth_data[t] = static_cast<std::byte>(average);
 
-        for(auto &p : pitch_range.permutations) {
-            p.format = sound_tag.format;
-        }
+                if(average > max) {
+                    max = average;
+                }
+            }
 
-        for(std::size_t i = 0; i < actual_permutation_count; i++) {
-            // Get the permutation and set its name, too
-            auto &permutation = permutations[i];
-            std::strncpy(pitch_range.permutations[i].name.string, permutation.name.c_str(), sizeof(pitch_range.permutations[i].name.string) - 1);
-
-            // Calculate length
-            double seconds = permutation.pcm.size() / static_cast<double>(static_cast<std::size_t>(permutation.sample_rate) * static_cast<std::size_t>(permutation.bits_per_sample / 8) * static_cast<std::size_t>(permutation.channel_count));
-            std::size_t bytes_per_sample_one_channel = permutation.bits_per_sample / 8;
-            std::size_t bytes_per_sample_all_channels = bytes_per_sample_one_channel * permutation.channel_count;
-
-            // Encode a permutation
-            auto encode_permutation = [](auto *sound_tag, std::size_t pitch_range, std::size_t pitch_range_permutation, std::mutex *mutex, std::vector<std::byte> pcm, const SoundReader::Sound *permutation, bool is_dialogue, SoundFormat format, SoundOptions *sound_options, std::atomic<std::size_t> *thread_count) {
-                auto generate_mouth_data = [&permutation](const std::vector<std::uint8_t> &pcm_8_bit) -> std::vector<std::byte> {
-                    // Basically, take the sample rate, multiply by channel count, divide by tick rate (30 Hz), and round the result
-                    std::size_t samples_per_tick = static_cast<std::size_t>((permutation->sample_rate * permutation->channel_count) / TICK_RATE + 0.5);
-                    std::size_t sample_count = pcm_8_bit.size();
-
-                    // Generate samples, adding an extra tick for incomplete ticks
-                    std::size_t tick_count = (sample_count + samples_per_tick - 1) / samples_per_tick;
-                    std::vector<std::byte> mouth_data = std::vector<std::byte>(tick_count);
-                    auto *pcm_data = pcm_8_bit.data();
-
-                    // Get max and total
-                    std::uint8_t max = 0;
-                    double mouth_total = 0;
-                    for(std::size_t t = 0; t < tick_count; t++) {
-                        // Get the sample range, accounting for when there aren't enough ticks
-                        std::size_t first_sample = t * samples_per_tick;
-                        std::size_t sample_count_to_check = sample_count - first_sample;
-                        if(sample_count_to_check > samples_per_tick) {
-                            sample_count_to_check = samples_per_tick;
-                        }
-                        std::size_t last_sample = first_sample + sample_count_to_check;
-                        double total = 0;
-                        for(std::size_t s = first_sample; s < last_sample; s++) {
-                            total += pcm_data[s];
-                        }
-
-                        // Divide by samples per tick
-                        double average = total / samples_per_tick;
-                        mouth_total += average;
-                        mouth_data[t] = static_cast<std::byte>(average);
-
-                        if(average > max) {
-                            max = average;
-                        }
-                    }
+            // Get average and min, clamping min to 0-255
+            double average = mouth_total / tick_count;
+            double min = 2.0 * average - max;
+            if(min > UINT8_MAX) {
+                min = UINT8_MAX;
+            }
+            else if(min < 0) {
+                min = 0;
+            }
 
-                    // Get average and min, clamping min to 0-255
-                    double average = mouth_total / tick_count;
-                    double min = 2.0 * average - max;
-                    if(min > UINT8_MAX) {
-                        min = UINT8_MAX;
-                    }
-                    else if(min < 0) {
-                        min = 0;
-                    }
+            // Get range
+            double range = static_cast<double>(max + average) / 2 - min;
 
-                    // Get range
-                    double range = static_cast<double>(max + average) / 2 - min;
+            // Do nothing if there's no range
+            if(range == 0) {
+                return mouth_data;
+            }
 
-                    // Do nothing if there's no range
-                    if(range == 0) {
-                        return mouth_data;
-                    }
+            // Go through each sample
+            for(std::size_t t = 0; t < tick_count; t++) {
+                double sample = (static_cast<std::uint8_t>(mouth_data[t]) - min) / range;
 
-                    // Go through each sample
-                    for(std::size_t t = 0; t < tick_count; t++) {
-                        double sample = (static_cast<std::uint8_t>(mouth_data[t]) - min) / range;
-
-                        // Clamp to 0 - 255
-                        if(sample >= 1.0) {
-                            mouth_data[t] = static_cast<std::byte>(UINT8_MAX);
-                        }
-                        else if(sample <= 0.0) {
-                            mouth_data[t] = static_cast<std::byte>(0);
-                        }
-                        else {
-                            mouth_data[t] = static_cast<std::byte>(sample * UINT8_MAX);
-                        }
-                    }
+                // Clamp to 0 - 255
+                if(sample >= 1.0) {
+                    mouth_data[t] = static_cast<std::byte>(UINT8_MAX);
+                }
+                else if(sample <= 0.0) {
+                    mouth_data[t] = static_cast<std::byte>(0);
+                }
+                else {
+                    mouth_data[t] = static_cast<std::byte>(sample * UINT8_MAX);
+                }
+            }
 
-                    return mouth_data;
-                };
-
-                // Generate mouth data if needed
-                if(is_dialogue) {
-                    // Convert samples to 8-bit unsigned so we can use it to generate mouth data
-                    auto samples_float = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-                    std::vector<std::uint8_t> pcm_8_bit;
-                    pcm_8_bit.reserve(samples_float.size());
-                    for(auto &f : samples_float) {
-                        float ff = f;
-                        if(ff < 0.0F) {
-                            ff *= -1.0F;
-                        }
-                        pcm_8_bit.emplace_back(static_cast<std::uint8_t>(ff * UINT8_MAX));
-                    }
-                    samples_float = {};
-                    generate_mouth_data(pcm_8_bit);
-                }
-
-                // Do the encoding thing
-                std::vector<std::byte> samples;
-                std::size_t buffer_size = 0;
-
-                switch(format) {
-                    // Basically, just make it 16-bit big endian
-                    case SoundFormat::SOUND_FORMAT_16_BIT_PCM:
-                        samples = Invader::SoundEncoder::convert_to_16_bit_pcm_big_endian(pcm, permutation->bits_per_sample);
-                        buffer_size = samples.size();
-                        break;
-
-                    // Encode to Vorbis in an Ogg container
-                    case SoundFormat::SOUND_FORMAT_OGG_VORBIS: {
-                        if(sound_options->compression_level > 1.0F) {
-                            sound_options->compression_level = 1.0F;
-                        }
-                        else if(sound_options->compression_level < 0.0F) {
-                            sound_options->compression_level = 0.0F;
-                        }
-                        if(sound_options->bitrate.has_value()) {
-                            samples = Invader::SoundEncoder::encode_to_ogg_vorbis_cbr(pcm, permutation->bits_per_sample, permutation->channel_count, permutation->sample_rate, *sound_options->bitrate);
-                        }
-                        else {
-                            samples = Invader::SoundEncoder::encode_to_ogg_vorbis_vbr(pcm, permutation->bits_per_sample, permutation->channel_count, permutation->sample_rate, *sound_options->compression_level);
-                        }
-                        buffer_size = pcm.size() / (permutation->bits_per_sample / 8) * sizeof(std::int16_t);
-                        break;
-                    }
+            return mouth_data;
+        };
+
+        // Generate mouth data if needed
+        if(is_dialogue) {
+            // Convert samples to 8-bit unsigned so we can use it to generate mouth data
+            auto samples_float = SoundEncoder::convert_int_to_float(pcm, permutation.bits_per_sample);
+            std::vector<std::uint8_t> pcm_8_bit;
+            pcm_8_bit.reserve(samples_float.size());
+            for(auto &f : samples_float) {
+                float ff = f;
+                if(ff < 0.0F) {
+                    ff *= -1.0F;
+                }
+                pcm_8_bit.emplace_back(static_cast<std::uint8_t>(ff * UINT8_MAX));
+            }
+            samples_float = {};
+            generate_mouth_data(pcm_8_bit);
+        }
+
+        // Do the encoding thing
+        std::vector<std::byte> samples;
+        std::size_t buffer_size = 0;
 
-                    // Encode to Xbox ADPCMeme
-                    case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
-                        samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation->bits_per_sample, permutation->channel_count);
-                        break;
+        switch(format) {
+            // Basically, just make it 16-bit big endian
+            case SoundFormat::SOUND_FORMAT_16_BIT_PCM:
+                samples = Invader::SoundEncoder::convert_to_16_bit_pcm_big_endian(pcm, permutation.bits_per_sample);
+                buffer_size = samples.size();
+                break;
 
-                    default:
-                        eprintf_error("Invalid format. What?");
-                        std::terminate();
+            // Encode to Vorbis in an Ogg container
+            case SoundFormat::SOUND_FORMAT_OGG_VORBIS:
+                if(sound_options.bitrate.has_value()) {
+                    samples = Invader::SoundEncoder::encode_to_ogg_vorbis_cbr(pcm, permutation.bits_per_sample, permutation.channel_count, permutation.sample_rate, *sound_options.bitrate);
                 }
+                else {
+                    samples = Invader::SoundEncoder::encode_to_ogg_vorbis_vbr(pcm, permutation.bits_per_sample, permutation.channel_count, permutation.sample_rate, *sound_options.compression_level);
+                }
+                buffer_size = pcm.size() / (permutation.bits_per_sample / 8) * sizeof(std::int16_t);
+                break;
 
-                // Set the default stuff
-                mutex->lock();
-                auto &p = sound_tag->pitch_ranges[pitch_range].permutations[pitch_range_permutation];
-                p.gain = 1.0F;
-                p.samples = samples;
-                p.buffer_size = buffer_size;
-                p.samples.shrink_to_fit();
-                mutex->unlock();
+            // Encode to Xbox ADPCMeme
+            case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
+                samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation.bits_per_sample, permutation.channel_count, sound_options.adpcm_lookahead, &thread_pool);
+                break;
 
-                // Finish up
-                (*thread_count)--;
-            };
+            default:
+                eprintf_error("Invalid format. What?");
+                std::terminate();
+        }
 
-            // Split things we can't trivially split losslessly
-            if(split && enable_threading_split_permutation_encoding) {
-                std::size_t max_split_size = SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
-
-                std::size_t digested = 0;
-                while(permutation.pcm.size() > 0) {
-                    // Basically, if we haven't encoded anything, use the i-th permutation, otherwise make a new one as a copy
-                    encoding_mutex.lock();
-                    auto &p = digested == 0 ? pitch_range.permutations[i] : pitch_range.permutations.emplace_back(pitch_range.permutations[i]);
-                    encoding_mutex.unlock();
-                    std::size_t remaining_size = permutation.pcm.size();
-                    std::size_t permutation_size = remaining_size > max_split_size ? max_split_size : remaining_size;
-
-                    // Encode it
-                    auto *sample_data_start = permutation.pcm.data();
-                    auto sample_data = std::vector<std::byte>(sample_data_start, sample_data_start + permutation_size);
-                    permutation.pcm = std::vector<std::byte>(permutation.pcm.begin() + permutation_size, permutation.pcm.end());
-                    permutation.pcm.shrink_to_fit();
-                    digested += permutation_size;
-
-                    if(permutation.pcm.size() == 0) {
-                        p.next_permutation_index = NULL_INDEX;
-                    }
-                    else {
-                        std::size_t next_permutation = pitch_range.permutations.size();
-                        if(next_permutation > MAX_PERMUTATIONS) {
-                            encoding_mutex.lock();
-                            eprintf_error("Maximum number of total permutations (%zu > %zu) exceeded", next_permutation, MAX_PERMUTATIONS);
-                            std::exit(EXIT_FAILURE);
-                        }
-                        p.next_permutation_index = static_cast<Index>(next_permutation);
-                    }
+        samples.shrink_to_fit();
+        return { std::move(samples), buffer_size };
+    };
+
+    // Get the size of each chunk a permutation is split into. The boundaries are decided before encoding so every chunk can be encoded in
+    // parallel while still coming out the same size as if the whole thing were encoded and then split.
+    auto get_split_size = [format](const SoundReader::Sound &permutation) -> std::size_t {
+        std::size_t bytes_per_sample_one_channel = permutation.bits_per_sample / 8;
+        std::size_t bytes_per_sample_all_channels = bytes_per_sample_one_channel * permutation.channel_count;
+        switch(format) {
+            // Each chunk holds exactly as many 16-bit samples as fit in the buffer
+            case SoundFormat::SOUND_FORMAT_16_BIT_PCM: {
+                std::size_t samples_per_split = SPLIT_BUFFER_SIZE / sizeof(std::int16_t);
+                return (samples_per_split - samples_per_split % permutation.channel_count) * bytes_per_sample_one_channel;
+            }
+
+            // Each chunk holds as many whole ADPCM blocks as fit in the buffer
+            case SoundFormat::SOUND_FORMAT_XBOX_ADPCM: {
+                std::size_t blocks_per_split = XBOX_ADPCM_SPLIT_SIZE / SoundEncoder::calculate_adpcm_block_size(permutation.channel_count);
+                return blocks_per_split * SoundEncoder::calculate_adpcm_pcm_block_size(permutation.channel_count) * bytes_per_sample_one_channel;
+            }
+
+            // Split by decoded size for everything else
+            default:
+                return SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
+        }
+    };
+
+    // Split permutations are handed to the encoder a chunk at a time as they're decoded, so they're never held in memory in full. Fitting to
+    // the ADPCM block size changes the start of the permutation based on its total length, though, so that still needs all of it first.
+    bool fit_adpcm_block_size = sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE;
+    bool stream_chunks = split && !(fit_adpcm_block_size && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM);
+
+    // A processing task stops to help encode once it's this many chunks ahead of the encoder
+    static constexpr std::size_t MAX_QUEUED_CHUNKS = 2;
+
+    // Start processing the next permutation, in order
+    std::size_t next_pitch_range = 0;
+    std::size_t next_permutation = 0;
+    auto start_next_permutation = [&]() {
+        while(next_pitch_range < pitch_range_count && next_permutation == pitch_ranges[next_pitch_range].first.size()) {
+            next_pitch_range++;
+            next_permutation = 0;
+        }
+        if(next_pitch_range == pitch_range_count) {
+            return;
+        }
 
-                    // Wait until we have threads cleared up
-                    wait_until_threads_are_open();
+        auto &job = jobs.emplace_back();
+        job.pitch_range = next_pitch_range;
+        job.permutation = next_permutation++;
+        job.processing = thread_pool.submit([&job, &permutation = pitch_ranges[job.pitch_range].first[job.permutation], &path = permutation_paths[job.pitch_range][job.permutation], encode_permutation, get_split_size, stream_chunks, split, highest_sample_rate, format, highest_channel_count, fit_adpcm_block_size, &sound_options, &thread_pool]() {
+            std::size_t chunks_done = 0;
+            auto encode_chunk = [&job, &permutation, &encode_permutation, &thread_pool, &chunks_done](std::vector<std::byte> &&pcm) {
+                job.chunks.emplace_back().task = thread_pool.submit([encode_permutation, pcm = std::move(pcm), &permutation]() {
+                    return encode_permutation(pcm, permutation);
+                });
+
+                // Don't get too far ahead of the encoder
+                while(job.chunks.size() - chunks_done > MAX_QUEUED_CHUNKS) {
+                    auto &chunk = job.chunks[chunks_done++];
+                    chunk.result = thread_pool.wait(chunk.task);
+                }
+            };
 
-                    // Punch it
-                    thread_count++;
-                    std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(sample_data), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+            std::vector<std::byte> pending;
+            auto split_pcm = [&pending, &encode_chunk, &get_split_size, &permutation](const std::byte *pcm, std::size_t size) {
+                auto max_split_size = get_split_size(permutation);
+                while(size > 0) {
+                    std::size_t amount = std::min(size, max_split_size - pending.size());
+                    pending.insert(pending.end(), pcm, pcm + amount);
+                    pcm += amount;
+                    size -= amount;
+                    if(pending.size() == max_split_size) {
+                        encode_chunk(std::exchange(pending, std::vector<std::byte>()));
+                    }
                 }
+            };
+
+            std::size_t pcm_size;
+            if(stream_chunks) {
+                pcm_size = process_permutation(permutation, path, highest_sample_rate, format, highest_channel_count, fit_adpcm_block_size, sound_options, split_pcm);
             }
             else {
-                // Wait until we have threads cleared up
-                wait_until_threads_are_open();
-
-                // Punch it
-                thread_count++;
-                auto &p = pitch_range.permutations[i];
-                p.next_permutation_index = NULL_INDEX;
-                std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(permutation.pcm), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+                pcm_size = process_permutation(permutation, path, highest_sample_rate, format, highest_channel_count, fit_adpcm_block_size, sound_options, nullptr);
+                if(split) {
+                    split_pcm(permutation.pcm.data(), permutation.pcm.size());
+                    permutation.pcm = std::vector<std::byte>();
+                }
+                else {
+                    encode_chunk(std::exchange(permutation.pcm, std::vector<std::byte>()));
+                }
             }
 
-            // Print sound info
-            encoding_mutex.lock();
-            oprintf("    %-32s%2zu:%06.3f (%2zu-bit %6s %5zu Hz)\n", permutation.name.c_str(), static_cast<std::size_t>(seconds) / 60, std::fmod(seconds, 60.0), static_cast<std::size_t>(permutation.input_bits_per_sample), permutation.input_channel_count == 1 ? "mono" : "stereo", static_cast<std::size_t>(permutation.input_sample_rate));
-            permutation.pcm = std::vector<std::byte>();
-            encoding_mutex.unlock();
-        }
-    }
-
-    // Wait until we have 0 threads left
-    wait_until_threads_are_done();
+            // Whatever's left is the last chunk
+            if(!pending.empty() || job.chunks.empty()) {
+                encode_chunk(std::move(pending));
+            }
 
-    // Next, if we can split losslessly, do it
-    if(split && !enable_threading_split_permutation_encoding) {
-        auto split_size = format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM ? XBOX_ADPCM_SPLIT_SIZE : SPLIT_BUFFER_SIZE;
+            return pcm_size;
+        });
+    };
 
-        for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
-            auto &pitch_range = sound_tag.pitch_ranges[pr];
-            for(std::size_t ap = 0; ap < pitch_range.actual_permutation_count; ap++) {
-                auto *next_permutation = &pitch_range.permutations[ap];
-                auto samples = std::move(next_permutation->samples);
-                next_permutation->samples.clear();
-                auto permutation_template = *next_permutation;
-                permutation_template.next_permutation_index = NULL_INDEX;
-                std::size_t samples_offset = 0;
+    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+        auto &pitch_range = sound_tag.pitch_ranges[pitch_range_index[pr]];
+        auto actual_permutation_count = pitch_ranges[pr].first.size();
+        pitch_range.actual_permutation_count = actual_permutation_count;
+        pitch_range.permutations.resize(actual_permutation_count);
 
-                while(true) {
-                    auto subpermutation_size = std::min(split_size, samples.size() - samples_offset);
-                    next_permutation->samples = std::vector<std::byte>(samples.data() + samples_offset, samples.data() + samples_offset + subpermutation_size);
-                    samples_offset += subpermutation_size;
+        for(auto &p : pitch_range.permutations) {
+            p.format = sound_tag.format;
+        }
+    }
 
-                    // If we've hit the end, we're done
-                    if(samples_offset == samples.size()) {
-                        break;
-                    }
+    // Only have one permutation per thread in flight at a time so memory use doesn't grow with how many there are
+    for(std::size_t t = 0; t < thread_pool.get_thread_count(); t++) {
+        start_next_permutation();
+    }
 
-                    // Add the next permutation
-                    next_permutation->next_permutation_index = pitch_range.permutations.size();
-                    next_permutation = &pitch_range.permutations.emplace_back(permutation_template);
-                }
+    // Encode this, putting each permutation into the tag as soon as it's done
+    while(!jobs.empty()) {
+        auto &job = jobs.front();
+        auto pcm_size = thread_pool.wait(job.processing);
+        start_next_permutation();
+
+        // Get the permutation and set its name, too
+        auto &pitch_range = sound_tag.pitch_ranges[pitch_range_index[job.pitch_range]];
+        auto &permutation = pitch_ranges[job.pitch_range].first[job.permutation];
+        std::size_t i = job.permutation;
+        std::strncpy(pitch_range.permutations[i].name.string, permutation.name.c_str(), sizeof(pitch_range.permutations[i].name.string) - 1);
+
+        // Basically, every chunk after the first goes into a new permutation made as a copy of this one
+        std::vector<std::size_t> chunk_permutations = { i };
+        for(std::size_t c = 1; c < job.chunks.size(); c++) {
+            std::size_t new_permutation = pitch_range.permutations.size();
+            if(new_permutation > MAX_PERMUTATIONS) {
+                eprintf_error("Maximum number of total permutations (%zu > %zu) exceeded", new_permutation, MAX_PERMUTATIONS);
+                throw InvalidInputSoundException();
             }
+            pitch_range.permutations[chunk_permutations.back()].next_permutation_index = static_cast<Index>(new_permutation);
+            pitch_range.permutations.emplace_back(pitch_range.permutations[i]);
+            chunk_permutations.emplace_back(new_permutation);
         }
+        pitch_range.permutations[chunk_permutations.back()].next_permutation_index = NULL_INDEX;
+
+        // Wait until it's encoded, then set the default stuff
+        for(std::size_t c = 0; c < job.chunks.size(); c++) {
+            auto &chunk = job.chunks[c];
+            auto encoded = chunk.result.has_value() ? std::move(*chunk.result) : thread_pool.wait(chunk.task);
+            auto &p = pitch_range.permutations[chunk_permutations[c]];
+            p.gain = 1.0F;
+            p.samples.assign(encoded.first.begin(), encoded.first.end());
+            p.buffer_size = encoded.second;
+        }
+
+        // Print sound info
+        double seconds = pcm_size / static_cast<double>(static_cast<std::size_t>(permutation.sample_rate) * static_cast<std::size_t>(permutation.bits_per_sample / 8) * static_cast<std::size_t>(permutation.channel_count));
+        oprintf("    %-32s%2zu:%06.3f (%2zu-bit %6s %5zu Hz)\n", permutation.name.c_str(), static_cast<std::size_t>(seconds) / 60, std::fmod(seconds, 60.0), static_cast<std::size_t>(permutation.input_bits_per_sample), permutation.input_channel_count == 1 ? "mono" : "stereo", static_cast<std::size_t>(permutation.input_sample_rate));
+        jobs.pop_front();
     }
 
     auto sound_tag_data = sound_tag.generate_hek_tag_data(TagFourCC::TAG_FOURCC_SOUND, true);
@@ -652,6 +682,9 @@ int main(int argc, const char **argv) {
     options.emplace_back("bitrate", 'b', 1, "Set the bitrate in kilobits per second. This only applies to vorbis.", "<br>");
     options.emplace_back("class", 'c', 1, "Set the class. This is required when generating new sounds. Can be: ambient_computers, ambient_machinery, ambient_nature, device_computers, device_door, device_force_field, device_machinery, device_nature, first_person_damage, game_event, music, object_impacts, particle_impacts, projectile_impact, projectile_detonation, scripted_dialog_force_unspatialized, scripted_dialog_other, scripted_dialog_player, scripted_effect, slow_particle_impacts, unit_dialog, unit_footsteps, vehicle_collision, vehicle_engine, weapon_charge, weapon_empty, weapon_fire, weapon_idle, weapon_overheat, weapon_ready, weapon_reload", "<class>");
     options.emplace_back("threads", 'j', 1, "Set the number of threads to use for parallel resampling and encoding. Default: CPU thread count");
+    options.emplace_back("adpcm-lookahead", 'L', 1, "Set the lookahead depth for Xbox ADPCM encoding. This can be between 0 and 8. Higher values are more accurate but much slower. Default: 3", "<#>");
+    options.emplace_back("resample-quality", 'q', 1, "Set the resampling quality. Can be: best, medium, fastest, or linear. Lower qualities are faster. Default: best", "<qlty>");
+    options.emplace_back("resample-cache", 'R', 1, "Cache resampled audio in the specified directory so unchanged files do not need to be resampled again.", "<dir>");
 
     static constexpr char DESCRIPTION[] = "Create or modify a sound tag.";
     static constexpr char USAGE[] = "[options] <sound-tag>";
@@ -688,6 +721,43 @@ int main(int argc, const char **argv) {
                 sound_options.split = false;
                 break;
 
+            case 'L':
+                try {
+                    sound_options.adpcm_lookahead = std::stoul(arguments[0]);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid ADPCM lookahead %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                if(sound_options.adpcm_lookahead > SoundEncoder::MAX_XBOX_ADPCM_LOOKAHEAD) {
+                    eprintf_error("ADPCM lookahead must be between 0 and %zu", SoundEncoder::MAX_XBOX_ADPCM_LOOKAHEAD);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'q':
+                if(std::strcmp(arguments[0], "best") == 0) {
+                    sound_options.resample_quality = SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_BEST;
+                }
+                else if(std::strcmp(arguments[0], "medium") == 0) {
+                    sound_options.resample_quality = SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_MEDIUM;
+                }
+                else if(std::strcmp(arguments[0], "fastest") == 0) {
+                    sound_options.resample_quality = SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_FASTEST;
+                }
+                else if(std::strcmp(arguments[0], "linear") == 0) {
+                    sound_options.resample_quality = SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_LINEAR;
+                }
+                else {
+                    eprintf_error("Unknown resample quality %s (should be \"best\", \"medium\", \"fastest\", or \"linear\")", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'R':
+                sound_options.resample_cache = arguments[0];
+                break;
+
             case 'b':
                 try {
                     sound_options.bitrate = static_cast<std::uint16_t>(std::stol(arguments[0]));
@@ -804,7 +874,7 @@ int main(int argc, const char **argv) {
     }
 }
 
-static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count) {
+static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, std::vector<std::filesystem::path> &permutation_paths, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count) {
     for(auto &wav : std::filesystem::directory_iterator(directory)) {
         // Skip directories
         auto path = wav.path();
@@ -814,14 +884,14 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
         }
         auto extension = path.extension().string();
 
-        // Get the sound
+        // Get the sound's format (the samples themselves are streamed in later when it's processed)
         SoundReader::Sound sound = {};
         try {
             if(extension == ".wav") {
-                sound = SoundReader::sound_from_wav_file(path);
+                sound = SoundReader::stream_wav_file(path, nullptr);
             }
             else if(extension == ".flac") {
-                sound = SoundReader::sound_from_flac_file(path);
+                sound = SoundReader::stream_flac_file(path, nullptr);
             }
             else {
                 eprintf_error("Unknown file format for %s", path.string().c_str());
@@ -864,9 +934,6 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
             std::exit(EXIT_FAILURE);
         }
 
-        // Make it small
-        sound.pcm.shrink_to_fit();
-
         // Add it
         std::size_t i;
         for(i = 0; i < permutations.size(); i++) {
@@ -879,30 +946,19 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
             }
         }
         permutations.insert(permutations.begin() + i, std::move(sound));
+        permutation_paths.insert(permutation_paths.begin() + i, std::move(path));
     }
 }
 
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size) {
-    // Calculate some stuff
-    std::size_t bytes_per_sample = permutation->bits_per_sample / 8;
-    std::size_t sample_count = permutation->pcm.size() / bytes_per_sample;
-
-    // Mutex for errors
-    static std::mutex error_mutex;
-
-    // Bits per sample doesn't match; we can fix that though
-    if(bytes_per_sample != sizeof(std::uint16_t) && (format == SoundFormat::SOUND_FORMAT_16_BIT_PCM || format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM)) {
-        std::size_t new_bytes_per_sample = sizeof(std::uint16_t);
-        permutation->pcm = SoundEncoder::convert_int_to_int(permutation->pcm, permutation->bits_per_sample, new_bytes_per_sample * 8);
-        bytes_per_sample = new_bytes_per_sample;
-        permutation->bits_per_sample = new_bytes_per_sample * 8;
-    }
+static std::vector<std::byte> convert_channel_count(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, std::size_t new_channel_count) {
+    std::size_t bytes_per_sample = bits_per_sample / 8;
+    std::size_t sample_count = pcm.size() / bytes_per_sample;
+    const std::byte *old_sample = pcm.data();
+    const std::byte *old_sample_end = pcm.data() + pcm.size();
 
     // Mono -> Stereo (just duplicate the channels)
-    if(permutation->channel_count == 1 && highest_channel_count == 2) {
+    if(channel_count == 1 && new_channel_count == 2) {
         std::vector<std::byte> new_samples(sample_count * 2 * bytes_per_sample);
-        const std::byte *old_sample = permutation->pcm.data();
-        const std::byte *old_sample_end = permutation->pcm.data() + permutation->pcm.size();
         std::byte *new_sample = new_samples.data();
 
         while(old_sample < old_sample_end) {
@@ -912,103 +968,293 @@ static void process_permutation_thread(SoundReader::Sound *permutation, std::uin
             new_sample += bytes_per_sample * 2;
         }
 
-        permutation->pcm = std::move(new_samples);
-        permutation->pcm.shrink_to_fit();
-        permutation->channel_count = 2;
+        return new_samples;
     }
 
     // Stereo -> Mono (mixdown)
-    else if(permutation->channel_count == 2 && highest_channel_count == 1) {
+    else if(channel_count == 2 && new_channel_count == 1) {
         std::vector<std::byte> new_samples(sample_count * bytes_per_sample / 2);
         std::byte *new_sample = new_samples.data();
-        const std::byte *old_sample = permutation->pcm.data();
-        const std::byte *old_sample_end = permutation->pcm.data() + permutation->pcm.size();
 
         while(old_sample < old_sample_end) {
-            std::int32_t a = Invader::SoundEncoder::read_sample(old_sample, permutation->bits_per_sample);
-            std::int32_t b = Invader::SoundEncoder::read_sample(old_sample + bytes_per_sample, permutation->bits_per_sample);
+            std::int32_t a = Invader::SoundEncoder::read_sample(old_sample, bits_per_sample);
+            std::int32_t b = Invader::SoundEncoder::read_sample(old_sample + bytes_per_sample, bits_per_sample);
             std::int64_t ab = a + b;
-            Invader::SoundEncoder::write_sample(static_cast<std::int32_t>(ab / 2), new_sample, permutation->bits_per_sample);
+            Invader::SoundEncoder::write_sample(static_cast<std::int32_t>(ab / 2), new_sample, bits_per_sample);
 
             old_sample += bytes_per_sample * 2;
             new_sample += bytes_per_sample;
         }
 
-        permutation->pcm = std::move(new_samples);
-        permutation->pcm.shrink_to_fit();
-        permutation->channel_count = 1;
+        return new_samples;
+    }
+
+    return pcm;
+}
+
+static std::optional<std::uint64_t> hash_file(const std::filesystem::path &path) {
+    // 64-bit FNV-1a
+    std::uint64_t hash = 0xCBF29CE484222325;
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::vector<char> buffer(256 * 1024);
+    while(file) {
+        file.read(buffer.data(), buffer.size());
+        auto read = static_cast<std::size_t>(file.gcount());
+        for(std::size_t i = 0; i < read; i++) {
+            hash = (hash ^ static_cast<std::uint8_t>(buffer[i])) * 0x100000001B3;
+        }
+    }
+    if(file.bad()) {
+        return std::nullopt;
+    }
+
+    return hash;
+}
+
+static std::optional<std::filesystem::path> get_resample_cache_path(const std::filesystem::path &path, std::uint32_t sample_rate, std::uint16_t channel_count, std::size_t bits_per_sample, SoundResamplerQuality quality, bool fit_adpcm_block_size, const std::filesystem::path &cache_directory) {
+    auto hash = hash_file(path);
+    if(!hash.has_value()) {
+        return std::nullopt;
+    }
+
+    static const char *QUALITY_NAMES[] = { "best", "medium", "fastest", "linear" };
+    char name[256];
+    std::snprintf(name, sizeof(name), "%016llx-%u-%uch-%zubit-%s%s.pcm", static_cast<unsigned long long>(*hash), sample_rate, channel_count, bits_per_sample, QUALITY_NAMES[quality], fit_adpcm_block_size ? "-adpcm" : "");
+    return cache_directory / name;
+}
+
+static constexpr std::size_t RESAMPLE_CACHE_READ_SIZE = 256 * 1024;
+
+static bool read_resample_cache(const std::filesystem::path &cache_path, std::size_t size, const std::function<void (const std::byte *pcm, std::size_t size)> &output) {
+    std::ifstream file(cache_path, std::ios::binary);
+    if(!file.is_open()) {
+        return false;
+    }
+
+    // Once anything has been passed on, it can't be taken back, so failing partway through is an error rather than a cache miss
+    std::vector<std::byte> buffer(std::min(size, RESAMPLE_CACHE_READ_SIZE));
+    for(std::size_t offset = 0; offset < size; offset += buffer.size()) {
+        std::size_t amount = std::min(buffer.size(), size - offset);
+        if(!file.read(reinterpret_cast<char *>(buffer.data()), amount)) {
+            eprintf_error("Failed to read %s from the resample cache", cache_path.string().c_str());
+            throw FailedToOpenFileException();
+        }
+        output(buffer.data(), amount);
+    }
+
+    return true;
+}
+
+class ResampleCacheWriter {
+public:
+    /**
+     * Start writing PCM to the resample cache. It's written to a temporary file first so a partially written file is never picked up by
+     * another instance. The name has the process ID, the thread, and a random number in it so no two writers (in this process or any
+     * other) use the same file.
+     * @param cache_path path in the resample cache
+     */
+    ResampleCacheWriter(const std::filesystem::path &cache_path) : cache_path(cache_path) {
+        std::error_code ec;
+        std::filesystem::create_directories(cache_path.parent_path(), ec);
+        char suffix[64];
+        std::snprintf(suffix, sizeof(suffix), ".%ld-%zx-%08x.tmp", static_cast<long>(getpid()), std::hash<std::thread::id>()(std::this_thread::get_id()), std::random_device()());
+        this->temp_path = cache_path;
+        this->temp_path += suffix;
+        this->file.open(this->temp_path, std::ios::binary);
+    }
+
+    /**
+     * Append PCM to the file
+     * @param pcm  PCM to append
+     * @param size size of the PCM in bytes
+     */
+    void write(const std::byte *pcm, std::size_t size) {
+        this->file.write(reinterpret_cast<const char *>(pcm), size);
+    }
+
+    /**
+     * Move the finished file into the cache
+     */
+    void commit() {
+        this->file.close();
+        this->committed = true;
+
+        std::error_code ec;
+        if(!this->file) {
+            eprintf_warn("Failed to save %s to the resample cache", this->cache_path.string().c_str());
+            std::filesystem::remove(this->temp_path, ec);
+            return;
+        }
+        std::filesystem::rename(this->temp_path, this->cache_path, ec);
+        if(ec) {
+            eprintf_warn("Failed to save %s to the resample cache: %s", this->cache_path.string().c_str(), ec.message().c_str());
+            std::filesystem::remove(this->temp_path, ec);
+        }
+    }
+
+    ~ResampleCacheWriter() {
+        // Don't leave anything behind if it was never finished (e.g. decoding failed)
+        if(!this->committed) {
+            this->file.close();
+            std::error_code ec;
+            std::filesystem::remove(this->temp_path, ec);
+        }
+    }
+
+private:
+    std::filesystem::path cache_path;
+    std::filesystem::path temp_path;
+    std::ofstream file;
+    bool committed = false;
+};
+
+static std::size_t process_permutation(SoundReader::Sound &permutation, const std::filesystem::path &path, std::uint32_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, const SoundOptions &sound_options, const std::function<void (const std::byte *pcm, std::size_t size)> &output) {
+    // Bits per sample doesn't match; we can fix that though
+    std::size_t bits_per_sample = permutation.bits_per_sample;
+    if(bits_per_sample != 16 && (format == SoundFormat::SOUND_FORMAT_16_BIT_PCM || format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM)) {
+        bits_per_sample = 16;
+    }
+    std::size_t bytes_per_sample = bits_per_sample / 8;
+    auto quality = sound_options.resample_quality;
+    fit_adpcm_block_size = fit_adpcm_block_size && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM;
+
+    // Set stuff. This is done first so whatever gets the output knows what it's getting.
+    auto input_sample_rate = permutation.sample_rate;
+    permutation.bits_per_sample = bits_per_sample;
+    permutation.channel_count = highest_channel_count;
+    permutation.sample_rate = highest_sample_rate;
+
+    // Either pass the PCM on as it's made or hold onto all of it
+    permutation.pcm.clear();
+    std::size_t pcm_size = 0;
+    std::optional<ResampleCacheWriter> cache_writer;
+    auto output_pcm = [&permutation, &pcm_size, &cache_writer, &output](const std::byte *pcm, std::size_t size) {
+        pcm_size += size;
+        if(output) {
+            if(cache_writer.has_value()) {
+                cache_writer->write(pcm, size);
+            }
+            output(pcm, size);
+        }
+        else {
+            permutation.pcm.insert(permutation.pcm.end(), pcm, pcm + size);
+        }
+    };
+
+    // If this will need to be resampled, check if we already did it. The cache is keyed by the file's contents and everything that affects the output.
+    std::optional<std::filesystem::path> cache_path;
+    bool may_resample = highest_sample_rate != input_sample_rate || fit_adpcm_block_size;
+    if(may_resample && sound_options.resample_cache.has_value()) {
+        cache_path = get_resample_cache_path(path, highest_sample_rate, highest_channel_count, bits_per_sample, quality, fit_adpcm_block_size, *sound_options.resample_cache);
+        if(cache_path.has_value()) {
+            std::error_code ec;
+            auto cached_size = std::filesystem::file_size(*cache_path, ec);
+            if(!ec && cached_size % (bytes_per_sample * highest_channel_count) == 0) {
+                if(!output) {
+                    permutation.pcm.reserve(cached_size);
+                }
+                if(read_resample_cache(*cache_path, cached_size, output_pcm)) {
+                    return pcm_size;
+                }
+            }
+        }
     }
 
     // Sample rate doesn't match; this can be fixed with resampling
-    if(static_cast<double>(highest_sample_rate) != permutation->sample_rate) {
-        double ratio = static_cast<double>(highest_sample_rate) / permutation->sample_rate;
-        std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-        std::vector<float> new_samples(float_samples.size() * ratio);
-        permutation->sample_rate = highest_sample_rate;
-
-        // Resample it
-        SRC_DATA data = {};
-        data.data_in = float_samples.data();
-        data.data_out = new_samples.data();
-        data.input_frames = float_samples.size() / permutation->channel_count;
-        data.output_frames = new_samples.size() / permutation->channel_count;
-        data.src_ratio = ratio;
-        int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
-        if(res) {
-            error_mutex.lock();
-            eprintf_error("Failed to resample: %s", src_strerror(res));
-            std::exit(EXIT_FAILURE);
+    std::optional<SoundResampler> resampler;
+    if(highest_sample_rate != input_sample_rate) {
+        resampler.emplace(highest_channel_count, bits_per_sample, static_cast<double>(highest_sample_rate) / input_sample_rate, quality);
+    }
+    bool resampled = resampler.has_value();
+
+    // When passing it on, it's cached as it goes since it's never all here at once
+    if(output && resampled && cache_path.has_value()) {
+        cache_writer.emplace(*cache_path);
+    }
+
+    // Decode, convert, and resample it a piece at a time, so at most the output is ever held in memory in full
+    std::vector<std::byte> resampled_pcm;
+    auto process_pcm = [&output_pcm, &resampler, &resampled_pcm, bits_per_sample, highest_channel_count](const SoundReader::Sound &sound, const std::byte *pcm, std::size_t size) {
+        auto converted = std::vector<std::byte>(pcm, pcm + size);
+        if(sound.bits_per_sample != bits_per_sample) {
+            converted = SoundEncoder::convert_int_to_int(converted, sound.bits_per_sample, bits_per_sample);
+        }
+        if(sound.channel_count != highest_channel_count) {
+            converted = convert_channel_count(converted, bits_per_sample, sound.channel_count, highest_channel_count);
+        }
+        if(resampler.has_value()) {
+            resampler->process(converted.data(), converted.size(), resampled_pcm);
+            output_pcm(resampled_pcm.data(), resampled_pcm.size());
+            resampled_pcm.clear();
         }
-        new_samples.resize(data.output_frames_gen * permutation->channel_count);
+        else {
+            output_pcm(converted.data(), converted.size());
+        }
+    };
 
-        // Set stuff
-        if(format == SoundFormat::SOUND_FORMAT_16_BIT_PCM) {
-            bytes_per_sample = sizeof(std::uint16_t);
+    auto extension = path.extension().string();
+    try {
+        if(extension == ".wav") {
+            SoundReader::stream_wav_file(path, process_pcm);
+        }
+        else {
+            SoundReader::stream_flac_file(path, process_pcm);
         }
-        permutation->sample_rate = highest_sample_rate;
-        permutation->bits_per_sample = bytes_per_sample * 8;
-        sample_count = new_samples.size();
-        permutation->pcm = SoundEncoder::convert_float_to_int(new_samples, permutation->bits_per_sample);
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to load %s: %s", path.string().c_str(), e.what());
+        throw;
     }
 
+    if(resampler.has_value()) {
+        resampler->finish(resampled_pcm);
+        output_pcm(resampled_pcm.data(), resampled_pcm.size());
+    }
+
+    if(output) {
+        if(cache_writer.has_value()) {
+            cache_writer->commit();
+        }
+        return pcm_size;
+    }
+
+    permutation.pcm.shrink_to_fit();
+    std::size_t sample_count = permutation.pcm.size() / bytes_per_sample;
 
     // Add samples to fit block size via resampling
     auto adpcm_block_size = SoundEncoder::calculate_adpcm_pcm_block_size(highest_channel_count);
     auto trip_adpcm_block_size = adpcm_block_size * 123;
     auto quad_adpcm_block_size = adpcm_block_size * 124;
 
-    if(fit_adpcm_block_size && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM && sample_count > quad_adpcm_block_size) {
+    if(fit_adpcm_block_size && sample_count > quad_adpcm_block_size) {
+        // Squeeze the first 124 blocks into this many samples so the total is a multiple of the block size (only those samples need resampling)
         std::size_t delta = trip_adpcm_block_size + (adpcm_block_size - (sample_count % adpcm_block_size));
-        if(delta > 0) {
+        if(delta != quad_adpcm_block_size) {
             double ratio = delta / static_cast<double>(quad_adpcm_block_size);
-            std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-            std::vector<float> new_samples(float_samples.size() * ratio);
-            auto new_quad = static_cast<std::size_t>(quad_adpcm_block_size * ratio);
-
-            // Resample it
-            SRC_DATA data = {};
-            data.data_in = float_samples.data();
-            data.data_out = new_samples.data();
-            data.input_frames = float_samples.size() / permutation->channel_count;
-            data.output_frames = new_samples.size() / permutation->channel_count;
-            data.src_ratio = ratio;
-            int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
-            if(res) {
-                error_mutex.lock();
-                eprintf_error("Failed to resample: %s", src_strerror(res));
-                std::exit(EXIT_FAILURE);
-            }
-
-            new_samples.resize(data.output_frames_gen * permutation->channel_count);
-            auto new_int_samples = SoundEncoder::convert_float_to_int(new_samples, permutation->bits_per_sample);
-
-            permutation->pcm.erase(permutation->pcm.begin(), permutation->pcm.begin() + quad_adpcm_block_size * bytes_per_sample);
-            permutation->pcm.insert(permutation->pcm.begin(), new_int_samples.begin(), new_int_samples.begin() + new_quad * bytes_per_sample);
-
-            sample_count -= quad_adpcm_block_size;
-            sample_count += new_quad;
+            std::vector<std::byte> new_int_samples;
+            SoundResampler block_resampler(highest_channel_count, bits_per_sample, ratio, quality);
+            block_resampler.process(permutation.pcm.data(), quad_adpcm_block_size * bytes_per_sample, new_int_samples);
+            block_resampler.finish(new_int_samples);
+            new_int_samples.resize(delta * bytes_per_sample);
+
+            // Write them over the end of the old blocks and drop whatever's left in front of them
+            std::size_t removed_size = (quad_adpcm_block_size - delta) * bytes_per_sample;
+            std::copy(new_int_samples.begin(), new_int_samples.end(), permutation.pcm.begin() + removed_size);
+            permutation.pcm.erase(permutation.pcm.begin(), permutation.pcm.begin() + removed_size);
+            resampled = true;
         }
     }
 
-    (*thread_count)--;
+    // Only cache it if it was actually resampled; otherwise decoding it again is just as fast
+    if(resampled && cache_path.has_value()) {
+        ResampleCacheWriter writer(*cache_path);
+        writer.write(permutation.pcm.data(), permutation.pcm.size());
+        writer.commit();
+    }
+
+    return permutation.pcm.size();
 }
@@ -3,6 +3,8 @@
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
+#include <invader/thread_pool.hpp>
+#include <algorithm>
 #include <memory>
 #include <cstdint>
 
@@ -12,7 +14,13 @@ extern "C" {
 
 namespace Invader::SoundEncoder {
     static constexpr std::size_t code_chunks_count = 8;
-    
+
+    // Number of blocks encoded by each task when encoding in parallel. This is fixed so the output doesn't depend on the number of threads.
+    static constexpr std::size_t parallel_block_count = 256;
+
+    // Number of blocks before each parallel range that are encoded (and discarded) to warm up the range's context
+    static constexpr std::size_t parallel_warmup_block_count = 2;
+
     static std::size_t calculate_samples_per_block() noexcept {
         return code_chunks_count * 8;
     }
@@ -20,9 +28,49 @@ namespace Invader::SoundEncoder {
     std::size_t calculate_adpcm_pcm_block_size(std::size_t channel_count) noexcept {
         return calculate_samples_per_block() * channel_count;
     }
+
+    std::size_t calculate_adpcm_block_size(std::size_t channel_count) noexcept {
+        return (code_chunks_count * 4 + 4) * channel_count;
+    }
+
+    // Encode a range of whole blocks with its own context, seeded from the first block of the range. If warmup_block_count is nonzero, pcm_stream
+    // starts that many blocks before the range, and those blocks are encoded and thrown away first so the context settles into the same state a
+    // context that encoded everything before the range would likely be in.
+    static void encode_xbox_adpcm_blocks(const std::int16_t *pcm_stream, std::uint8_t *adpcm_stream, std::size_t block_count, std::size_t warmup_block_count, std::size_t channel_count, std::size_t lookahead) {
+        std::size_t samples_per_block = calculate_samples_per_block();
+        std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);  // number of pcm sint16 per block
+        std::size_t adpcm_block_size = calculate_adpcm_block_size(channel_count);  // number of adpcm bytes per block
+        std::size_t num_bytes_decoded = 0;
+
+        std::int32_t average_deltas[2];
+        void *adpcm_context = NULL;
+
+        // calculate initial adpcm predictors using decaying average
+        for (std::size_t c = 0; c < channel_count; c++) {
+            average_deltas[c] = 0;
+            for (std::size_t i = c + pcm_block_size - channel_count; i >= channel_count; i -= channel_count) {
+                average_deltas[c] = (average_deltas[c] / 8) + std::abs(static_cast<std::int32_t>(pcm_stream[i]) - pcm_stream[i - channel_count]);
+            }
+            average_deltas[c] /= 8;
+        }
+
+        // Encode!
+        adpcm_context = adpcm_create_context(channel_count, lookahead, 0, average_deltas);
+        std::vector<std::uint8_t> warmup_block(adpcm_block_size);
+        for (std::size_t b = 0; b < warmup_block_count; b++) {
+            adpcm_encode_block(adpcm_context, warmup_block.data(), &num_bytes_decoded, pcm_stream, samples_per_block);
+            pcm_stream += pcm_block_size;
+        }
+        for (std::size_t b = 0; b < block_count; b++) {
+            adpcm_encode_block(adpcm_context, adpcm_stream, &num_bytes_decoded, pcm_stream, samples_per_block);
+            adpcm_stream += adpcm_block_size;
+            pcm_stream += pcm_block_size;
+        }
+        adpcm_free_context(adpcm_context);
+    }
     
     // From the MEK - I have no clue how to do this
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count) {
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, std::size_t lookahead, ThreadPool *thread_pool) {
         // Set some parameters
         std::unique_ptr<std::vector<std::byte>> pcm_16_bit_data_ptr;
         const std::int16_t *pcm_stream;
@@ -38,40 +86,43 @@ namespace Invader::SoundEncoder {
             pcm_stream = reinterpret_cast<const std::int16_t *>(pcm.data());
         }
 
-        // Set our output
-        std::vector<std::byte> adpcm_stream_buffer(sample_count * bytes_per_sample);
-        std::uint8_t *adpcm_stream = reinterpret_cast<std::uint8_t *>(adpcm_stream_buffer.data());
+        if(lookahead > MAX_XBOX_ADPCM_LOOKAHEAD) {
+            eprintf_error("ADPCM lookahead (%zu) exceeds the maximum lookahead of %zu", lookahead, MAX_XBOX_ADPCM_LOOKAHEAD);
+            throw InvalidArgumentException();
+        }
 
-        std::size_t samples_per_block = code_chunks_count * 8;
-        std::size_t block_count = sample_count / samples_per_block;
-        std::size_t num_bytes_decoded = 0;
+        std::size_t block_count = sample_count / calculate_samples_per_block();
+        std::size_t pcm_block_size = calculate_adpcm_pcm_block_size(channel_count);
+        std::size_t adpcm_block_size = calculate_adpcm_block_size(channel_count);
 
-        std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);  // number of pcm sint16 per block
-        std::size_t adpcm_block_size = (code_chunks_count * 4 + 4) * channel_count;  // number of adpcm bytes per block
+        // Set our output (partial blocks at the end are dropped)
+        std::vector<std::byte> adpcm_stream_buffer(block_count * adpcm_block_size);
+        auto *adpcm_stream = reinterpret_cast<std::uint8_t *>(adpcm_stream_buffer.data());
 
-        std::int32_t average_deltas[2];
-        void *adpcm_context = NULL;
+        if(block_count == 0) {
+            return adpcm_stream_buffer;
+        }
 
-        // calculate initial adpcm predictors using decaying average
-        for (std::size_t c = 0; c < channel_count; c++) {
-            average_deltas[c] = 0;
-            for (std::size_t i = c + pcm_block_size - channel_count; i >= channel_count; i -= channel_count) {
-                average_deltas[c] = (average_deltas[c] / 8) + std::abs(static_cast<std::int32_t>(pcm_stream[i]) - pcm_stream[i - channel_count]);
-            }
-            average_deltas[c] /= 8;
+        // Encode it all with one context
+        if(thread_pool == nullptr || block_count <= parallel_block_count) {
+            encode_xbox_adpcm_blocks(pcm_stream, adpcm_stream, block_count, 0, channel_count, lookahead);
         }
 
-        // Encode!
-        adpcm_context = adpcm_create_context(channel_count, 3, 0, average_deltas);
-        for (std::size_t b = 0; b < block_count; b++) {
-            adpcm_encode_block(adpcm_context, adpcm_stream, &num_bytes_decoded, pcm_stream, samples_per_block);
-            adpcm_stream += adpcm_block_size;
-            pcm_stream += pcm_block_size;
+        // Every block has its own header, so ranges of blocks can be encoded separately
+        else {
+            std::vector<std::future<void>> tasks;
+            for(std::size_t b = 0; b < block_count; b += parallel_block_count) {
+                std::size_t range_block_count = std::min(parallel_block_count, block_count - b);
+                std::size_t warmup_block_count = std::min(parallel_warmup_block_count, b);
+                auto *range_pcm = pcm_stream + (b - warmup_block_count) * pcm_block_size;
+                auto *range_adpcm = adpcm_stream + b * adpcm_block_size;
+                tasks.emplace_back(thread_pool->submit([range_pcm, range_adpcm, range_block_count, warmup_block_count, channel_count, lookahead]() {
+                    encode_xbox_adpcm_blocks(range_pcm, range_adpcm, range_block_count, warmup_block_count, channel_count, lookahead);
+                }));
+            }
+            thread_pool->wait_all(tasks);
         }
-        adpcm_free_context(adpcm_context);
 
-        // Resize to fit the buffer
-        adpcm_stream_buffer.resize(reinterpret_cast<std::byte *>(adpcm_stream) - adpcm_stream_buffer.data());
         return adpcm_stream_buffer;
     }
 }
@@ -5,6 +5,7 @@
 #include <invader/sound/sound_reader.hpp>
 #include <FLAC/stream_decoder.h>
 #include <memory>
+#include <exception>
 
 namespace Invader::SoundReader {
     static FLAC__StreamDecoderWriteStatus write_flac_data(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data) noexcept {
@@ -21,9 +22,8 @@ namespace Invader::SoundReader {
         return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
     }
 
-    static void on_flac_metadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data) noexcept {
+    static void read_flac_stream_info(SoundReader::Sound &result, const FLAC__StreamMetadata *metadata) noexcept {
         if(metadata->type == FLAC__MetadataType::FLAC__METADATA_TYPE_STREAMINFO) {
-            auto &result = *reinterpret_cast<SoundReader::Sound *>(client_data);
             auto &stream_info = metadata->data.stream_info;
             result.bits_per_sample = stream_info.bits_per_sample;
             result.channel_count = stream_info.channels;
@@ -34,6 +34,10 @@ namespace Invader::SoundReader {
         }
     }
 
+    static void on_flac_metadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data) noexcept {
+        read_flac_stream_info(*reinterpret_cast<SoundReader::Sound *>(client_data), metadata);
+    }
+
     static void on_flac_error(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *client_data) noexcept {
         reinterpret_cast<SoundReader::Sound *>(client_data)->pcm.clear();
     }
@@ -66,6 +70,95 @@ namespace Invader::SoundReader {
         return result;
     }
 
+    struct FLACPCMStream {
+        Sound result;
+        const PCMCallback *callback;
+        std::vector<std::byte> frame;
+        std::size_t bytes_streamed;
+        std::exception_ptr exception;
+        bool error;
+    };
+
+    static FLAC__StreamDecoderWriteStatus stream_flac_data(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data) noexcept {
+        auto &stream = *reinterpret_cast<FLACPCMStream *>(client_data);
+        auto bytes = frame->header.bits_per_sample / 8;
+
+        // Interleave the frame
+        stream.frame.resize(static_cast<std::size_t>(frame->header.blocksize) * frame->header.channels * bytes);
+        auto *pcm = stream.frame.data();
+        for(std::size_t i = 0; i < frame->header.blocksize; i++) {
+            for(std::size_t c = 0; c < frame->header.channels; c++) {
+                auto &s = buffer[c][i];
+                for(std::size_t b = 0; b < bytes; b++) {
+                    *(pcm++) = static_cast<std::byte>((s >> b * 8) & 0xFF);
+                }
+            }
+        }
+
+        // Hand it off, holding onto any exception so it can be rethrown once the decoder is done
+        try {
+            (*stream.callback)(stream.result, stream.frame.data(), stream.frame.size());
+        }
+        catch(...) {
+            stream.exception = std::current_exception();
+            return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+        }
+        stream.bytes_streamed += stream.frame.size();
+
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    }
+
+    static void on_flac_stream_metadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data) noexcept {
+        read_flac_stream_info(reinterpret_cast<FLACPCMStream *>(client_data)->result, metadata);
+    }
+
+    static void on_flac_stream_error(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *client_data) noexcept {
+        reinterpret_cast<FLACPCMStream *>(client_data)->error = true;
+    }
+
+    Sound stream_flac_file(const std::filesystem::path &path, const PCMCallback &callback) {
+        FLACPCMStream stream = {};
+        stream.callback = &callback;
+        auto path_str = path.string();
+
+        FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+        try {
+            if(FLAC__stream_decoder_init_file(decoder, path_str.c_str(), stream_flac_data, on_flac_stream_metadata, on_flac_stream_error, &stream) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+                eprintf_error("Failed to init FLAC stream");
+                throw InvalidInputSoundException();
+            }
+
+            // If we just want the format, stop after the metadata
+            if(!callback) {
+                if(!FLAC__stream_decoder_process_until_end_of_metadata(decoder) || stream.result.sample_rate == 0) {
+                    eprintf_error("Failed to read FLAC metadata");
+                    throw InvalidInputSoundException();
+                }
+            }
+            else {
+                bool processed = FLAC__stream_decoder_process_until_end_of_stream(decoder);
+                if(stream.exception) {
+                    std::rethrow_exception(stream.exception);
+                }
+                if(!processed) {
+                    eprintf_error("Failed to process FLAC stream");
+                    throw InvalidInputSoundException();
+                }
+                if(stream.error || stream.bytes_streamed == 0) {
+                    eprintf_error("Invalid or empty PCM stream from FLAC");
+                    throw InvalidInputSoundException();
+                }
+            }
+            FLAC__stream_decoder_delete(decoder);
+        }
+        catch(std::exception &) {
+            FLAC__stream_decoder_delete(decoder);
+            throw;
+        }
+
+        return std::move(stream.result);
+    }
+
     struct StreamHolder {
         const std::byte *data;
         std::size_t data_length;
@@ -5,20 +5,30 @@
 #include <invader/sound/sound_reader.hpp>
 #include <invader/sound/sound_encoder.hpp>
 #include <memory>
+#include <fstream>
 #include <invader/file/file.hpp>
 #include "wav.hpp"
 
 namespace Invader::SoundReader {
     using namespace HEK;
 
-    Sound sound_from_wav(const std::byte *data, std::size_t data_length) {
-        Sound result = {};
-        std::size_t offset = 0;
-
-        #define READ_OR_BAIL(to_what) if(sizeof(to_what) > data_length - offset) { \
+    // Size of each piece of PCM passed to the callback when streaming
+    static constexpr std::size_t WAV_STREAM_CHUNK_SIZE = 256 * 1024;
+
+    /**
+     * Read the WAV header up to the start of the data subchunk
+     * @param  result         sound to write the format to
+     * @param  floating_point set to true if the data is floating point PCM (output)
+     * @param  read           function that reads the given number of bytes, returning false if it can't
+     * @param  skip           function that skips the given number of bytes
+     * @return                size of the data subchunk
+     */
+    template<typename ReadFunction, typename SkipFunction>
+    static std::size_t read_wav_header(Sound &result, bool &floating_point, ReadFunction read, SkipFunction skip) {
+        #define READ_OR_BAIL(to_what) if(!read(reinterpret_cast<std::uint8_t *>(&to_what), sizeof(to_what))) { \
             eprintf_error("Failed to read " # to_what); \
             throw InvalidInputSoundException(); \
-        } std::memcpy(reinterpret_cast<std::uint8_t *>(&to_what), data + offset, sizeof(to_what)); offset += sizeof(to_what);
+        }
 
         // Make sure everything is valid
         WAVChunk wav_chunk;
@@ -50,13 +60,14 @@ namespace Invader::SoundReader {
 
         // Handle WAV files that are too big
         std::size_t excess_data_ignored = fmt_subchunk_size - expected_fmt_subchunk_size;
-        offset += excess_data_ignored;
+        skip(excess_data_ignored);
 
         // Make sure it's something we can handle
         if(fmt_subchunk.audio_format != 1 && fmt_subchunk.audio_format != 3) {
             eprintf_error("WAV data type (%u) is not integer or floating point PCM", static_cast<unsigned int>(fmt_subchunk.audio_format));
             throw InvalidInputSoundException();
         }
+        floating_point = fmt_subchunk.audio_format == 3;
 
         // Get the values we need from the fmt header
         result.bits_per_sample = fmt_subchunk.bits_per_sample;
@@ -80,6 +91,15 @@ namespace Invader::SoundReader {
             eprintf_error("Sample rate is invalid");
             throw InvalidInputSoundException();
         }
+        if(floating_point && result.bits_per_sample != 32) {
+            eprintf_error("Only 32-bit floating point PCM is supported");
+            throw InvalidInputSoundException();
+        }
+
+        // Floating point PCM is converted to 24-bit integer PCM
+        if(floating_point) {
+            result.bits_per_sample = 24;
+        }
 
         // Search for the data subchunk
         WAVSubchunkHeader subchunk = {};
@@ -89,29 +109,49 @@ namespace Invader::SoundReader {
                 break;
             }
             else {
-                offset += subchunk.subchunk_size.read();
+                skip(subchunk.subchunk_size.read());
             }
         }
 
-        // Convert PCM to integer
-        std::size_t data_size = subchunk.subchunk_size.read();
-        if(data_size > data_length) {
-            eprintf_error("Data is out of bounds");
-        }
+        #undef READ_OR_BAIL
 
-        if(fmt_subchunk.audio_format == 1) {
-            result.pcm = std::vector<std::byte>(data_size);
-            std::memcpy(result.pcm.data(), data + offset, data_size);
-        }
-        else if(fmt_subchunk.audio_format == 3) {
+        return subchunk.subchunk_size.read();
+    }
+
+    // Convert a piece of WAV data into the PCM we output
+    static std::vector<std::byte> convert_wav_data(const std::byte *data, std::size_t data_size, bool floating_point) {
+        if(floating_point) {
             std::vector<float> pcm_float(data_size / sizeof(*pcm_float.data()));
-            std::memcpy(result.pcm.data(), data + offset, data_size);
-            result.bits_per_sample = 24;
-            result.pcm = SoundEncoder::convert_float_to_int(pcm_float, 24);
+            std::memcpy(pcm_float.data(), data, pcm_float.size() * sizeof(*pcm_float.data()));
+            return SoundEncoder::convert_float_to_int(pcm_float, 24);
         }
         else {
-            std::terminate();
+            return std::vector<std::byte>(data, data + data_size);
+        }
+    }
+
+    Sound sound_from_wav(const std::byte *data, std::size_t data_length) {
+        Sound result = {};
+        std::size_t offset = 0;
+        bool floating_point;
+
+        std::size_t data_size = read_wav_header(result, floating_point, [&data, &data_length, &offset](std::uint8_t *to, std::size_t size) -> bool {
+            if(offset > data_length || size > data_length - offset) {
+                return false;
+            }
+            std::memcpy(to, data + offset, size);
+            offset += size;
+            return true;
+        }, [&offset](std::size_t size) {
+            offset += size;
+        });
+
+        // Convert PCM to integer
+        if(offset > data_length || data_size > data_length - offset) {
+            eprintf_error("Data is out of bounds");
+            throw InvalidInputSoundException();
         }
+        result.pcm = convert_wav_data(data + offset, data_size, floating_point);
 
         return result;
     }
@@ -126,4 +166,48 @@ namespace Invader::SoundReader {
             throw FailedToOpenFileException();
         }
     }
+
+    Sound stream_wav_file(const std::filesystem::path &path, const PCMCallback &callback) {
+        Sound result = {};
+        bool floating_point;
+
+        std::ifstream file(path, std::ios::binary);
+        if(!file.is_open()) {
+            throw FailedToOpenFileException();
+        }
+
+        std::size_t data_size = read_wav_header(result, floating_point, [&file](std::uint8_t *to, std::size_t size) -> bool {
+            return static_cast<bool>(file.read(reinterpret_cast<char *>(to), size));
+        }, [&file](std::size_t size) {
+            file.seekg(size, std::ios::cur);
+        });
+
+        if(!callback) {
+            return result;
+        }
+
+        // Read whole frames at a time
+        std::size_t frame_size = result.input_channel_count * (result.input_bits_per_sample / 8);
+        std::vector<std::byte> chunk(WAV_STREAM_CHUNK_SIZE - WAV_STREAM_CHUNK_SIZE % frame_size);
+
+        std::size_t remaining = data_size - data_size % frame_size;
+        while(remaining > 0) {
+            std::size_t chunk_size = std::min(chunk.size(), remaining);
+            if(!file.read(reinterpret_cast<char *>(chunk.data()), chunk_size)) {
+                eprintf_error("Data is out of bounds");
+                throw InvalidInputSoundException();
+            }
+            remaining -= chunk_size;
+
+            if(floating_point) {
+                auto converted = convert_wav_data(chunk.data(), chunk_size, true);
+                callback(result, converted.data(), converted.size());
+            }
+            else {
+                callback(result, chunk.data(), chunk_size);
+            }
+        }
+
+        return result;
+    }
 }
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/sound/sound_resampler.hpp>
+#include <invader/sound/sound_encoder.hpp>
+#include <invader/printf.hpp>
+#include <invader/error.hpp>
+#include <samplerate.h>
+
+namespace Invader {
+    // Number of output frames to generate per src_process() call
+    static constexpr std::size_t OUTPUT_BUFFER_FRAMES = 4096;
+
+    SoundResampler::SoundResampler(std::size_t channel_count, std::size_t bits_per_sample, double ratio, SoundResamplerQuality quality) : channel_count(channel_count), bits_per_sample(bits_per_sample), ratio(ratio) {
+        int converter_type;
+        switch(quality) {
+            case SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_BEST:
+                converter_type = SRC_SINC_BEST_QUALITY;
+                break;
+            case SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_MEDIUM:
+                converter_type = SRC_SINC_MEDIUM_QUALITY;
+                break;
+            case SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_FASTEST:
+                converter_type = SRC_SINC_FASTEST;
+                break;
+            case SoundResamplerQuality::SOUND_RESAMPLER_QUALITY_LINEAR:
+                converter_type = SRC_LINEAR;
+                break;
+            default:
+                eprintf_error("Invalid resampler quality. What?");
+                throw InvalidArgumentException();
+        }
+
+        int error = 0;
+        this->state = src_new(converter_type, static_cast<int>(channel_count), &error);
+        if(this->state == nullptr) {
+            eprintf_error("Failed to start resampling: %s", src_strerror(error));
+            throw SoundEncodeFailureException();
+        }
+        this->output_buffer.resize(OUTPUT_BUFFER_FRAMES * channel_count);
+    }
+
+    SoundResampler::~SoundResampler() {
+        src_delete(reinterpret_cast<SRC_STATE *>(this->state));
+    }
+
+    void SoundResampler::process(const std::byte *pcm, std::size_t size, std::vector<std::byte> &output) {
+        this->input = SoundEncoder::convert_int_to_float(std::vector<std::byte>(pcm, pcm + size), this->bits_per_sample);
+        this->run(false, output);
+    }
+
+    void SoundResampler::finish(std::vector<std::byte> &output) {
+        this->input.clear();
+        this->run(true, output);
+    }
+
+    void SoundResampler::run(bool end_of_input, std::vector<std::byte> &output) {
+        SRC_DATA data = {};
+        data.data_in = this->input.data();
+        data.input_frames = this->input.size() / this->channel_count;
+        data.end_of_input = end_of_input;
+        data.src_ratio = this->ratio;
+
+        while(true) {
+            data.data_out = this->output_buffer.data();
+            data.output_frames = OUTPUT_BUFFER_FRAMES;
+
+            int res = src_process(reinterpret_cast<SRC_STATE *>(this->state), &data);
+            if(res) {
+                eprintf_error("Failed to resample: %s", src_strerror(res));
+                throw SoundEncodeFailureException();
+            }
+
+            // Append what we got
+            if(data.output_frames_gen > 0) {
+                auto *output_start = this->output_buffer.data();
+                auto generated = SoundEncoder::convert_float_to_int(std::vector<float>(output_start, output_start + data.output_frames_gen * this->channel_count), this->bits_per_sample);
+                output.insert(output.end(), generated.begin(), generated.end());
+            }
+
+            // Move past what was used
+            data.data_in += data.input_frames_used * this->channel_count;
+            data.input_frames -= data.input_frames_used;
+
+            // Once the input is used up, we're done (unless we're flushing, in which case we keep going until nothing else comes out)
+            if(data.input_frames_used == 0 && data.output_frames_gen == 0) {
+                break;
+            }
+            if(!end_of_input && data.input_frames == 0) {
+                break;
+            }
+        }
+
+        this->input.clear();
+    }
+}
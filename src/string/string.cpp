@@ -74,10 +74,10 @@ template <typename T, typename G, Invader::TagFourCC C> static std::vector<std::
 
         if(sizeof(T) == sizeof(char16_t)) {
             auto string_data = std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>{}.from_bytes(reinterpret_cast<const char *>(str.c_str()));
-            new_string_data = std::vector<std::byte>(reinterpret_cast<const std::byte *>(string_data.c_str()), reinterpret_cast<const std::byte *>(string_data.c_str() + string_data.size() + 1));
+            new_string_data.assign(reinterpret_cast<const std::byte *>(string_data.c_str()), reinterpret_cast<const std::byte *>(string_data.c_str() + string_data.size() + 1));
         }
         else {
-            new_string_data = std::vector<std::byte>(reinterpret_cast<const std::byte *>(str.c_str()), reinterpret_cast<const std::byte *>(str.c_str() + str.size() + 1));
+            new_string_data.assign(reinterpret_cast<const std::byte *>(str.c_str()), reinterpret_cast<const std::byte *>(str.c_str() + str.size() + 1));
         }
     }
 
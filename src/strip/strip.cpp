@@ -9,36 +9,48 @@
 #include <invader/tag/hek/definition.hpp>
 #include <invader/command_line_option.hpp>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/tag/parser/tag_arena.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/tag_batch.hpp>
+#include <invader/thread_pool.hpp>
+
+static Invader::File::TagBatch::Result strip_tag(const std::filesystem::path &file_path, Invader::File::TagBatch::Output &output) {
+    using namespace Invader::File;
 
-int strip_tag(const std::filesystem::path &file_path) {
     // Open the tag
-    auto tag = Invader::File::open_file(file_path);
+    auto tag = open_file(file_path);
     if(!tag.has_value()) {
-        eprintf_error("Failed to open %s", file_path.string().c_str());
-        return EXIT_FAILURE;
+        output.error("Failed to open %s", file_path.string().c_str());
+        return TagBatch::RESULT_FAILED;
     }
 
+    // Each thread reuses the same memory for every tag it parses
+    static thread_local Invader::Parser::TagArena tag_arena;
+
     // Get the header
     std::vector<std::byte> file_data;
     try {
         const auto *header = reinterpret_cast<const Invader::HEK::TagFileHeader *>(tag->data());
         Invader::HEK::TagFileHeader::validate_header(header, tag->size());
-        file_data = Invader::Parser::ParserStruct::parse_hek_tag_file(tag->data(), tag->size())->generate_hek_tag_data(header->tag_fourcc, true);
+        file_data = Invader::Parser::ParserStruct::parse_hek_tag_file(tag->data(), tag->size(), false, tag_arena.next_tag(tag->size()))->generate_hek_tag_data(header->tag_fourcc, true);
     }
     catch(std::exception &e) {
-        eprintf_error("Error: Failed to strip %s: %s", file_path.string().c_str(), e.what());
-        return EXIT_FAILURE;
+        output.error("Error: Failed to strip %s: %s", file_path.string().c_str(), e.what());
+        return TagBatch::RESULT_FAILED;
     }
 
-    if(!Invader::File::save_file(file_path, file_data)) {
-        eprintf_error("Error: Failed to write to %s.", file_path.string().c_str());
-        return EXIT_FAILURE;
+    // Tags that are already stripped don't need to be written again
+    switch(TagBatch::save_if_changed(file_path, file_data, &*tag)) {
+        case TagBatch::SAVE_RESULT_FAILED:
+            output.error("Error: Failed to write to %s.", file_path.string().c_str());
+            return TagBatch::RESULT_FAILED;
+        case TagBatch::SAVE_RESULT_UNCHANGED:
+            output.message("%s is already stripped", file_path.string().c_str());
+            return TagBatch::RESULT_UNCHANGED;
+        default:
+            output.success("Stripped %s", file_path.string().c_str());
+            return TagBatch::RESULT_CHANGED;
     }
-
-    oprintf_success("Stripped %s", file_path.string().c_str());
-
-    return EXIT_SUCCESS;
 }
 
 int main(int argc, char * const *argv) {
@@ -47,6 +59,7 @@ int main(int argc, char * const *argv) {
     options.emplace_back("tags", 't', 1, "Use the specified tags directory.", "<dir>");
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the tag path if specifying a tag.");
     options.emplace_back("all", 'a', 0, "Strip all tags in the tags directory.");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for parallel stripping when using --all. Default: CPU thread count");
 
     static constexpr char DESCRIPTION[] = "Strips extra hidden data from tags.";
     static constexpr char USAGE[] = "[options] <-a | tag.class>";
@@ -55,6 +68,7 @@ int main(int argc, char * const *argv) {
         std::optional<std::filesystem::path> tags;
         bool use_filesystem_path = false;
         bool all = false;
+        std::size_t max_threads = Invader::ThreadPool::default_thread_count();
     } strip_options;
 
     auto remaining_arguments = Invader::CommandLineOption::parse_arguments<StripOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, strip_options, [](char opt, const std::vector<const char *> &arguments, auto &strip_options) {
@@ -75,6 +89,19 @@ int main(int argc, char * const *argv) {
             case 'a':
                 strip_options.all = true;
                 break;
+            case 'j':
+                try {
+                    auto threads = std::stoi(arguments[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    strip_options.max_threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
         }
     });
     if(!strip_options.tags.has_value()) {
@@ -87,24 +114,13 @@ int main(int argc, char * const *argv) {
             return EXIT_FAILURE;
         }
 
-        std::size_t success = 0;
-        std::size_t total = 0;
-
-        auto recursively_strip_dir = [&total, &success](const std::filesystem::path &dir, auto &recursively_strip_dir) -> void {
-            for(auto i : std::filesystem::directory_iterator(dir)) {
-                if(i.is_directory()) {
-                    recursively_strip_dir(i, recursively_strip_dir);
-                }
-                else if(i.is_regular_file()) {
-                    total++;
-                    success += strip_tag(i.path().string().c_str()) == EXIT_SUCCESS;
-                }
-            }
-        };
-
-        recursively_strip_dir(std::filesystem::path(*strip_options.tags), recursively_strip_dir);
+        auto all_tags = Invader::File::load_virtual_tag_folder(std::vector<std::filesystem::path>(&*strip_options.tags, &*strip_options.tags + 1));
+        auto summary = Invader::File::TagBatch::run(all_tags.size(), [&all_tags](std::size_t index, Invader::File::TagBatch::Output &output) {
+            return strip_tag(all_tags[index].full_path, output);
+        }, strip_options.max_threads);
 
-        oprintf("Stripped %zu out of %zu tag%s\n", success, total, total == 1 ? "" : "s");
+        std::size_t total = all_tags.size();
+        oprintf("Stripped %zu out of %zu tag%s (%zu already stripped)\n", summary.changed + summary.unchanged, total, total == 1 ? "" : "s", summary.unchanged);
 
         return EXIT_SUCCESS;
     }
@@ -120,7 +136,9 @@ int main(int argc, char * const *argv) {
         else {
             file_path = std::filesystem::path(*strip_options.tags) / Invader::File::halo_path_to_preferred_path(remaining_arguments[0]);
         }
-        std::string file_path_str = file_path.string();
-        return strip_tag(file_path_str.c_str());
+        Invader::File::TagBatch::Output output;
+        auto result = strip_tag(file_path, output);
+        output.print();
+        return result == Invader::File::TagBatch::RESULT_FAILED ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 }
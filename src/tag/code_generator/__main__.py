@@ -6,10 +6,11 @@ import os
 
 from definition import make_definitions
 from parser import make_parser
+from view import make_view
 
 bitfield_cpp = 15
 
-if len(sys.argv) < bitfield_cpp+3:
+if len(sys.argv) < bitfield_cpp+4:
     print("Usage: {} <a lovely bunch of cppoconuts.cpp> <json> [json [...]]".format(sys.argv[0]), file=sys.stderr)
     sys.exit(1)
 
@@ -38,7 +39,7 @@ compound_structs = [
     "Vector3D"
 ]
 
-for i in range(bitfield_cpp+2, len(sys.argv)):
+for i in range(bitfield_cpp+3, len(sys.argv)):
     def make_name_fun(name, ignore_numbers):
         name = name.replace(" ", "_").replace("'", "").replace("(","").replace(")","")
         if not ignore_numbers and name[0].isnumeric():
@@ -150,3 +151,6 @@ make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs,
             *parser_files)
 for f in parser_files:
     f.close()
+
+with open(sys.argv[bitfield_cpp+2], "w") as f:
+    make_view(all_structs_arranged, all_structs, f)
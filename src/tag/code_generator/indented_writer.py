@@ -0,0 +1,12 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+class IndentedWriter:
+    """Writes to another file, indenting every line"""
+
+    def __init__(self, f, indent):
+        self.f = f
+        self.indent = indent
+
+    def write(self, what):
+        for line in what.splitlines(keepends=True):
+            self.f.write(self.indent + line if line != "\n" else line)
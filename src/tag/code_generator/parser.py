@@ -36,6 +36,7 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, hpp
     hpp.write("#define {}\n\n".format(header_name))
     hpp.write("#include <string>\n")
     hpp.write("#include <optional>\n")
+    hpp.write("#include <memory_resource>\n")
     hpp.write("#include \"../../map/map.hpp\"\n")
     hpp.write("#include \"parser_struct.hpp\"\n\n")
     hpp.write("namespace Invader {\n")
@@ -48,12 +49,29 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, hpp
     write_for_all_cpps("#include <invader/map/tag.hpp>\n")
     write_for_all_cpps("#include <invader/tag/hek/header.hpp>\n")
     write_for_all_cpps("#include <invader/printf.hpp>\n")
+    cpp_save_hek_data.write("#include <invader/hek/bulk_swap.hpp>\n")
     cpp_cache_format_data.write("#include <invader/build/build_workload.hpp>\n")
     cpp_read_cache_file_data.write("#include <invader/file/file.hpp>\n")
     cpp_read_hek_data.write("#include <invader/file/file.hpp>\n")
     cpp_save_hek_data.write("extern \"C\" std::uint32_t crc32(std::uint32_t crc, const void *buf, std::size_t size) noexcept;\n")
     write_for_all_cpps("namespace Invader::Parser {\n")
 
+    # Structs with no dependencies, reflexives, or data (and nothing to postprocess) can be converted as whole arrays
+    def is_flat(struct):
+        if "postprocess_hek_data" in struct and struct["postprocess_hek_data"]:
+            return False
+        if "inherits" in struct:
+            for t in all_structs:
+                if t["name"] == struct["inherits"]:
+                    if not is_flat(t):
+                        return False
+                    break
+        for t in struct["fields"]:
+            if t["type"] == "TagDependency" or t["type"] == "TagReflexive" or t["type"] == "TagDataOffset":
+                return False
+        return True
+    flat_structs = [s["name"] for s in all_structs_arranged if is_flat(s)]
+
     for struct in all_structs_arranged:
         struct_name = struct["name"]
         post_cache_deformat = "post_cache_deformat" in struct and struct["post_cache_deformat"]
@@ -97,10 +115,10 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, hpp
                     type_to_write = "Dependency"
                     non_type = True
                 elif type_to_write == "TagReflexive":
-                    type_to_write = "std::vector<{}>".format(t["struct"])
+                    type_to_write = "std::pmr::vector<{}>".format(t["struct"])
                     non_type = True
                 elif type_to_write == "TagDataOffset":
-                    type_to_write = "std::vector<std::byte>"
+                    type_to_write = "std::pmr::vector<std::byte>"
                     non_type = True
                 else:
                     type_to_write = "HEK::{}".format(type_to_write)
@@ -117,7 +135,25 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, hpp
                 all_used_structs.append(deepcopy(t))
                 continue
         add_structs_from_struct(struct)
-        
+
+        # Blocks and data can be allocated from a memory resource (such as an arena), which is passed down when parsing
+        containers = ["{}(resource)".format(s["member_name"]) for s in all_used_structs if s["type"] == "TagReflexive" or s["type"] == "TagDataOffset"]
+        hpp.write("\n        {}() = default;\n".format(struct_name))
+        hpp.write("\n        /**\n")
+        hpp.write("         * Make an empty struct whose blocks and data are allocated from the given memory resource\n")
+        hpp.write("         * @param resource memory resource to allocate from\n")
+        hpp.write("         */\n")
+        if len(containers) > 0:
+            hpp.write("        explicit {}(std::pmr::memory_resource *resource) : {} {{}}\n".format(struct_name, ", ".join(containers)))
+        else:
+            hpp.write("        explicit {}(std::pmr::memory_resource *) {{}}\n".format(struct_name))
+
+        # The destructor is declared, so moving has to be asked for explicitly (otherwise blocks get copied out of the arena when moved)
+        hpp.write("\n        {0}(const {0} &) = default;\n".format(struct_name))
+        hpp.write("        {0}({0} &&) = default;\n".format(struct_name))
+        hpp.write("        {0} &operator=(const {0} &) = default;\n".format(struct_name))
+        hpp.write("        {0} &operator=({0} &&) = default;\n".format(struct_name))
+
         # Next, account for enums being excluded on different structs
         for s in all_used_structs:
             for q in all_enums:
@@ -183,9 +219,9 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, hpp
         make_scan_padding(all_used_structs, struct_name, all_bitfields, hpp, cpp_scan_padding)
         make_cache_deformat(post_cache_deformat, all_used_structs, struct_name, hpp, cpp_cache_deformat_data)
         make_cache_format_data(struct_name, struct, pre_compile, post_compile, all_used_structs, hpp, cpp_cache_format_data, all_enums, all_structs_arranged)
-        make_cpp_save_hek_data(all_bitfields, all_used_structs, struct_name, hpp, cpp_save_hek_data)
+        make_cpp_save_hek_data(all_bitfields, all_used_structs, struct_name, flat_structs, hpp, cpp_save_hek_data)
         make_parse_cache_file_data(post_cache_parse, all_bitfields, all_used_structs, struct_name, hpp, cpp_read_cache_file_data)
-        make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data)
+        make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, flat_structs, hpp, cpp_read_hek_data)
         make_parse_hek_tag_file(struct_name, hpp, cpp_read_hek_file)
         make_refactor_reference(all_used_structs, struct_name, hpp, cpp_refactor_reference)
         make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_structs, all_used_groups, hpp, struct_name, read_only, title)
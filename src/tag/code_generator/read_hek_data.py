@@ -1,31 +1,10 @@
 # SPDX-License-Identifier: GPL-3.0-only
 
-def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data):
-    hpp.write("\n        /**\n")
-    hpp.write("         * Parse the HEK tag data.\n")
-    hpp.write("         * @param data        Data to read from for structs, tag references, and reflexives; if data_this is nullptr, this must point to the struct\n")
-    hpp.write("         * @param data_size   Size of the buffer\n")
-    hpp.write("         * @param data_read   This will be set to the amount of data read. If data_this is null, then the initial struct will also be added\n")
-    hpp.write("         * @param postprocess Do post-processing on data, such as default values\n")
-    hpp.write("         * @param data_this   Pointer to the struct; if this is null, then data will be used instead\n")
-    hpp.write("         * @return parsed tag data\n")
-    hpp.write("         */\n")
-    hpp.write("        static {} parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, bool postprocess = false, const std::byte *data_this = nullptr);\n".format(struct_name))
-    cpp_read_hek_data.write("    {} {}::parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, [[maybe_unused]] bool postprocess, const std::byte *data_this) {{\n".format(struct_name, struct_name))
-    cpp_read_hek_data.write("        {} r = {{}};\n".format(struct_name))
-    cpp_read_hek_data.write("        data_read = 0;\n")
-    cpp_read_hek_data.write("        if(data_this == nullptr) {\n")
-    cpp_read_hek_data.write("            if(sizeof(struct_big) > data_size) {\n")
-    cpp_read_hek_data.write("                eprintf_error(\"Failed to read {} base struct: %zu bytes needed > %zu bytes available\", sizeof(struct_big), data_size);\n".format(struct_name))
-    cpp_read_hek_data.write("                throw OutOfBoundsException();\n")
-    cpp_read_hek_data.write("            }\n")
-    cpp_read_hek_data.write("            data_this = data;\n")
-    cpp_read_hek_data.write("            data_size -= sizeof(struct_big);\n")
-    cpp_read_hek_data.write("            data_read += sizeof(struct_big);\n")
-    cpp_read_hek_data.write("            data += sizeof(struct_big);\n")
-    cpp_read_hek_data.write("        }\n")
-    if len(all_used_structs) > 0:
-        cpp_read_hek_data.write("        [[maybe_unused]] const auto &h = *reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data_this);\n".format(struct_name))
+from indented_writer import IndentedWriter
+
+def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, flat_structs, hpp, cpp_read_hek_data):
+    # Read each field from h into r
+    def write_fields(out):
         for struct in all_used_structs:
             name = struct["member_name"]
             unread = ("cache_only" in struct and struct["cache_only"]) or ("unused" in struct and struct["unused"])
@@ -33,114 +12,123 @@ def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, al
                 continue
             default_sign = "<=" if "default_sign" in struct and struct["default_sign"] else "=="
             if struct["type"] == "TagDependency":
-                cpp_read_hek_data.write("        std::size_t h_{}_expected_length = h.{}.path_size;\n".format(name,name))
+                out.write("        std::size_t h_{}_expected_length = h.{}.path_size;\n".format(name,name))
                 
-                cpp_read_hek_data.write("        r.{}.tag_fourcc = h.{}.tag_fourcc;\n".format(name, name))
-                cpp_read_hek_data.write("        if(h_{}_expected_length > 0) {{\n".format(name))
-                cpp_read_hek_data.write("            if(h_{}_expected_length + 1 > data_size) {{\n".format(name))
-                cpp_read_hek_data.write("                eprintf_error(\"Failed to read dependency {}::{}: %zu bytes needed > %zu bytes available\", h_{}_expected_length, data_size);\n".format(struct_name, name, name))
-                cpp_read_hek_data.write("                throw OutOfBoundsException();\n")
-                cpp_read_hek_data.write("            }\n")
-                cpp_read_hek_data.write("            const char *h_{}_char = reinterpret_cast<const char *>(data);\n".format(name))
-                cpp_read_hek_data.write("            for(std::size_t i = 0; i < h_{}_expected_length; i++) {{\n".format(name))
-                cpp_read_hek_data.write("                if(h_{}_char[i] == 0) {{\n".format(name))
-                cpp_read_hek_data.write("                    eprintf_error(\"Failed to read dependency {}::{}: size is smaller than expected (%zu expected > %zu actual)\", h_{}_expected_length, i);\n".format(struct_name, name, name))
-                cpp_read_hek_data.write("                    throw InvalidTagDataException();\n")
-                cpp_read_hek_data.write("                }\n")
-                cpp_read_hek_data.write("            }\n")
-                cpp_read_hek_data.write("            if(static_cast<char>(data[h_{}_expected_length]) != 0) {{\n".format(name))
-                cpp_read_hek_data.write("                eprintf_error(\"Failed to read dependency {}::{}: missing null terminator\");\n".format(struct_name, name))
-                cpp_read_hek_data.write("                throw InvalidTagDataException();\n")
-                cpp_read_hek_data.write("            }\n")
+                out.write("        r.{}.tag_fourcc = h.{}.tag_fourcc;\n".format(name, name))
+                out.write("        if(h_{}_expected_length > 0) {{\n".format(name))
+                out.write("            if(h_{}_expected_length + 1 > data_size) {{\n".format(name))
+                out.write("                eprintf_error(\"Failed to read dependency {}::{}: %zu bytes needed > %zu bytes available\", h_{}_expected_length, data_size);\n".format(struct_name, name, name))
+                out.write("                throw OutOfBoundsException();\n")
+                out.write("            }\n")
+                out.write("            const char *h_{}_char = reinterpret_cast<const char *>(data);\n".format(name))
+                out.write("            for(std::size_t i = 0; i < h_{}_expected_length; i++) {{\n".format(name))
+                out.write("                if(h_{}_char[i] == 0) {{\n".format(name))
+                out.write("                    eprintf_error(\"Failed to read dependency {}::{}: size is smaller than expected (%zu expected > %zu actual)\", h_{}_expected_length, i);\n".format(struct_name, name, name))
+                out.write("                    throw InvalidTagDataException();\n")
+                out.write("                }\n")
+                out.write("            }\n")
+                out.write("            if(static_cast<char>(data[h_{}_expected_length]) != 0) {{\n".format(name))
+                out.write("                eprintf_error(\"Failed to read dependency {}::{}: missing null terminator\");\n".format(struct_name, name))
+                out.write("                throw InvalidTagDataException();\n")
+                out.write("            }\n")
                 if not unread:
-                    cpp_read_hek_data.write("            r.{}.path = Invader::File::remove_duplicate_slashes(std::string(reinterpret_cast<const char *>(data)));\n".format(name))
-                cpp_read_hek_data.write("            data_size -= h_{}_expected_length + 1;\n".format(name))
-                cpp_read_hek_data.write("            data_read += h_{}_expected_length + 1;\n".format(name))
-                cpp_read_hek_data.write("            data += h_{}_expected_length + 1;\n".format(name))
-                cpp_read_hek_data.write("        }\n")
+                    out.write("            r.{}.path = Invader::File::remove_duplicate_slashes(std::string(reinterpret_cast<const char *>(data)));\n".format(name))
+                out.write("            data_size -= h_{}_expected_length + 1;\n".format(name))
+                out.write("            data_read += h_{}_expected_length + 1;\n".format(name))
+                out.write("            data += h_{}_expected_length + 1;\n".format(name))
+                out.write("        }\n")
                 if struct["classes"][0] != "*":
-                    cpp_read_hek_data.write("        else if(r.{}.tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL) {{\n".format(name))
-                    cpp_read_hek_data.write("            r.{}.tag_fourcc = HEK::TagFourCC::TAG_FOURCC_{};\n".format(name, struct["classes"][0].upper()))
-                    cpp_read_hek_data.write("        }\n")
+                    out.write("        else if(r.{}.tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL) {{\n".format(name))
+                    out.write("            r.{}.tag_fourcc = HEK::TagFourCC::TAG_FOURCC_{};\n".format(name, struct["classes"][0].upper()))
+                    out.write("        }\n")
             elif struct["type"] == "TagReflexive":
-                cpp_read_hek_data.write("        std::size_t h_{}_count = h.{}.count;\n".format(name,name))
-                cpp_read_hek_data.write("        if(h_{}_count > 0) {{\n".format(name))
-                cpp_read_hek_data.write("            const auto *array = reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data);\n".format(struct["struct"]))
-                cpp_read_hek_data.write("            std::size_t total_size = sizeof(*array) * h_{}_count;\n".format(name))
-                cpp_read_hek_data.write("            if(total_size > data_size) {\n")
-                cpp_read_hek_data.write("                eprintf_error(\"Failed to read reflexive {}::{}: %zu bytes needed > %zu bytes available\", total_size, data_size);\n".format(struct_name, name))
-                cpp_read_hek_data.write("                throw OutOfBoundsException();\n")
-                cpp_read_hek_data.write("            }\n")
-                cpp_read_hek_data.write("            data_size -= total_size;\n")
-                cpp_read_hek_data.write("            data_read += total_size;\n")
-                cpp_read_hek_data.write("            data += total_size;\n")
+                out.write("        std::size_t h_{}_count = h.{}.count;\n".format(name,name))
+                out.write("        if(h_{}_count > 0) {{\n".format(name))
+                out.write("            const auto *array = reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data);\n".format(struct["struct"]))
+                out.write("            std::size_t total_size = sizeof(*array) * h_{}_count;\n".format(name))
+                out.write("            if(total_size > data_size) {\n")
+                out.write("                eprintf_error(\"Failed to read reflexive {}::{}: %zu bytes needed > %zu bytes available\", total_size, data_size);\n".format(struct_name, name))
+                out.write("                throw OutOfBoundsException();\n")
+                out.write("            }\n")
+                if struct["struct"] in flat_structs:
+                    # Nothing follows these structs, so the whole array can be converted at once (or skipped if we don't need it)
+                    if not unread:
+                        out.write("            {}::parse_hek_tag_data_array(data, h_{}_count, r.{}, postprocess);\n".format(struct["struct"], name, name))
+                    out.write("            data_size -= total_size;\n")
+                    out.write("            data_read += total_size;\n")
+                    out.write("            data += total_size;\n")
+                    out.write("        }\n")
+                    continue
+                out.write("            data_size -= total_size;\n")
+                out.write("            data_read += total_size;\n")
+                out.write("            data += total_size;\n")
                 if not unread:
-                    cpp_read_hek_data.write("            r.{}.reserve(h_{}_count);\n".format(name, name))
-                cpp_read_hek_data.write("            for(std::size_t ref = 0; ref < h_{}_count; ref++) {{\n".format(name))
-                cpp_read_hek_data.write("                std::size_t ref_data_read = 0;\n")
-                call = "{}::parse_hek_tag_data(data, data_size, ref_data_read, postprocess, reinterpret_cast<const std::byte *>(array + ref))".format(struct["struct"])
+                    out.write("            r.{}.reserve(h_{}_count);\n".format(name, name))
+                out.write("            for(std::size_t ref = 0; ref < h_{}_count; ref++) {{\n".format(name))
+                out.write("                std::size_t ref_data_read = 0;\n")
+                call = "{}::parse_hek_tag_data(data, data_size, ref_data_read, postprocess, reinterpret_cast<const std::byte *>(array + ref), resource)".format(struct["struct"])
                 if not unread:
-                    cpp_read_hek_data.write("                r.{}.emplace_back({});\n".format(name, call))
+                    out.write("                r.{}.emplace_back({});\n".format(name, call))
                 else:
-                    cpp_read_hek_data.write("                {};\n".format(call))
-                cpp_read_hek_data.write("                data += ref_data_read;\n")
-                cpp_read_hek_data.write("                data_read += ref_data_read;\n")
-                cpp_read_hek_data.write("                data_size -= ref_data_read;\n")
-                cpp_read_hek_data.write("            }\n")
-                cpp_read_hek_data.write("        }\n")
+                    out.write("                {};\n".format(call))
+                out.write("                data += ref_data_read;\n")
+                out.write("                data_read += ref_data_read;\n")
+                out.write("                data_size -= ref_data_read;\n")
+                out.write("            }\n")
+                out.write("        }\n")
             elif struct["type"] == "TagDataOffset":
-                cpp_read_hek_data.write("        std::size_t h_{}_size = h.{}.size;\n".format(name, name))
-                cpp_read_hek_data.write("        if(h_{}_size > data_size) {{\n".format(name))
-                cpp_read_hek_data.write("            eprintf_error(\"Failed to read tag data block {}::{}: %zu bytes needed > %zu bytes available\", h_{}_size, data_size);\n".format(struct_name, name, name))
-                cpp_read_hek_data.write("            throw OutOfBoundsException();\n")
-                cpp_read_hek_data.write("        }\n")
+                out.write("        std::size_t h_{}_size = h.{}.size;\n".format(name, name))
+                out.write("        if(h_{}_size > data_size) {{\n".format(name))
+                out.write("            eprintf_error(\"Failed to read tag data block {}::{}: %zu bytes needed > %zu bytes available\", h_{}_size, data_size);\n".format(struct_name, name, name))
+                out.write("            throw OutOfBoundsException();\n")
+                out.write("        }\n")
                 if not unread:
-                    cpp_read_hek_data.write("        r.{} = std::vector<std::byte>(data, data + h_{}_size);\n".format(name, name))
-                cpp_read_hek_data.write("        data_size -= h_{}_size;\n".format(name))
-                cpp_read_hek_data.write("        data_read += h_{}_size;\n".format(name))
-                cpp_read_hek_data.write("        data += h_{}_size;\n".format(name))
+                    out.write("        r.{}.assign(data, data + h_{}_size);\n".format(name, name))
+                out.write("        data_size -= h_{}_size;\n".format(name))
+                out.write("        data_read += h_{}_size;\n".format(name))
+                out.write("        data += h_{}_size;\n".format(name))
             elif struct["type"] == "ColorRGB":
-                cpp_read_hek_data.write("        r.{} = h.{};\n".format(name, name))
+                out.write("        r.{} = h.{};\n".format(name, name))
                 if "default" in struct:
                     default = struct["default"]
                     suffix = "F" if isinstance(default[0], float) else ""
-                    cpp_read_hek_data.write("        if(postprocess && r.{}.red {} 0 && r.{}.green {} 0 && r.{}.blue {} 0) {{\n".format(name,default_sign,name,default_sign,name,default_sign))
-                    cpp_read_hek_data.write("            r.{}.red = {}{};\n".format(name, default[0], suffix))
-                    cpp_read_hek_data.write("            r.{}.green = {}{};\n".format(name, default[1], suffix))
-                    cpp_read_hek_data.write("            r.{}.blue = {}{};\n".format(name, default[2], suffix))
-                    cpp_read_hek_data.write("        }\n")
+                    out.write("        if(postprocess && r.{}.red {} 0 && r.{}.green {} 0 && r.{}.blue {} 0) {{\n".format(name,default_sign,name,default_sign,name,default_sign))
+                    out.write("            r.{}.red = {}{};\n".format(name, default[0], suffix))
+                    out.write("            r.{}.green = {}{};\n".format(name, default[1], suffix))
+                    out.write("            r.{}.blue = {}{};\n".format(name, default[2], suffix))
+                    out.write("        }\n")
             elif struct["type"] == "ColorARGB" or struct["type"] == "ColorARGBInt":
-                cpp_read_hek_data.write("        r.{} = h.{};\n".format(name, name))
+                out.write("        r.{} = h.{};\n".format(name, name))
                 if "default" in struct:
                     default = struct["default"]
                     suffix = "F" if isinstance(default[0], float) else ""
-                    cpp_read_hek_data.write("        if(postprocess && r.{}.alpha {} 0 && r.{}.red {} 0 && r.{}.green {} 0 && r.{}.blue {} 0) {{\n".format(name,default_sign,name,default_sign,name,default_sign,name,default_sign))
-                    cpp_read_hek_data.write("            r.{}.alpha = {}{};\n".format(name, default[0], suffix))
-                    cpp_read_hek_data.write("            r.{}.red = {}{};\n".format(name, default[1], suffix))
-                    cpp_read_hek_data.write("            r.{}.green = {}{};\n".format(name, default[2], suffix))
-                    cpp_read_hek_data.write("            r.{}.blue = {}{};\n".format(name, default[3], suffix))
-                    cpp_read_hek_data.write("        }\n")
+                    out.write("        if(postprocess && r.{}.alpha {} 0 && r.{}.red {} 0 && r.{}.green {} 0 && r.{}.blue {} 0) {{\n".format(name,default_sign,name,default_sign,name,default_sign,name,default_sign))
+                    out.write("            r.{}.alpha = {}{};\n".format(name, default[0], suffix))
+                    out.write("            r.{}.red = {}{};\n".format(name, default[1], suffix))
+                    out.write("            r.{}.green = {}{};\n".format(name, default[2], suffix))
+                    out.write("            r.{}.blue = {}{};\n".format(name, default[3], suffix))
+                    out.write("        }\n")
             elif struct["type"] == "TagID":
-                cpp_read_hek_data.write("        r.{} = HEK::TagID::null_tag_id();\n".format(name))
+                out.write("        r.{} = HEK::TagID::null_tag_id();\n".format(name))
             elif "bounds" in struct and struct["bounds"]:
-                cpp_read_hek_data.write("        r.{}.from = h.{}.from;\n".format(name, name))
-                cpp_read_hek_data.write("        r.{}.to = h.{}.to;\n".format(name, name))
+                out.write("        r.{}.from = h.{}.from;\n".format(name, name))
+                out.write("        r.{}.to = h.{}.to;\n".format(name, name))
                 if "default" in struct:
                     default = struct["default"]
                     suffix = "F" if isinstance(default[0], float) else ""
-                    cpp_read_hek_data.write("        if(postprocess && r.{}.from {} 0 && r.{}.to {} 0) {{\n".format(name, default_sign, name, default_sign))
-                    cpp_read_hek_data.write("            r.{}.from = {}{};\n".format(name, default[0], suffix))
-                    cpp_read_hek_data.write("            r.{}.to = {}{};\n".format(name, default[1], suffix))
-                    cpp_read_hek_data.write("        }\n")
+                    out.write("        if(postprocess && r.{}.from {} 0 && r.{}.to {} 0) {{\n".format(name, default_sign, name, default_sign))
+                    out.write("            r.{}.from = {}{};\n".format(name, default[0], suffix))
+                    out.write("            r.{}.to = {}{};\n".format(name, default[1], suffix))
+                    out.write("        }\n")
             elif "count" in struct and struct["count"] > 1:
-                cpp_read_hek_data.write("        std::copy(h.{}, h.{} + {}, r.{});\n".format(name, name, struct["count"], name))
+                out.write("        std::copy(h.{}, h.{} + {}, r.{});\n".format(name, name, struct["count"], name))
                 if "default" in struct:
                     default = struct["default"]
                     suffix = "F" if isinstance(default[0], float) else ""
                     for q in range(struct["count"]):
-                        cpp_read_hek_data.write("        if(postprocess && r.{}[{}] {} 0) {{\n".format(name, q, default_sign))
-                        cpp_read_hek_data.write("            r.{}[{}] = {}{};\n".format(name, q, default[q], suffix))
-                        cpp_read_hek_data.write("        }\n")
+                        out.write("        if(postprocess && r.{}[{}] {} 0) {{\n".format(name, q, default_sign))
+                        out.write("            r.{}[{}] = {}{};\n".format(name, q, default[q], suffix))
+                        out.write("        }\n")
             else:
                 added = False
                 for b in all_bitfields:
@@ -158,20 +146,67 @@ def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, al
                         if "__excluded" in struct and struct["__excluded"] is not None:
                             negate = "{} & ~static_cast<std::uint{}_t>(0x{:X})".format(negate, b["width"], struct["__excluded"])
                             
-                        cpp_read_hek_data.write("        r.{} = static_cast<std::uint{}_t>(h.{}) & static_cast<std::uint{}_t>(0x{:X}){};\n".format(name, b["width"], name, b["width"], (1 << len(b["fields"])) - 1, negate))
+                        out.write("        r.{} = static_cast<std::uint{}_t>(h.{}) & static_cast<std::uint{}_t>(0x{:X}){};\n".format(name, b["width"], name, b["width"], (1 << len(b["fields"])) - 1, negate))
                         
                         break
                 if not added:
-                    cpp_read_hek_data.write("        r.{} = h.{};\n".format(name, name))
+                    out.write("        r.{} = h.{};\n".format(name, name))
                     if "default" in struct:
                         default = struct["default"]
                         suffix = "F" if isinstance(default, float) else ""
-                        cpp_read_hek_data.write("        if(postprocess && r.{} {} 0) {{\n".format(name, default_sign))
-                        cpp_read_hek_data.write("            r.{} = {}{};\n".format(name, default, suffix))
-                        cpp_read_hek_data.write("        }\n")
+                        out.write("        if(postprocess && r.{} {} 0) {{\n".format(name, default_sign))
+                        out.write("            r.{} = {}{};\n".format(name, default, suffix))
+                        out.write("        }\n")
+
+    hpp.write("\n        /**\n")
+    hpp.write("         * Parse the HEK tag data.\n")
+    hpp.write("         * @param data        Data to read from for structs, tag references, and reflexives; if data_this is nullptr, this must point to the struct\n")
+    hpp.write("         * @param data_size   Size of the buffer\n")
+    hpp.write("         * @param data_read   This will be set to the amount of data read. If data_this is null, then the initial struct will also be added\n")
+    hpp.write("         * @param postprocess Do post-processing on data, such as default values\n")
+    hpp.write("         * @param data_this   Pointer to the struct; if this is null, then data will be used instead\n")
+    hpp.write("         * @param resource    Memory resource to allocate blocks and data from\n")
+    hpp.write("         * @return parsed tag data\n")
+    hpp.write("         */\n")
+    hpp.write("        static {} parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, bool postprocess = false, const std::byte *data_this = nullptr, std::pmr::memory_resource *resource = std::pmr::get_default_resource());\n".format(struct_name))
+    cpp_read_hek_data.write("    {} {}::parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, [[maybe_unused]] bool postprocess, const std::byte *data_this, std::pmr::memory_resource *resource) {{\n".format(struct_name, struct_name))
+    cpp_read_hek_data.write("        {} r(resource);\n".format(struct_name))
+    cpp_read_hek_data.write("        data_read = 0;\n")
+    cpp_read_hek_data.write("        if(data_this == nullptr) {\n")
+    cpp_read_hek_data.write("            if(sizeof(struct_big) > data_size) {\n")
+    cpp_read_hek_data.write("                eprintf_error(\"Failed to read {} base struct: %zu bytes needed > %zu bytes available\", sizeof(struct_big), data_size);\n".format(struct_name))
+    cpp_read_hek_data.write("                throw OutOfBoundsException();\n")
+    cpp_read_hek_data.write("            }\n")
+    cpp_read_hek_data.write("            data_this = data;\n")
+    cpp_read_hek_data.write("            data_size -= sizeof(struct_big);\n")
+    cpp_read_hek_data.write("            data_read += sizeof(struct_big);\n")
+    cpp_read_hek_data.write("            data += sizeof(struct_big);\n")
+    cpp_read_hek_data.write("        }\n")
+    if len(all_used_structs) > 0:
+        cpp_read_hek_data.write("        [[maybe_unused]] const auto &h = *reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data_this);\n".format(struct_name))
+        write_fields(cpp_read_hek_data)
     if postprocess_hek_data:
         cpp_read_hek_data.write("        if(postprocess) {\n")
         cpp_read_hek_data.write("            r.postprocess_hek_data();\n")
         cpp_read_hek_data.write("        }\n")
     cpp_read_hek_data.write("        return r;\n")
     cpp_read_hek_data.write("    }\n")
+
+    if struct_name in flat_structs:
+        hpp.write("\n        /**\n")
+        hpp.write("         * Parse an array of HEK tag data. This struct has no tag references, reflexives, or data, so the whole array is read in one pass.\n")
+        hpp.write("         * @param data        Array to read from; this must have count structs in it\n")
+        hpp.write("         * @param count       Number of structs\n")
+        hpp.write("         * @param output      Vector to append the parsed structs to\n")
+        hpp.write("         * @param postprocess Do post-processing on data, such as default values\n")
+        hpp.write("         */\n")
+        hpp.write("        static void parse_hek_tag_data_array(const std::byte *data, std::size_t count, std::pmr::vector<{}> &output, bool postprocess = false);\n".format(struct_name))
+        cpp_read_hek_data.write("    void {}::parse_hek_tag_data_array(const std::byte *data, std::size_t count, std::pmr::vector<{}> &output, [[maybe_unused]] bool postprocess) {{\n".format(struct_name, struct_name))
+        cpp_read_hek_data.write("        [[maybe_unused]] const auto *array = reinterpret_cast<const struct_big *>(data);\n")
+        cpp_read_hek_data.write("        output.reserve(output.size() + count);\n")
+        cpp_read_hek_data.write("        for(std::size_t i = 0; i < count; i++) {\n")
+        cpp_read_hek_data.write("            [[maybe_unused]] auto &r = output.emplace_back();\n")
+        cpp_read_hek_data.write("            [[maybe_unused]] const auto &h = array[i];\n")
+        write_fields(IndentedWriter(cpp_read_hek_data, "    "))
+        cpp_read_hek_data.write("        }\n")
+        cpp_read_hek_data.write("    }\n")
@@ -0,0 +1,150 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+def make_view(all_structs_arranged, all_structs, hpp):
+    hpp.write("// SPDX-License-Identifier: GPL-3.0-only\n\n// This file was auto-generated.\n// If you want to edit this, edit the .json definitions and rerun the generator script, instead.\n\n")
+    header_name = "INVADER__TAG__PARSER__VIEW_HPP"
+    hpp.write("#ifndef {}\n".format(header_name))
+    hpp.write("#define {}\n\n".format(header_name))
+    hpp.write("#include \"view_struct.hpp\"\n\n")
+    hpp.write("namespace Invader::Parser::View {\n")
+
+    variable_types = ["TagDependency", "TagReflexive", "TagDataOffset"]
+
+    # Get the references, blocks, and data stored after the struct, in the order they're stored (inherited fields first)
+    def get_variable_fields(struct):
+        fields = []
+        if "inherits" in struct:
+            for t in all_structs:
+                if t["name"] == struct["inherits"]:
+                    fields = get_variable_fields(t)
+                    break
+        for t in struct["fields"]:
+            if t["type"] in variable_types:
+                fields.append(t)
+        return fields
+
+    # Class to use for a reference if its class is null, like when parsing
+    def default_fourcc(field):
+        if field["classes"][0] == "*":
+            return "HEK::TagFourCC::TAG_FOURCC_NULL"
+        return "HEK::TagFourCC::TAG_FOURCC_{}".format(field["classes"][0].upper())
+
+    # References and blocks that are skipped when parsing
+    def is_unread(field):
+        return ("cache_only" in field and field["cache_only"]) or ("unused" in field and field["unused"])
+
+    # Whether any references are read when parsing blocks of this struct (including its blocks)
+    has_dependencies_cache = {}
+    def has_dependencies(struct_name):
+        if struct_name in has_dependencies_cache:
+            return has_dependencies_cache[struct_name]
+        has_dependencies_cache[struct_name] = False
+        for t in all_structs:
+            if t["name"] == struct_name:
+                for f in get_variable_fields(t):
+                    if is_unread(f):
+                        continue
+                    if f["type"] == "TagDependency" or (f["type"] == "TagReflexive" and has_dependencies(f["struct"])):
+                        has_dependencies_cache[struct_name] = True
+                        break
+                break
+        return has_dependencies_cache[struct_name]
+
+    # Write a function that makes a cursor and walks it over the given number of fields
+    def write_skip_fields(struct_name, fields):
+        hpp.write("        ViewCursor skip_fields(std::size_t field_count) const {\n")
+        hpp.write("            auto cursor = this->get_cursor();\n")
+        for i in range(len(fields)):
+            f = fields[i]
+            name = f["member_name"]
+            hpp.write("            if(field_count == {}) {{\n".format(i))
+            hpp.write("                return cursor;\n")
+            hpp.write("            }\n")
+            if f["type"] == "TagDependency":
+                hpp.write("            cursor.read_dependency(this->struct_data->{}, \"{}::{}\", {});\n".format(name, struct_name, name, default_fourcc(f)))
+            elif f["type"] == "TagReflexive":
+                hpp.write("            cursor.read_reflexive<{}>(this->struct_data->{}.count.read(), \"{}::{}\");\n".format(f["struct"], name, struct_name, name))
+            elif f["type"] == "TagDataOffset":
+                hpp.write("            cursor.read_data(this->struct_data->{}, \"{}::{}\");\n".format(name, struct_name, name))
+        hpp.write("            return cursor;\n")
+        hpp.write("        }\n")
+
+    for struct in all_structs_arranged:
+        struct_name = struct["name"]
+        fields = get_variable_fields(struct)
+
+        hpp.write("    class {} : public ViewStruct<{}, HEK::{}<HEK::BigEndian>> {{\n".format(struct_name, struct_name, struct_name))
+        hpp.write("    public:\n")
+        hpp.write("        /** Whether any references, blocks, or data follow blocks of this struct */\n")
+        hpp.write("        static constexpr bool HAS_TRAILING_DATA = {};\n\n".format("true" if len(fields) > 0 else "false"))
+        hpp.write("        /** Whether any references are read when parsing blocks of this struct */\n")
+        hpp.write("        static constexpr bool HAS_DEPENDENCIES = {};\n\n".format("true" if has_dependencies(struct_name) else "false"))
+        hpp.write("        using ViewStruct::ViewStruct;\n\n")
+
+        hpp.write("        /**\n")
+        hpp.write("         * Get the size of the references, blocks, and data following this block\n")
+        hpp.write("         * @return size in bytes\n")
+        hpp.write("         */\n")
+        if len(fields) == 0:
+            hpp.write("        std::size_t get_trailing_size() const noexcept {\n")
+            hpp.write("            return 0;\n")
+            hpp.write("        }\n")
+        else:
+            hpp.write("        std::size_t get_trailing_size() const {\n")
+            hpp.write("            return static_cast<std::size_t>(this->skip_fields({}).get_position() - this->trailing_data);\n".format(len(fields)))
+            hpp.write("        }\n")
+
+        for i in range(len(fields)):
+            f = fields[i]
+            name = f["member_name"]
+            hpp.write("\n")
+            if f["type"] == "TagDependency":
+                hpp.write("        TagDependencyView {}() const {{\n".format(name))
+                hpp.write("            return this->skip_fields({}).read_dependency(this->struct_data->{}, \"{}::{}\", {});\n".format(i, name, struct_name, name, default_fourcc(f)))
+            elif f["type"] == "TagReflexive":
+                hpp.write("        TagReflexiveView<{}> {}() const {{\n".format(f["struct"], name))
+                hpp.write("            return this->skip_fields({}).get_reflexive<{}>(this->struct_data->{}.count.read(), \"{}::{}\");\n".format(i, f["struct"], name, struct_name, name))
+            elif f["type"] == "TagDataOffset":
+                hpp.write("        TagDataView {}() const {{\n".format(name))
+                hpp.write("            return this->skip_fields({}).read_data(this->struct_data->{}, \"{}::{}\");\n".format(i, name, struct_name, name))
+            hpp.write("        }\n")
+
+        hpp.write("\n")
+        hpp.write("        /**\n")
+        hpp.write("         * Call a function for each reference in this block and its blocks that is read when parsing, in the order they're stored\n")
+        hpp.write("         * @param callback function to call with each non-null reference\n")
+        hpp.write("         * @return         size of the references, blocks, and data following this block\n")
+        hpp.write("         */\n")
+        if len(fields) == 0:
+            hpp.write("        template<typename Callback> std::size_t for_each_dependency(Callback &) const noexcept {\n")
+            hpp.write("            return 0;\n")
+            hpp.write("        }\n")
+        else:
+            hpp.write("        template<typename Callback> std::size_t for_each_dependency([[maybe_unused]] Callback &callback) const {\n")
+            hpp.write("            auto cursor = this->get_cursor();\n")
+            for f in fields:
+                name = f["member_name"]
+                if f["type"] == "TagDependency":
+                    if is_unread(f):
+                        hpp.write("            cursor.read_dependency(this->struct_data->{}, \"{}::{}\");\n".format(name, struct_name, name))
+                    else:
+                        hpp.write("            if(auto dependency = cursor.read_dependency(this->struct_data->{}, \"{}::{}\", {}); !dependency.is_null()) {{\n".format(name, struct_name, name, default_fourcc(f)))
+                        hpp.write("                callback(dependency);\n")
+                        hpp.write("            }\n")
+                elif f["type"] == "TagReflexive":
+                    if is_unread(f):
+                        hpp.write("            cursor.read_reflexive<{}>(this->struct_data->{}.count.read(), \"{}::{}\");\n".format(f["struct"], name, struct_name, name))
+                    else:
+                        hpp.write("            cursor.read_reflexive_dependencies<{}>(this->struct_data->{}.count.read(), \"{}::{}\", callback);\n".format(f["struct"], name, struct_name, name))
+                elif f["type"] == "TagDataOffset":
+                    hpp.write("            cursor.read_data(this->struct_data->{}, \"{}::{}\");\n".format(name, struct_name, name))
+            hpp.write("            return static_cast<std::size_t>(cursor.get_position() - this->trailing_data);\n")
+            hpp.write("        }\n")
+
+        if len(fields) > 0:
+            hpp.write("\n    private:\n")
+            write_skip_fields(struct_name, fields)
+        hpp.write("    };\n")
+
+    hpp.write("}\n\n")
+    hpp.write("#endif\n")
@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <invader/tag/hek/class/model_collision_geometry.hpp>
+#include <invader/thread_pool.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader::HEK {
+    using Flagged = FlaggedInt<std::uint32_t>;
+
+    // Number of queries each task gets when splitting a batch across a thread pool
+    static constexpr std::size_t QUERIES_PER_TASK = 64;
+
+    // Projection plane (see IntersectionCheck)
+    static const std::uint8_t PLANE_INDICES[2][3][2] = {
+        {
+            {2, 1},
+            {0, 2},
+            {1, 0}
+        },
+        {
+            {1, 2},
+            {2, 0},
+            {0, 1}
+        }
+    };
+
+    template<typename Query, typename Function> static std::vector<BSPQuery::Result> run_queries(const std::vector<Query> &queries, ThreadPool *thread_pool, const Function &function) {
+        std::size_t query_count = queries.size();
+        std::vector<BSPQuery::Result> results(query_count);
+
+        auto run_range = [&queries, &results, &function](std::size_t first, std::size_t end) {
+            for(std::size_t q = first; q < end; q++) {
+                results[q] = function(queries[q]);
+            }
+        };
+
+        if(thread_pool == nullptr || query_count <= QUERIES_PER_TASK) {
+            run_range(0, query_count);
+        }
+        else {
+            std::vector<std::future<void>> tasks;
+            for(std::size_t q = 0; q < query_count; q += QUERIES_PER_TASK) {
+                std::size_t end = std::min(q + QUERIES_PER_TASK, query_count);
+                tasks.emplace_back(thread_pool->submit([&run_range, q, end]() {
+                    run_range(q, end);
+                }));
+            }
+            thread_pool->wait_all(tasks);
+        }
+
+        return results;
+    }
+
+    BSPQuery::BSPQuery(const BSPData &bsp) : bsp(bsp) {
+        // Put each BSP3D node's plane in the node so we don't have to look it up while walking the tree
+        this->nodes_3d.reserve(bsp.bsp3d_node_count);
+        for(std::uint32_t n = 0; n < bsp.bsp3d_node_count; n++) {
+            auto &node = bsp.bsp3d_nodes[n];
+            auto &flat = this->nodes_3d.emplace_back();
+            flat.plane = node.plane.read();
+            flat.back_child = node.back_child.read().value;
+            flat.front_child = node.front_child.read().value;
+            if(flat.plane < bsp.plane_count) {
+                auto &plane = bsp.planes[flat.plane].plane;
+                flat.i = plane.vector.i;
+                flat.j = plane.vector.j;
+                flat.k = plane.vector.k;
+                flat.w = plane.w;
+            }
+            else {
+                flat.i = flat.j = flat.k = flat.w = 0.0F;
+            }
+        }
+
+        this->nodes_2d.reserve(bsp.bsp2d_node_count);
+        for(std::uint32_t n = 0; n < bsp.bsp2d_node_count; n++) {
+            auto &node = bsp.bsp2d_nodes[n];
+            auto &flat = this->nodes_2d.emplace_back();
+            flat.i = node.plane.vector.i;
+            flat.j = node.plane.vector.j;
+            flat.w = node.plane.w;
+            flat.left_child = node.left_child.read().value;
+            flat.right_child = node.right_child.read().value;
+        }
+
+        // Work out which axes each BSP2D reference projects onto ahead of time
+        this->references_2d.reserve(bsp.bsp2d_reference_count);
+        for(std::uint32_t r = 0; r < bsp.bsp2d_reference_count; r++) {
+            auto &reference = bsp.bsp2d_references[r];
+            auto &flat = this->references_2d.emplace_back();
+            flat.plane = reference.plane.read().value;
+            flat.node = reference.bsp2d_node.read().value;
+            flat.x_axis = 0;
+            flat.y_axis = 0;
+
+            if(flat.plane >= bsp.plane_count) {
+                continue;
+            }
+
+            auto &plane = bsp.planes[flat.plane].plane;
+            float x = std::fabs(plane.vector.i);
+            float y = std::fabs(plane.vector.j);
+            float z = std::fabs(plane.vector.k);
+            int axis;
+            float highest;
+            if(z < y || z < x) {
+                if(x > y) {
+                    axis = 0;
+                    highest = x;
+                }
+                else {
+                    axis = 1;
+                    highest = y;
+                }
+            }
+            else {
+                axis = 2;
+                highest = z;
+            }
+            int sign = highest > 0.0F ? 1 : 0;
+
+            flat.x_axis = PLANE_INDICES[sign][axis][0];
+            flat.y_axis = PLANE_INDICES[sign][axis][1];
+        }
+    }
+
+    std::vector<BSPQuery::Result> BSPQuery::check_for_intersections(const std::vector<Segment> &segments, ThreadPool *thread_pool) const {
+        return run_queries(segments, thread_pool, [this](const Segment &segment) {
+            return this->intersect_segment(segment);
+        });
+    }
+
+    std::vector<BSPQuery::Result> BSPQuery::check_for_intersections(const std::vector<Point3D<LittleEndian>> &points, float range, ThreadPool *thread_pool) const {
+        return run_queries(points, thread_pool, [this, range](const Point3D<LittleEndian> &point) {
+            return this->intersect_vertically(point, range);
+        });
+    }
+
+    std::vector<BSPQuery::Result> BSPQuery::check_if_points_inside_bsp(const std::vector<Point3D<LittleEndian>> &points, ThreadPool *thread_pool) const {
+        return run_queries(points, thread_pool, [this](const Point3D<LittleEndian> &point) {
+            Result result;
+            Flagged leaf = { this->leaf_for_point(point) };
+            if(!leaf.is_null()) {
+                result.found = true;
+                result.leaf_index = leaf.int_value();
+            }
+            return result;
+        });
+    }
+
+    bool BSPQuery::in_front_of_node(const Node3D &node, const Point3D<LittleEndian> &point) const {
+        if(node.plane >= this->bsp.plane_count) {
+            eprintf_error("Invalid plane index %u / %u in BSP.\n", node.plane, this->bsp.plane_count);
+            throw OutOfBoundsException();
+        }
+        return ((node.i * point.x) + (node.j * point.y) + (node.k * point.z)) - node.w >= 0;
+    }
+
+    std::uint32_t BSPQuery::leaf_for_point(const Point3D<LittleEndian> &point) const {
+        Flagged node_index = {0};
+        auto node_count = static_cast<std::uint32_t>(this->nodes_3d.size());
+        auto *nodes = this->nodes_3d.data();
+
+        while(!node_index.flag_value() && !node_index.is_null()) {
+            if(node_index.value >= node_count) {
+                eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", node_index.int_value(), node_count);
+                throw OutOfBoundsException();
+            }
+
+            auto &node = nodes[node_index.value];
+            node_index.value = this->in_front_of_node(node, point) ? node.front_child : node.back_child;
+        }
+
+        return node_index.value;
+    }
+
+    bool BSPQuery::surface_for_point(std::uint32_t node_index_value, const Point2D<LittleEndian> &point, std::uint32_t &surface_index) const {
+        Flagged node_index = { node_index_value };
+        if(node_index.is_null()) {
+            return false;
+        }
+
+        auto node_count = static_cast<std::uint32_t>(this->nodes_2d.size());
+        auto *nodes = this->nodes_2d.data();
+        float x = point.x;
+        float y = point.y;
+
+        while(!node_index.flag_value() && !node_index.is_null()) {
+            if(node_index.int_value() >= node_count) {
+                eprintf_error("Invalid BSP2D node %u / %u in BSP.\n", node_index.int_value(), node_count);
+                throw OutOfBoundsException();
+            }
+
+            auto &node = nodes[node_index.int_value()];
+            node_index.value = ((node.i * x) + (node.j * y)) - node.w > 0.0F ? node.right_child : node.left_child;
+        }
+
+        if(node_index.is_null()) {
+            return false;
+        }
+
+        if(node_index.int_value() >= this->bsp.surface_count) {
+            eprintf_error("Invalid surface %u / %u in BSP.\n", node_index.int_value(), this->bsp.surface_count);
+            throw OutOfBoundsException();
+        }
+
+        surface_index = node_index.int_value();
+        return true;
+    }
+
+    bool BSPQuery::intersect_segment(const Segment &original, const Point3D<LittleEndian> &point_a, const Point3D<LittleEndian> &point_b, std::uint32_t node_index_value, Result &result) const {
+        // This does the same thing as IntersectionCheck::check_for_intersection_recursion, but on the flat layout
+        if(point_a == point_b) {
+            return false;
+        }
+
+        Flagged node_index = { node_index_value };
+        auto node_count = static_cast<std::uint32_t>(this->nodes_3d.size());
+
+        while(!node_index.flag_value() && !node_index.is_null()) {
+            if(node_index.value >= node_count) {
+                eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", node_index.int_value(), node_count);
+                throw OutOfBoundsException();
+            }
+
+            auto &node = this->nodes_3d[node_index.value];
+            std::uint32_t node_index_a = this->in_front_of_node(node, point_a) ? node.front_child : node.back_child;
+            std::uint32_t node_index_b = this->in_front_of_node(node, point_b) ? node.front_child : node.back_child;
+
+            // Both on the same side? Keep going
+            if(node_index_a == node_index_b) {
+                node_index.value = node_index_a;
+                continue;
+            }
+
+            // Otherwise, split the segment at the plane and check both halves
+            Point3D<LittleEndian> intersection_front;
+            if(!intersect_plane_with_points(this->bsp.planes[node.plane].plane, point_a, point_b, &intersection_front)) {
+                return false;
+            }
+
+            Result result_a, result_b;
+            bool point_a_intersected = this->intersect_segment(original, point_a, intersection_front, node_index_a, result_a);
+            bool point_b_intersected = this->intersect_segment(original, intersection_front, point_b, node_index_b, result_b);
+
+            if(!point_a_intersected && !point_b_intersected) {
+                return false;
+            }
+
+            // If both intersected, take the closest one
+            if(point_a_intersected && point_b_intersected) {
+                float a_distance_squared = result_a.intersection_point.distance_from_point_squared(point_a);
+                float b_distance_squared = result_b.intersection_point.distance_from_point_squared(point_a);
+                point_a_intersected = !(a_distance_squared > b_distance_squared);
+            }
+
+            auto &closest = point_a_intersected ? result_a : result_b;
+            result.intersection_point = closest.intersection_point;
+            result.leaf_index = closest.leaf_index;
+            result.surface_index = closest.surface_index;
+            return true;
+        }
+
+        // Fell out of the BSP
+        if(node_index.is_null()) {
+            return false;
+        }
+
+        std::uint32_t leaf_index = node_index.int_value();
+        if(leaf_index >= this->bsp.leaf_count) {
+            eprintf_error("invalid leaf index #%u / %u\n", leaf_index, this->bsp.leaf_count);
+            throw OutOfBoundsException();
+        }
+
+        auto &leaf = this->bsp.leaves[leaf_index];
+        std::uint32_t leaf_reference_count = leaf.bsp2d_reference_count.read();
+        std::uint32_t leaf_first_reference = leaf.first_bsp2d_reference.read();
+        if(leaf_reference_count == 0) {
+            return false;
+        }
+
+        std::uint64_t reference_end = static_cast<std::uint64_t>(leaf_first_reference + leaf_reference_count);
+        if(reference_end > this->bsp.bsp2d_reference_count) {
+            eprintf_error("invalid bsp2d reference range #%u - %zu / %u\n", leaf_reference_count, static_cast<std::size_t>(leaf_first_reference + leaf_reference_count), this->bsp.bsp2d_reference_count);
+            throw OutOfBoundsException();
+        }
+
+        // Find the closest surface of the leaf that the original segment passes through
+        bool ever_intersected = false;
+        float closest_intersection_distance = 0.0F;
+        for(std::uint32_t r = leaf_first_reference; r < reference_end; r++) {
+            auto &reference = this->references_2d[r];
+            if(reference.plane >= this->bsp.plane_count) {
+                eprintf_error("invalid plane range for BSP #%u / %u\n", Flagged { reference.plane }.int_value(), this->bsp.plane_count);
+                throw OutOfBoundsException();
+            }
+
+            Point3D<LittleEndian> intersection;
+            if(!intersect_plane_with_points(this->bsp.planes[reference.plane].plane, original.point_a, original.point_b, &intersection)) {
+                continue;
+            }
+
+            float intersection_distance = point_a.distance_from_point_squared(intersection);
+            if(ever_intersected && closest_intersection_distance < intersection_distance) {
+                continue;
+            }
+
+            Point2D<LittleEndian> point;
+            point.x = (&intersection.x)[reference.x_axis];
+            point.y = (&intersection.x)[reference.y_axis];
+
+            if(this->surface_for_point(reference.node, point, result.surface_index)) {
+                ever_intersected = true;
+                result.intersection_point = intersection;
+                result.leaf_index = leaf_index;
+                closest_intersection_distance = intersection_distance;
+            }
+        }
+
+        return ever_intersected;
+    }
+
+    BSPQuery::Result BSPQuery::intersect_segment(const Segment &segment) const {
+        Result result;
+        result.found = this->intersect_segment(segment, segment.point_a, segment.point_b, 0, result);
+        return result;
+    }
+
+    BSPQuery::Result BSPQuery::intersect_vertically(const Point3D<LittleEndian> &point, float range) const {
+        // Same as BSPData::check_for_intersection: cast down from above the point, stepping past each hit, and take the hit closest to the point
+        Segment segment;
+        segment.point_a = point;
+        segment.point_a.z = segment.point_a.z + range;
+        segment.point_b = point;
+        segment.point_b.z = segment.point_b.z - range;
+
+        Result closest;
+        float closest_distance_squared = range;
+
+        while(segment.point_a.z.read() > segment.point_b.z.read()) {
+            auto hit = this->intersect_segment(segment);
+            if(!hit.found) {
+                break;
+            }
+
+            float distance = hit.intersection_point.distance_from_point_squared(point);
+            if(!closest.found || distance < closest_distance_squared) {
+                closest_distance_squared = distance;
+                closest = hit;
+            }
+
+            segment.point_a.z = hit.intersection_point.z - 0.01F; // subtract a lil' bit so we don't loop forever
+        }
+
+        return closest;
+    }
+}
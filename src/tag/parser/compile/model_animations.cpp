@@ -141,7 +141,7 @@ namespace Invader::Parser {
         // Do frame info stuff
         if(frame_info_size > 0) {
             const auto *frame_info_big = this->frame_info.data();
-            std::vector<std::byte> frame_info_little_v(frame_info_size);
+            std::pmr::vector<std::byte> frame_info_little_v(frame_info_size);
             std::byte *frame_info_little = frame_info_little_v.data();
 
             // Update frame_info data, updating everything to little endian endian
@@ -237,7 +237,7 @@ namespace Invader::Parser {
         // Let's do default_data. Basically just add what isn't in frame_data, and only for one frame
         if(default_data_size != 0 && !compressed) {
             const auto *default_data_big = this->default_data.data();
-            std::vector<std::byte> default_data(default_data_size);
+            std::pmr::vector<std::byte> default_data(default_data_size);
             auto *default_data_little = default_data.data();
             for(std::size_t node = 0; node < node_count; node++) {
                 if(!rotate[node]) {
@@ -274,12 +274,12 @@ namespace Invader::Parser {
                 REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid compressed data offset (%zu > %zu)", struct_index, compressed_data_offset, frame_data_size);
                 throw InvalidTagDataException();
             }
-            this->frame_data = std::vector<std::byte>(this->frame_data.begin() + compressed_data_offset, this->frame_data.end());
+            this->frame_data = std::pmr::vector<std::byte>(this->frame_data.begin() + compressed_data_offset, this->frame_data.end());
         }
         else {
             const auto *frame_data_big = this->frame_data.data();
             if(frame_data_size > 0) {
-                std::vector<std::byte> frame_data(frame_data_size, std::byte());
+                std::pmr::vector<std::byte> frame_data(frame_data_size, std::byte());
                 auto *frame_data_little = frame_data.data();
                 for(std::size_t frame = 0; frame < frame_count; frame++) {
                     for(std::size_t node = 0; node < node_count; node++) {
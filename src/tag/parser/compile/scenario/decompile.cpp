@@ -19,7 +19,7 @@ namespace Invader::Parser {
                 const auto *script_data = reinterpret_cast<const std::byte *>(script.c_str());
                 auto &source_file = scenario.source_files.emplace_back();
                 std::snprintf(source_file.name.string, sizeof(source_file.name.string), "extracted");
-                source_file.source = std::vector<std::byte>(script_data, script_data + script.size());
+                source_file.source.assign(script_data, script_data + script.size());
             }
             catch(std::exception &e) {
                 eprintf_error("Failed to decompile scripts; scenario will not have any source data: %s", e.what());
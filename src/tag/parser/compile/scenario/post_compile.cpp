@@ -6,9 +6,11 @@
 #include <invader/tag/hek/class/model_collision_geometry.hpp>
 #include <invader/script/compiler.hpp>
 #include <invader/tag/parser/compile/scenario.hpp>
+#include <invader/thread_pool.hpp>
 
 namespace Invader::Parser {
     using BSPData = HEK::BSPData;
+    using BSPQuery = HEK::BSPQuery;
     
     void ScenarioNetgameEquipment::post_compile(BuildWorkload &workload, std::size_t, std::size_t struct_index, std::size_t struct_offset) {
         reinterpret_cast<struct_little *>(workload.structs[struct_index].data.data() + struct_offset)->unknown_ffffffff = 0xFFFFFFFF;
@@ -16,9 +18,9 @@ namespace Invader::Parser {
     
     // Functions for finding stuff
     static std::vector<BSPData> get_bsp_data(const Scenario &scenario, BuildWorkload &workload);
-    static void find_encounters(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
-    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
-    static void find_decals(Scenario &scenario, BuildWorkload &workload, const std::vector<BSPData> &bsp_data);
+    static void find_encounters(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, const std::vector<BSPQuery> &bsp_queries, ThreadPool &thread_pool, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
+    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, const std::vector<BSPQuery> &bsp_queries, ThreadPool &thread_pool, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
+    static void find_decals(Scenario &scenario, BuildWorkload &workload, const std::vector<BSPData> &bsp_data, const std::vector<BSPQuery> &bsp_queries, ThreadPool &thread_pool);
     static void find_conversations(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data);
 
     void Scenario::post_compile(BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, std::size_t struct_offset) {
@@ -36,15 +38,26 @@ namespace Invader::Parser {
         auto bsp_data = get_bsp_data(*this, workload);
         auto bsp_count = bsp_data.size();
 
+        // Flatten each BSP once; everything below queries them in batches
+        ThreadPool thread_pool;
+        std::vector<BSPQuery> bsp_queries;
+        bsp_queries.reserve(bsp_count);
+        for(auto &b : bsp_data) {
+            bsp_queries.emplace_back(b);
+        }
+
         // Determine which BSP light fixtures and scenery are in
         #define FIND_BSP_INDICES_FOR_OBJECT_ARRAY(array_type, objects, palette_type, palette, type_name, warn_if_partially_outside) { \
             std::size_t object_count = this->objects.size(); \
             if(object_count) { \
                 auto &object_struct = workload.structs[*scenario_struct.resolve_pointer(&scenario_data.objects.pointer)]; \
                 auto *object_array = reinterpret_cast<array_type::struct_little *>(object_struct.data.data()); \
+                /* find the positions to check first so we can check them all at once */ \
+                std::vector<std::size_t> objects_checked; \
+                std::vector<bool> models_present; \
+                std::vector<HEK::Point3D<HEK::LittleEndian>> positions; \
+                std::vector<HEK::Point3D<HEK::LittleEndian>> positions_to_check; \
                 for(std::size_t o = 0; o < object_count; o++) { \
-                    std::uint32_t bsp_indices = 0; \
-                    std::uint32_t bsp_indices_technically_inside = 0; \
                     auto &object = object_array[o]; \
                     if(object.type != NULL_INDEX) { \
                         auto &type = this->palette[object.type].name; \
@@ -61,30 +74,51 @@ namespace Invader::Parser {
                         } \
                         auto rotation = object.rotation; \
                         auto rotated = rotate_vector(object_bounding_offset, euler_to_matrix(rotation)); \
-                        auto position_to_check = object.position + rotated; \
-                        for(std::size_t b = 0; b < bsp_count; b++) { \
-                            /* Check if we're inside this BSP */ \
-                            auto &bsp = bsp_data[b]; \
-                            if(bsp.check_if_point_inside_bsp(object.position)) { \
-                                bsp_indices_technically_inside |= 1 << b; \
-                            } \
-                            if(bsp.check_if_point_inside_bsp(position_to_check)) { \
-                                bsp_indices |= 1 << b; \
-                            } \
+                        objects_checked.emplace_back(o); \
+                        models_present.emplace_back(model_present); \
+                        positions.emplace_back(object.position); \
+                        positions_to_check.emplace_back(object.position + rotated); \
+                    } \
+                } \
+                /* Check if we're inside each BSP */ \
+                std::size_t checked_count = objects_checked.size(); \
+                std::vector<std::uint32_t> bsp_indices(checked_count); \
+                std::vector<std::uint32_t> bsp_indices_technically_inside(checked_count); \
+                for(std::size_t b = 0; b < bsp_count; b++) { \
+                    auto inside = bsp_queries[b].check_if_points_inside_bsp(positions, &thread_pool); \
+                    auto offset_inside = bsp_queries[b].check_if_points_inside_bsp(positions_to_check, &thread_pool); \
+                    for(std::size_t c = 0; c < checked_count; c++) { \
+                        if(inside[c].found) { \
+                            bsp_indices_technically_inside[c] |= 1 << b; \
                         } \
-                        if(bsp_indices == 0 && bsp_indices_technically_inside == 0) { \
-                            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu was found in 0 BSPs, so it will not spawn", o); \
+                        if(offset_inside[c].found) { \
+                            bsp_indices[c] |= 1 << b; \
                         } \
-                        else if(warn_if_partially_outside) { \
-                            /* If it's technically outside of a BSP due to bounding offset and we have a model, warn */ \
-                            auto partially_outside = (bsp_indices ^ bsp_indices_technically_inside) & bsp_indices_technically_inside; \
-                            if(partially_outside && model_present) { \
-                                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu is inside a BSP but offset outside, so it will be fullbright", o); \
-                            } \
+                    } \
+                } \
+                std::size_t c = 0; \
+                for(std::size_t o = 0; o < object_count; o++) { \
+                    auto &object = object_array[o]; \
+                    if(c == checked_count || objects_checked[c] != o) { \
+                        object.bsp_indices = 0; \
+                        continue; \
+                    } \
+                    auto object_bsp_indices = bsp_indices[c]; \
+                    auto object_bsp_indices_technically_inside = bsp_indices_technically_inside[c]; \
+                    auto model_present = models_present[c]; \
+                    c++; \
+                    if(object_bsp_indices == 0 && object_bsp_indices_technically_inside == 0) { \
+                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu was found in 0 BSPs, so it will not spawn", o); \
+                    } \
+                    else if(warn_if_partially_outside) { \
+                        /* If it's technically outside of a BSP due to bounding offset and we have a model, warn */ \
+                        auto partially_outside = (object_bsp_indices ^ object_bsp_indices_technically_inside) & object_bsp_indices_technically_inside; \
+                        if(partially_outside && model_present) { \
+                            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu is inside a BSP but offset outside, so it will be fullbright", o); \
                         } \
                     } \
                     /* Set to the result */ \
-                    object.bsp_indices = bsp_indices | bsp_indices_technically_inside; \
+                    object.bsp_indices = object_bsp_indices | object_bsp_indices_technically_inside; \
                 } \
             } \
         }
@@ -96,9 +130,9 @@ namespace Invader::Parser {
 
         // Find what we need
         std::size_t bsp_find_warnings = 0;
-        find_encounters(*this, workload, tag_index, bsp_data, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
-        find_command_lists(*this, workload, tag_index, bsp_data, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
-        find_decals(*this, workload, bsp_data);
+        find_encounters(*this, workload, tag_index, bsp_data, bsp_queries, thread_pool, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
+        find_command_lists(*this, workload, tag_index, bsp_data, bsp_queries, thread_pool, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
+        find_decals(*this, workload, bsp_data, bsp_queries, thread_pool);
         find_conversations(*this, workload, tag_index, scenario_struct, scenario_data);
         
         if(bsp_find_warnings && workload.get_build_parameters()->verbosity > BuildWorkload::BuildParameters::BUILD_VERBOSITY_HIDE_WARNINGS) {
@@ -176,7 +210,7 @@ namespace Invader::Parser {
     
     
     
-    static void find_encounters(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
+    static void find_encounters(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, const std::vector<BSPQuery> &bsp_queries, ThreadPool &thread_pool, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
         // Determine which BSP the encounters fall in
         std::size_t encounter_list_count = scenario.encounters.size();
         if(encounter_list_count != 0) {
@@ -184,6 +218,43 @@ namespace Invader::Parser {
             auto *encounter_array = reinterpret_cast<ScenarioEncounter::struct_little *>(encounter_struct.data.data());
             auto bsp_count = bsp_data.size();
             
+            // Gather every squad starting location and firing position for each BSP the encounter will be checked in, so each BSP only
+            // gets one batch of raycasts and one batch of point checks
+            std::vector<std::vector<HEK::Point3D<HEK::LittleEndian>>> raycast_points(bsp_count);
+            std::vector<std::vector<HEK::Point3D<HEK::LittleEndian>>> inside_points(bsp_count);
+            std::vector<std::size_t> first_query(encounter_list_count * bsp_count);
+            for(std::size_t i = 0; i < encounter_list_count; i++) {
+                auto &encounter = scenario.encounters[i];
+                bool manual_bsp_index_specified = encounter.flags & HEK::ScenarioEncounterFlagsFlag::SCENARIO_ENCOUNTER_FLAGS_FLAG_MANUAL_BSP_INDEX_SPECIFIED;
+                std::size_t start_bsp = manual_bsp_index_specified ? encounter_array[i].manual_bsp_index.read() : 0;
+                bool raycast = !(encounter.flags & HEK::ScenarioEncounterFlagsFlag::SCENARIO_ENCOUNTER_FLAGS_FLAG__3D_FIRING_POSITIONS);
+                
+                for(std::size_t b = start_bsp; b < bsp_count; b++) {
+                    auto &points = raycast ? raycast_points[b] : inside_points[b];
+                    first_query[i * bsp_count + b] = points.size();
+                    for(auto &squad : encounter.squads) {
+                        for(auto &location : squad.starting_locations) {
+                            points.emplace_back(location.position);
+                        }
+                    }
+                    for(auto &f : encounter.firing_positions) {
+                        points.emplace_back(f.position);
+                    }
+                    
+                    if(manual_bsp_index_specified) {
+                        break;
+                    }
+                }
+            }
+            
+            // If raycasting check for a surface that is 0.5 world units above/below it
+            std::vector<std::vector<BSPQuery::Result>> raycast_results(bsp_count);
+            std::vector<std::vector<BSPQuery::Result>> inside_results(bsp_count);
+            for(std::size_t b = 0; b < bsp_count; b++) {
+                raycast_results[b] = bsp_queries[b].check_for_intersections(raycast_points[b], 0.5F, &thread_pool);
+                inside_results[b] = bsp_queries[b].check_if_points_inside_bsp(inside_points[b], &thread_pool);
+            }
+            
             for(std::size_t i = 0; i < encounter_list_count; i++) {
                 auto &encounter = scenario.encounters[i];
                 auto &encounter_data = encounter_array[i];
@@ -248,6 +319,8 @@ namespace Invader::Parser {
                     firing_positions_indices.clear();
                     squad_positions_found.clear();
                     auto &bsp = bsp_data[b];
+                    auto &results = raycast ? raycast_results[b] : inside_results[b];
+                    std::size_t query = first_query[i * bsp_count + b];
 
                     // Go through each squad; add 1 to hits for every squad we find in the BSP
                     std::size_t squad_hits = 0;
@@ -256,61 +329,30 @@ namespace Invader::Parser {
                         std::size_t location_count = squad.starting_locations.size();
                         
                         for(std::size_t l = 0; l < location_count; l++) {
-                            auto &location = squad.starting_locations[l];
-                            
-                            // If raycasting check for a surface that is 0.5 world units above/below it
-                            bool found;
-                            std::optional<std::uint32_t> leaf_index;
-                            
-                            if(raycast) {
-                                std::uint32_t leaf;
-                                if((found = bsp.check_for_intersection(location.position, 0.5F, nullptr, nullptr, &leaf))) {
-                                    leaf_index = leaf;
-                                }
-                            }
-                            else {
-                                std::uint32_t leaf;
-                                if((found = bsp.check_if_point_inside_bsp(location.position, &leaf))) {
-                                    leaf_index = leaf; 
-                                }
-                            }
+                            auto &result = results[query++];
                             
                             // Set the cluster index
                             HEK::Index cluster_index;
-                            if(leaf_index.has_value()) {
-                                cluster_index = bsp.render_leaves[*leaf_index].cluster;
+                            if(result.found) {
+                                cluster_index = bsp.render_leaves[result.leaf_index].cluster;
                             }
                             else {
                                 cluster_index = NULL_INDEX;
                             }
                             
-                            squad_hits += found;
-                            squad_positions_found.emplace_back(SquadPositionFound { s, l, cluster_index, found });
+                            squad_hits += result.found;
+                            squad_positions_found.emplace_back(SquadPositionFound { s, l, cluster_index, result.found });
                         }
                     }
                     
                     // Go through each firing position
                     std::size_t firing_position_hits = 0;
-                    for(auto &f : encounter.firing_positions) {
-                        // Here are the indices we'll set
-                        bool in_bsp;
-                        std::uint32_t surface_index = 0;
-                        std::uint32_t leaf_index = 0;
-                        
-                        // Raycast stuff
-                        if(raycast) {
-                            in_bsp = bsp.check_for_intersection(f.position, 0.5F, nullptr, &surface_index, &leaf_index);
-                        }
-                        else {
-                            std::uint32_t leaf;
-                            if((in_bsp = bsp.check_if_point_inside_bsp(f.position, &leaf))) {
-                                leaf_index = leaf;
-                            }
-                        }
+                    for(std::size_t f = 0; f < firing_position_count; f++) {
+                        auto &result = results[query++];
                         
                         // If we're in the BSP, add it
-                        if(in_bsp) {
-                            firing_positions_indices.emplace_back(FiringPositionIndex {bsp.render_leaves[leaf_index].cluster, surface_index, true});
+                        if(result.found) {
+                            firing_positions_indices.emplace_back(FiringPositionIndex {bsp.render_leaves[result.leaf_index].cluster, result.surface_index, true});
                             firing_position_hits++;
                         }
                         else {
@@ -438,6 +480,30 @@ namespace Invader::Parser {
                     std::vector<std::vector<std::size_t>> missing_squad_positions(squad_count);
                     std::size_t out_of_bounds = 0;
                     
+                    // Check all of the move positions in the BSP we found at once
+                    std::vector<HEK::Point3D<HEK::LittleEndian>> move_positions;
+                    if(found_bsp) {
+                        for(std::size_t s = 0; s < squad_count; s++) {
+                            auto &squad = squad_data[s];
+                            std::size_t move_position_count = squad.move_positions.count.read();
+                            if(move_position_count) {
+                                auto *move_position_data = reinterpret_cast<Parser::ScenarioMovePosition::struct_little *>(workload.structs[*squad_struct.resolve_pointer(&squad.move_positions.pointer)].data.data());
+                                for(std::size_t p = 0; p < move_position_count; p++) {
+                                    move_positions.emplace_back(move_position_data[p].position);
+                                }
+                            }
+                        }
+                    }
+                    
+                    std::vector<BSPQuery::Result> move_position_results;
+                    if(found_bsp && raycast) {
+                        move_position_results = bsp_queries[best_bsp].check_for_intersections(move_positions, 0.5F, &thread_pool);
+                    }
+                    else if(found_bsp) {
+                        move_position_results = bsp_queries[best_bsp].check_if_points_inside_bsp(move_positions, &thread_pool);
+                    }
+                    std::size_t move_position_index_found = 0;
+                    
                     for(std::size_t s = 0; s < squad_count; s++) {
                         auto &squad = squad_data[s];
                         std::size_t position_count = squad.starting_locations.count.read();
@@ -459,26 +525,12 @@ namespace Invader::Parser {
                                     continue;
                                 }
                                 
-                                std::optional<std::uint32_t> leaf_index;
-                                std::uint32_t surface_index = 0;
-                                
-                                if(raycast) {
-                                    std::uint32_t leaf;
-                                    if(found_bsp->check_for_intersection(move_position_data[p].position, 0.5F, nullptr, &surface_index, &leaf)) {
-                                        leaf_index = leaf;
-                                    }
-                                }
-                                else {
-                                    std::uint32_t leaf;
-                                    if(found_bsp->check_if_point_inside_bsp(move_position_data[p].position, &leaf)) {
-                                        leaf_index = leaf; 
-                                    }
-                                }
+                                auto &result = move_position_results[move_position_index_found++];
                                 
                                 // Set the cluster index
                                 HEK::Index cluster_index;
-                                if(leaf_index.has_value()) {
-                                    cluster_index = found_bsp->render_leaves[*leaf_index].cluster;
+                                if(result.found) {
+                                    cluster_index = found_bsp->render_leaves[result.leaf_index].cluster;
                                 }
                                 else {
                                     cluster_index = NULL_INDEX;
@@ -487,7 +539,7 @@ namespace Invader::Parser {
                                 }
                                 
                                 // Set surface and cluster index
-                                move_position_data[p].surface_index = surface_index;
+                                move_position_data[p].surface_index = result.surface_index;
                                 move_position_data[p].cluster_index = cluster_index;
                             }
                         }
@@ -523,12 +575,39 @@ namespace Invader::Parser {
         }
     }
     
-    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
+    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, const std::vector<BSPQuery> &bsp_queries, ThreadPool &thread_pool, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
         std::size_t command_list_count = scenario.command_lists.size();
         if(command_list_count != 0) {
             auto &command_list_struct = workload.structs[*scenario_struct.resolve_pointer(&scenario_data.command_lists.pointer)];
             auto *command_list_array = reinterpret_cast<ScenarioCommandList::struct_little *>(command_list_struct.data.data());
             auto bsp_count = bsp_data.size();
+            
+            // Gather every point for each BSP the command list will be checked in, so each BSP only gets one batch of raycasts
+            std::vector<std::vector<HEK::Point3D<HEK::LittleEndian>>> points(bsp_count);
+            std::vector<std::size_t> first_query(command_list_count * bsp_count);
+            for(std::size_t i = 0; i < command_list_count; i++) {
+                auto &command_list = scenario.command_lists[i];
+                bool manual_bsp_index_specified = command_list.flags & HEK::ScenarioCommandListFlagsFlag::SCENARIO_COMMAND_LIST_FLAGS_FLAG_MANUAL_BSP_INDEX;
+                std::size_t start = manual_bsp_index_specified ? command_list.manual_bsp_index : 0;
+                
+                for(std::size_t b = start; b < bsp_count; b++) {
+                    first_query[i * bsp_count + b] = points[b].size();
+                    for(auto &p : command_list.points) {
+                        points[b].emplace_back(p.position);
+                    }
+                    
+                    if(manual_bsp_index_specified) {
+                        break;
+                    }
+                }
+            }
+            
+            // We need to check if there is a surface that is half a world unit or less below each position
+            std::vector<std::vector<BSPQuery::Result>> results(bsp_count);
+            for(std::size_t b = 0; b < bsp_count; b++) {
+                results[b] = bsp_queries[b].check_for_intersections(points[b], 0.5F, &thread_pool);
+            }
+            
             for(std::size_t i = 0; i < command_list_count; i++) {
                 auto &command_list = scenario.command_lists[i];
                 auto &command_list_data = command_list_array[i];
@@ -560,21 +639,17 @@ namespace Invader::Parser {
                 
                 // Go through each BSP (or one BSP for manual) to look for surface indices
                 for(std::size_t b = start; b < bsp_count; b++) {
-                    auto &bsp = bsp_data[b];
                     std::size_t hits = 0;
-                    std::size_t total_hits = 0;
                     std::vector<std::optional<std::uint32_t>> surface_indices;
                     surface_indices.reserve(point_count);
 
                     // Basically, add 1 for every time we find it in here
-                    // We need to check if there is a surface that is half a world unit or less below the position
-                    for(auto &p : command_list.points) {
-                        total_hits++;
-                        
-                        std::uint32_t surface_index = 0;
-                        if(bsp.check_for_intersection(p.position, 0.5F, nullptr, &surface_index, nullptr)) {
+                    auto *point_results = results[b].data() + first_query[i * bsp_count + b];
+                    for(std::size_t p = 0; p < point_count; p++) {
+                        auto &result = point_results[p];
+                        if(result.found) {
                             hits++;
-                            surface_indices.emplace_back(surface_index); // found a surface
+                            surface_indices.emplace_back(result.surface_index); // found a surface
                         }
                         else {
                             surface_indices.emplace_back(std::nullopt); // no surface underneath
@@ -659,9 +734,15 @@ namespace Invader::Parser {
         }
     }
     
-    static void find_decals(Scenario &scenario, BuildWorkload &workload, const std::vector<BSPData> &bsp_data) {
+    static void find_decals(Scenario &scenario, BuildWorkload &workload, const std::vector<BSPData> &bsp_data, const std::vector<BSPQuery> &bsp_queries, ThreadPool &thread_pool) {
         std::size_t decal_count = scenario.decals.size();
         if(decal_count > 0) {
+            std::vector<HEK::Point3D<HEK::LittleEndian>> decal_positions;
+            decal_positions.reserve(decal_count);
+            for(auto &decal : scenario.decals) {
+                decal_positions.emplace_back(decal.position);
+            }
+            
             for(std::size_t bsp = 0; bsp < scenario.structure_bsps.size(); bsp++) {
                 auto &b = scenario.structure_bsps[bsp];
                 auto &bsp_id = b.structure_bsp.tag_id;
@@ -689,15 +770,14 @@ namespace Invader::Parser {
                     auto *clusters = reinterpret_cast<ScenarioStructureBSPCluster::struct_little *>(bsp_cluster_struct.data.data());
 
                     // Go through each decal; see what we can come up with
+                    auto &bd = bsp_data[bsp];
+                    auto results = bsp_queries[bsp].check_if_points_inside_bsp(decal_positions, &thread_pool);
                     std::vector<std::pair<std::size_t, std::size_t>> cluster_decals;
                     for(std::size_t d = 0; d < decal_count; d++) {
-                        auto &decal = scenario.decals[d];
-                        auto &bd = bsp_data[bsp];
-                        std::uint32_t leaf;
-                        if(!bd.check_if_point_inside_bsp(decal.position, &leaf)) {
+                        if(!results[d].found) {
                             continue;
                         }
-                        cluster_decals.emplace_back(bd.render_leaves[leaf].cluster, d);
+                        cluster_decals.emplace_back(bd.render_leaves[results[d].leaf_index].cluster, d);
                     }
 
                     // Get clusters
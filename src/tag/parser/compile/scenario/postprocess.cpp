@@ -8,6 +8,44 @@
 #include <invader/tag/parser/compile/scenario.hpp>
 
 namespace Invader::Parser {
+    // Get the class of tag a script node references, if it references a tag
+    static std::optional<TagFourCC> get_script_node_tag_class(const ScenarioScriptNode::struct_big &node) {
+        switch(node.type.read()) {
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_SOUND:
+                return HEK::TAG_FOURCC_SOUND;
+
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_EFFECT:
+                return HEK::TAG_FOURCC_EFFECT;
+
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE:
+                return HEK::TAG_FOURCC_DAMAGE_EFFECT;
+
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_LOOPING_SOUND:
+                return HEK::TAG_FOURCC_SOUND_LOOPING;
+
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ANIMATION_GRAPH:
+                return HEK::TAG_FOURCC_MODEL_ANIMATIONS;
+
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ACTOR_VARIANT:
+                return HEK::TAG_FOURCC_ACTOR_VARIANT;
+
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE_EFFECT:
+                return HEK::TAG_FOURCC_DAMAGE_EFFECT;
+
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_OBJECT_DEFINITION:
+                return HEK::TAG_FOURCC_OBJECT;
+
+            default:
+                return std::nullopt;
+        }
+    }
+
+    // Check if a node that would reference a tag is actually a global or script call (and thus doesn't)
+    static bool script_node_is_global_or_call(const ScenarioScriptNode::struct_big &node) {
+        auto flags = node.flags.read();
+        return (flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_GLOBAL) || (flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_SCRIPT_CALL);
+    }
+
     void Invader::Parser::Scenario::postprocess_hek_data() {
         if(this->script_syntax_data.size() >= sizeof(ScenarioScriptNodeTable::struct_little)) {
             auto *table = reinterpret_cast<ScenarioScriptNodeTable::struct_big *>(this->script_syntax_data.data());
@@ -18,57 +56,47 @@ namespace Invader::Parser {
             auto *nodes = reinterpret_cast<ScenarioScriptNode::struct_big *>(table + 1);
 
             for(std::uint16_t i = 0; i < element_count; i++) {
-                // Check if we know the class
-                std::optional<TagFourCC> tag_class;
                 auto &node = nodes[i];
+                if(get_script_node_tag_class(node).has_value() && !script_node_is_global_or_call(node)) {
+                    node.data = HEK::TagID::null_tag_id();
+                }
+            }
+        }
+    }
 
-                // Check the class type
-                switch(node.type.read()) {
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_SOUND:
-                        tag_class = HEK::TAG_FOURCC_SOUND;
-                        break;
-
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_EFFECT:
-                        tag_class = HEK::TAG_FOURCC_EFFECT;
-                        break;
-
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE:
-                        tag_class = HEK::TAG_FOURCC_DAMAGE_EFFECT;
-                        break;
-
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_LOOPING_SOUND:
-                        tag_class = HEK::TAG_FOURCC_SOUND_LOOPING;
-                        break;
-
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ANIMATION_GRAPH:
-                        tag_class = HEK::TAG_FOURCC_MODEL_ANIMATIONS;
-                        break;
-
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ACTOR_VARIANT:
-                        tag_class = HEK::TAG_FOURCC_ACTOR_VARIANT;
-                        break;
+    std::vector<File::TagFilePath> get_script_tag_references(const Scenario &scenario) {
+        std::vector<File::TagFilePath> references;
+        if(scenario.script_syntax_data.size() < sizeof(ScenarioScriptNodeTable::struct_big)) {
+            return references;
+        }
 
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE_EFFECT:
-                        tag_class = HEK::TAG_FOURCC_DAMAGE_EFFECT;
-                        break;
+        // Only use strings that are null terminated
+        const char *string_data = reinterpret_cast<const char *>(scenario.script_string_data.data());
+        std::size_t string_data_length = scenario.script_string_data.size();
+        while(string_data_length > 0 && string_data[string_data_length - 1] != 0) {
+            string_data_length--;
+        }
 
-                    case HEK::SCENARIO_SCRIPT_VALUE_TYPE_OBJECT_DEFINITION:
-                        tag_class = HEK::TAG_FOURCC_OBJECT;
-                        break;
+        const auto *table = reinterpret_cast<const ScenarioScriptNodeTable::struct_big *>(scenario.script_syntax_data.data());
+        std::size_t element_count = std::min(static_cast<std::size_t>(table->size.read()), static_cast<std::size_t>(scenario.script_syntax_data.size() - sizeof(*table)) / sizeof(ScenarioScriptNode::struct_big));
+        const auto *nodes = reinterpret_cast<const ScenarioScriptNode::struct_big *>(table + 1);
 
-                    default:
-                        continue;
-                }
+        for(std::size_t i = 0; i < element_count; i++) {
+            auto &node = nodes[i];
+            auto tag_class = get_script_node_tag_class(node);
+            if(!tag_class.has_value() || script_node_is_global_or_call(node)) {
+                continue;
+            }
 
-                if(tag_class.has_value()) {
-                    // Check if we should leave it alone
-                    auto flags = node.flags.read();
-                    if((flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_GLOBAL) || (flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_SCRIPT_CALL)) {
-                        continue;
-                    }
-                    node.data = HEK::TagID::null_tag_id();
-                }
+            std::size_t string_offset = node.string_offset.read();
+            if(string_offset >= string_data_length) {
+                eprintf_error("Script node #%zu has an invalid string offset. The scripts need recompiled.", i);
+                throw InvalidTagDataException();
             }
+
+            references.emplace_back(string_data + string_offset, *tag_class);
         }
+
+        return references;
     }
 }
@@ -180,7 +180,7 @@ namespace Invader::Parser {
 
         // Let's start on the script data
         BuildWorkload::BuildWorkloadStruct script_data_struct = {};
-        script_data_struct.data = std::move(scenario.script_syntax_data);
+        script_data_struct.data.assign(scenario.script_syntax_data.begin(), scenario.script_syntax_data.end());
         const char *string_data = reinterpret_cast<const char *>(scenario.script_string_data.data());
         std::size_t string_data_length = scenario.script_string_data.size();
 
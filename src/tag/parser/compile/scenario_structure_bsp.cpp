@@ -332,7 +332,7 @@ namespace Invader::Parser {
             std::size_t lightmap_vertices_size = this->lightmap_vertices_count * sizeof(ScenarioStructureBSPMaterialCompressedLightmapVertex::struct_little);
             std::size_t total_vertices_size = lightmap_vertices_size + compressed_vertices_size;
             const std::byte *compressed_bsp_vertices_start = tag.data(bsp_material.compressed_vertices.pointer, total_vertices_size);
-            this->compressed_vertices = std::vector<std::byte>(compressed_bsp_vertices_start, compressed_bsp_vertices_start + total_vertices_size);
+            this->compressed_vertices.assign(compressed_bsp_vertices_start, compressed_bsp_vertices_start + total_vertices_size);
             if(!regenerate_missing_bsp_vertices(*this, true)) {
                 eprintf_error("Failed to decompress vertices");
                 throw InvalidTagDataException();
@@ -359,7 +359,7 @@ namespace Invader::Parser {
                 uncompressed_lightmap_vertices_start = uncompressed_bsp_vertices_start + this->rendered_vertices_count * sizeof(ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little);
             }
             
-            this->uncompressed_vertices = std::vector<std::byte>(uncompressed_bsp_vertices_start, uncompressed_bsp_vertices_start + uncompressed_vertices_size);
+            this->uncompressed_vertices.assign(uncompressed_bsp_vertices_start, uncompressed_bsp_vertices_start + uncompressed_vertices_size);
             this->uncompressed_vertices.insert(this->uncompressed_vertices.end(), uncompressed_lightmap_vertices_start, uncompressed_lightmap_vertices_start + lightmap_vertices_size);
 
             if(!regenerate_missing_bsp_vertices(*this, true)) {
@@ -91,7 +91,7 @@ namespace Invader::Parser {
         new_id_2.tag_id_only = true;
 
         // Add samples
-        auto &r = workload.raw_data.emplace_back(this->samples);
+        auto &r = workload.raw_data.emplace_back(this->samples.begin(), this->samples.end());
         workload.tags[tag_index].asset_data.emplace_back(&r - workload.raw_data.data());
         this->samples_pointer = 0xFFFFFFFF;
     }
@@ -97,11 +97,11 @@ namespace Invader::Parser {
         read_only(read_only) {}
 
     ParserStructValue::ParserStructValue(
-        const char *            name,
-        const char *            member_name,
-        const char *            comment,
-        std::vector<std::byte> *offset,
-        bool                    read_only
+        const char *                 name,
+        const char *                 member_name,
+        const char *                 comment,
+        std::pmr::vector<std::byte> *offset,
+        bool                         read_only
     ) : name(name),
         member_name(member_name),
         comment(comment),
@@ -679,12 +679,12 @@ namespace Invader::Parser {
         return this->set_values(values.data());
     }
 
-    std::unique_ptr<ParserStruct> ParserStruct::parse_hek_tag_file(const std::byte *data, std::size_t data_size, bool postprocess) {
+    std::unique_ptr<ParserStruct> ParserStruct::parse_hek_tag_file(const std::byte *data, std::size_t data_size, bool postprocess, std::pmr::memory_resource *resource) {
         const auto *header = reinterpret_cast<const HEK::TagFileHeader *>(data);
         HEK::TagFileHeader::validate_header(header, data_size);
 
         #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
-            return std::make_unique<Parser::class_struct>(Invader::Parser::class_struct::parse_hek_tag_file(data, data_size, postprocess)); \
+            return std::make_unique<Parser::class_struct>(Invader::Parser::class_struct::parse_hek_tag_file(data, data_size, postprocess, resource)); \
         }
 
         switch(header->tag_fourcc) {
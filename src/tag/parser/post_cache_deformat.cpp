@@ -52,9 +52,9 @@ namespace Invader::Parser {
     void Invader::Parser::ModelAnimationsAnimation::post_cache_deformat() {
         // Get whether or not it's compressed
         bool compressed = this->flags & HEK::ModelAnimationsAnimationFlagsFlag::MODEL_ANIMATIONS_ANIMATION_FLAGS_FLAG_COMPRESSED_DATA;
-        std::vector<std::byte> frame_data = this->frame_data;
-        std::vector<std::byte> frame_info = this->frame_info;
-        std::vector<std::byte> default_data = this->default_data;
+        std::pmr::vector<std::byte> frame_data = this->frame_data;
+        std::pmr::vector<std::byte> frame_info = this->frame_info;
+        std::pmr::vector<std::byte> default_data = this->default_data;
 
         // Frame info
         std::size_t required_frame_info_size;
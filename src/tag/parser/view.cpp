@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/tag/parser/view.hpp>
+#include <invader/tag/parser/parser_struct.hpp>
+
+namespace Invader::Parser::View {
+    template<typename T> static std::vector<File::TagFilePath> get_dependencies(const std::byte *data, std::size_t data_size) {
+        std::vector<File::TagFilePath> dependencies;
+        auto add_dependency = [&dependencies](const TagDependencyView &dependency) {
+            dependencies.emplace_back(File::remove_duplicate_slashes(dependency.get_path()), dependency.get_tag_fourcc());
+        };
+
+        auto tag = T::from_hek_tag_file(data, data_size);
+        std::size_t data_read = sizeof(HEK::TagFileHeader) + sizeof(typename T::struct_big) + tag.for_each_dependency(add_dependency);
+        if(data_read != data_size) {
+            eprintf_error("invalid tag file; tag data was left over");
+            throw InvalidTagDataException();
+        }
+
+        return dependencies;
+    }
+
+    std::vector<File::TagFilePath> get_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size) {
+        const auto *header = reinterpret_cast<const HEK::TagFileHeader *>(data);
+        HEK::TagFileHeader::validate_header(header, data_size);
+
+        #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
+            return get_dependencies<class_struct>(data, data_size); \
+        }
+
+        switch(header->tag_fourcc) {
+            DO_BASED_ON_TAG_CLASS
+
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NONE:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NULL:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_SPHEROID:
+                break;
+        }
+
+        eprintf_error("Unknown tag class %s", tag_fourcc_to_extension(header->tag_fourcc));
+        throw InvalidTagDataException();
+
+        #undef DO_TAG_CLASS
+    }
+
+    bool hek_tag_class_has_dependencies(TagFourCC tag_fourcc) noexcept {
+        #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
+            return class_struct::HAS_DEPENDENCIES; \
+        }
+
+        switch(tag_fourcc) {
+            DO_BASED_ON_TAG_CLASS
+
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NONE:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NULL:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_SPHEROID:
+                break;
+        }
+
+        return true;
+
+        #undef DO_TAG_CLASS
+    }
+}
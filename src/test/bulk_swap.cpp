@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Checks that HEK::BulkSwap converts arrays of flat tag structs exactly like converting each struct does, and that tags with flat blocks
+// come out the same after being parsed and saved again.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <invader/hek/bulk_swap.hpp>
+#include <invader/tag/parser/parser.hpp>
+
+using namespace Invader;
+
+// Odd counts, counts around BulkSwap::BLOCK_SIZE, and enough for the masks to wrap around many times
+static constexpr std::size_t COUNTS[] = { 1, 2, 3, 5, 7, 17, 63, 64, 65, 127, 1001 };
+
+static bool passed = true;
+
+static std::mt19937 random_bytes(1);
+
+template<typename From, typename To> static bool check_swap(const char *name, std::size_t offset) {
+    static_assert(sizeof(From) == sizeof(To));
+    constexpr std::size_t size = sizeof(From);
+    const auto &swap = HEK::BulkSwap::for_struct<From, To>();
+
+    for(std::size_t count : COUNTS) {
+        // Not all bytes are used, so they're limited to six bits like BulkSwap's own check in case floats are converted as floats
+        std::vector<std::byte> input(count * size + offset);
+        for(auto &b : input) {
+            b = static_cast<std::byte>(random_bytes() & 0x3F);
+        }
+
+        // Bytes that conversion doesn't copy (padding) are zero
+        std::vector<std::byte> expected(count * size + offset), swapped(count * size + offset, std::byte { 0xCC });
+        for(std::size_t i = 0; i < count; i++) {
+            *reinterpret_cast<To *>(expected.data() + offset + i * size) = *reinterpret_cast<const From *>(input.data() + offset + i * size);
+        }
+        swap.swap(input.data() + offset, swapped.data() + offset, count);
+
+        if(std::memcmp(expected.data() + offset, swapped.data() + offset, count * size) != 0) {
+            std::printf("%s (%zu bytes): %zu structs at offset %zu: FAILED\n", name, size, count, offset);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename T> static void check_struct(const char *name) {
+    using struct_little = typename T::struct_little;
+    using struct_big = typename T::struct_big;
+    // None of these have anything that stops them from being shuffled, so if they aren't, the shuffle didn't pass BulkSwap's own check
+    bool ok = HEK::BulkSwap::for_struct<struct_little, struct_big>().is_shuffle() && HEK::BulkSwap::for_struct<struct_big, struct_little>().is_shuffle();
+    for(std::size_t offset : { 0, 1 }) {
+        ok = check_swap<struct_little, struct_big>(name, offset) && ok;
+        ok = check_swap<struct_big, struct_little>(name, offset) && ok;
+    }
+    std::printf("%s (%zu bytes): %s\n", name, sizeof(struct_big), ok ? "ok" : "FAILED");
+    passed = passed && ok;
+}
+
+#define CHECK_STRUCT(name) check_struct<Parser::name>(#name)
+
+// A collision model with flat blocks of several sizes, both at the top level and inside blocks that aren't flat
+static void check_round_trip() {
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> real(-1000.0F, 1000.0F);
+
+    Parser::ModelCollisionGeometry tag;
+    tag.pathfinding_spheres.resize(33);
+    for(auto &sphere : tag.pathfinding_spheres) {
+        sphere.node = static_cast<HEK::Index>(random() % 4);
+        sphere.center.x = real(random);
+        sphere.center.y = real(random);
+        sphere.center.z = real(random);
+        sphere.radius = real(random);
+    }
+
+    auto &node = tag.nodes.emplace_back();
+    std::strcpy(node.name.string, "node");
+    auto &bsp = node.bsps.emplace_back();
+    bsp.bsp3d_nodes.resize(1001);
+    for(auto &n : bsp.bsp3d_nodes) {
+        n.plane = random();
+        n.back_child.value = random();
+        n.front_child.value = random();
+    }
+    bsp.planes.resize(65);
+    for(auto &p : bsp.planes) {
+        p.plane = { { real(random), real(random), real(random) }, real(random) };
+    }
+    bsp.edges.resize(7);
+    for(auto &e : bsp.edges) {
+        e.start_vertex = random();
+        e.end_vertex = random();
+        e.forward_edge = random();
+        e.reverse_edge = random();
+        e.left_surface = random();
+        e.right_surface = random();
+    }
+    bsp.vertices.resize(129);
+    for(auto &v : bsp.vertices) {
+        v.point.x = real(random);
+        v.point.y = real(random);
+        v.point.z = real(random);
+        v.first_edge = random();
+    }
+
+    auto saved = tag.generate_hek_tag_data(TagFourCC::TAG_FOURCC_MODEL_COLLISION_GEOMETRY);
+    auto parsed = Parser::ModelCollisionGeometry::parse_hek_tag_file(saved.data(), saved.size());
+    auto saved_again = parsed.generate_hek_tag_data(TagFourCC::TAG_FOURCC_MODEL_COLLISION_GEOMETRY);
+
+    bool ok = saved == saved_again && parsed.pathfinding_spheres.size() == tag.pathfinding_spheres.size() && parsed.nodes.size() == 1 && parsed.nodes[0].bsps.size() == 1;
+    if(ok) {
+        auto &parsed_bsp = parsed.nodes[0].bsps[0];
+        ok = parsed_bsp.bsp3d_nodes.size() == bsp.bsp3d_nodes.size() && parsed_bsp.planes.size() == bsp.planes.size() && parsed_bsp.edges.size() == bsp.edges.size() && parsed_bsp.vertices.size() == bsp.vertices.size();
+        for(std::size_t i = 0; ok && i < bsp.bsp3d_nodes.size(); i++) {
+            ok = parsed_bsp.bsp3d_nodes[i].plane == bsp.bsp3d_nodes[i].plane && parsed_bsp.bsp3d_nodes[i].front_child.value == bsp.bsp3d_nodes[i].front_child.value && parsed_bsp.bsp3d_nodes[i].back_child.value == bsp.bsp3d_nodes[i].back_child.value;
+        }
+        for(std::size_t i = 0; ok && i < bsp.planes.size(); i++) {
+            ok = parsed_bsp.planes[i].plane.vector.i == bsp.planes[i].plane.vector.i && parsed_bsp.planes[i].plane.w == bsp.planes[i].plane.w;
+        }
+        for(std::size_t i = 0; ok && i < bsp.edges.size(); i++) {
+            ok = parsed_bsp.edges[i].start_vertex == bsp.edges[i].start_vertex && parsed_bsp.edges[i].right_surface == bsp.edges[i].right_surface;
+        }
+        for(std::size_t i = 0; ok && i < bsp.vertices.size(); i++) {
+            ok = parsed_bsp.vertices[i].point.z == bsp.vertices[i].point.z && parsed_bsp.vertices[i].first_edge == bsp.vertices[i].first_edge;
+        }
+        for(std::size_t i = 0; ok && i < tag.pathfinding_spheres.size(); i++) {
+            ok = parsed.pathfinding_spheres[i].node == tag.pathfinding_spheres[i].node && parsed.pathfinding_spheres[i].radius == tag.pathfinding_spheres[i].radius;
+        }
+    }
+
+    std::printf("model_collision_geometry round trip: %s\n", ok ? "ok" : "FAILED");
+    passed = passed && ok;
+}
+
+int main() {
+    CHECK_STRUCT(ScenarioStructureBSPPathfindingEdge);
+    CHECK_STRUCT(FontCharacterIndex);
+    CHECK_STRUCT(ModelTriangle);
+    CHECK_STRUCT(ScenarioStructureBSPSurface);
+    CHECK_STRUCT(ModelAnimationsRotation);
+    CHECK_STRUCT(ModelCollisionGeometryBSP3DNode);
+    CHECK_STRUCT(ScenarioDecal);
+    CHECK_STRUCT(ScenarioStructureBSPMaterialUncompressedLightmapVertex);
+    CHECK_STRUCT(ScenarioFiringPosition);
+    CHECK_STRUCT(ScenarioActorStartingLocation);
+    CHECK_STRUCT(ModelVertexCompressed);
+    CHECK_STRUCT(SkyAnimation);
+    CHECK_STRUCT(ScenarioStructureBSPFogRegion);
+    CHECK_STRUCT(ScenarioPlayerStartingLocation);
+    CHECK_STRUCT(ScenarioStructureBSPMaterialUncompressedRenderedVertex);
+    CHECK_STRUCT(CameraTrackControlPoint);
+    CHECK_STRUCT(ModelVertexUncompressed);
+    CHECK_STRUCT(ScenarioScenery);
+    CHECK_STRUCT(ScenarioWeapon);
+    CHECK_STRUCT(AntennaVertex);
+    CHECK_STRUCT(LightningShader);
+    CHECK_STRUCT(GlobalsDifficulty);
+
+    check_round_trip();
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
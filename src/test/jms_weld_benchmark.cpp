@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Times welding duplicate vertices (JMS::optimize()) on a generated JMS, optionally checking the result against the old pairwise weld.
+//
+// Usage: invader-benchmark-jms-weld [triangles] [vertices] [distinct vertices to pick from] [--reference]
+//
+// The defaults are 500000 triangles and 65535 vertices picked from 20000. The old weld is quadratic (and erases from the middle of the vertex
+// array for each duplicate), so --reference takes several minutes with the defaults.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <invader/model/jms.hpp>
+
+using namespace Invader;
+
+// How JMS::optimize() used to weld vertices: compare every pair, erasing each duplicate and fixing every triangle as it's found
+static void reference_optimize(JMS &jms) {
+    for(std::size_t v = 0; v < jms.vertices.size(); v++) {
+        for(std::size_t v2 = v + 1; v2 < jms.vertices.size(); v2++) {
+            if(jms.vertices[v] != jms.vertices[v2]) {
+                continue;
+            }
+            jms.vertices.erase(jms.vertices.begin() + v2);
+            for(auto &t : jms.triangles) {
+                for(auto &t2 : t.vertices) {
+                    if(t2 == v2) {
+                        t2 = static_cast<HEK::Index>(v);
+                    }
+                    else if(t2 > v2) {
+                        t2--;
+                    }
+                }
+            }
+            v2--;
+        }
+    }
+}
+
+static JMS generate_jms(std::size_t triangle_count, std::size_t vertex_count, std::size_t distinct_count) {
+    // Seeded, so every run is the same; 0.0 and -0.0 are both used since they have to be welded together
+    std::mt19937 random(1);
+    std::vector<JMS::Vertex> distinct(distinct_count);
+    for(auto &vertex : distinct) {
+        vertex.node0 = static_cast<HEK::Index>(random() % 4);
+        vertex.node1 = NULL_INDEX;
+        vertex.node1_weight = 0.0F;
+        vertex.position.x = static_cast<float>(random() % 1000);
+        vertex.position.y = static_cast<float>(random() % 1000);
+        vertex.position.z = (random() % 2) ? 0.0F : -0.0F;
+        vertex.normal.i = 0.0F;
+        vertex.normal.j = 0.0F;
+        vertex.normal.k = 1.0F;
+        vertex.texture_coordinates.x = static_cast<float>(random() % 7);
+        vertex.texture_coordinates.y = 0.0F;
+    }
+
+    JMS jms;
+    jms.vertices.reserve(vertex_count);
+    for(std::size_t v = 0; v < vertex_count; v++) {
+        jms.vertices.emplace_back(distinct[random() % distinct_count]);
+    }
+    jms.triangles.reserve(triangle_count);
+    for(std::size_t t = 0; t < triangle_count; t++) {
+        auto &triangle = jms.triangles.emplace_back();
+        triangle.region = 0;
+        triangle.shader = 0;
+        for(auto &v : triangle.vertices) {
+            v = static_cast<HEK::Index>(random() % vertex_count);
+        }
+    }
+    return jms;
+}
+
+static bool same_triangles(const JMS &a, const JMS &b) {
+    if(a.triangles.size() != b.triangles.size()) {
+        return false;
+    }
+    for(std::size_t t = 0; t < a.triangles.size(); t++) {
+        if(std::memcmp(a.triangles[t].vertices, b.triangles[t].vertices, sizeof(a.triangles[t].vertices)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, const char **argv) {
+    std::size_t counts[] = { 500000, 65535, 20000 };
+    std::size_t count_index = 0;
+    bool reference = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--reference") == 0) {
+            reference = true;
+            continue;
+        }
+        try {
+            int value = std::stoi(argv[i]);
+            if(value <= 0 || count_index >= sizeof(counts) / sizeof(*counts)) {
+                throw std::exception();
+            }
+            counts[count_index++] = static_cast<std::size_t>(value);
+        }
+        catch(std::exception &) {
+            std::fprintf(stderr, "Usage: %s [triangles] [vertices] [distinct vertices to pick from] [--reference]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto [triangle_count, vertex_count, distinct_count] = counts;
+    if(vertex_count > NULL_INDEX) {
+        std::fprintf(stderr, "A JMS can't have more than %zu vertices\n", static_cast<std::size_t>(NULL_INDEX));
+        return EXIT_FAILURE;
+    }
+
+    auto jms = generate_jms(triangle_count, vertex_count, distinct_count);
+    std::printf("Generated %zu triangles and %zu vertices\n", jms.triangles.size(), jms.vertices.size());
+
+    auto welded = jms;
+    auto start = std::chrono::steady_clock::now();
+    welded.optimize();
+    auto welded_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("optimize(): %zu vertices left in %.03f s\n", welded.vertices.size(), welded_time);
+
+    // Every triangle still has to point to the same vertex data
+    bool passed = true;
+    for(std::size_t t = 0; t < jms.triangles.size() && passed; t++) {
+        for(std::size_t v = 0; v < 3 && passed; v++) {
+            passed = jms.vertices[jms.triangles[t].vertices[v]] == welded.vertices[welded.triangles[t].vertices[v]];
+        }
+    }
+
+    if(reference) {
+        auto reference_welded = jms;
+        start = std::chrono::steady_clock::now();
+        reference_optimize(reference_welded);
+        auto reference_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("Pairwise weld: %zu vertices left in %.03f s (%.0fx slower)\n", reference_welded.vertices.size(), reference_time, reference_time / welded_time);
+        passed = passed && reference_welded.vertices == welded.vertices && same_triangles(reference_welded, welded);
+    }
+
+    std::printf("%s\n", passed ? "Output matches" : "Output does NOT match");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Times parsing every tag in a tags directory, both with the default memory resource and with a TagArena.
+//
+// Usage: invader-benchmark-parse <tags> [passes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <invader/file/file.hpp>
+#include <invader/tag/parser/parser.hpp>
+#include <invader/tag/parser/tag_arena.hpp>
+
+int main(int argc, const char **argv) {
+    using namespace Invader;
+
+    if(argc < 2 || argc > 3) {
+        std::fprintf(stderr, "Usage: %s <tags> [passes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::size_t passes = 3;
+    if(argc == 3) {
+        try {
+            int value = std::stoi(argv[2]);
+            if(value <= 0) {
+                throw std::exception();
+            }
+            passes = static_cast<std::size_t>(value);
+        }
+        catch(std::exception &) {
+            std::fprintf(stderr, "Invalid number of passes %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Read everything first so only parsing is timed, and leave out anything that doesn't parse
+    std::vector<std::vector<std::byte>> tags;
+    std::size_t total_size = 0;
+    std::size_t failed = 0;
+    for(auto &tag : File::load_virtual_tag_folder({ std::filesystem::path(argv[1]) })) {
+        auto data = File::open_file(tag.full_path);
+        if(!data.has_value()) {
+            failed++;
+            continue;
+        }
+        try {
+            Parser::ParserStruct::parse_hek_tag_file(data->data(), data->size(), false);
+        }
+        catch(std::exception &) {
+            failed++;
+            continue;
+        }
+        total_size += data->size();
+        tags.emplace_back(std::move(*data));
+    }
+    std::printf("Read %zu tag%s (%.03f MiB)\n", tags.size(), tags.size() == 1 ? "" : "s", total_size / 1024.0 / 1024.0);
+    if(failed > 0) {
+        std::printf("Skipped %zu tag%s that failed to load\n", failed, failed == 1 ? "" : "s");
+    }
+
+    Parser::TagArena tag_arena;
+    auto parse_all = [&tags, &tag_arena](bool use_arena) {
+        auto start = std::chrono::steady_clock::now();
+        for(auto &data : tags) {
+            auto *resource = use_arena ? tag_arena.next_tag(data.size()) : std::pmr::get_default_resource();
+            Parser::ParserStruct::parse_hek_tag_file(data.data(), data.size(), false, resource);
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // Alternate between the two so neither gets a warmer cache
+    double best_default = 0.0, best_arena = 0.0;
+    for(std::size_t p = 0; p < passes; p++) {
+        auto default_time = parse_all(false);
+        auto arena_time = parse_all(true);
+        std::printf("Pass %zu: default %.03f ms, arena %.03f ms\n", p + 1, default_time, arena_time);
+        best_default = p == 0 ? default_time : std::min(best_default, default_time);
+        best_arena = p == 0 ? arena_time : std::min(best_arena, arena_time);
+    }
+
+    std::printf("Best: default %.03f ms, arena %.03f ms (%.02fx)\n", best_default, best_arena, best_default / best_arena);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Watches a tags directory, moves a directory into a parent that is listed before its old parent, and checks that changes in the moved
+// directory are still picked up afterwards.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <invader/file/tag_index.hpp>
+
+static bool passed = true;
+
+static void check(bool condition, const char *what) {
+    std::printf("%s: %s\n", what, condition ? "ok" : "FAILED");
+    passed = passed && condition;
+}
+
+static void make_tag(const std::filesystem::path &path) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path).put('\0');
+}
+
+static bool has_tag(const Invader::File::TagIndex &index, const std::filesystem::path &tag_path) {
+    auto tags = index.get_tags();
+    return std::find_if(tags.begin(), tags.end(), [&tag_path](auto &tag) { return tag.tag_path == tag_path.string(); }) != tags.end();
+}
+
+int main() {
+    using namespace Invader::File;
+
+    auto tags = std::filesystem::temp_directory_path() / ("invader-test-tag-index-" + std::to_string(getpid()));
+    std::filesystem::remove_all(tags);
+    make_tag(tags / "a" / "rock.scenery");
+    make_tag(tags / "z" / "moved" / "sub" / "tree.scenery");
+
+    {
+        TagIndex index({ tags });
+        index.load();
+        if(!index.watch()) {
+            std::printf("Watching isn't supported here, so there is nothing to test\n");
+            std::filesystem::remove_all(tags);
+            return EXIT_SUCCESS;
+        }
+        index.update();
+
+        // "a" sorts before "z", so the new path is listed before the old path is removed
+        std::filesystem::rename(tags / "z" / "moved", tags / "a" / "moved");
+        check(index.update(), "move is noticed");
+        check(has_tag(index, std::filesystem::path("a") / "moved" / "sub" / "tree.scenery"), "moved tag is at its new path");
+        check(!has_tag(index, std::filesystem::path("z") / "moved" / "sub" / "tree.scenery"), "moved tag is gone from its old path");
+
+        // This is only seen if the moved directories are still watched
+        make_tag(tags / "a" / "moved" / "sub" / "bush.scenery");
+        make_tag(tags / "a" / "moved" / "boulder.scenery");
+        check(index.update(), "new tags in the moved directory are noticed");
+        check(has_tag(index, std::filesystem::path("a") / "moved" / "sub" / "bush.scenery"), "new tag in a moved subdirectory is listed");
+        check(has_tag(index, std::filesystem::path("a") / "moved" / "boulder.scenery"), "new tag in the moved directory is listed");
+
+        // Moving it back the other way should work, too
+        std::filesystem::rename(tags / "a" / "moved", tags / "z" / "moved");
+        check(index.update(), "move back is noticed");
+        make_tag(tags / "z" / "moved" / "sub" / "shrub.scenery");
+        check(index.update(), "new tag after moving back is noticed");
+        check(has_tag(index, std::filesystem::path("z") / "moved" / "sub" / "shrub.scenery"), "new tag after moving back is listed");
+        check(index.get_tags().size() == 5, "every tag is listed once");
+    }
+
+    std::filesystem::remove_all(tags);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
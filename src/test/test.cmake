@@ -0,0 +1,44 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+if(NOT DEFINED ${INVADER_TESTS})
+    set(INVADER_TESTS false CACHE BOOL "Build tests (run them with ctest)")
+endif()
+
+if(${INVADER_TESTS})
+    enable_testing()
+
+    if(${INVADER_USE_AUDIO})
+        add_executable(invader-test-xbox-adpcm
+            src/test/xbox_adpcm.cpp
+        )
+        target_link_libraries(invader-test-xbox-adpcm invader)
+        add_test(NAME xbox-adpcm COMMAND invader-test-xbox-adpcm)
+    endif()
+
+    add_executable(invader-test-bulk-swap
+        src/test/bulk_swap.cpp
+    )
+    target_link_libraries(invader-test-bulk-swap invader)
+    add_test(NAME bulk-swap COMMAND invader-test-bulk-swap)
+
+    # Watching tags directories is only supported on Linux
+    if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+        add_executable(invader-test-tag-index
+            src/test/tag_index.cpp
+        )
+        target_link_libraries(invader-test-tag-index invader)
+        add_test(NAME tag-index COMMAND invader-test-tag-index)
+    endif()
+
+    # Not run by ctest since it needs a tags directory (invader-benchmark-parse <tags> [passes])
+    add_executable(invader-benchmark-parse
+        src/test/parse_benchmark.cpp
+    )
+    target_link_libraries(invader-benchmark-parse invader)
+
+    # Not run by ctest either (invader-benchmark-jms-weld [triangles] [vertices] [distinct vertices to pick from] [--reference])
+    add_executable(invader-benchmark-jms-weld
+        src/test/jms_weld_benchmark.cpp
+    )
+    target_link_libraries(invader-benchmark-jms-weld invader)
+endif()
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Encodes a fixed signal to Xbox ADPCM serially and in parallel, and checks that encoding ranges of blocks in parallel doesn't cost any
+// meaningful signal-to-noise ratio compared to the serial encoder.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <invader/sound/sound_encoder.hpp>
+#include <invader/sound/sound_reader.hpp>
+#include <invader/thread_pool.hpp>
+
+static constexpr std::size_t CHANNEL_COUNT = 2;
+static constexpr std::size_t SAMPLE_RATE = 44100;
+static constexpr std::size_t SECONDS = 10;
+
+// How much worse (in dB) the parallel encoder may be than the serial encoder
+static constexpr double MAX_SNR_LOSS = 0.02;
+
+static std::vector<std::int16_t> generate_signal() {
+    static constexpr double PI = 3.14159265358979323846;
+    std::size_t frame_count = SAMPLE_RATE * SECONDS;
+    std::vector<std::int16_t> samples(frame_count * CHANNEL_COUNT);
+
+    // Tones with a slow swell, a high tone, and some noise (seeded, so every run is the same)
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0.0, 0.02);
+    for(std::size_t f = 0; f < frame_count; f++) {
+        double t = static_cast<double>(f) / SAMPLE_RATE;
+        for(std::size_t c = 0; c < CHANNEL_COUNT; c++) {
+            double value = 0.4 * std::sin(2.0 * PI * (220.0 + 30.0 * c) * t) * (0.5 + 0.5 * std::sin(t)) + 0.2 * std::sin(2.0 * PI * 3150.0 * t) + noise(random);
+            samples[f * CHANNEL_COUNT + c] = static_cast<std::int16_t>(std::clamp(value, -1.0, 1.0) * 32767.0);
+        }
+    }
+
+    return samples;
+}
+
+static double signal_to_noise_ratio(const std::vector<std::int16_t> &reference, const std::vector<std::byte> &decoded_pcm) {
+    std::size_t sample_count = std::min(reference.size(), decoded_pcm.size() / sizeof(std::int16_t));
+    double signal = 0.0;
+    double noise = 0.0;
+    for(std::size_t i = 0; i < sample_count; i++) {
+        std::int16_t decoded;
+        std::memcpy(&decoded, decoded_pcm.data() + i * sizeof(decoded), sizeof(decoded));
+        double difference = static_cast<double>(reference[i]) - decoded;
+        signal += static_cast<double>(reference[i]) * reference[i];
+        noise += difference * difference;
+    }
+    return 10.0 * std::log10(signal / noise);
+}
+
+int main() {
+    using namespace Invader;
+
+    auto samples = generate_signal();
+    std::vector<std::byte> pcm(samples.size() * sizeof(samples[0]));
+    std::memcpy(pcm.data(), samples.data(), pcm.size());
+
+    // The ranges don't depend on the thread count, so this gives the same output on any machine
+    ThreadPool thread_pool(4);
+
+    bool passed = true;
+    for(std::size_t lookahead : { static_cast<std::size_t>(0), static_cast<std::size_t>(1), SoundEncoder::DEFAULT_XBOX_ADPCM_LOOKAHEAD }) {
+        auto serial = SoundEncoder::encode_to_xbox_adpcm(pcm, 16, CHANNEL_COUNT, lookahead);
+        auto parallel = SoundEncoder::encode_to_xbox_adpcm(pcm, 16, CHANNEL_COUNT, lookahead, &thread_pool);
+        if(serial.size() != parallel.size()) {
+            std::printf("lookahead %zu: serial output is %zu bytes, but parallel output is %zu bytes\n", lookahead, serial.size(), parallel.size());
+            passed = false;
+            continue;
+        }
+
+        auto serial_snr = signal_to_noise_ratio(samples, SoundReader::sound_from_xbox_adpcm(serial.data(), serial.size(), CHANNEL_COUNT, SAMPLE_RATE).pcm);
+        auto parallel_snr = signal_to_noise_ratio(samples, SoundReader::sound_from_xbox_adpcm(parallel.data(), parallel.size(), CHANNEL_COUNT, SAMPLE_RATE).pcm);
+        bool ok = parallel_snr >= serial_snr - MAX_SNR_LOSS;
+        std::printf("lookahead %zu: serial %.3f dB, parallel %.3f dB (%+.3f dB)%s\n", lookahead, serial_snr, parallel_snr, parallel_snr - serial_snr, ok ? "" : " FAILED");
+        passed = passed && ok;
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}